@@ -0,0 +1,62 @@
+/**
+ * @file board_bench.cpp
+ * @brief 共享内存占用看板的读取示例和读取延迟测试
+ *
+ * 用法：./board_bench [共享内存名称] [读取次数]
+ * 只依赖occupancy_board.h，与本机的显示屏、道闸程序读取看板的方式相同：
+ * 先打印一次看板内容，再连续读取，统计每次读取的平均耗时和与写入冲突而重读的次数。
+ * 读取期间可以对服务器施加入场/出场负载，观察写入对读取的影响
+ */
+#include "occupancy_board.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+void printSnapshot(const OccupancyBoardSnapshot& snapshot) {
+    std::printf("capacity %u, occupied %u, available %u, updated at %lld, %s\n",
+                snapshot.capacity, snapshot.occupied, snapshot.available,
+                static_cast<long long>(snapshot.updatedAt),
+                OccupancyBoardReader::alive(snapshot) ? "server alive" : "server stale");
+    for (uint32_t i = 0; i < snapshot.zoneCount; ++i) {
+        std::printf("  %-8s %u\n", snapshot.zones[i].name, snapshot.zones[i].occupied);
+    }
+}
+}
+
+int main(int argc, char* argv[]) {
+    std::string name = argc > 1 ? argv[1] : "/parking_board";
+    size_t reads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+
+    OccupancyBoardReader board;
+    if (!board.open(name)) {
+        std::fprintf(stderr, "Cannot open occupancy board %s (is the server running with PARKING_BOARD?)\n", name.c_str());
+        return 1;
+    }
+    OccupancyBoardSnapshot snapshot;
+    board.read(snapshot);
+    printSnapshot(snapshot);
+
+    uint64_t retries = 0;
+    uint64_t changes = 0;
+    int64_t lastUpdate = snapshot.updatedAt;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < reads; ++i) {
+        board.read(snapshot);
+        retries += snapshot.retries;
+        if (snapshot.updatedAt != lastUpdate) {
+            lastUpdate = snapshot.updatedAt;
+            ++changes;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("\n%zu reads in %.3f s: %.1f ns/read, %llu retries, %llu updates observed\n",
+                reads, seconds, reads > 0 ? seconds * 1e9 / reads : 0.0,
+                static_cast<unsigned long long>(retries), static_cast<unsigned long long>(changes));
+    printSnapshot(snapshot);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file storage_bench.cpp
+ * @brief 各存储引擎的写入延迟和事件扫描吞吐量对比
+ *
+ * 用法：./storage_bench [入场/出场次数] [扫描的事件数] [并发线程数]
+ * 1. 写入延迟：用每种引擎创建一个停车场，交替入场、出场，统计每次操作（含持久化）的耗时；
+ *    数据文件引擎每次重写快照，另两种引擎只追加事件，积累到快照间隔才写快照；
+ *    日志引擎的耗时包括等待事件所在的提交组fdatasync。再用多个线程同时入场、出场，
+ *    日志引擎并发时每个提交组包含多个事件，吞吐量随线程数增加
+ * 2. 扫描吞吐量：直接向引擎追加事件，再按序号顺序全部扫描一遍，并按车牌查找；
+ *    数据文件引擎不单独保存事件，不参与这一项
+ */
+#include "parking_lot.h"
+#include "storage_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+const char* const ENGINES[] = {"file", "log", "sqlite"};
+const size_t PARKED = 200;  // 写入测试中保持在场的车辆数
+
+double elapsedMicros(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double>& values, double fraction) {
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// 每种引擎使用单独的空目录
+std::string freshDirectory(const std::string& name) {
+    fs::path directory = fs::temp_directory_path() / ("storage_bench_" + name);
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    return (directory / "parking_data.dat").string();
+}
+
+// 第thread个写入线程使用的车牌，各线程互不重复
+std::string plateOf(size_t i, unsigned thread = 0) {
+    return std::string("苏") + static_cast<char>('B' + thread) + std::to_string(10000 + i % 90000);
+}
+
+// 先入场PARKED辆，之后每辆新车入场前让最早的一辆出场，记录每次操作的耗时
+void runWrites(ParkingLot& lot, size_t operations, unsigned thread, std::vector<double>& latencies) {
+    latencies.reserve(operations);
+    for (size_t i = 0; latencies.size() < operations; ++i) {
+        if (i >= PARKED) {
+            Vehicle exited;
+            Clock::time_point start = Clock::now();
+            lot.removeVehicle(plateOf(i - PARKED, thread), exited);
+            latencies.push_back(elapsedMicros(start));
+        }
+        Clock::time_point start = Clock::now();
+        lot.addVehicle(plateOf(i, thread), i % 3 ? "小型" : "大型");
+        latencies.push_back(elapsedMicros(start));
+    }
+}
+
+void benchmarkWrites(const std::string& engine, size_t operations, unsigned threads) {
+    ParkingLot lot(PARKED * threads + 1, 500, 800, freshDirectory(engine), engine);
+    std::vector<std::vector<double>> perThread(threads);
+
+    Clock::time_point total = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(runWrites, std::ref(lot), operations / threads, t, std::ref(perThread[t]));
+    }
+    runWrites(lot, operations / threads, 0, perThread[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = elapsedMicros(total) / 1e6;
+
+    std::vector<double> latencies;
+    for (const auto& values : perThread) {
+        latencies.insert(latencies.end(), values.begin(), values.end());
+    }
+
+    double mean = 0;
+    for (double latency : latencies) {
+        mean += latency;
+    }
+    mean /= latencies.size();
+    std::printf("%-8s %10zu %10.1f %10.1f %10.1f %12.0f\n", engine.c_str(), latencies.size(), mean,
+                percentile(latencies, 0.5), percentile(latencies, 0.99), latencies.size() / seconds);
+}
+
+void benchmarkScan(const std::string& engine, size_t events) {
+    // 直接追加到引擎，不经过ParkingLot。日志引擎在有基准快照之后才接受事件，
+    // 先写一个空快照，之后不再写快照，事件全部保留
+    std::unique_ptr<StorageEngine> storage = createStorageEngine(engine, freshDirectory(engine + "_scan"));
+    if (!storage->writeSnapshot(std::string())) {
+        std::cerr << engine << ": snapshot failed" << std::endl;
+        return;
+    }
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < events; ++i) {
+        StorageEvent event;
+        event.kind = i % 2 ? StorageEventKind::Exit : StorageEventKind::Entry;
+        event.plate = plateOf(i / 2);
+        event.type = "小型";
+        event.entryTime = 1760000000 + static_cast<time_t>(i);
+        event.exitTime = i % 2 ? event.entryTime + 3600 : 0;
+        event.fee = i % 2 ? 500 : 0;
+        if (!storage->append(event)) {
+            std::cerr << engine << ": append failed" << std::endl;
+            return;
+        }
+    }
+    double appendSeconds = elapsedMicros(start) / 1e6;
+
+    size_t scanned = 0;
+    start = Clock::now();
+    storage->scan(0, storage->lastSequence(), [&](const StorageEvent&) {
+        ++scanned;
+        return true;
+    });
+    double scanSeconds = elapsedMicros(start) / 1e6;
+
+    const size_t lookups = 20;
+    size_t found = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        found += storage->lookup(plateOf(i * 7919 % (events / 2))).size();
+    }
+    double lookupMicros = elapsedMicros(start) / lookups;
+
+    std::printf("%-8s %10zu %12.0f %12.0f %12.1f %8zu\n", engine.c_str(), scanned, events / appendSeconds,
+                scanned / scanSeconds, lookupMicros, found);
+}
+}
+
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    size_t events = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+    unsigned threads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 8;
+    threads = std::max(1u, std::min(threads, 24u));  // 每个线程的车牌以不同字母开头
+    try {
+        std::printf("Write latency (%zu entries/exits through ParkingLot, microseconds)\n", operations);
+        std::printf("%-8s %10s %10s %10s %10s %12s\n", "engine", "ops", "mean", "p50", "p99", "ops/s");
+        for (const char* engine : ENGINES) {
+            benchmarkWrites(engine, operations, 1);
+        }
+
+        std::printf("\nConcurrent writes (%u threads, %zu entries/exits in total, microseconds)\n", threads, operations);
+        std::printf("%-8s %10s %10s %10s %10s %12s\n", "engine", "ops", "mean", "p50", "p99", "ops/s");
+        for (const char* engine : ENGINES) {
+            benchmarkWrites(engine, operations, threads);
+        }
+
+        std::printf("\nEvent scan (%zu events appended directly to the engine)\n", events);
+        std::printf("%-8s %10s %12s %12s %12s %8s\n", "engine", "scanned", "append/s", "scan/s", "lookup us", "found");
+        for (const char* engine : ENGINES) {
+            if (std::string(engine) != "file") {
+                benchmarkScan(engine, events);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark error: " << e.what() << std::endl;
+        return 1;
+    }
+    for (const char* engine : ENGINES) {
+        fs::remove_all(fs::temp_directory_path() / (std::string("storage_bench_") + engine));
+        fs::remove_all(fs::temp_directory_path() / (std::string("storage_bench_") + engine + "_scan"));
+    }
+    return 0;
+}
@@ -19,6 +19,8 @@
  */
 
 #include "include/api_server.h"
+#include "include/columnar_export.h"
+#include "include/history_query.h"
 #include <sys/socket.h>     // 提供Socket API
 #include <netinet/in.h>     // 提供网络地址结构
 #include <unistd.h>         // 提供Unix标准系统调用
@@ -31,6 +33,9 @@
 #include <iomanip>         // 输出格式控制
 #include <fstream>         // 文件操作
 #include <filesystem>      // 文件系统操作(C++17)
+#include <chrono>          // 后台线程定时
+#include <cerrno>          // send的错误码
+#include <cctype>          // 停车场编号校验
 
 namespace fs = std::filesystem;
 
@@ -108,11 +113,15 @@ std::string urlDecode(const std::string& encoded) {
 /**
  * @brief ParkingApiServer构造函数
  * @param capacity 停车场容量
- * @param smallRate 小型车每小时费率
- * @param largeRate 大型车每小时费率
+ * @param smallRate 小型车每小时费率（分/小时）
+ * @param largeRate 大型车每小时费率（分/小时）
+ * @param storageEngine 停车场数据的存储引擎（file、log或sqlite）
+ * @param dataFile 默认停车场的数据文件路径（同一台机器上运行主节点和备用节点时须不同）
+ * @param workerThreads 处理连接的工作线程数
+ * @param taskThreads 后台任务调度器的线程数，0表示按CPU核数
  * 
  * 初始化过程：
- * 1. 创建停车场管理对象
+ * 1. 创建默认停车场，再载入dataFile + ".lots"目录下已创建的其他停车场
  * 2. 初始化服务器socket为-1（未创建）
  * 3. 设置运行状态为false
  * 4. 初始化路由表
@@ -121,11 +130,125 @@ std::string urlDecode(const std::string& encoded) {
  * - 使用智能指针管理ParkingLot对象
  * - 构造函数不会创建socket或启动服务器
  */
-ParkingApiServer::ParkingApiServer(size_t capacity, double smallRate, double largeRate) 
-    : parkingLot(std::make_unique<ParkingLot>(capacity, smallRate, largeRate))
-    , serverSocket(-1)
-    , running(false) {
+ParkingApiServer::ParkingApiServer(size_t capacity, Cents smallRate, Cents largeRate, const std::string& storageEngine,
+                                   const std::string& dataFile, size_t workerThreads, size_t taskThreads)
+    : serverSocket(-1)
+    , running(false)
+    , storageEngine(storageEngine)
+    , defaultShard(nullptr)
+    , workerCount(std::max<size_t>(1, workerThreads))
+    , scheduler(taskThreads)
+    , dataFile(dataFile)
+    , standby(false) {
     initializeRoutes();  // 初始化路由表
+
+    std::unique_lock<std::shared_mutex> lock(lotsMutex);
+    defaultShard = &addLot("default", std::make_unique<PartitionedLot>(
+        std::make_unique<ParkingLot>(capacity, smallRate, largeRate, dataFile, storageEngine)));
+
+    // 其他停车场各占一个子目录，目录名即编号；容量和费率从各自的数据文件读取。
+    // 分区停车场的子目录下是p0、p1...各分区的目录
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(dataFile + ".lots", error)) {
+        std::string id = entry.path().filename().string();
+        if (!entry.is_directory() || !isValidLotId(id) || id == "default") {
+            continue;
+        }
+        size_t partitions = 0;
+        while (partitions < PartitionedLot::MAX_PARTITIONS &&
+               fs::is_directory(fs::path(lotDataFile(id, partitions)).parent_path())) {
+            ++partitions;
+        }
+        std::vector<std::unique_ptr<ParkingLot>> parts;
+        if (partitions == 0) {
+            parts.push_back(std::make_unique<ParkingLot>(capacity, smallRate, largeRate, lotDataFile(id), storageEngine));
+        }
+        for (size_t k = 0; k < partitions; ++k) {
+            parts.push_back(std::make_unique<ParkingLot>(capacity, smallRate, largeRate, lotDataFile(id, k), storageEngine));
+        }
+        addLot(id, std::make_unique<PartitionedLot>(std::move(parts), lotSeriesFile(id)));
+        std::cout << "Loaded parking lot " << id;
+        if (partitions > 0) {
+            std::cout << " (" << partitions << " partitions)";
+        }
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * @brief 加入一个停车场分片，调用者持有lotsMutex的写锁
+ * 超时告警由停车场主动推送给服务器，记入该分片的告警队列
+ */
+ParkingApiServer::LotShard& ParkingApiServer::addLot(const std::string& id, std::unique_ptr<PartitionedLot> lot) {
+    auto shard = std::make_unique<LotShard>();
+    shard->id = id;
+    shard->lot = std::move(lot);
+    LotShard* raw = shard.get();
+    raw->lot->setOverstayListener([this, raw](const OverstayEvent& event) {
+        onOverstay(*raw, event);
+    });
+    // 快照等后台工作交给调度器；调度器已停止时返回false，由停车场同步执行
+    raw->lot->setBackgroundExecutor([this](const std::string& type, std::function<void()> task) {
+        return !scheduler.submit(type, TaskPriority::Normal, std::move(task)).cancelled();
+    });
+    lots[id] = std::move(shard);
+    return *raw;
+}
+
+/**
+ * @brief 按编号查找停车场分片
+ * @return 不存在时返回nullptr；分片创建后不会删除，返回的指针一直有效
+ */
+ParkingApiServer::LotShard* ParkingApiServer::findLot(const std::string& id) const {
+    std::shared_lock<std::shared_mutex> lock(lotsMutex);
+    auto it = lots.find(id);
+    return it != lots.end() ? it->second.get() : nullptr;
+}
+
+/**
+ * @brief 全部停车场分片（按编号排列），供后台线程和汇总状态遍历
+ */
+std::vector<ParkingApiServer::LotShard*> ParkingApiServer::allLots() const {
+    std::shared_lock<std::shared_mutex> lock(lotsMutex);
+    std::vector<LotShard*> result;
+    result.reserve(lots.size());
+    for (const auto& entry : lots) {
+        result.push_back(entry.second.get());
+    }
+    return result;
+}
+
+/**
+ * @brief 非默认停车场的数据文件路径，段目录等都在同一个子目录中
+ */
+std::string ParkingApiServer::lotDataFile(const std::string& id) const {
+    return dataFile + ".lots/" + id + "/parking_data.dat";
+}
+
+/**
+ * @brief 分区停车场第partition个分区的数据文件路径
+ */
+std::string ParkingApiServer::lotDataFile(const std::string& id, size_t partition) const {
+    return dataFile + ".lots/" + id + "/p" + std::to_string(partition) + "/parking_data.dat";
+}
+
+/**
+ * @brief 分区停车场整个停车场的占用时间序列文件，在各分区目录的上一级
+ */
+std::string ParkingApiServer::lotSeriesFile(const std::string& id) const {
+    return lotDataFile(id) + ".occupancy";
+}
+
+/**
+ * @brief 停车场编号只允许字母、数字、'-'和'_'，最长32个字符（同时用作目录名）
+ */
+bool ParkingApiServer::isValidLotId(const std::string& id) {
+    if (id.empty() || id.size() > 32) {
+        return false;
+    }
+    return std::all_of(id.begin(), id.end(), [](unsigned char c) {
+        return std::isalnum(c) || c == '-' || c == '_';
+    });
 }
 
 /**
@@ -204,7 +327,7 @@ HttpResponse ParkingApiServer::handleStaticFile(const std::string& path) {
     // 设置CORS相关头部
     response.headers["Access-Control-Allow-Origin"] = "*";
     response.headers["Access-Control-Allow-Methods"] = "GET, POST, PUT, DELETE, OPTIONS";
-    response.headers["Access-Control-Allow-Headers"] = "Content-Type";
+    response.headers["Access-Control-Allow-Headers"] = "Content-Type, Idempotency-Key";
     response.body = content;
     return response;
 }
@@ -215,6 +338,8 @@ HttpResponse ParkingApiServer::handleStaticFile(const std::string& path) {
  */
 ParkingApiServer::~ParkingApiServer() {
     stop();
+    // 看板先于停车场析构，之后不再回调
+    defaultShard->lot->partition(0).setOccupancyListener(nullptr);
 }
 
 /**
@@ -237,8 +362,8 @@ ParkingApiServer::~ParkingApiServer() {
  * - 接受连接失败
  * 
  * 并发处理：
- * - 每个客户端连接在独立线程中处理
- * - 使用detach模式避免资源泄漏
+ * - 接受的连接放入队列，由固定数量的工作线程处理，全部停车场共用
+ * - 等待处理的连接过多时直接返回503，不再排队
  */
 void ParkingApiServer::start(uint16_t port) {
     // 1. 创建服务器socket
@@ -274,6 +399,18 @@ void ParkingApiServer::start(uint16_t port) {
     running = true;
     std::cout << "Server started on port " << port << std::endl;
 
+    // 启动工作线程
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&ParkingApiServer::runWorker, this);
+    }
+    // 每秒检查一次超时车辆，每秒为有待清理数据的停车场提交清理任务
+    alertTask = scheduler.scheduleEvery("overstay-check", TaskPriority::High, std::chrono::seconds(1),
+                                        [this] { checkOverstays(); });
+    retentionTask = scheduler.scheduleEvery("retention-tick", TaskPriority::Low, std::chrono::seconds(1),
+                                            [this] { scheduleRetention(); });
+    seriesTask = scheduler.scheduleEvery("occupancy-save", TaskPriority::Low, OCCUPANCY_SAVE_INTERVAL,
+                                         [this] { saveOccupancySeries(); });
+
     while (running) {
         sockaddr_in clientAddr{};
         socklen_t clientLen = sizeof(clientAddr);
@@ -284,22 +421,62 @@ void ParkingApiServer::start(uint16_t port) {
             continue;
         }
 
-        // 创建新线程处理客户端请求
-        std::thread([this, clientSocket]() {
-            try {
-                // 解析请求并生成响应
-                HttpRequest request = parseRequest(clientSocket);
-                HttpResponse response = routeRequest(request);
-                sendResponse(clientSocket, response);
-            } catch (const std::exception& e) {
-                // 处理请求过程中的任何异常
-                HttpResponse errorResponse(500);
-                errorResponse.body = createJsonResponse(false, e.what());
-                sendResponse(clientSocket, errorResponse);
+        // 交给工作线程处理
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(clientMutex);
+            if (pendingClients.size() < MAX_PENDING_CLIENTS) {
+                pendingClients.push_back(clientSocket);
+                queued = true;
+            }
+        }
+        if (queued) {
+            clientReady.notify_one();
+        } else {
+            HttpResponse busy(503);
+            busy.body = createJsonResponse(false, "Server busy");
+            sendResponse(clientSocket, busy);
+            close(clientSocket);
+        }
+    }
+}
+
+/**
+ * @brief 工作线程主循环
+ * 从队列中取出已接受的连接逐个处理，服务器停止时退出
+ */
+void ParkingApiServer::runWorker() {
+    while (true) {
+        int clientSocket;
+        {
+            std::unique_lock<std::mutex> lock(clientMutex);
+            clientReady.wait(lock, [this] { return !running || !pendingClients.empty(); });
+            if (pendingClients.empty()) {
+                return;  // 已停止且没有待处理的连接
             }
-            close(clientSocket);  // 确保连接被关闭
-        }).detach();  // 分离线程，避免资源泄漏
+            clientSocket = pendingClients.front();
+            pendingClients.pop_front();
+        }
+        serveClient(clientSocket);
+    }
+}
+
+/**
+ * @brief 处理一个连接上的请求并关闭连接
+ */
+void ParkingApiServer::serveClient(int clientSocket) {
+    try {
+        // 解析请求并生成响应
+        HttpRequest request = parseRequest(clientSocket);
+        HttpResponse response = routeRequest(request);
+        sendResponse(clientSocket, response);
+    } catch (const std::exception& e) {
+        // 处理请求过程中的任何异常
+        HttpResponse errorResponse(500);
+        errorResponse.body = createJsonResponse(false, e.what());
+        sendResponse(clientSocket, errorResponse);
     }
+    close(clientSocket);  // 确保连接被关闭
 }
 
 /**
@@ -312,6 +489,57 @@ void ParkingApiServer::stop() {
         close(serverSocket);
         serverSocket = -1;
     }
+    {
+        // 加锁后再通知，避免工作线程检查完running、尚未等待时错过通知
+        std::lock_guard<std::mutex> lock(clientMutex);
+    }
+    clientReady.notify_all();
+    for (std::thread& worker : workers) {
+        if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+            worker.join();
+        }
+    }
+    // 取消尚未执行的后台任务，等待正在执行的任务结束
+    alertTask.cancel();
+    retentionTask.cancel();
+    seriesTask.cancel();
+    scheduler.shutdown();
+    saveOccupancySeries();  // 正常退出时保存最后一次定期保存之后的点
+    std::lock_guard<std::mutex> lock(replicationMutex);
+    if (follower) {
+        follower->stop();
+    }
+    if (publisher) {
+        publisher->stop();
+    }
+}
+
+/**
+ * @brief 开启主备复制
+ * 主节点在socket上发布变更；备用节点连接该socket跟随主节点，基准段文件暂存在数据文件旁的目录中
+ */
+void ParkingApiServer::startReplication(const std::string& socketPath, bool asStandby) {
+    std::lock_guard<std::mutex> lock(replicationMutex);
+    replicationSocket = socketPath;
+    if (asStandby) {
+        standby = true;
+        follower = std::make_unique<ReplicationFollower>(defaultShard->lot->partition(0), socketPath, dataFile + ".replica");
+    } else {
+        publisher = std::make_unique<ReplicationPublisher>(defaultShard->lot->partition(0), socketPath);
+    }
+}
+
+/**
+ * @brief 开启共享内存占用看板
+ * 每次占用变化时在停车场的锁内写入看板（停车场的锁保证只有一个写入者），超时检查线程每秒更新心跳
+ */
+void ParkingApiServer::startOccupancyBoard(const std::string& name) {
+    occupancyBoard = std::make_unique<OccupancyBoard>(name);
+    OccupancyBoard* board = occupancyBoard.get();
+    defaultShard->lot->partition(0).setOccupancyListener(
+        [board](size_t capacity, size_t occupied, const std::map<std::string, size_t>& byType) {
+            board->publish(capacity, occupied, byType);
+        });
 }
 
 /**
@@ -323,38 +551,136 @@ void ParkingApiServer::initializeRoutes() {
     routes = {
         // 处理车辆入场请求 POST /api/vehicle
         {"POST", "/api/vehicle", 
-         std::bind(&ParkingApiServer::handleAddVehicle, this, std::placeholders::_1), 
+         std::bind(&ParkingApiServer::handleAddVehicle, this, std::placeholders::_1, std::placeholders::_2), 
          false},  // false表示精确匹配路径
 
         // 处理车辆出场请求 DELETE /api/vehicle/{车牌号}
         {"DELETE", "/api/vehicle/", 
-         std::bind(&ParkingApiServer::handleRemoveVehicle, this, std::placeholders::_1), 
+         std::bind(&ParkingApiServer::handleRemoveVehicle, this, std::placeholders::_1, std::placeholders::_2), 
          true},   // true表示前缀匹配,因为后面还有动态参数(车牌号)
 
+        // 查询车辆全部停车记录 GET /api/vehicle/{车牌号}/visits
+        // 必须排在下面的前缀路由之前
+        {"GET", "/api/vehicle/",
+         std::bind(&ParkingApiServer::handleGetVehicleVisits, this, std::placeholders::_1, std::placeholders::_2),
+         true, "/visits"},
+
         // 查询车辆信息 GET /api/vehicle/{车牌号}
         {"GET", "/api/vehicle/", 
-         std::bind(&ParkingApiServer::handleQueryVehicle, this, std::placeholders::_1), 
+         std::bind(&ParkingApiServer::handleQueryVehicle, this, std::placeholders::_1, std::placeholders::_2), 
          true},   // 同样使用前缀匹配
 
         // 获取停车场状态 GET /api/status
         {"GET", "/api/status", 
-         std::bind(&ParkingApiServer::handleGetParkingStatus, this, std::placeholders::_1), 
+         std::bind(&ParkingApiServer::handleGetParkingStatus, this, std::placeholders::_1, std::placeholders::_2), 
          false},
 
         // 更新停车费率 PUT /api/rate
         {"PUT", "/api/rate", 
-         std::bind(&ParkingApiServer::handleSetRate, this, std::placeholders::_1), 
+         std::bind(&ParkingApiServer::handleSetRate, this, std::placeholders::_1, std::placeholders::_2), 
          false},
 
         // 获取历史记录 GET /api/history
         {"GET", "/api/history", 
-         std::bind(&ParkingApiServer::handleGetHistory, this, std::placeholders::_1), 
+         std::bind(&ParkingApiServer::handleGetHistory, this, std::placeholders::_1, std::placeholders::_2), 
+         false},
+
+        // 历史记录过滤/聚合查询 GET /api/history/query?type=&minDuration=&maxFee=&groupBy=
+        {"GET", "/api/history/query",
+         std::bind(&ParkingApiServer::handleQueryHistory, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 历史记录分层存储状态 GET /api/history/storage
+        {"GET", "/api/history/storage",
+         std::bind(&ParkingApiServer::handleGetHistoryStorage, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 设置热段窗口和冷段缓存预算 PUT /api/history/storage
+        {"PUT", "/api/history/storage",
+         std::bind(&ParkingApiServer::handleSetHistoryStorage, this, std::placeholders::_1, std::placeholders::_2),
          false},
 
         // 获取当前在场车辆 GET /api/current-vehicles
         {"GET", "/api/current-vehicles", 
-         std::bind(&ParkingApiServer::handleGetCurrentVehicles, this, std::placeholders::_1), 
-         false}
+         std::bind(&ParkingApiServer::handleGetCurrentVehicles, this, std::placeholders::_1, std::placeholders::_2), 
+         false},
+
+        // 获取超时停车告警 GET /api/alerts/overstay?since={序号}
+        {"GET", "/api/alerts/overstay",
+         std::bind(&ParkingApiServer::handleGetOverstayAlerts, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 设置车型停车时限 PUT /api/alerts/overstay
+        {"PUT", "/api/alerts/overstay",
+         std::bind(&ParkingApiServer::handleSetOverstayLimit, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 营收和车次汇总 GET /api/stats/revenue?granularity=hour|day&from=&to=
+        {"GET", "/api/stats/revenue",
+         std::bind(&ParkingApiServer::handleGetRevenueStats, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 占用车位数时间序列 GET /api/stats/occupancy?resolution=second|minute|hour&from=&to=
+        {"GET", "/api/stats/occupancy",
+         std::bind(&ParkingApiServer::handleGetOccupancyStats, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 停车时长和费用分位数 GET /api/stats/distribution?from=&to=&type=
+        {"GET", "/api/stats/distribution",
+         std::bind(&ParkingApiServer::handleGetDistributionStats, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 常客Top-K GET /api/stats/frequent-visitors?days=7&limit=10
+        {"GET", "/api/stats/frequent-visitors",
+         std::bind(&ParkingApiServer::handleGetFrequentVisitors, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 占用预测 GET /api/forecast?horizon={分钟}
+        {"GET", "/api/forecast",
+         std::bind(&ParkingApiServer::handleGetForecast, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 导出历史记录CSV GET /api/export/history.csv?from=&to=
+        {"GET", "/api/export/history.csv",
+         std::bind(&ParkingApiServer::handleExportHistoryCsv, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 导出历史记录Arrow IPC流 GET /api/export/history.arrow?from=&to=
+        {"GET", "/api/export/history.arrow",
+         std::bind(&ParkingApiServer::handleExportHistoryArrow, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 导出历史记录Parquet文件 GET /api/export/history.parquet?from=&to=
+        {"GET", "/api/export/history.parquet",
+         std::bind(&ParkingApiServer::handleExportHistoryParquet, this, std::placeholders::_1, std::placeholders::_2),
+         false},
+
+        // 以下接口属于整个服务器，不能通过/api/lots/{编号}访问
+
+        // 主备复制状态和延迟 GET /api/replication（复制默认停车场）
+        {"GET", "/api/replication",
+         std::bind(&ParkingApiServer::handleGetReplication, this, std::placeholders::_1, std::placeholders::_2),
+         false, "", false},
+
+        // 提升备用节点为主节点 POST /api/replication/promote
+        {"POST", "/api/replication/promote",
+         std::bind(&ParkingApiServer::handlePromote, this, std::placeholders::_1, std::placeholders::_2),
+         false, "", false},
+
+        // 全部停车场及汇总状态 GET /api/lots
+        {"GET", "/api/lots",
+         std::bind(&ParkingApiServer::handleGetLots, this, std::placeholders::_1, std::placeholders::_2),
+         false, "", false},
+
+        // 创建停车场 POST /api/lots
+        {"POST", "/api/lots",
+         std::bind(&ParkingApiServer::handleCreateLot, this, std::placeholders::_1, std::placeholders::_2),
+         false, "", false},
+
+        // 后台任务调度器状态和各类任务的CPU时间 GET /api/scheduler
+        {"GET", "/api/scheduler",
+         std::bind(&ParkingApiServer::handleGetScheduler, this, std::placeholders::_1, std::placeholders::_2),
+         false, "", false}
     };
 }
 
@@ -364,6 +690,9 @@ void ParkingApiServer::initializeRoutes() {
  * 
  * @param request HTTP请求对象
  * @return HTTP响应对象
+ *
+ * /api/lots/{编号}/xxx去掉编号后按/api/xxx匹配，交给该停车场的分片处理；
+ * 其余的/api/xxx交给默认停车场。编号不存在时返回404
  */
 HttpResponse ParkingApiServer::routeRequest(const HttpRequest& request) {
     // 处理跨域预检请求(CORS preflight)
@@ -372,22 +701,62 @@ HttpResponse ParkingApiServer::routeRequest(const HttpRequest& request) {
         // 设置CORS相关响应头
         response.headers["Access-Control-Allow-Origin"] = "*";
         response.headers["Access-Control-Allow-Methods"] = "GET, POST, PUT, DELETE, OPTIONS";
-        response.headers["Access-Control-Allow-Headers"] = "Content-Type";
+        response.headers["Access-Control-Allow-Headers"] = "Content-Type, Idempotency-Key";
         return response;
     }
 
     // 处理API请求
     if (request.path.find("/api/") == 0) {  // 检查是否是API请求(以/api/开头)
+        // 备用节点的状态来自主节点，提升之前只接受查询
+        if (standby && request.method != "GET" && request.path != "/api/replication/promote") {
+            HttpResponse response(503);
+            response.body = createJsonResponse(false, "Standby is read-only until promoted");
+            return response;
+        }
+
+        // 解析路径中的停车场编号
+        LotShard* shard = defaultShard;
+        bool lotScoped = false;
+        HttpRequest scoped;
+        const std::string lotsPrefix = "/api/lots/";
+        if (request.path.compare(0, lotsPrefix.size(), lotsPrefix) == 0) {
+            size_t idEnd = request.path.find('/', lotsPrefix.size());
+            std::string id = urlDecode(request.path.substr(lotsPrefix.size(), idEnd - lotsPrefix.size()));
+            shard = findLot(id);
+            if (shard == nullptr) {
+                HttpResponse response(404);
+                response.body = createJsonResponse(false, "Parking lot not found");
+                return response;
+            }
+            lotScoped = true;
+            scoped = request;
+            scoped.path = "/api" + (idEnd == std::string::npos ? std::string() : request.path.substr(idEnd));
+        }
+        const HttpRequest& target = lotScoped ? scoped : request;
+
         // 遍历路由表寻找匹配的处理函数
         for (const auto& route : routes) {
+            if (lotScoped && !route.perLot) {
+                continue;
+            }
             // 根据路由配置决定使用精确匹配还是前缀匹配
             bool matched = route.isPrefix ? 
-                         request.path.find(route.path) == 0 :  // 前缀匹配
-                         request.path == route.path;           // 精确匹配
+                         target.path.find(route.path) == 0 :  // 前缀匹配
+                         target.path == route.path;           // 精确匹配
+            if (matched && !route.suffix.empty()) {
+                matched = target.path.size() > route.path.size() + route.suffix.size() &&
+                          target.path.compare(target.path.size() - route.suffix.size(),
+                                              route.suffix.size(), route.suffix) == 0;
+            }
             
             // 如果路径匹配且HTTP方法一致,调用对应的处理函数
-            if (matched && request.method == route.method) {
-                return route.handler(request);
+            if (matched && target.method == route.method) {
+                // 入场/出场请求携带Idempotency-Key时,重试直接重放原响应
+                std::string idempotencyKey = target.getHeader("Idempotency-Key");
+                if (!idempotencyKey.empty() && (target.method == "POST" || target.method == "DELETE")) {
+                    return dispatchIdempotent(route, *shard, target, idempotencyKey);
+                }
+                return route.handler(*shard, target);
             }
         }
         // 未找到匹配的路由,返回404错误
@@ -400,6 +769,60 @@ HttpResponse ParkingApiServer::routeRequest(const HttpRequest& request) {
     return handleStaticFile(request.path);
 }
 
+/**
+ * @brief 以幂等方式分发请求
+ * 同一个Idempotency-Key只会真正执行一次处理函数，之后的重试重放第一次的响应
+ *
+ * @param route 匹配到的路由
+ * @param shard 请求所属的停车场分片
+ * @param request HTTP请求对象（已去掉停车场编号）
+ * @param key 请求头中的Idempotency-Key
+ * @return HTTP响应对象
+ *
+ * 边界情况处理：
+ * - 同一个键用于不同的请求内容：返回422
+ * - 原请求仍在执行且等待超时：返回409，客户端可稍后重试
+ * - 处理函数抛出异常：放弃该键，允许重试重新执行
+ */
+HttpResponse ParkingApiServer::dispatchIdempotent(const Route& route, LotShard& shard, const HttpRequest& request,
+                                                  const std::string& key) {
+    // 幂等键按停车场、方法和路径区分，避免不同停车场、不同接口之间互相冲突
+    std::string scopedKey = shard.id + " " + request.method + " " + request.path + "\n" + key;
+    size_t fingerprint = std::hash<std::string>{}(request.body);
+
+    HttpResponse cached;
+    switch (idempotencyCache.begin(scopedKey, fingerprint, cached)) {
+        case IdempotencyCache::Status::Replayed:
+            cached.headers["Idempotent-Replayed"] = "true";
+            return cached;
+        case IdempotencyCache::Status::Mismatch: {
+            HttpResponse response(422);
+            response.body = createJsonResponse(false, "Idempotency-Key reused with a different request");
+            return response;
+        }
+        case IdempotencyCache::Status::InProgress: {
+            HttpResponse response(409);
+            response.body = createJsonResponse(false, "Request with this Idempotency-Key is still in progress");
+            return response;
+        }
+        case IdempotencyCache::Status::Acquired:
+            break;
+    }
+
+    try {
+        HttpResponse response = route.handler(shard, request);
+        if (response.status >= 500) {
+            idempotencyCache.abandon(scopedKey);  // 服务器错误不保存，允许重试
+        } else {
+            idempotencyCache.complete(scopedKey, response);
+        }
+        return response;
+    } catch (...) {
+        idempotencyCache.abandon(scopedKey);
+        throw;
+    }
+}
+
 /**
  * @brief 从socket读取指定字节数的数据
  * @param clientSocket socket描述符 
@@ -499,6 +922,23 @@ HttpRequest ParkingApiServer::parseRequest(int clientSocket) {
         }
         std::istringstream lineStream(line);
         lineStream >> request.method >> request.path;
+
+        // 拆分查询字符串：/api/history?from=1&to=2
+        size_t queryPos = request.path.find('?');
+        if (queryPos != std::string::npos) {
+            std::istringstream queryStream(request.path.substr(queryPos + 1));
+            request.path.erase(queryPos);
+
+            std::string pair;
+            while (std::getline(queryStream, pair, '&')) {
+                size_t eqPos = pair.find('=');
+                if (eqPos == std::string::npos) {
+                    request.query[urlDecode(pair)] = "";
+                } else {
+                    request.query[urlDecode(pair.substr(0, eqPos))] = urlDecode(pair.substr(eqPos + 1));
+                }
+            }
+        }
     }
 
     // 解析头部字段
@@ -595,18 +1035,28 @@ void ParkingApiServer::sendResponse(int clientSocket, const HttpResponse& respon
         case 404:
             responseStream << "Not Found";
             break;
+        case 409:
+            responseStream << "Conflict";
+            break;
+        case 422:
+            responseStream << "Unprocessable Entity";
+            break;
         case 500:
             responseStream << "Internal Server Error";
             break;
+        case 503:
+            responseStream << "Service Unavailable";
+            break;
         default:
             responseStream << "Unknown Status";
             break;
     }
-    
+    responseStream << "\r\n";
+
     // Add CORS headers for all responses
     responseStream << "Access-Control-Allow-Origin: *\r\n";
     responseStream << "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-    responseStream << "Access-Control-Allow-Headers: Content-Type\r\n";
+    responseStream << "Access-Control-Allow-Headers: Content-Type, Idempotency-Key\r\n";
     
     // Add other headers
     for (const auto& [key, value] : response.headers) {
@@ -617,12 +1067,64 @@ void ParkingApiServer::sendResponse(int clientSocket, const HttpResponse& respon
         }
     }
 
-    responseStream << "Content-Length: " << response.body.length() << "\r\n";
+    if (!response.stream) {
+        responseStream << "Content-Length: " << response.body.length() << "\r\n";
+        responseStream << "\r\n";
+        responseStream << response.body;
+        sendAll(clientSocket, responseStream.str());
+        return;
+    }
+
+    // 流式响应：每块数据前加十六进制长度，以长度为0的块结束
+    responseStream << "Transfer-Encoding: chunked\r\n";
     responseStream << "\r\n";
-    responseStream << response.body;
+    if (!sendAll(clientSocket, responseStream.str())) {
+        return;
+    }
+
+    bool connected = true;
+    auto writeChunk = [&](const std::string& chunk) {
+        if (!connected || chunk.empty()) {
+            return connected;  // 空块会被当作结束标记，不能发送
+        }
+        std::ostringstream header;
+        header << std::hex << chunk.size() << "\r\n";
+        connected = sendAll(clientSocket, header.str()) &&
+                    sendAll(clientSocket, chunk) &&
+                    sendAll(clientSocket, "\r\n");
+        return connected;
+    };
+    try {
+        response.stream(writeChunk);
+    } catch (const std::exception& e) {
+        // 响应头已经发出，无法再返回错误状态码；不发送结束块，客户端会发现传输不完整
+        std::cerr << "Streaming response aborted: " << e.what() << std::endl;
+        return;
+    }
+    if (connected) {
+        sendAll(clientSocket, "0\r\n\r\n");
+    }
+}
 
-    std::string responseStr = responseStream.str();
-    send(clientSocket, responseStr.c_str(), responseStr.length(), 0);
+/**
+ * @brief 发送全部数据
+ * send可能只发送一部分数据（大响应或发送缓冲区已满时），需要循环直到发送完毕
+ *
+ * @return 发送成功返回true，连接已断开返回false
+ */
+bool ParkingApiServer::sendAll(int clientSocket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(clientSocket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
 }
 
 /**
@@ -671,7 +1173,7 @@ std::string ParkingApiServer::createJsonResponse(bool success, const std::string
  * 错误处理：
  * - 任何解析或处理错误返回400 Bad Request
  */
-HttpResponse ParkingApiServer::handleAddVehicle(const HttpRequest& req) {
+HttpResponse ParkingApiServer::handleAddVehicle(LotShard& shard, const HttpRequest& req) {
     try {
         std::cout << "Received body: " << req.body << std::endl;
         
@@ -705,14 +1207,14 @@ HttpResponse ParkingApiServer::handleAddVehicle(const HttpRequest& req) {
 
         std::cout << "Extracted plate: " << plate << ", type: " << type << std::endl;
 
-        if (parkingLot->addVehicle(plate, type)) {
+        if (shard.lot->addVehicle(plate, type)) {
             HttpResponse response;
             response.body = createJsonResponse(true, "Vehicle added successfully");
             return response;
         } else {
             // 检查是否是因为车辆已存在而失败
             Vehicle v;
-            if (parkingLot->queryVehicle(plate, v) && v.getExitTime() == 0) {
+            if (shard.lot->queryVehicle(plate, v) && v.getExitTime() == 0) {
                 HttpResponse response(400);
                 response.body = createJsonResponse(false, "该车辆已在停车场内");
                 return response;
@@ -740,7 +1242,7 @@ HttpResponse ParkingApiServer::handleAddVehicle(const HttpRequest& req) {
  * 处理流程：
  * 1. 从请求路径中提取车牌号
  * 2. 调用停车场管理对象的removeVehicle方法
- * 3. 如果成功，返回车辆信息和费用
+ * 3. 如果成功，返回removeVehicle给出的本次出场记录（出场后同一车牌可能已再次入场，不能再按车牌查询）
  * 4. 如果失败，返回404错误
  * 
  * 边界情况处理：
@@ -750,7 +1252,7 @@ HttpResponse ParkingApiServer::handleAddVehicle(const HttpRequest& req) {
  * 错误处理：
  * - 任何处理错误返回400 Bad Request
  */
-HttpResponse ParkingApiServer::handleRemoveVehicle(const HttpRequest& req) {
+HttpResponse ParkingApiServer::handleRemoveVehicle(LotShard& shard, const HttpRequest& req) {
     try {
         size_t pos = req.path.find_last_of('/');
         if (pos == std::string::npos) {
@@ -761,14 +1263,13 @@ HttpResponse ParkingApiServer::handleRemoveVehicle(const HttpRequest& req) {
         std::string plate = urlDecode(encodedPlate);
         std::cout << "Removing vehicle with plate: " << plate << std::endl;
 
-        if (parkingLot->removeVehicle(plate)) {
-            Vehicle v;
-            parkingLot->queryVehicle(plate, v);
-            
+        Vehicle v;
+        if (shard.lot->removeVehicle(plate, v)) {
             std::ostringstream data;
             data << "{\"plate\":\"" << v.getLicensePlate() << "\",";
             data << "\"type\":\"" << v.getType() << "\",";
-            data << "\"fee\":" << v.getFee() << "}";
+            data << "\"fee\":" << formatCents(v.getFeeCents()) << ",";
+            data << "\"feeCents\":" << v.getFeeCents() << "}";
 
             HttpResponse response;
             response.body = createJsonResponse(true, "Vehicle removed successfully", data.str());
@@ -804,7 +1305,7 @@ HttpResponse ParkingApiServer::handleRemoveVehicle(const HttpRequest& req) {
  * 错误处理：
  * - 任何处理错误返回400 Bad Request
  */
-HttpResponse ParkingApiServer::handleQueryVehicle(const HttpRequest& req) {
+HttpResponse ParkingApiServer::handleQueryVehicle(LotShard& shard, const HttpRequest& req) {
     try {
         size_t pos = req.path.find_last_of('/');
         if (pos == std::string::npos) {
@@ -816,13 +1317,14 @@ HttpResponse ParkingApiServer::handleQueryVehicle(const HttpRequest& req) {
         std::cout << "Querying vehicle with plate: " << plate << std::endl;
 
         Vehicle v;
-        if (parkingLot->queryVehicle(plate, v)) {
+        if (shard.lot->queryVehicle(plate, v)) {
             std::ostringstream data;
             data << "{\"plate\":\"" << v.getLicensePlate() << "\",";
             data << "\"type\":\"" << v.getType() << "\",";
             data << "\"entryTime\":" << v.getEntryTime() << ",";
             data << "\"exitTime\":" << v.getExitTime() << ",";
-            data << "\"fee\":" << v.getFee() << "}";
+            data << "\"fee\":" << formatCents(v.getFeeCents()) << ",";
+            data << "\"feeCents\":" << v.getFeeCents() << "}";
 
             HttpResponse response;
             response.body = createJsonResponse(true, "Vehicle found", data.str());
@@ -839,9 +1341,62 @@ HttpResponse ParkingApiServer::handleQueryVehicle(const HttpRequest& req) {
     }
 }
 
+/**
+ * @brief 处理车辆全部停车记录查询请求
+ * 返回某个车牌的每一次停车（按入场先后排列），车辆在场时最后一条的exitTime为0
+ *
+ * @param req HTTP请求对象，路径为/api/vehicle/{车牌号}/visits
+ * @return HTTP响应对象
+ *
+ * 边界情况处理：
+ * - 没有任何停车记录时返回404
+ */
+HttpResponse ParkingApiServer::handleGetVehicleVisits(LotShard& shard, const HttpRequest& req) {
+    try {
+        const std::string prefix = "/api/vehicle/";
+        const std::string suffix = "/visits";
+        std::string plate = urlDecode(req.path.substr(prefix.size(), req.path.size() - prefix.size() - suffix.size()));
+
+        auto visits = shard.lot->getVehicleVisits(plate);
+        if (visits.empty()) {
+            HttpResponse response(404);
+            response.body = createJsonResponse(false, "Vehicle not found");
+            return response;
+        }
+
+        Cents totalFee = 0;
+        std::ostringstream list;
+        for (size_t i = 0; i < visits.size(); ++i) {
+            const auto& v = visits[i];
+            totalFee += v.getFeeCents();
+            list << (i > 0 ? "," : "");
+            list << "{\"type\":\"" << v.getType() << "\",";
+            list << "\"entryTime\":" << v.getEntryTime() << ",";
+            list << "\"exitTime\":" << v.getExitTime() << ",";
+            list << "\"fee\":" << formatCents(v.getFeeCents()) << ",";
+            list << "\"feeCents\":" << v.getFeeCents() << "}";
+        }
+
+        std::ostringstream data;
+        data << "{\"plate\":\"" << plate << "\",";
+        data << "\"count\":" << visits.size() << ",";
+        data << "\"totalFee\":" << formatCents(totalFee) << ",";
+        data << "\"totalFeeCents\":" << totalFee << ",";
+        data << "\"visits\":[" << list.str() << "]}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Visits retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
 /**
  * @brief 处理停车场状态查询请求
- * 返回当前停车场的空闲车位和占用车位数量
+ * 返回当前停车场的空闲车位、占用车位数量和累计营收
  * 
  * @param req HTTP请求对象
  * @return HTTP响应对象
@@ -851,10 +1406,12 @@ HttpResponse ParkingApiServer::handleQueryVehicle(const HttpRequest& req) {
  * 2. 构造状态数据的JSON表示
  * 3. 返回成功的HTTP响应
  */
-HttpResponse ParkingApiServer::handleGetParkingStatus(const HttpRequest&) {
+HttpResponse ParkingApiServer::handleGetParkingStatus(LotShard& shard, const HttpRequest&) {
     std::ostringstream data;
-    data << "{\"available\":" << parkingLot->getAvailableSpaces() << ",";
-    data << "\"occupied\":" << parkingLot->getOccupiedSpaces() << "}";
+    data << "{\"available\":" << shard.lot->getAvailableSpaces() << ",";
+    data << "\"occupied\":" << shard.lot->getOccupiedSpaces() << ",";
+    data << "\"revenue\":" << formatCents(shard.lot->getTotalRevenue()) << ",";
+    data << "\"revenueCents\":" << shard.lot->getTotalRevenue() << "}";
 
     HttpResponse response;
     response.body = createJsonResponse(true, "Status retrieved", data.str());
@@ -880,7 +1437,7 @@ HttpResponse ParkingApiServer::handleGetParkingStatus(const HttpRequest&) {
  * 错误处理：
  * - 任何解析或处理错误返回400 Bad Request
  */
-HttpResponse ParkingApiServer::handleSetRate(const HttpRequest& req) {
+HttpResponse ParkingApiServer::handleSetRate(LotShard& shard, const HttpRequest& req) {
     try {
         std::cout << "Received rate update body: " << req.body << std::endl;
         
@@ -915,14 +1472,20 @@ HttpResponse ParkingApiServer::handleSetRate(const HttpRequest& req) {
 
         std::cout << "Extracted rates - small: " << smallRateStr << ", large: " << largeRateStr << std::endl;
 
-        double smallRate = std::stod(smallRateStr);
-        double largeRate = std::stod(largeRateStr);
+        // 费率按"元"输入，精确解析为整数分
+        Cents smallRate, largeRate;
+        if (!parseCents(smallRateStr, smallRate) || !parseCents(largeRateStr, largeRate)) {
+            throw std::runtime_error("Rates must be decimal numbers");
+        }
 
         if (smallRate <= 0 || largeRate <= 0) {
             throw std::runtime_error("Rates must be positive numbers");
         }
+        if (!ParkingLot::isValidRate(smallRate) || !ParkingLot::isValidRate(largeRate)) {
+            throw std::runtime_error("Rates must not exceed " + formatCents(ParkingLot::MAX_HOURLY_RATE) + " per hour");
+        }
 
-        parkingLot->setRate(smallRate, largeRate);
+        shard.lot->setRate(smallRate, largeRate);
 
         HttpResponse response;
         response.body = createJsonResponse(true, "Rates updated successfully");
@@ -947,8 +1510,8 @@ HttpResponse ParkingApiServer::handleSetRate(const HttpRequest& req) {
  * 2. 构造记录数据的JSON数组表示
  * 3. 返回成功的HTTP响应
  */
-HttpResponse ParkingApiServer::handleGetHistory(const HttpRequest&) {
-    auto history = parkingLot->getHistoryVehicles();
+HttpResponse ParkingApiServer::handleGetHistory(LotShard& shard, const HttpRequest&) {
+    auto history = shard.lot->getHistoryVehicles();
     std::ostringstream data;
     data << "[";
     for (size_t i = 0; i < history.size(); ++i) {
@@ -957,7 +1520,8 @@ HttpResponse ParkingApiServer::handleGetHistory(const HttpRequest&) {
         data << "\"type\":\"" << v.getType() << "\",";
         data << "\"entryTime\":" << v.getEntryTime() << ",";
         data << "\"exitTime\":" << v.getExitTime() << ",";
-        data << "\"fee\":" << v.getFee() << "}";
+        data << "\"fee\":" << formatCents(v.getFeeCents()) << ",";
+        data << "\"feeCents\":" << v.getFeeCents() << "}";
         if (i < history.size() - 1) {
             data << ",";
         }
@@ -984,17 +1548,18 @@ HttpResponse ParkingApiServer::handleGetHistory(const HttpRequest&) {
  * 边界情况处理：
  * - 当前没有车辆时返回空数组
  */
-HttpResponse ParkingApiServer::handleGetCurrentVehicles(const HttpRequest&) {
-    auto currentVehicles = parkingLot->getCurrentVehicles();
+HttpResponse ParkingApiServer::handleGetCurrentVehicles(LotShard& shard, const HttpRequest&) {
+    auto currentVehicles = shard.lot->getCurrentVehicles();
     std::ostringstream data;
     data << "[";
     for (size_t i = 0; i < currentVehicles.size(); ++i) {
         const auto& v = currentVehicles[i];
-        double hourlyRate = (v.getType() == "小型") ? parkingLot->getSmallRate() : parkingLot->getLargeRate();
+        Cents hourlyRate = (v.getType() == "小型") ? shard.lot->getSmallRate() : shard.lot->getLargeRate();
         data << "{\"plate\":\"" << v.getLicensePlate() << "\",";
         data << "\"type\":\"" << v.getType() << "\",";
         data << "\"entryTime\":" << v.getEntryTime() << ",";
-        data << "\"hourlyRate\":" << hourlyRate << "}";
+        data << "\"hourlyRate\":" << formatCents(hourlyRate) << ",";
+        data << "\"hourlyRateCents\":" << hourlyRate << "}";
         if (i < currentVehicles.size() - 1) {
             data << ",";
         }
@@ -1004,4 +1569,1230 @@ HttpResponse ParkingApiServer::handleGetCurrentVehicles(const HttpRequest&) {
     HttpResponse response;
     response.body = createJsonResponse(true, "Current vehicles retrieved", data.str());
     return response;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 记录一条超时告警
+ * 由停车场在检测到车辆超时时回调，保存到有上限的最近告警队列中
+ *
+ * @param event 超时告警
+ */
+void ParkingApiServer::onOverstay(LotShard& shard, const OverstayEvent& event) {
+    const size_t MAX_RECENT_ALERTS = 1000;  // 每个停车场最多保留的告警条数
+
+    std::lock_guard<std::mutex> lock(shard.alertMutex);
+    shard.recentAlerts.push_back({shard.nextAlertSeq++, event});
+    if (shard.recentAlerts.size() > MAX_RECENT_ALERTS) {
+        shard.recentAlerts.pop_front();
+    }
+    std::cout << "Overstay alert: " << event.licensePlate << " (" << event.type
+              << ") in lot " << shard.id << ", deadline " << event.deadline << std::endl;
+}
+
+/**
+ * @brief 检查各停车场的超时车辆，更新占用看板的心跳
+ * 周期任务，每秒执行一次
+ */
+void ParkingApiServer::checkOverstays() {
+    time_t now = std::time(nullptr);
+    for (LotShard* shard : allLots()) {
+        shard->lot->checkOverstays(now);
+    }
+    if (occupancyBoard) {
+        occupancyBoard->heartbeat();
+    }
+}
+
+/**
+ * @brief 为各停车场提交历史记录清理任务
+ * 周期任务，每秒执行一次；已有清理任务排队或正在执行的停车场跳过。
+ * 各停车场的清理是独立的任务，空闲的调度器线程可以窃取，多个停车场的积压并行清理
+ */
+void ParkingApiServer::scheduleRetention() {
+    for (LotShard* shard : allLots()) {
+        if (!shard->retentionQueued.exchange(true)) {
+            scheduler.submit("retention", TaskPriority::Low, [this, shard] { runRetentionStep(*shard); });
+        }
+    }
+}
+
+/**
+ * @brief 执行一步历史记录清理和段合并
+ * 还有待清理的数据时重新提交自己：每一步之间释放锁，也让出调度器线程给更高优先级的任务
+ */
+void ParkingApiServer::runRetentionStep(LotShard& shard) {
+    time_t now = std::time(nullptr);
+    bool more = shard.lot->expireHistory(now);
+    more = shard.lot->compactHistory(now) || more;
+    if (more && running &&
+        !scheduler.submit("retention", TaskPriority::Low, [this, &shard] { runRetentionStep(shard); }).cancelled()) {
+        return;
+    }
+    shard.retentionQueued = false;
+}
+
+/**
+ * @brief 保存各停车场有变化的占用时间序列
+ * 周期任务，每OCCUPANCY_SAVE_INTERVAL执行一次；各停车场在锁内只复制缓冲区，写文件在锁外
+ */
+void ParkingApiServer::saveOccupancySeries() {
+    for (LotShard* shard : allLots()) {
+        shard->lot->saveOccupancySeries();
+    }
+}
+
+/**
+ * @brief 将超时告警序列化为JSON对象
+ */
+static std::string overstayEventToJson(const OverstayEvent& event) {
+    std::ostringstream json;
+    json << "{\"plate\":\"" << event.licensePlate << "\",";
+    json << "\"type\":\"" << event.type << "\",";
+    json << "\"entryTime\":" << event.entryTime << ",";
+    json << "\"deadline\":" << event.deadline << "}";
+    return json.str();
+}
+
+/**
+ * @brief 处理超时告警查询请求
+ * 返回当前仍在场的超时车辆，以及序号大于since的告警事件
+ *
+ * @param req HTTP请求对象，可选查询参数since（上次收到的最大序号）
+ * @return HTTP响应对象
+ *
+ * 客户端保存返回的lastSeq，下次携带since=lastSeq即可只拉取新告警
+ */
+HttpResponse ParkingApiServer::handleGetOverstayAlerts(LotShard& shard, const HttpRequest& req) {
+    try {
+        uint64_t since = 0;
+        auto sinceIt = req.query.find("since");
+        if (sinceIt != req.query.end() && !sinceIt->second.empty()) {
+            since = std::stoull(sinceIt->second);
+        }
+
+        auto overstaying = shard.lot->getOverstayingVehicles();
+
+        std::ostringstream data;
+        data << "{\"overstaying\":[";
+        for (size_t i = 0; i < overstaying.size(); ++i) {
+            data << overstayEventToJson(overstaying[i]);
+            if (i < overstaying.size() - 1) {
+                data << ",";
+            }
+        }
+        data << "],\"events\":[";
+
+        uint64_t lastSeq;
+        {
+            std::lock_guard<std::mutex> lock(shard.alertMutex);
+            bool first = true;
+            for (const auto& record : shard.recentAlerts) {
+                if (record.seq <= since) {
+                    continue;
+                }
+                if (!first) {
+                    data << ",";
+                }
+                first = false;
+                std::string event = overstayEventToJson(record.event);
+                data << "{\"seq\":" << record.seq << "," << event.substr(1);
+            }
+            lastSeq = shard.nextAlertSeq - 1;
+        }
+        data << "],\"lastSeq\":" << lastSeq << ",";
+        data << "\"limits\":{\"小型\":" << shard.lot->getOverstayLimit("小型") << ",";
+        data << "\"大型\":" << shard.lot->getOverstayLimit("大型") << "}}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Overstay alerts retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 处理停车时限设置请求
+ * 请求体格式：{"type":"小型","limitMinutes":240}
+ *
+ * @param req HTTP请求对象
+ * @return HTTP响应对象
+ */
+HttpResponse ParkingApiServer::handleSetOverstayLimit(LotShard& shard, const HttpRequest& req) {
+    try {
+        const std::string& body = req.body;
+
+        // Extract type
+        size_t typePos = body.find("\"type\"");
+        if (typePos == std::string::npos) {
+            throw std::runtime_error("Missing type field");
+        }
+        typePos = body.find(':', typePos) + 1;
+        typePos = body.find('\"', typePos) + 1;
+        size_t typeEnd = body.find('\"', typePos);
+        std::string type = body.substr(typePos, typeEnd - typePos);
+
+        // Extract limitMinutes
+        size_t limitPos = body.find("\"limitMinutes\"");
+        if (limitPos == std::string::npos) {
+            throw std::runtime_error("Missing limitMinutes field");
+        }
+        limitPos = body.find(':', limitPos) + 1;
+        while (limitPos < body.length() && std::isspace(body[limitPos])) {
+            ++limitPos;
+        }
+        size_t limitEnd = body.find_first_not_of("0123456789", limitPos);
+        long long minutes = std::stoll(body.substr(limitPos, limitEnd - limitPos));
+
+        if (type.empty() || minutes <= 0) {
+            throw std::runtime_error("Type must be set and limit must be positive");
+        }
+
+        shard.lot->setOverstayLimit(type, static_cast<time_t>(minutes) * 60);
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Overstay limit updated");
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, std::string("Error updating overstay limit: ") + e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 读取Unix时间戳格式的查询参数
+ * @param req HTTP请求对象
+ * @param name 参数名
+ * @param defaultValue 参数缺失或为空时的默认值
+ * @return 参数值
+ * @throws std::invalid_argument 参数不是整数
+ */
+static time_t getTimeParam(const HttpRequest& req, const std::string& name, time_t defaultValue) {
+    auto it = req.query.find(name);
+    if (it == req.query.end() || it->second.empty()) {
+        return defaultValue;
+    }
+    return static_cast<time_t>(std::stoll(it->second));
+}
+
+/**
+ * @brief 将一组汇总计数序列化为JSON对象
+ */
+static std::string rollupCountersToJson(const RollupCounters& counters) {
+    std::ostringstream json;
+    json << "{\"visits\":" << counters.visits << ",";
+    json << "\"revenue\":" << formatCents(counters.revenue) << ",";
+    json << "\"revenueCents\":" << counters.revenue << "}";
+    return json.str();
+}
+
+/**
+ * @brief 处理营收汇总查询请求
+ * 返回按小时或天汇总的营收和出场车次，以及按车型的细分
+ *
+ * @param req HTTP请求对象
+ *   - granularity: hour或day（默认day）
+ *   - from: 起始时间（Unix时间戳，默认0）
+ *   - to: 结束时间（Unix时间戳，不包含，默认当前时间之后）
+ * @return HTTP响应对象
+ *
+ * 数据来自停车场维护的增量汇总表，不扫描历史记录
+ */
+HttpResponse ParkingApiServer::handleGetRevenueStats(LotShard& shard, const HttpRequest& req) {
+    try {
+        RollupGranularity granularity = RollupGranularity::Day;
+        auto granularityIt = req.query.find("granularity");
+        if (granularityIt != req.query.end() && !granularityIt->second.empty()) {
+            if (granularityIt->second == "hour") {
+                granularity = RollupGranularity::Hour;
+            } else if (granularityIt->second != "day") {
+                throw std::runtime_error("granularity must be hour or day");
+            }
+        }
+        time_t from = getTimeParam(req, "from", 0);
+        time_t to = getTimeParam(req, "to", std::time(nullptr) + 1);
+
+        auto buckets = shard.lot->getRevenueRollup(granularity, from, to);
+
+        RollupCounters total;
+        std::ostringstream data;
+        data << "{\"granularity\":\"" << (granularity == RollupGranularity::Hour ? "hour" : "day") << "\",";
+        data << "\"buckets\":[";
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            const auto& bucket = buckets[i];
+            total.visits += bucket.total.visits;
+            total.revenue += bucket.total.revenue;
+
+            data << "{\"start\":" << bucket.start << ",";
+            data << "\"total\":" << rollupCountersToJson(bucket.total) << ",";
+            data << "\"byType\":{";
+            bool first = true;
+            for (const auto& [type, counters] : bucket.byType) {
+                if (!first) {
+                    data << ",";
+                }
+                first = false;
+                data << "\"" << type << "\":" << rollupCountersToJson(counters);
+            }
+            data << "}}";
+            if (i < buckets.size() - 1) {
+                data << ",";
+            }
+        }
+        data << "],\"total\":" << rollupCountersToJson(total) << "}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Revenue stats retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 处理占用时间序列查询请求
+ * 返回指定分辨率下每个时间段的最少、最多和期末占用车位数
+ *
+ * @param req HTTP请求对象
+ *   - resolution: second、minute或hour；缺省时选择能覆盖from的最细分辨率
+ *   - from: 起始时间（Unix时间戳，默认to之前1小时）
+ *   - to: 结束时间（Unix时间戳，不包含，默认当前时间之后）
+ * @return HTTP响应对象
+ *
+ * 数据来自固定内存的环形缓冲区，不扫描历史记录
+ */
+HttpResponse ParkingApiServer::handleGetOccupancyStats(LotShard& shard, const HttpRequest& req) {
+    try {
+        time_t now = std::time(nullptr);
+        time_t to = getTimeParam(req, "to", now + 1);
+        time_t from = getTimeParam(req, "from", to - 3600);
+
+        OccupancyResolution resolution;
+        auto resolutionIt = req.query.find("resolution");
+        std::string name = resolutionIt != req.query.end() ? resolutionIt->second : "";
+        if (name == "second") {
+            resolution = OccupancyResolution::Second;
+        } else if (name == "minute") {
+            resolution = OccupancyResolution::Minute;
+        } else if (name == "hour") {
+            resolution = OccupancyResolution::Hour;
+        } else if (name.empty()) {
+            // 选择保留时长能覆盖起始时间的最细分辨率
+            resolution = OccupancyResolution::Hour;
+            name = "hour";
+            if (from >= now - shard.lot->getOccupancyRetention(OccupancyResolution::Second)) {
+                resolution = OccupancyResolution::Second;
+                name = "second";
+            } else if (from >= now - shard.lot->getOccupancyRetention(OccupancyResolution::Minute)) {
+                resolution = OccupancyResolution::Minute;
+                name = "minute";
+            }
+        } else {
+            throw std::runtime_error("resolution must be second, minute or hour");
+        }
+
+        auto points = shard.lot->getOccupancySeries(resolution, from, to);
+
+        std::ostringstream data;
+        data << "{\"resolution\":\"" << name << "\",";
+        data << "\"points\":[";
+        for (size_t i = 0; i < points.size(); ++i) {
+            const auto& point = points[i];
+            data << "{\"t\":" << point.start << ",";
+            data << "\"min\":" << point.min << ",";
+            data << "\"max\":" << point.max << ",";
+            data << "\"occupied\":" << point.last << "}";
+            if (i < points.size() - 1) {
+                data << ",";
+            }
+        }
+        data << "]}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Occupancy stats retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 将停车时长和费用分布序列化为JSON对象（p50/p90/p99）
+ */
+static std::string stayDistributionToJson(const StayDistribution& distribution) {
+    std::ostringstream json;
+    json << "\"count\":" << distribution.duration.count() << ",";
+    json << "\"durationSeconds\":{\"p50\":" << distribution.duration.quantile(0.5) << ",";
+    json << "\"p90\":" << distribution.duration.quantile(0.9) << ",";
+    json << "\"p99\":" << distribution.duration.quantile(0.99) << "},";
+    json << "\"feeCents\":{\"p50\":" << distribution.fee.quantile(0.5) << ",";
+    json << "\"p90\":" << distribution.fee.quantile(0.9) << ",";
+    json << "\"p99\":" << distribution.fee.quantile(0.99) << "}";
+    return json.str();
+}
+
+/**
+ * @brief 处理停车时长和费用分布查询请求
+ * 返回范围内每天每个车型的p50/p90/p99，以及整个范围按车型合并后的结果
+ *
+ * @param req HTTP请求对象
+ *   - from: 起始时间（Unix时间戳，默认0）
+ *   - to: 结束时间（Unix时间戳，不包含，默认当前时间之后）
+ *   - type: 只返回指定车型（可选）
+ * @return HTTP响应对象
+ *
+ * 分位数来自出场时增量更新的直方图，相对误差小于1%，不扫描历史记录
+ */
+HttpResponse ParkingApiServer::handleGetDistributionStats(LotShard& shard, const HttpRequest& req) {
+    try {
+        time_t from = getTimeParam(req, "from", 0);
+        time_t to = getTimeParam(req, "to", std::time(nullptr) + 1);
+        auto typeIt = req.query.find("type");
+        std::string typeFilter = typeIt != req.query.end() ? typeIt->second : "";
+
+        auto distributions = shard.lot->getStayDistributions(from, to);
+
+        std::map<std::string, StayDistribution> overall;  // 按车型合并
+        std::ostringstream daily;
+        bool first = true;
+        for (const auto& [key, distribution] : distributions) {
+            const auto& [day, type] = key;
+            if (!typeFilter.empty() && type != typeFilter) {
+                continue;
+            }
+            overall[type].merge(distribution);
+
+            if (!first) {
+                daily << ",";
+            }
+            first = false;
+            daily << "{\"day\":" << day << ",\"type\":\"" << type << "\","
+                  << stayDistributionToJson(distribution) << "}";
+        }
+
+        std::ostringstream data;
+        data << "{\"overall\":{";
+        first = true;
+        for (const auto& [type, distribution] : overall) {
+            if (!first) {
+                data << ",";
+            }
+            first = false;
+            data << "\"" << type << "\":{" << stayDistributionToJson(distribution) << "}";
+        }
+        data << "},\"daily\":[" << daily.str() << "]}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Distribution stats retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 处理常客查询请求
+ * 返回最近若干天内入场次数最多的车牌
+ *
+ * @param req HTTP请求对象
+ *   - days: 窗口天数（包含今天，1到31，默认7）
+ *   - limit: 返回的车牌数（1到100，默认10）
+ * @return HTTP响应对象
+ *
+ * 次数为Count-Min Sketch估计值，只会略微偏高
+ */
+HttpResponse ParkingApiServer::handleGetFrequentVisitors(LotShard& shard, const HttpRequest& req) {
+    try {
+        int days = 7;
+        size_t limit = 10;
+        auto daysIt = req.query.find("days");
+        if (daysIt != req.query.end() && !daysIt->second.empty()) {
+            days = std::stoi(daysIt->second);
+        }
+        auto limitIt = req.query.find("limit");
+        if (limitIt != req.query.end() && !limitIt->second.empty()) {
+            limit = std::stoul(limitIt->second);
+        }
+        if (days < 1 || days > FrequentVisitorTracker::MAX_WINDOW_DAYS || limit < 1 || limit > 100) {
+            throw std::runtime_error("days must be 1-31 and limit must be 1-100");
+        }
+
+        auto visitors = shard.lot->getFrequentVisitors(limit, days);
+
+        std::ostringstream data;
+        data << "{\"days\":" << days << ",\"visitors\":[";
+        for (size_t i = 0; i < visitors.size(); ++i) {
+            data << "{\"plate\":\"" << visitors[i].licensePlate << "\",";
+            data << "\"visits\":" << visitors[i].visits << "}";
+            if (i < visitors.size() - 1) {
+                data << ",";
+            }
+        }
+        data << "]}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Frequent visitors retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 处理占用预测请求
+ * 供场外诱导屏显示"约20分钟后满位"等信息
+ *
+ * @param req HTTP请求对象
+ *   - horizon: 预测多少分钟之后（1到1440，默认30）
+ * @return HTTP响应对象
+ *
+ * 返回字段：
+ * - predictedOccupied / predictedAvailable: 预测的占用数和空余数
+ * - fullInMinutes: 预计多少分钟后占满，24小时内不会占满时为null
+ * - samples: 目标时段已学习的周数，0表示没有历史数据
+ */
+HttpResponse ParkingApiServer::handleGetForecast(LotShard& shard, const HttpRequest& req) {
+    try {
+        long long horizon = 30;
+        auto horizonIt = req.query.find("horizon");
+        if (horizonIt != req.query.end() && !horizonIt->second.empty()) {
+            horizon = std::stoll(horizonIt->second);
+        }
+        if (horizon < 1 || horizon > 1440) {
+            throw std::runtime_error("horizon must be 1-1440 minutes");
+        }
+
+        OccupancyForecast forecast = shard.lot->forecastOccupancy(static_cast<time_t>(horizon) * 60);
+        size_t capacity = shard.lot->getAvailableSpaces() + shard.lot->getOccupiedSpaces();
+
+        std::ostringstream data;
+        data << std::fixed << std::setprecision(1);
+        data << "{\"horizonMinutes\":" << horizon << ",";
+        data << "\"occupied\":" << shard.lot->getOccupiedSpaces() << ",";
+        data << "\"capacity\":" << capacity << ",";
+        data << "\"predictedOccupied\":" << forecast.predicted << ",";
+        data << "\"predictedAvailable\":" << (static_cast<double>(capacity) - forecast.predicted) << ",";
+        data << "\"fullInMinutes\":";
+        if (forecast.fullIn < 0) {
+            data << "null";
+        } else {
+            data << forecast.fullIn / 60;
+        }
+        data << ",\"samples\":" << forecast.samples << "}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Forecast retrieved", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 将字段转义为CSV格式
+ * 含逗号、引号或换行的字段用双引号包围，内部的双引号写两次
+ */
+static std::string csvField(const std::string& value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+/**
+ * @brief 将时间格式化为本地时间字符串（YYYY-MM-DD HH:MM:SS）
+ */
+static std::string formatLocalTime(time_t time) {
+    std::tm local{};
+    localtime_r(&time, &local);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return buffer;
+}
+
+/**
+ * @brief 处理历史记录CSV导出请求
+ * 供财务按月导出停车记录，以chunked编码边读边发送，不在内存中生成完整文件
+ *
+ * @param req HTTP请求对象
+ *   - from: 出场时间下限（Unix时间戳，包含，默认0）
+ *   - to: 出场时间上限（Unix时间戳，不包含，默认当前时间之后）
+ * @return 流式HTTP响应对象
+ *
+ * CSV列：plate, type, entry_time, exit_time, duration_seconds, fee, fee_cents。
+ * 时间为本地时间，文件带UTF-8 BOM以便Excel正确识别中文车牌
+ */
+HttpResponse ParkingApiServer::handleExportHistoryCsv(LotShard& shard, const HttpRequest& req) {
+    try {
+        time_t from = getTimeParam(req, "from", 0);
+        time_t to = getTimeParam(req, "to", std::time(nullptr) + 1);
+        if (from >= to) {
+            throw std::runtime_error("from must be earlier than to");
+        }
+
+        HttpResponse response;
+        response.headers["Content-Type"] = "text/csv; charset=utf-8";
+        response.headers["Content-Disposition"] = "attachment; filename=\"history.csv\"";
+        // 分片创建后不会删除，流式发送期间停车场一直有效
+        response.stream = [lot = shard.lot.get(), from, to](const HttpResponse::ChunkWriter& write) {
+            const size_t BATCH_SIZE = 4096;        // 每次持锁检查的记录数
+            const size_t CHUNK_SIZE = 64 * 1024;   // 攒够一块再发送，减少系统调用
+
+            std::string chunk = "\xEF\xBB\xBF"
+                                "plate,type,entry_time,exit_time,duration_seconds,fee,fee_cents\r\n";
+            lot->scanHistory(from, to, BATCH_SIZE, [&](const std::vector<Vehicle>& batch) {
+                for (const auto& v : batch) {
+                    chunk += csvField(v.getLicensePlate());
+                    chunk += ',';
+                    chunk += csvField(v.getType());
+                    chunk += ',';
+                    chunk += formatLocalTime(v.getEntryTime());
+                    chunk += ',';
+                    chunk += formatLocalTime(v.getExitTime());
+                    chunk += ',';
+                    chunk += std::to_string(v.getExitTime() - v.getEntryTime());
+                    chunk += ',';
+                    chunk += formatCents(v.getFeeCents());
+                    chunk += ',';
+                    chunk += std::to_string(v.getFeeCents());
+                    chunk += "\r\n";
+
+                    if (chunk.size() >= CHUNK_SIZE) {
+                        if (!write(chunk)) {
+                            return false;  // 客户端已断开，停止遍历
+                        }
+                        chunk.clear();
+                    }
+                }
+                return true;
+            });
+            write(chunk);
+        };
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 生成列式导出的流式响应
+ * 在锁内取历史记录快照，之后在发送线程中由exporter逐块写出，不阻塞入场/出场
+ */
+static HttpResponse columnarExportResponse(
+    const HttpRequest& req, const PartitionedLot& parkingLot, const std::string& contentType, const std::string& fileName,
+    bool (*exporter)(const HistorySnapshot&, int64_t, int64_t, ExportSink&)) {
+    time_t from = getTimeParam(req, "from", 0);
+    time_t to = getTimeParam(req, "to", std::time(nullptr) + 1);
+    if (from >= to) {
+        throw std::runtime_error("from must be earlier than to");
+    }
+
+    // 列式文件只有一个车牌字典，而各分区的字典各自编号，分区停车场请用CSV导出
+    if (parkingLot.partitionCount() > 1) {
+        throw std::runtime_error("Columnar export is not available for partitioned lots, use /export/history.csv");
+    }
+
+    auto snapshot = std::make_shared<const HistorySnapshot>(parkingLot.partition(0).getHistorySnapshot());
+    HttpResponse response;
+    response.headers["Content-Type"] = contentType;
+    response.headers["Content-Disposition"] = "attachment; filename=\"" + fileName + "\"";
+    response.stream = [snapshot, from, to, exporter](const HttpResponse::ChunkWriter& write) {
+        ExportSink sink(write);
+        exporter(*snapshot, from, to, sink);
+    };
+    return response;
+}
+
+/**
+ * @brief 处理历史记录Arrow IPC流导出请求
+ * 供数据分析工具直接读取（例如pyarrow.ipc.open_stream）
+ *
+ * @param req HTTP请求对象
+ *   - from: 出场时间下限（Unix时间戳，包含，默认0）
+ *   - to: 出场时间上限（Unix时间戳，不包含，默认当前时间之后）
+ * @return 流式HTTP响应对象
+ */
+HttpResponse ParkingApiServer::handleExportHistoryArrow(LotShard& shard, const HttpRequest& req) {
+    try {
+        return columnarExportResponse(req, *shard.lot, "application/vnd.apache.arrow.stream",
+                                      "history.arrows", exportArrowStream);
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 处理历史记录Parquet导出请求
+ *
+ * @param req HTTP请求对象
+ *   - from: 出场时间下限（Unix时间戳，包含，默认0）
+ *   - to: 出场时间上限（Unix时间戳，不包含，默认当前时间之后）
+ * @return 流式HTTP响应对象
+ */
+HttpResponse ParkingApiServer::handleExportHistoryParquet(LotShard& shard, const HttpRequest& req) {
+    try {
+        return columnarExportResponse(req, *shard.lot, "application/vnd.apache.parquet",
+                                      "history.parquet", exportParquet);
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 将一组查询聚合值序列化为JSON字段（不含外层花括号）
+ */
+static std::string queryAggregateToJson(const QueryAggregate& aggregate) {
+    std::ostringstream json;
+    json << "\"count\":" << aggregate.count << ",";
+    json << "\"fee\":" << formatCents(aggregate.feeSum) << ",";
+    json << "\"feeCents\":" << aggregate.feeSum << ",";
+    if (aggregate.count == 0) {
+        json << "\"avgFee\":null,\"avgDurationSeconds\":null";
+    } else {
+        auto count = static_cast<int64_t>(aggregate.count);
+        json << "\"avgFee\":" << formatCents((aggregate.feeSum + count / 2) / count) << ",";
+        json << "\"avgDurationSeconds\":" << (aggregate.durationSum + count / 2) / count;
+    }
+    return json.str();
+}
+
+/**
+ * @brief 处理历史记录过滤/聚合查询请求
+ * 例如"上周停车超过10小时且费用不超过20元的大型车"：
+ * type=大型&from=...&to=...&minDuration=36000&maxFee=20
+ *
+ * @param req HTTP请求对象
+ *   - type: 车型（默认不限）
+ *   - plate: 车牌号（默认不限，各段的Bloom过滤器跳过不含该车牌的段）
+ *   - from / to: 出场时间范围（Unix时间戳，左闭右开）
+ *   - entryFrom / entryTo: 入场时间范围（Unix时间戳，左闭右开）
+ *   - minDuration / maxDuration: 停车时长范围（秒，闭区间）
+ *   - minFee / maxFee: 费用范围（元，闭区间）
+ *   - groupBy: none、type、day或hour（默认none）
+ * @return HTTP响应对象，包含合计、各分组的车次/费用合计/平均费用/平均时长
+ */
+HttpResponse ParkingApiServer::handleQueryHistory(LotShard& shard, const HttpRequest& req) {
+    try {
+        HistoryQuery query;
+        auto typeIt = req.query.find("type");
+        if (typeIt != req.query.end()) {
+            query.type = typeIt->second;
+        }
+
+        // 左闭右开的时间范围转换为闭区间
+        auto timeRange = [&](const char* fromName, const char* toName, int64_t& min, int64_t& max) {
+            min = getTimeParam(req, fromName, HistoryQuery::NO_MIN);
+            max = getTimeParam(req, toName, HistoryQuery::NO_MAX);
+            if (max != HistoryQuery::NO_MAX) {
+                max -= 1;
+            }
+        };
+        timeRange("from", "to", query.exitMin, query.exitMax);
+        timeRange("entryFrom", "entryTo", query.entryMin, query.entryMax);
+        query.durationMin = getTimeParam(req, "minDuration", query.durationMin);
+        query.durationMax = getTimeParam(req, "maxDuration", query.durationMax);
+
+        for (auto [name, bound] : {std::make_pair("minFee", &query.feeMin), std::make_pair("maxFee", &query.feeMax)}) {
+            auto it = req.query.find(name);
+            if (it != req.query.end() && !it->second.empty()) {
+                Cents cents;
+                if (!parseCents(it->second, cents)) {
+                    throw std::runtime_error(std::string("Invalid ") + name);
+                }
+                *bound = cents;
+            }
+        }
+
+        auto groupIt = req.query.find("groupBy");
+        std::string groupBy = groupIt != req.query.end() && !groupIt->second.empty() ? groupIt->second : "none";
+        if (groupBy == "none") {
+            query.groupBy = QueryGroupBy::None;
+        } else if (groupBy == "type") {
+            query.groupBy = QueryGroupBy::Type;
+        } else if (groupBy == "day") {
+            query.groupBy = QueryGroupBy::Day;
+        } else if (groupBy == "hour") {
+            query.groupBy = QueryGroupBy::Hour;
+        } else {
+            throw std::runtime_error("groupBy must be none, type, day or hour");
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        // 分区停车场在各分区上分别查询再合并；按车牌查询只需查该车牌所在的分区
+        auto plateIt = req.query.find("plate");
+        bool byPlate = plateIt != req.query.end() && !plateIt->second.empty();
+        HistoryQueryResult result;
+        for (size_t k = 0; k < shard.lot->partitionCount(); ++k) {
+            const ParkingLot& partition = shard.lot->partition(k);
+            if (byPlate && &partition != &shard.lot->partitionOf(plateIt->second)) {
+                continue;
+            }
+            HistorySnapshot snapshot = partition.getHistorySnapshot(false);
+            // 取快照之后再查编号：之后才出现的车牌不在快照中，不会查到快照中没有的编号
+            if (byPlate) {
+                int32_t plateId = partition.findHistoryPlate(plateIt->second);
+                query.plateId = plateId >= 0 ? plateId : HistoryQuery::NO_PLATE;
+            }
+            HistoryQueryResult part = runHistoryQuery(snapshot, query);
+            result.total.merge(part.total);
+            for (const auto& [type, aggregate] : part.byType) {
+                result.byType[type].merge(aggregate);
+            }
+            for (const auto& [start, aggregate] : part.byTime) {
+                result.byTime[start].merge(aggregate);
+            }
+            result.scannedRows += part.scannedRows;
+            result.filteredSegments += part.filteredSegments;
+            result.threads = std::max(result.threads, part.threads);
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started);
+
+        std::ostringstream data;
+        data << "{\"groupBy\":\"" << groupBy << "\",";
+        data << "\"total\":{" << queryAggregateToJson(result.total) << "},";
+        data << "\"groups\":[";
+        bool first = true;
+        for (const auto& [type, aggregate] : result.byType) {
+            data << (first ? "" : ",") << "{\"key\":\"" << type << "\"," << queryAggregateToJson(aggregate) << "}";
+            first = false;
+        }
+        for (const auto& [start, aggregate] : result.byTime) {
+            data << (first ? "" : ",") << "{\"key\":" << start << "," << queryAggregateToJson(aggregate) << "}";
+            first = false;
+        }
+        data << "],";
+        data << "\"scannedRows\":" << result.scannedRows << ",";
+        data << "\"filteredSegments\":" << result.filteredSegments << ",";
+        data << "\"threads\":" << result.threads << ",";
+        data << std::fixed << std::setprecision(3) << "\"elapsedMs\":" << elapsed.count() << "}";
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Query executed", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 历史记录各层存储的统计信息
+ */
+static std::string historyStorageToJson(const HistoryStorageStats& stats) {
+    std::ostringstream data;
+    data << "{\"rows\":" << stats.rows << ",";
+    data << "\"segments\":" << stats.segments << ",";
+    data << "\"level0Segments\":" << stats.level0Segments << ",";
+    data << "\"compactions\":" << stats.compactions << ",";
+    data << "\"compactedRows\":" << stats.compactedRows << ",";
+    data << "\"filterBytes\":" << stats.filterBytes << ",";
+    data << "\"residentSegments\":" << stats.residentSegments << ",";
+    data << "\"residentBytes\":" << stats.residentBytes << ",";
+    data << "\"openRows\":" << stats.openRows << ",";
+    data << "\"diskBytes\":" << stats.diskBytes << ",";
+    data << "\"hotDays\":" << stats.hotWindow / 86400 << ",";
+    data << "\"retentionDays\":" << stats.retention / 86400 << ",";
+    data << "\"purgedRows\":" << stats.purgedRows << ",";
+    data << "\"cache\":{\"segments\":" << stats.cache.entries << ",";
+    data << "\"bytes\":" << stats.cache.bytes << ",";
+    data << "\"budgetBytes\":" << stats.cache.budget << ",";
+    data << "\"hits\":" << stats.cache.hits << ",";
+    data << "\"misses\":" << stats.cache.misses << "}}";
+    return data.str();
+}
+
+/**
+ * @brief 主备复制状态：主节点列出已连接的备用节点，备用节点给出落后的记录数和延迟
+ */
+static std::string replicationStatusToJson(const ReplicationStatus& status) {
+    std::ostringstream data;
+    data << "{\"role\":\"" << (status.standby ? "standby" : "primary") << "\",";
+    data << "\"socket\":\"" << status.socketPath << "\",";
+    data << "\"epoch\":" << status.epoch << ",";
+    data << "\"position\":" << status.position;
+    if (status.standby) {
+        data << ",\"connected\":" << (status.connected ? "true" : "false") << ",";
+        data << "\"primaryPosition\":" << status.primaryPosition << ",";
+        data << "\"lagRecords\":" << status.lagRecords << ",";
+        data << "\"lagMillis\":" << status.lagMillis << ",";
+        data << "\"lastContactMillis\":" << status.lastContactMillis << ",";
+        data << "\"baseSyncs\":" << status.baseSyncs << ",";
+        data << "\"appliedRecords\":" << status.appliedRecords;
+    } else if (!status.socketPath.empty()) {
+        data << ",\"backlogFirst\":" << status.backlogFirst << ",";
+        data << "\"followers\":[";
+        for (size_t i = 0; i < status.followers.size(); ++i) {
+            const ReplicationFollowerStatus& follower = status.followers[i];
+            data << (i > 0 ? "," : "") << "{\"sentPosition\":" << follower.sentPosition << ",";
+            data << "\"lagRecords\":" << (status.position - std::min(status.position, follower.sentPosition)) << ",";
+            data << "\"connectedAt\":" << follower.connectedAt << ",";
+            data << "\"syncingBase\":" << (follower.syncingBase ? "true" : "false") << "}";
+        }
+        data << "]";
+    }
+    data << "}";
+    return data.str();
+}
+
+HttpResponse ParkingApiServer::handleGetReplication(LotShard&, const HttpRequest&) {
+    ReplicationStatus status;
+    {
+        std::lock_guard<std::mutex> lock(replicationMutex);
+        if (follower) {
+            status = follower->status();
+        } else if (publisher) {
+            status = publisher->status();
+        } else {
+            status.position = defaultShard->lot->partition(0).getReplicationPosition();  // 未开启复制
+        }
+    }
+    HttpResponse response;
+    response.body = createJsonResponse(true, "Replication status retrieved", replicationStatusToJson(status));
+    return response;
+}
+
+/**
+ * @brief 提升备用节点为主节点
+ * 停止跟随后立即接受写请求，并在同一个socket上发布变更，供其他备用节点（包括恢复后的原主节点）跟随。
+ * 不会隔离原主节点，调用者应确认原主节点已经停止
+ */
+HttpResponse ParkingApiServer::handlePromote(LotShard&, const HttpRequest&) {
+    std::lock_guard<std::mutex> lock(replicationMutex);
+    if (!standby) {
+        HttpResponse response(409);
+        response.body = createJsonResponse(false, "Not a standby");
+        return response;
+    }
+    follower->stop();
+    ReplicationStatus last = follower->status();
+    follower.reset();
+    standby = false;
+    std::cout << "Promoted to primary at replication position " << last.position << std::endl;
+
+    std::string message = "Promoted to primary";
+    try {
+        publisher = std::make_unique<ReplicationPublisher>(defaultShard->lot->partition(0), replicationSocket);
+    } catch (const std::exception& e) {
+        // 已经可以接受写请求，只是暂时没有备用节点能跟随
+        std::cerr << e.what() << std::endl;
+        message += std::string(", but cannot publish changes: ") + e.what();
+    }
+    ReplicationStatus status = publisher ? publisher->status() : ReplicationStatus();
+    status.position = defaultShard->lot->partition(0).getReplicationPosition();
+    HttpResponse response;
+    response.body = createJsonResponse(true, message, replicationStatusToJson(status));
+    return response;
+}
+
+HttpResponse ParkingApiServer::handleGetHistoryStorage(LotShard& shard, const HttpRequest&) {
+    HttpResponse response;
+    response.body = createJsonResponse(true, "History storage retrieved",
+                                       historyStorageToJson(shard.lot->getHistoryStorageStats()));
+    return response;
+}
+
+/**
+ * @brief 读取请求体中的非负整数字段
+ * @return 字段不存在时返回false
+ */
+static bool extractCountField(const std::string& body, const std::string& name, long long& value) {
+    size_t pos = body.find("\"" + name + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos = body.find(':', pos) + 1;
+    while (pos < body.length() && std::isspace(body[pos])) {
+        ++pos;
+    }
+    size_t end = body.find_first_not_of("0123456789", pos);
+    value = std::stoll(body.substr(pos, end - pos));
+    return true;
+}
+
+HttpResponse ParkingApiServer::handleSetHistoryStorage(LotShard& shard, const HttpRequest& req) {
+    try {
+        // 未提供的字段保持原值
+        HistoryStorageStats current = shard.lot->getHistoryStorageStats();
+        long long hotDays = current.hotWindow / 86400;
+        long long cacheMB = static_cast<long long>(current.cache.budget >> 20);
+        long long retentionDays = current.retention / 86400;
+        bool hasHotDays = extractCountField(req.body, "hotDays", hotDays);
+        bool hasCacheMB = extractCountField(req.body, "cacheMB", cacheMB);
+        bool hasRetentionDays = extractCountField(req.body, "retentionDays", retentionDays);
+        if (!hasHotDays && !hasCacheMB && !hasRetentionDays) {
+            throw std::runtime_error("Missing hotDays, cacheMB or retentionDays field");
+        }
+        if (hotDays < 1 || hotDays > 3650 || cacheMB < 1 || cacheMB > 65536) {
+            throw std::runtime_error("hotDays must be 1-3650 and cacheMB must be 1-65536");
+        }
+        // 0表示永久保留；保留期限不短于热段窗口，也不短于常客统计的窗口
+        if (retentionDays != 0 && (retentionDays < std::max(hotDays, 31LL) || retentionDays > 36500)) {
+            throw std::runtime_error("retentionDays must be 0 or between max(hotDays, 31) and 36500");
+        }
+
+        if (hasHotDays || hasCacheMB) {
+            shard.lot->setHistoryTiering(static_cast<time_t>(hotDays) * 86400, static_cast<uint64_t>(cacheMB) << 20);
+        }
+        if (hasRetentionDays) {
+            shard.lot->setHistoryRetention(static_cast<time_t>(retentionDays) * 86400);
+        }
+
+        HttpResponse response;
+        response.body = createJsonResponse(true, "History storage updated",
+                                           historyStorageToJson(shard.lot->getHistoryStorageStats()));
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, std::string("Error updating history storage: ") + e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 读取请求体中的字符串字段
+ * @return 字段不存在时返回false
+ */
+static bool extractStringField(const std::string& body, const std::string& name, std::string& value) {
+    size_t pos = body.find("\"" + name + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos = body.find(':', pos) + 1;
+    pos = body.find('\"', pos) + 1;
+    size_t end = body.find('\"', pos);
+    value = body.substr(pos, end - pos);
+    return true;
+}
+
+/**
+ * @brief 读取请求体中以"元"为单位的金额字段，精确解析为整数分
+ * @return 字段不存在时返回false
+ * @throws std::runtime_error 不是十进制数
+ */
+static bool extractCentsField(const std::string& body, const std::string& name, Cents& value) {
+    size_t pos = body.find("\"" + name + "\"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos = body.find(':', pos) + 1;
+    while (pos < body.length() && std::isspace(body[pos])) {
+        ++pos;
+    }
+    size_t end = body.find_first_not_of("0123456789.", pos);
+    if (!parseCents(body.substr(pos, end - pos), value)) {
+        throw std::runtime_error(name + " must be a decimal number");
+    }
+    return true;
+}
+
+/**
+ * @brief 处理停车场列表请求
+ * 返回每个停车场的容量、占用和营收，以及全部停车场的合计
+ *
+ * 各停车场依次读取，每次只加该停车场的锁，合计不是同一时刻的快照
+ */
+HttpResponse ParkingApiServer::handleGetLots(LotShard&, const HttpRequest&) {
+    size_t totalCapacity = 0;
+    size_t totalOccupied = 0;
+    Cents totalRevenue = 0;
+    std::vector<LotShard*> shards = allLots();
+
+    std::ostringstream list;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        const PartitionedLot& lot = *shards[i]->lot;
+        size_t available = lot.getAvailableSpaces();
+        size_t occupied = lot.getOccupiedSpaces();
+        Cents revenue = lot.getTotalRevenue();
+        totalCapacity += available + occupied;
+        totalOccupied += occupied;
+        totalRevenue += revenue;
+        list << (i > 0 ? "," : "");
+        list << "{\"id\":\"" << shards[i]->id << "\",";
+        list << "\"capacity\":" << available + occupied << ",";
+        list << "\"available\":" << available << ",";
+        list << "\"occupied\":" << occupied << ",";
+        list << "\"partitions\":" << lot.partitionCount() << ",";
+        list << "\"smallRate\":" << formatCents(lot.getSmallRate()) << ",";
+        list << "\"largeRate\":" << formatCents(lot.getLargeRate()) << ",";
+        list << "\"revenue\":" << formatCents(revenue) << ",";
+        list << "\"revenueCents\":" << revenue << "}";
+    }
+
+    std::ostringstream data;
+    data << "{\"lots\":[" << list.str() << "],";
+    data << "\"total\":{\"lots\":" << shards.size() << ",";
+    data << "\"capacity\":" << totalCapacity << ",";
+    data << "\"available\":" << totalCapacity - totalOccupied << ",";
+    data << "\"occupied\":" << totalOccupied << ",";
+    data << "\"revenue\":" << formatCents(totalRevenue) << ",";
+    data << "\"revenueCents\":" << totalRevenue << "}}";
+
+    HttpResponse response;
+    response.body = createJsonResponse(true, "Parking lots retrieved", data.str());
+    return response;
+}
+
+/**
+ * @brief 处理创建停车场请求
+ * 请求体格式：{"id":"north","capacity":200,"smallRate":5,"largeRate":8,"partitions":4}，
+ * 容量、费率和分区数可省略（默认100个车位、5元、8元、不分区）
+ *
+ * 新停车场保存在dataFile + ".lots/{编号}/"下，使用与默认停车场相同的存储引擎，服务器重启后自动载入；
+ * 之后通过/api/lots/{编号}/...访问。分区数大于1时按车牌哈希分为多个分区（各在p{k}子目录下），
+ * 不同分区的入场/出场并行处理，适合车流量很大的停车场；分区数创建后不能修改
+ */
+HttpResponse ParkingApiServer::handleCreateLot(LotShard&, const HttpRequest& req) {
+    try {
+        std::string id;
+        if (!extractStringField(req.body, "id", id)) {
+            throw std::runtime_error("Missing id field");
+        }
+        if (!isValidLotId(id)) {
+            throw std::runtime_error("id must be 1-32 letters, digits, '-' or '_'");
+        }
+        long long capacity = 100;
+        Cents smallRate = 500;
+        Cents largeRate = 800;
+        extractCountField(req.body, "capacity", capacity);
+        extractCentsField(req.body, "smallRate", smallRate);
+        extractCentsField(req.body, "largeRate", largeRate);
+        if (capacity < 1 || capacity > static_cast<long long>(ParkingLot::MAX_CAPACITY) ||
+            !ParkingLot::isValidRate(smallRate) || !ParkingLot::isValidRate(largeRate)) {
+            throw std::runtime_error("capacity must be 1-" + std::to_string(ParkingLot::MAX_CAPACITY) +
+                                     " and rates must be positive and at most " +
+                                     formatCents(ParkingLot::MAX_HOURLY_RATE));
+        }
+        long long partitions = 1;
+        extractCountField(req.body, "partitions", partitions);
+        if (partitions < 1 || partitions > static_cast<long long>(PartitionedLot::MAX_PARTITIONS)) {
+            throw std::runtime_error("partitions must be 1-" + std::to_string(PartitionedLot::MAX_PARTITIONS));
+        }
+
+        // 写锁内只占用编号：构造各分区、写快照（日志引擎要fsync）在锁外进行，
+        // 不阻塞其他停车场的请求（每个请求都要加读锁查找停车场）
+        {
+            std::unique_lock<std::shared_mutex> lock(lotsMutex);
+            if (lots.count(id) > 0 || creatingLots.count(id) > 0) {
+                HttpResponse response(409);
+                response.body = createJsonResponse(false, "Parking lot already exists");
+                return response;
+            }
+            creatingLots.insert(id);
+        }
+
+        std::unique_ptr<PartitionedLot> lot;
+        try {
+            // 每个分区的容量都是整个停车场的容量，总数由PartitionedLot控制
+            std::vector<std::unique_ptr<ParkingLot>> parts;
+            for (long long k = 0; k < partitions; ++k) {
+                std::string file = partitions > 1 ? lotDataFile(id, static_cast<size_t>(k)) : lotDataFile(id);
+                fs::create_directories(fs::path(file).parent_path());
+                parts.push_back(std::make_unique<ParkingLot>(static_cast<size_t>(capacity), smallRate, largeRate,
+                                                             file, storageEngine));
+            }
+            lot = std::make_unique<PartitionedLot>(std::move(parts), lotSeriesFile(id));
+            lot->saveData();  // 立即保存容量和费率，没有车辆进出时重启也能恢复
+        } catch (...) {
+            // 创建失败：删除写了一半的目录，释放编号
+            lot.reset();
+            std::error_code error;
+            fs::remove_all(fs::path(lotDataFile(id)).parent_path(), error);
+            std::unique_lock<std::shared_mutex> lock(lotsMutex);
+            creatingLots.erase(id);
+            throw;
+        }
+
+        {
+            std::unique_lock<std::shared_mutex> lock(lotsMutex);
+            creatingLots.erase(id);
+            addLot(id, std::move(lot));
+        }
+        std::cout << "Created parking lot " << id << " with " << capacity << " spaces";
+        if (partitions > 1) {
+            std::cout << " in " << partitions << " partitions";
+        }
+        std::cout << std::endl;
+
+        std::ostringstream data;
+        data << "{\"id\":\"" << id << "\",\"capacity\":" << capacity << ",\"partitions\":" << partitions << "}";
+        HttpResponse response;
+        response.body = createJsonResponse(true, "Parking lot created", data.str());
+        return response;
+    } catch (const std::exception& e) {
+        HttpResponse response(400);
+        response.body = createJsonResponse(false, std::string("Error creating parking lot: ") + e.what());
+        return response;
+    }
+}
+
+/**
+ * @brief 处理后台任务调度器状态请求
+ * 返回工作线程数、各优先级排队的任务数、窃取次数，以及按任务类型累计的执行次数、CPU时间、
+ * 执行耗时和平均排队时间（毫秒），用于发现占用CPU最多的后台工作
+ */
+HttpResponse ParkingApiServer::handleGetScheduler(LotShard&, const HttpRequest&) {
+    TaskSchedulerStats stats = scheduler.getStats();
+
+    std::ostringstream data;
+    data << std::fixed << std::setprecision(3);
+    data << "{\"workers\":" << stats.workers << ",";
+    data << "\"queued\":{\"high\":" << stats.queued[static_cast<int>(TaskPriority::High)] << ",";
+    data << "\"normal\":" << stats.queued[static_cast<int>(TaskPriority::Normal)] << ",";
+    data << "\"low\":" << stats.queued[static_cast<int>(TaskPriority::Low)] << "},";
+    data << "\"delayed\":" << stats.delayed << ",";
+    data << "\"steals\":" << stats.steals << ",";
+    data << "\"tasks\":[";
+    for (size_t i = 0; i < stats.types.size(); ++i) {
+        const TaskTypeStats& type = stats.types[i];
+        uint64_t started = type.completed + type.failed + type.running;
+        data << (i > 0 ? "," : "");
+        data << "{\"type\":\"" << type.type << "\",";
+        data << "\"submitted\":" << type.submitted << ",";
+        data << "\"completed\":" << type.completed << ",";
+        data << "\"failed\":" << type.failed << ",";
+        data << "\"cancelled\":" << type.cancelled << ",";
+        data << "\"running\":" << type.running << ",";
+        data << "\"cpuMs\":" << type.cpuNanos / 1e6 << ",";
+        data << "\"wallMs\":" << type.wallNanos / 1e6 << ",";
+        data << "\"avgQueueWaitMs\":";
+        if (started > 0) {
+            data << type.queueWaitNanos / 1e6 / started;
+        } else {
+            data << "null";
+        }
+        data << "}";
+    }
+    data << "]}";
+
+    HttpResponse response;
+    response.body = createJsonResponse(true, "Scheduler stats retrieved", data.str());
+    return response;
+}
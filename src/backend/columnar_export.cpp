@@ -0,0 +1,767 @@
+/**
+ * @file columnar_export.cpp
+ * @brief Arrow IPC流格式和Parquet格式导出的具体实现
+ *
+ * 两种格式的元数据分别使用FlatBuffers和Thrift Compact协议编码，
+ * 这里只实现导出所需的最小子集，不依赖Arrow/Parquet库。
+ * 数值均按小端序写出（与x86/ARM主机字节序一致）
+ */
+#include "include/columnar_export.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+ExportSink::ExportSink(Writer writer, size_t flushSize)
+    : writer(std::move(writer))
+    , flushSize(flushSize)
+    , written(0)
+    , failed(false)
+{
+    buffer.reserve(flushSize);
+}
+
+bool ExportSink::write(const void* data, size_t size) {
+    if (failed) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+    buffer.append(static_cast<const char*>(data), size);
+    written += size;
+    if (buffer.size() >= flushSize) {
+        return flush();
+    }
+    return true;
+}
+
+bool ExportSink::pad(size_t alignment) {
+    static const char zeros[64] = {};
+    size_t padding = (alignment - written % alignment) % alignment;
+    return write(zeros, padding);
+}
+
+bool ExportSink::flush() {
+    if (!failed && !buffer.empty()) {
+        failed = !writer(buffer);
+        buffer.clear();
+    }
+    return !failed;
+}
+
+namespace {
+
+// ==================== FlatBuffers（Arrow元数据） ====================
+
+/**
+ * 最小的FlatBuffers构造器：与官方实现一样从缓冲区末尾向前构造，
+ * 对象的位置用"距缓冲区末尾的字节数"表示，嵌套对象必须先于引用它的表构造
+ */
+class FlatBufferBuilder {
+public:
+    using Offset = uint32_t;
+
+private:
+    std::vector<uint8_t> bytes;   // 已构造的部分，位于最终缓冲区的末尾
+    size_t minAlign = 1;
+    size_t tableStart = 0;
+    std::vector<std::pair<int, Offset>> fields;  // 当前表的(字段编号, 字段位置)
+
+    void pushFront(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.begin(), p, p + size);
+    }
+
+    // 填充0字节，使接下来写入additional字节后的位置按align对齐
+    void prep(size_t align, size_t additional) {
+        minAlign = std::max(minAlign, align);
+        size_t padding = (align - (bytes.size() + additional) % align) % align;
+        bytes.insert(bytes.begin(), padding, 0);
+    }
+
+    template <typename T>
+    void push(T value) {
+        prep(sizeof(T), 0);
+        pushFront(&value, sizeof(T));
+    }
+
+    // 写入指向target的uoffset（相对于该字段自身的位置）
+    void pushOffset(Offset target) {
+        prep(4, 0);
+        push<uint32_t>(static_cast<uint32_t>(bytes.size() + 4 - target));
+    }
+
+public:
+    Offset createString(const std::string& value) {
+        prep(4, value.size() + 1);
+        push<uint8_t>(0);
+        pushFront(value.data(), value.size());
+        push<uint32_t>(static_cast<uint32_t>(value.size()));
+        return static_cast<Offset>(bytes.size());
+    }
+
+    // 结构体数组（元素为若干int64，8字节对齐）
+    template <typename T>
+    Offset createStructVector(const std::vector<T>& items) {
+        prep(4, sizeof(T) * items.size());
+        prep(8, sizeof(T) * items.size());
+        for (size_t i = items.size(); i-- > 0;) {
+            pushFront(&items[i], sizeof(T));
+        }
+        push<uint32_t>(static_cast<uint32_t>(items.size()));
+        return static_cast<Offset>(bytes.size());
+    }
+
+    Offset createOffsetVector(const std::vector<Offset>& items) {
+        prep(4, 4 * items.size());
+        for (size_t i = items.size(); i-- > 0;) {
+            pushOffset(items[i]);
+        }
+        push<uint32_t>(static_cast<uint32_t>(items.size()));
+        return static_cast<Offset>(bytes.size());
+    }
+
+    void startTable() {
+        fields.clear();
+        tableStart = bytes.size();
+    }
+
+    template <typename T>
+    void addScalar(int id, T value) {
+        push<T>(value);
+        fields.emplace_back(id, static_cast<Offset>(bytes.size()));
+    }
+
+    void addOffset(int id, Offset target) {
+        pushOffset(target);
+        fields.emplace_back(id, static_cast<Offset>(bytes.size()));
+    }
+
+    Offset endTable() {
+        push<int32_t>(0);  // 指向vtable的soffset，vtable写入后回填
+        Offset table = static_cast<Offset>(bytes.size());
+
+        int maxId = -1;
+        for (const auto& field : fields) {
+            maxId = std::max(maxId, field.first);
+        }
+        std::vector<uint16_t> vtable(maxId + 1, 0);
+        for (const auto& [id, position] : fields) {
+            vtable[id] = static_cast<uint16_t>(table - position);
+        }
+
+        // vtable: [vtable字节数, 表字节数, 各字段在表内的偏移...]，紧接在表之前
+        for (size_t i = vtable.size(); i-- > 0;) {
+            push<uint16_t>(vtable[i]);
+        }
+        push<uint16_t>(static_cast<uint16_t>(table - tableStart));
+        push<uint16_t>(static_cast<uint16_t>((vtable.size() + 2) * 2));
+
+        int32_t soffset = static_cast<int32_t>(bytes.size() - table);
+        std::memcpy(&bytes[bytes.size() - table], &soffset, sizeof(soffset));
+        return table;
+    }
+
+    std::vector<uint8_t> finish(Offset root) {
+        prep(std::max<size_t>(minAlign, 8), 4);
+        pushOffset(root);
+        return std::move(bytes);
+    }
+};
+
+// Arrow Schema.fbs / Message.fbs中用到的枚举值
+const int16_t ARROW_METADATA_V5 = 4;
+const uint8_t ARROW_HEADER_SCHEMA = 1;
+const uint8_t ARROW_HEADER_DICTIONARY_BATCH = 2;
+const uint8_t ARROW_HEADER_RECORD_BATCH = 3;
+const uint8_t ARROW_TYPE_INT = 2;
+const uint8_t ARROW_TYPE_UTF8 = 5;
+const uint8_t ARROW_TYPE_TIMESTAMP = 10;
+const int16_t ARROW_TIME_UNIT_SECOND = 0;
+
+// RecordBatch中的FieldNode和Buffer结构体
+struct ArrowFieldNode {
+    int64_t length;
+    int64_t nullCount;
+};
+struct ArrowBuffer {
+    int64_t offset;
+    int64_t length;
+};
+
+// 记录批的消息体：各缓冲区按8字节对齐依次排列
+struct ArrowBody {
+    std::vector<ArrowFieldNode> nodes;
+    std::vector<ArrowBuffer> buffers;
+    std::vector<std::pair<const void*, size_t>> data;  // 各缓冲区的数据（不复制）
+    int64_t length = 0;
+
+    void addBuffer(const void* pointer, size_t size) {
+        buffers.push_back({length, static_cast<int64_t>(size)});
+        data.emplace_back(pointer, size);
+        length += static_cast<int64_t>((size + 7) / 8 * 8);
+    }
+
+    // 不可为空的定长列：空的有效位图 + 数据
+    template <typename T>
+    void addColumn(const std::vector<T>& values) {
+        nodes.push_back({static_cast<int64_t>(values.size()), 0});
+        addBuffer(nullptr, 0);
+        addBuffer(values.data(), values.size() * sizeof(T));
+    }
+};
+
+FlatBufferBuilder::Offset buildIntType(FlatBufferBuilder& fbb, int32_t bitWidth) {
+    fbb.startTable();
+    fbb.addScalar<int32_t>(0, bitWidth);   // bitWidth
+    fbb.addScalar<uint8_t>(1, 1);          // is_signed
+    return fbb.endTable();
+}
+
+FlatBufferBuilder::Offset buildRecordBatch(FlatBufferBuilder& fbb, int64_t rows, const ArrowBody& body) {
+    auto nodes = fbb.createStructVector(body.nodes);
+    auto buffers = fbb.createStructVector(body.buffers);
+    fbb.startTable();
+    fbb.addScalar<int64_t>(0, rows);       // length
+    fbb.addOffset(1, nodes);               // nodes
+    fbb.addOffset(2, buffers);             // buffers
+    return fbb.endTable();
+}
+
+std::vector<uint8_t> finishMessage(FlatBufferBuilder& fbb, uint8_t headerType,
+                                   FlatBufferBuilder::Offset header, int64_t bodyLength) {
+    fbb.startTable();
+    fbb.addScalar<int16_t>(0, ARROW_METADATA_V5);  // version
+    fbb.addScalar<uint8_t>(1, headerType);         // header_type
+    fbb.addOffset(2, header);                      // header
+    fbb.addScalar<int64_t>(3, bodyLength);         // bodyLength
+    return fbb.finish(fbb.endTable());
+}
+
+// 写出一条封装消息：0xFFFFFFFF、元数据长度、元数据（补齐到8字节）、消息体
+bool writeArrowMessage(ExportSink& sink, const std::vector<uint8_t>& metadata, const ArrowBody* body) {
+    const uint32_t continuation = 0xFFFFFFFF;
+    int32_t metadataSize = static_cast<int32_t>((metadata.size() + 7) / 8 * 8);
+    sink.write(&continuation, sizeof(continuation));
+    sink.write(&metadataSize, sizeof(metadataSize));
+    sink.write(metadata.data(), metadata.size());
+    sink.pad(8);
+    if (body) {
+        for (const auto& [pointer, size] : body->data) {
+            sink.write(pointer, size);
+            sink.pad(8);
+        }
+    }
+    return sink.ok();
+}
+
+std::vector<uint8_t> buildArrowSchema() {
+    FlatBufferBuilder fbb;
+
+    struct ColumnSpec {
+        const char* name;
+        uint8_t typeId;
+        int64_t dictionaryId;  // -1表示不使用字典编码
+    };
+    const ColumnSpec columns[] = {
+        {"plate", ARROW_TYPE_UTF8, 0},
+        {"type", ARROW_TYPE_UTF8, 1},
+        {"entry_time", ARROW_TYPE_TIMESTAMP, -1},
+        {"exit_time", ARROW_TYPE_TIMESTAMP, -1},
+        {"fee_cents", ARROW_TYPE_INT, -1},
+    };
+
+    std::vector<FlatBufferBuilder::Offset> fields;
+    for (const auto& column : columns) {
+        auto name = fbb.createString(column.name);
+        auto children = fbb.createOffsetVector({});
+
+        FlatBufferBuilder::Offset type;
+        if (column.typeId == ARROW_TYPE_TIMESTAMP) {
+            auto timezone = fbb.createString("UTC");
+            fbb.startTable();
+            fbb.addScalar<int16_t>(0, ARROW_TIME_UNIT_SECOND);  // unit
+            fbb.addOffset(1, timezone);                          // timezone
+            type = fbb.endTable();
+        } else if (column.typeId == ARROW_TYPE_INT) {
+            type = buildIntType(fbb, 64);
+        } else {
+            fbb.startTable();  // Utf8没有字段
+            type = fbb.endTable();
+        }
+
+        FlatBufferBuilder::Offset dictionary = 0;
+        if (column.dictionaryId >= 0) {
+            auto indexType = buildIntType(fbb, 32);
+            fbb.startTable();
+            fbb.addScalar<int64_t>(0, column.dictionaryId);  // id
+            fbb.addOffset(1, indexType);                     // indexType
+            dictionary = fbb.endTable();
+        }
+
+        fbb.startTable();
+        fbb.addOffset(0, name);                      // name
+        fbb.addScalar<uint8_t>(1, 0);                // nullable
+        fbb.addScalar<uint8_t>(2, column.typeId);    // type_type
+        fbb.addOffset(3, type);                      // type
+        if (column.dictionaryId >= 0) {
+            fbb.addOffset(4, dictionary);            // dictionary
+        }
+        fbb.addOffset(5, children);                  // children
+        fields.push_back(fbb.endTable());
+    }
+
+    auto fieldVector = fbb.createOffsetVector(fields);
+    fbb.startTable();
+    fbb.addScalar<int16_t>(0, 0);      // endianness: Little
+    fbb.addOffset(1, fieldVector);     // fields
+    auto schema = fbb.endTable();
+    return finishMessage(fbb, ARROW_HEADER_SCHEMA, schema, 0);
+}
+
+// 字符串字典转换为Arrow的utf8数组（int32偏移量 + 连续字节）
+struct Utf8Array {
+    std::vector<int32_t> offsets;
+    std::string bytes;
+
+    explicit Utf8Array(const std::vector<std::string>& values) {
+        offsets.reserve(values.size() + 1);
+        offsets.push_back(0);
+        for (const auto& value : values) {
+            bytes += value;
+            offsets.push_back(static_cast<int32_t>(bytes.size()));
+        }
+    }
+};
+
+bool writeArrowDictionary(ExportSink& sink, int64_t id, const std::vector<std::string>& values) {
+    Utf8Array array(values);
+    ArrowBody body;
+    body.nodes.push_back({static_cast<int64_t>(values.size()), 0});
+    body.addBuffer(nullptr, 0);
+    body.addBuffer(array.offsets.data(), array.offsets.size() * sizeof(int32_t));
+    body.addBuffer(array.bytes.data(), array.bytes.size());
+
+    FlatBufferBuilder fbb;
+    auto data = buildRecordBatch(fbb, static_cast<int64_t>(values.size()), body);
+    fbb.startTable();
+    fbb.addScalar<int64_t>(0, id);     // id
+    fbb.addOffset(1, data);            // data
+    auto batch = fbb.endTable();
+    return writeArrowMessage(sink, finishMessage(fbb, ARROW_HEADER_DICTIONARY_BATCH, batch, body.length), &body);
+}
+
+bool writeArrowRecordBatch(ExportSink& sink, const HistoryChunk& chunk) {
+    ArrowBody body;
+    body.addColumn(chunk.plate);
+    body.addColumn(chunk.type);
+    body.addColumn(chunk.entryTime);
+    body.addColumn(chunk.exitTime);
+    body.addColumn(chunk.fee);
+
+    FlatBufferBuilder fbb;
+    auto batch = buildRecordBatch(fbb, static_cast<int64_t>(chunk.size()), body);
+    return writeArrowMessage(sink, finishMessage(fbb, ARROW_HEADER_RECORD_BATCH, batch, body.length), &body);
+}
+
+// ==================== Thrift Compact协议（Parquet元数据） ====================
+
+class ThriftCompactWriter {
+private:
+    std::string out;
+    int16_t lastField = 0;
+    std::vector<int16_t> fieldStack;  // 外层结构体的lastField
+
+    enum : uint8_t {
+        TYPE_TRUE = 1, TYPE_FALSE = 2, TYPE_I32 = 5, TYPE_I64 = 6,
+        TYPE_BINARY = 8, TYPE_LIST = 9, TYPE_STRUCT = 12,
+    };
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    void fieldHeader(int16_t id, uint8_t type) {
+        int delta = id - lastField;
+        if (delta > 0 && delta <= 15) {
+            out += static_cast<char>((delta << 4) | type);
+        } else {
+            out += static_cast<char>(type);
+            varint(zigzag(id));
+        }
+        lastField = id;
+    }
+
+    void listHeader(int16_t id, uint8_t elementType, size_t size) {
+        fieldHeader(id, TYPE_LIST);
+        if (size < 15) {
+            out += static_cast<char>((size << 4) | elementType);
+        } else {
+            out += static_cast<char>(0xF0 | elementType);
+            varint(size);
+        }
+    }
+
+public:
+    void i32(int16_t id, int32_t value) { fieldHeader(id, TYPE_I32); varint(zigzag(value)); }
+    void i64(int16_t id, int64_t value) { fieldHeader(id, TYPE_I64); varint(zigzag(value)); }
+    void boolean(int16_t id, bool value) { fieldHeader(id, value ? TYPE_TRUE : TYPE_FALSE); }
+    void string(int16_t id, const std::string& value) {
+        fieldHeader(id, TYPE_BINARY);
+        varint(value.size());
+        out += value;
+    }
+
+    void i32List(int16_t id, const std::vector<int32_t>& values) {
+        listHeader(id, TYPE_I32, values.size());
+        for (int32_t value : values) {
+            varint(zigzag(value));
+        }
+    }
+    void stringList(int16_t id, const std::vector<std::string>& values) {
+        listHeader(id, TYPE_BINARY, values.size());
+        for (const auto& value : values) {
+            varint(value.size());
+            out += value;
+        }
+    }
+
+    // 结构体字段 / 结构体列表，之后依次写入元素并以endStruct结束
+    void beginStruct(int16_t id) {
+        fieldHeader(id, TYPE_STRUCT);
+        beginStructElement();
+    }
+    void beginStructList(int16_t id, size_t size) { listHeader(id, TYPE_STRUCT, size); }
+    void beginStructElement() {
+        fieldStack.push_back(lastField);
+        lastField = 0;
+    }
+    void endStruct() {
+        out += '\0';
+        lastField = fieldStack.back();
+        fieldStack.pop_back();
+    }
+
+    // 结束最外层结构体并返回编码结果
+    const std::string& finish() {
+        out += '\0';
+        return out;
+    }
+};
+
+// parquet.thrift中用到的枚举值
+const int32_t PARQUET_INT64 = 2;
+const int32_t PARQUET_BYTE_ARRAY = 6;
+const int32_t PARQUET_REQUIRED = 0;
+const int32_t PARQUET_CONVERTED_UTF8 = 0;
+const int32_t PARQUET_CONVERTED_TIMESTAMP_MILLIS = 9;
+const int32_t PARQUET_PLAIN = 0;
+const int32_t PARQUET_RLE = 3;
+const int32_t PARQUET_RLE_DICTIONARY = 8;
+const int32_t PARQUET_DATA_PAGE = 0;
+const int32_t PARQUET_DICTIONARY_PAGE = 2;
+
+const size_t ROW_GROUP_CHUNKS = 16;  // 每个行组最多包含的段数
+
+enum class ParquetColumn { Plate, Type, EntryTime, ExitTime, Fee };
+
+struct ParquetColumnSpec {
+    ParquetColumn column;
+    const char* name;
+    int32_t physicalType;
+    bool dictionary;
+    bool timestamp;
+};
+
+const ParquetColumnSpec PARQUET_COLUMNS[] = {
+    {ParquetColumn::Plate, "plate", PARQUET_BYTE_ARRAY, true, false},
+    {ParquetColumn::Type, "type", PARQUET_BYTE_ARRAY, true, false},
+    {ParquetColumn::EntryTime, "entry_time", PARQUET_INT64, false, true},
+    {ParquetColumn::ExitTime, "exit_time", PARQUET_INT64, false, true},
+    {ParquetColumn::Fee, "fee_cents", PARQUET_INT64, false, false},
+};
+
+// 一个列块（column chunk）写出后的位置信息
+struct ParquetColumnChunk {
+    int64_t start;
+    int64_t dictionaryPageOffset;
+    int64_t dataPageOffset;
+    int64_t size;
+    int64_t values;
+};
+
+struct ParquetRowGroup {
+    std::vector<ParquetColumnChunk> columns;
+    int64_t rows;
+};
+
+bool writeParquetPage(ExportSink& sink, int32_t pageType, int32_t values, int32_t encoding,
+                      const std::vector<std::pair<const void*, size_t>>& parts) {
+    size_t size = 0;
+    for (const auto& part : parts) {
+        size += part.second;
+    }
+
+    ThriftCompactWriter header;
+    header.i32(1, pageType);                          // type
+    header.i32(2, static_cast<int32_t>(size));        // uncompressed_page_size
+    header.i32(3, static_cast<int32_t>(size));        // compressed_page_size
+    if (pageType == PARQUET_DATA_PAGE) {
+        header.beginStruct(5);                        // data_page_header
+        header.i32(1, values);                        // num_values
+        header.i32(2, encoding);                      // encoding
+        header.i32(3, PARQUET_RLE);                   // definition_level_encoding
+        header.i32(4, PARQUET_RLE);                   // repetition_level_encoding
+        header.endStruct();
+    } else {
+        header.beginStruct(7);                        // dictionary_page_header
+        header.i32(1, values);                        // num_values
+        header.i32(2, encoding);                      // encoding
+        header.endStruct();
+    }
+    const std::string& encoded = header.finish();
+
+    sink.write(encoded.data(), encoded.size());
+    for (const auto& [pointer, partSize] : parts) {
+        sink.write(pointer, partSize);
+    }
+    return sink.ok();
+}
+
+// 字典页：PLAIN编码的BYTE_ARRAY（每个值为4字节长度 + 内容）
+bool writeParquetDictionaryPage(ExportSink& sink, const std::vector<std::string>& values) {
+    std::string plain;
+    for (const auto& value : values) {
+        uint32_t length = static_cast<uint32_t>(value.size());
+        plain.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        plain += value;
+    }
+    return writeParquetPage(sink, PARQUET_DICTIONARY_PAGE, static_cast<int32_t>(values.size()),
+                            PARQUET_PLAIN, {{plain.data(), plain.size()}});
+}
+
+// 字典编号数据页：位宽字节 + 一个位打包（bit-packed）段。
+// 位宽为32时每个值正好占4个小端字节，可直接输出编号数组，不足8个的部分补0
+bool writeParquetIndexPage(ExportSink& sink, const std::vector<int32_t>& ids) {
+    size_t groups = (ids.size() + 7) / 8;
+    std::string header;
+    header += static_cast<char>(32);
+    uint64_t runHeader = (static_cast<uint64_t>(groups) << 1) | 1;
+    while (runHeader >= 0x80) {
+        header += static_cast<char>((runHeader & 0x7F) | 0x80);
+        runHeader >>= 7;
+    }
+    header += static_cast<char>(runHeader);
+
+    static const int32_t zeros[8] = {};
+    size_t padding = groups * 8 - ids.size();
+    return writeParquetPage(sink, PARQUET_DATA_PAGE, static_cast<int32_t>(ids.size()), PARQUET_RLE_DICTIONARY,
+                            {{header.data(), header.size()},
+                             {ids.data(), ids.size() * sizeof(int32_t)},
+                             {zeros, padding * sizeof(int32_t)}});
+}
+
+bool writeParquetInt64Page(ExportSink& sink, const std::vector<int64_t>& values) {
+    return writeParquetPage(sink, PARQUET_DATA_PAGE, static_cast<int32_t>(values.size()), PARQUET_PLAIN,
+                            {{values.data(), values.size() * sizeof(int64_t)}});
+}
+
+bool writeParquetRowGroup(ExportSink& sink, const HistorySnapshot& snapshot,
+                          const std::vector<std::shared_ptr<const HistoryChunk>>& chunks,
+                          std::vector<ParquetRowGroup>& rowGroups) {
+    ParquetRowGroup rowGroup;
+    rowGroup.rows = 0;
+    for (const auto& chunk : chunks) {
+        rowGroup.rows += static_cast<int64_t>(chunk->size());
+    }
+
+    std::vector<int64_t> millis;
+    for (const auto& spec : PARQUET_COLUMNS) {
+        ParquetColumnChunk column;
+        column.start = static_cast<int64_t>(sink.offset());
+        column.dictionaryPageOffset = column.start;
+        column.values = rowGroup.rows;
+
+        if (spec.dictionary) {
+            const auto& dictionary = spec.column == ParquetColumn::Plate ? snapshot.plates : snapshot.types;
+            writeParquetDictionaryPage(sink, dictionary);
+        }
+        column.dataPageOffset = static_cast<int64_t>(sink.offset());
+
+        for (const auto& chunk : chunks) {
+            switch (spec.column) {
+                case ParquetColumn::Plate:
+                    writeParquetIndexPage(sink, chunk->plate);
+                    break;
+                case ParquetColumn::Type:
+                    writeParquetIndexPage(sink, chunk->type);
+                    break;
+                case ParquetColumn::EntryTime:
+                case ParquetColumn::ExitTime: {
+                    // Parquet的时间戳最小单位为毫秒
+                    const auto& seconds = spec.column == ParquetColumn::EntryTime ? chunk->entryTime : chunk->exitTime;
+                    millis.resize(seconds.size());
+                    for (size_t i = 0; i < seconds.size(); ++i) {
+                        millis[i] = seconds[i] * 1000;
+                    }
+                    writeParquetInt64Page(sink, millis);
+                    break;
+                }
+                case ParquetColumn::Fee:
+                    writeParquetInt64Page(sink, chunk->fee);
+                    break;
+            }
+        }
+        column.size = static_cast<int64_t>(sink.offset()) - column.start;
+        rowGroup.columns.push_back(column);
+    }
+
+    rowGroups.push_back(std::move(rowGroup));
+    return sink.ok();
+}
+
+std::string buildParquetFooter(const std::vector<ParquetRowGroup>& rowGroups) {
+    int64_t totalRows = 0;
+    for (const auto& rowGroup : rowGroups) {
+        totalRows += rowGroup.rows;
+    }
+
+    ThriftCompactWriter meta;
+    meta.i32(1, 1);  // version
+
+    // schema：根节点 + 各列
+    const size_t columnCount = sizeof(PARQUET_COLUMNS) / sizeof(PARQUET_COLUMNS[0]);
+    meta.beginStructList(2, columnCount + 1);
+    meta.beginStructElement();
+    meta.string(4, "schema");                                 // name
+    meta.i32(5, static_cast<int32_t>(columnCount));           // num_children
+    meta.endStruct();
+    for (const auto& spec : PARQUET_COLUMNS) {
+        meta.beginStructElement();
+        meta.i32(1, spec.physicalType);                       // type
+        meta.i32(3, PARQUET_REQUIRED);                        // repetition_type
+        meta.string(4, spec.name);                            // name
+        if (spec.physicalType == PARQUET_BYTE_ARRAY) {
+            meta.i32(6, PARQUET_CONVERTED_UTF8);              // converted_type
+            meta.beginStruct(10);                             // logicalType
+            meta.beginStruct(1);                              // STRING
+            meta.endStruct();
+            meta.endStruct();
+        } else if (spec.timestamp) {
+            meta.i32(6, PARQUET_CONVERTED_TIMESTAMP_MILLIS);  // converted_type
+            meta.beginStruct(10);                             // logicalType
+            meta.beginStruct(8);                              // TIMESTAMP
+            meta.boolean(1, true);                            // isAdjustedToUTC
+            meta.beginStruct(2);                              // unit
+            meta.beginStruct(1);                              // MILLIS
+            meta.endStruct();
+            meta.endStruct();
+            meta.endStruct();
+            meta.endStruct();
+        }
+        meta.endStruct();
+    }
+
+    meta.i64(3, totalRows);  // num_rows
+
+    meta.beginStructList(4, rowGroups.size());
+    for (const auto& rowGroup : rowGroups) {
+        int64_t totalSize = 0;
+        for (const auto& column : rowGroup.columns) {
+            totalSize += column.size;
+        }
+
+        meta.beginStructElement();
+        meta.beginStructList(1, rowGroup.columns.size());  // columns
+        for (size_t i = 0; i < rowGroup.columns.size(); ++i) {
+            const auto& spec = PARQUET_COLUMNS[i];
+            const auto& column = rowGroup.columns[i];
+            meta.beginStructElement();
+            meta.i64(2, column.start);                     // file_offset
+            meta.beginStruct(3);                           // meta_data
+            meta.i32(1, spec.physicalType);                // type
+            if (spec.dictionary) {
+                meta.i32List(2, {PARQUET_PLAIN, PARQUET_RLE_DICTIONARY});  // encodings
+            } else {
+                meta.i32List(2, {PARQUET_PLAIN});
+            }
+            meta.stringList(3, {spec.name});               // path_in_schema
+            meta.i32(4, 0);                                // codec: UNCOMPRESSED
+            meta.i64(5, column.values);                    // num_values
+            meta.i64(6, column.size);                      // total_uncompressed_size
+            meta.i64(7, column.size);                      // total_compressed_size
+            meta.i64(9, column.dataPageOffset);            // data_page_offset
+            if (spec.dictionary) {
+                meta.i64(11, column.dictionaryPageOffset); // dictionary_page_offset
+            }
+            meta.endStruct();
+            meta.endStruct();
+        }
+        meta.i64(2, totalSize);                            // total_byte_size
+        meta.i64(3, rowGroup.rows);                        // num_rows
+        meta.i64(5, rowGroup.columns.front().start);       // file_offset
+        meta.i64(6, totalSize);                            // total_compressed_size
+        meta.endStruct();
+    }
+
+    meta.string(6, "parking_api_server");  // created_by
+    return meta.finish();
+}
+
+}
+
+bool exportArrowStream(const HistorySnapshot& snapshot, int64_t from, int64_t to, ExportSink& sink) {
+    if (!writeArrowMessage(sink, buildArrowSchema(), nullptr) ||
+        !writeArrowDictionary(sink, 0, snapshot.plates) ||
+        !writeArrowDictionary(sink, 1, snapshot.types)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < snapshot.segments.size(); ++i) {
+        auto rows = snapshot.rowsOf(i, from, to);
+        if (rows && !writeArrowRecordBatch(sink, *rows)) {
+            return false;
+        }
+    }
+
+    // 流结束标记
+    const uint32_t endOfStream[2] = {0xFFFFFFFF, 0};
+    sink.write(endOfStream, sizeof(endOfStream));
+    return sink.flush();
+}
+
+bool exportParquet(const HistorySnapshot& snapshot, int64_t from, int64_t to, ExportSink& sink) {
+    const char magic[4] = {'P', 'A', 'R', '1'};
+    sink.write(magic, sizeof(magic));
+
+    std::vector<ParquetRowGroup> rowGroups;
+    std::vector<std::shared_ptr<const HistoryChunk>> pending;
+    for (size_t i = 0; i < snapshot.segments.size(); ++i) {
+        auto rows = snapshot.rowsOf(i, from, to);
+        if (rows) {
+            pending.push_back(std::move(rows));
+        }
+        if (pending.size() == ROW_GROUP_CHUNKS || (i + 1 == snapshot.segments.size() && !pending.empty())) {
+            if (!writeParquetRowGroup(sink, snapshot, pending, rowGroups)) {
+                return false;
+            }
+            pending.clear();
+        }
+    }
+
+    std::string footer = buildParquetFooter(rowGroups);
+    uint32_t footerLength = static_cast<uint32_t>(footer.size());
+    sink.write(footer.data(), footer.size());
+    sink.write(&footerLength, sizeof(footerLength));
+    sink.write(magic, sizeof(magic));
+    return sink.flush();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file crc32c.cpp
+ * @brief CRC32C校验和的硬件和查表实现
+ */
+#include "include/crc32c.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HAS_SSE42 1
+#endif
+
+namespace {
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;  // 反转后的Castagnoli多项式
+
+// 查表实现的8张表：tables[k][b]为字节b之后再跟k个零字节的余数，每次可以处理8字节
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+CrcTables buildTables() {
+    CrcTables tables{};
+    for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1)));
+        }
+        tables[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+        for (size_t k = 1; k < tables.size(); ++k) {
+            tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+uint32_t crc32cSoftware(const uint8_t* p, size_t length, uint32_t crc) {
+    static const CrcTables tables = buildTables();
+    for (; length >= 8; p += 8, length -= 8) {
+        uint32_t low, high;
+        std::memcpy(&low, p, sizeof(low));
+        std::memcpy(&high, p + 4, sizeof(high));
+        low ^= crc;  // 按小端字节序
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^
+              tables[4][low >> 24] ^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^
+              tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+    }
+    for (; length > 0; ++p, --length) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *p) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef CRC32C_HAS_SSE42
+#if defined(__x86_64__)
+const size_t STREAM_BLOCK = 8192;  // 三路并行时每路每次处理的字节数
+
+// 把寄存器值推进STREAM_BLOCK个零字节的查找表：余数运算是线性的，
+// 先求32个单独的位各自推进后的结果，再按字节组合成4张表
+using ShiftTables = std::array<std::array<uint32_t, 256>, 4>;
+
+ShiftTables buildShiftTables() {
+    uint32_t basis[32];
+    for (int bit = 0; bit < 32; ++bit) {
+        uint32_t crc = 1u << bit;
+        for (size_t i = 0; i < STREAM_BLOCK * 8; ++i) {
+            crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1)));
+        }
+        basis[bit] = crc;
+    }
+    ShiftTables tables{};
+    for (int k = 0; k < 4; ++k) {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t value = 0;
+            for (int bit = 0; bit < 8; ++bit) {
+                if (b & (1u << bit)) {
+                    value ^= basis[8 * k + bit];
+                }
+            }
+            tables[k][b] = value;
+        }
+    }
+    return tables;
+}
+
+uint32_t shiftBlock(const ShiftTables& tables, uint32_t crc) {
+    return tables[0][crc & 0xFF] ^ tables[1][(crc >> 8) & 0xFF] ^ tables[2][(crc >> 16) & 0xFF] ^ tables[3][crc >> 24];
+}
+#endif
+
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(const uint8_t* p, size_t length, uint32_t crc) {
+#if defined(__x86_64__)
+    // crc32指令延迟3个周期、吞吐1个周期，三段数据各算一路再合并，接近内存带宽
+    if (length >= 3 * STREAM_BLOCK) {
+        static const ShiftTables shift = buildShiftTables();
+        uint64_t crc0 = crc;
+        do {
+            uint64_t crc1 = 0, crc2 = 0;
+            for (size_t i = 0; i < STREAM_BLOCK; i += 8) {
+                uint64_t w0, w1, w2;
+                std::memcpy(&w0, p + i, sizeof(w0));
+                std::memcpy(&w1, p + STREAM_BLOCK + i, sizeof(w1));
+                std::memcpy(&w2, p + 2 * STREAM_BLOCK + i, sizeof(w2));
+                crc0 = _mm_crc32_u64(crc0, w0);
+                crc1 = _mm_crc32_u64(crc1, w1);
+                crc2 = _mm_crc32_u64(crc2, w2);
+            }
+            crc0 = shiftBlock(shift, static_cast<uint32_t>(crc0)) ^ crc1;
+            crc0 = shiftBlock(shift, static_cast<uint32_t>(crc0)) ^ crc2;
+            p += 3 * STREAM_BLOCK;
+            length -= 3 * STREAM_BLOCK;
+        } while (length >= 3 * STREAM_BLOCK);
+        crc = static_cast<uint32_t>(crc0);
+    }
+
+    uint64_t value = crc;
+    for (; length >= 8; p += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        value = _mm_crc32_u64(value, word);
+    }
+    crc = static_cast<uint32_t>(value);
+#endif
+    for (; length >= 4; p += 4, length -= 4) {
+        uint32_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; length > 0; ++p, --length) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+#endif
+
+using CrcKernel = uint32_t (*)(const uint8_t* p, size_t length, uint32_t crc);
+
+CrcKernel selectKernel() {
+#ifdef CRC32C_HAS_SSE42
+    if (__builtin_cpu_supports("sse4.2")) {
+        return crc32cHardware;
+    }
+#endif
+    return crc32cSoftware;
+}
+}
+
+uint32_t crc32c(const void* data, size_t length, uint32_t crc) {
+    static const CrcKernel kernel = selectKernel();
+    // 初值和结果都取反，分段计算时先还原上一段的中间状态
+    return ~kernel(static_cast<const uint8_t*>(data), length, ~crc);
+}
@@ -0,0 +1,149 @@
+/**
+ * @file frequent_visitors.cpp
+ * @brief CountMinSketch和FrequentVisitorTracker类的具体实现
+ */
+#include "include/frequent_visitors.h"
+#include <algorithm>
+#include <functional>
+
+CountMinSketch::CountMinSketch(size_t depth, size_t width)
+    : depth(depth)
+    , width(width)
+    , counters(depth * width, 0)
+{
+}
+
+size_t CountMinSketch::cellIndex(uint64_t hash, size_t row) const {
+    // 双重哈希：第row行使用 h1 + row × h2，h2为奇数保证各行分布不同
+    uint64_t h1 = hash & 0xffffffffu;
+    uint64_t h2 = (hash >> 32) | 1;
+    return row * width + (h1 + row * h2) % width;
+}
+
+uint32_t CountMinSketch::add(uint64_t hash) {
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < depth; ++row) {
+        uint32_t& counter = counters[cellIndex(hash, row)];
+        if (counter < UINT32_MAX) {
+            ++counter;
+        }
+        estimate = std::min(estimate, counter);
+    }
+    return estimate;
+}
+
+void CountMinSketch::clear() {
+    std::fill(counters.begin(), counters.end(), 0);
+}
+
+FrequentVisitorTracker::FrequentVisitorTracker(size_t candidatesPerDay)
+    : slots(MAX_WINDOW_DAYS)
+    , candidatesPerDay(candidatesPerDay)
+{
+}
+
+int64_t FrequentVisitorTracker::dayNumber(time_t time) {
+    // 按本地时间划分天
+    std::tm local{};
+    localtime_r(&time, &local);
+    return (static_cast<int64_t>(time) + local.tm_gmtoff) / 86400;
+}
+
+uint64_t FrequentVisitorTracker::hashPlate(const std::string& plate) {
+    // std::hash的结果再经过splitmix64混合，保证高低32位都足够随机
+    uint64_t x = std::hash<std::string>{}(plate) + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void FrequentVisitorTracker::record(const std::string& plate, time_t time) {
+    int64_t day = dayNumber(time);
+    DaySlot& slot = slots[day % MAX_WINDOW_DAYS];
+    if (slot.day > day) {
+        return;  // 早于窗口的旧数据
+    }
+    if (slot.day < day) {
+        // 新的一天覆盖MAX_WINDOW_DAYS天之前的数据
+        slot.day = day;
+        slot.sketch.clear();
+        slot.candidates.clear();
+        slot.ranking.clear();
+    }
+
+    uint32_t estimate = slot.sketch.add(hashPlate(plate));
+
+    // 更新当天的候选集合
+    auto it = slot.candidates.find(plate);
+    if (it != slot.candidates.end()) {
+        slot.ranking.erase({it->second, plate});
+        it->second = estimate;
+        slot.ranking.emplace(estimate, plate);
+        return;
+    }
+    if (slot.candidates.size() >= candidatesPerDay) {
+        auto smallest = slot.ranking.begin();
+        if (smallest->first >= estimate) {
+            return;  // 不足以进入候选集合
+        }
+        slot.candidates.erase(smallest->second);
+        slot.ranking.erase(smallest);
+    }
+    slot.candidates.emplace(plate, estimate);
+    slot.ranking.emplace(estimate, plate);
+}
+
+std::vector<VisitorCount> FrequentVisitorTracker::topK(size_t k, int windowDays, time_t now) const {
+    windowDays = std::max(1, std::min(windowDays, MAX_WINDOW_DAYS));
+    int64_t today = dayNumber(now);
+
+    // 找出窗口内有数据的天
+    std::vector<const DaySlot*> window;
+    for (int64_t day = today - windowDays + 1; day <= today; ++day) {
+        const DaySlot& slot = slots[day % MAX_WINDOW_DAYS];
+        if (slot.day == day) {
+            window.push_back(&slot);
+        }
+    }
+
+    // 合并各天的候选车牌
+    std::set<std::string> plates;
+    for (const DaySlot* slot : window) {
+        for (const auto& [plate, _] : slot->candidates) {
+            plates.insert(plate);
+        }
+    }
+
+    // 用窗口内Sketch逐行求和后的最小值估计窗口内的总次数
+    std::vector<VisitorCount> result;
+    result.reserve(plates.size());
+    for (const auto& plate : plates) {
+        uint64_t hash = hashPlate(plate);
+        uint64_t estimate = UINT64_MAX;
+        for (size_t row = 0; row < window.front()->sketch.getDepth(); ++row) {
+            uint64_t sum = 0;
+            for (const DaySlot* slot : window) {
+                sum += slot->sketch.cell(slot->sketch.cellIndex(hash, row));
+            }
+            estimate = std::min(estimate, sum);
+        }
+        result.push_back({plate, estimate});
+    }
+
+    std::sort(result.begin(), result.end(), [](const VisitorCount& a, const VisitorCount& b) {
+        return a.visits != b.visits ? a.visits > b.visits : a.licensePlate < b.licensePlate;
+    });
+    if (result.size() > k) {
+        result.resize(k);
+    }
+    return result;
+}
+
+void FrequentVisitorTracker::clear() {
+    for (DaySlot& slot : slots) {
+        slot.day = -1;
+        slot.sketch.clear();
+        slot.candidates.clear();
+        slot.ranking.clear();
+    }
+}
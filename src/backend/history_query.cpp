@@ -0,0 +1,244 @@
+/**
+ * @file history_query.cpp
+ * @brief 历史记录过滤/聚合查询的具体实现
+ */
+#include "include/history_query.h"
+#include "include/revenue_rollup.h"
+#include <algorithm>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HISTORY_QUERY_HAS_AVX2 1
+#endif
+
+namespace {
+
+// 编译后的查询条件：车型换成字典编号，各范围直接用于比较
+struct CompiledQuery {
+    int32_t typeId;          // -1表示不限车型
+    int32_t plateId;         // -1表示不限车牌
+    int64_t exitMin, exitMax;
+    int64_t entryMin, entryMax;
+    int64_t durationMin, durationMax;
+    int64_t feeMin, feeMax;
+};
+
+// 对块中[begin, begin + count)行（count不超过64）求值谓词，第j位为1表示第begin + j行命中
+using FilterKernel = uint64_t (*)(const HistoryChunk& chunk, size_t begin, size_t count, const CompiledQuery& query);
+
+uint64_t filterBlockScalar(const HistoryChunk& chunk, size_t begin, size_t count, const CompiledQuery& query) {
+    uint64_t mask = 0;
+    for (size_t j = 0; j < count; ++j) {
+        size_t i = begin + j;
+        int64_t exit = chunk.exitTime[i];
+        int64_t entry = chunk.entryTime[i];
+        int64_t duration = exit - entry;
+        int64_t fee = chunk.fee[i];
+        // 用按位与代替短路求值，避免分支
+        bool hit = (query.typeId < 0 || chunk.type[i] == query.typeId) &
+                   (query.plateId < 0 || chunk.plate[i] == query.plateId) &
+                   (exit >= query.exitMin) & (exit <= query.exitMax) &
+                   (entry >= query.entryMin) & (entry <= query.entryMax) &
+                   (duration >= query.durationMin) & (duration <= query.durationMax) &
+                   (fee >= query.feeMin) & (fee <= query.feeMax);
+        mask |= static_cast<uint64_t>(hit) << j;
+    }
+    return mask;
+}
+
+#ifdef HISTORY_QUERY_HAS_AVX2
+// x不在[min, max]内的通道为全1
+__attribute__((target("avx2")))
+inline __m256i outOfRange(__m256i x, __m256i min, __m256i max) {
+    return _mm256_or_si256(_mm256_cmpgt_epi64(min, x), _mm256_cmpgt_epi64(x, max));
+}
+
+__attribute__((target("avx2")))
+uint64_t filterBlockAvx2(const HistoryChunk& chunk, size_t begin, size_t count, const CompiledQuery& query) {
+    const int64_t* exitTime = chunk.exitTime.data() + begin;
+    const int64_t* entryTime = chunk.entryTime.data() + begin;
+    const int64_t* fee = chunk.fee.data() + begin;
+    const int32_t* type = chunk.type.data() + begin;
+    const int32_t* plate = chunk.plate.data() + begin;
+
+    const __m256i exitMin = _mm256_set1_epi64x(query.exitMin), exitMax = _mm256_set1_epi64x(query.exitMax);
+    const __m256i entryMin = _mm256_set1_epi64x(query.entryMin), entryMax = _mm256_set1_epi64x(query.entryMax);
+    const __m256i durationMin = _mm256_set1_epi64x(query.durationMin);
+    const __m256i durationMax = _mm256_set1_epi64x(query.durationMax);
+    const __m256i feeMin = _mm256_set1_epi64x(query.feeMin), feeMax = _mm256_set1_epi64x(query.feeMax);
+    const __m128i typeId = _mm_set1_epi32(query.typeId);
+    const __m128i plateId = _mm_set1_epi32(query.plateId);
+    const __m128i allOnes = _mm_set1_epi32(-1);
+
+    uint64_t mask = 0;
+    size_t j = 0;
+    for (; j + 4 <= count; j += 4) {
+        __m256i exit = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(exitTime + j));
+        __m256i entry = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(entryTime + j));
+        __m256i amount = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(fee + j));
+        __m256i duration = _mm256_sub_epi64(exit, entry);
+
+        __m256i reject = outOfRange(exit, exitMin, exitMax);
+        reject = _mm256_or_si256(reject, outOfRange(entry, entryMin, entryMax));
+        reject = _mm256_or_si256(reject, outOfRange(duration, durationMin, durationMax));
+        reject = _mm256_or_si256(reject, outOfRange(amount, feeMin, feeMax));
+        if (query.typeId >= 0) {
+            // 4个int32比较结果符号扩展为4个int64后合并
+            __m128i types = _mm_loadu_si128(reinterpret_cast<const __m128i*>(type + j));
+            __m128i typeReject = _mm_xor_si128(_mm_cmpeq_epi32(types, typeId), allOnes);
+            reject = _mm256_or_si256(reject, _mm256_cvtepi32_epi64(typeReject));
+        }
+        if (query.plateId >= 0) {
+            __m128i plates = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plate + j));
+            __m128i plateReject = _mm_xor_si128(_mm_cmpeq_epi32(plates, plateId), allOnes);
+            reject = _mm256_or_si256(reject, _mm256_cvtepi32_epi64(plateReject));
+        }
+
+        unsigned rejected = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(reject)));
+        mask |= static_cast<uint64_t>(~rejected & 0xF) << j;
+    }
+    if (j < count) {
+        mask |= filterBlockScalar(chunk, begin + j, count - j, query) << j;
+    }
+    return mask;
+}
+#endif
+
+FilterKernel selectKernel() {
+#ifdef HISTORY_QUERY_HAS_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return filterBlockAvx2;
+    }
+#endif
+    return filterBlockScalar;
+}
+
+// 一个线程的聚合结果
+struct PartialResult {
+    QueryAggregate total;
+    std::vector<QueryAggregate> byType;         // 按车型字典编号
+    std::map<int64_t, QueryAggregate> byTime;
+    uint64_t scannedRows = 0;
+};
+
+void scanChunk(const HistoryChunk& chunk, const CompiledQuery& compiled, QueryGroupBy groupBy,
+               FilterKernel kernel, PartialResult& out) {
+    RollupGranularity granularity = groupBy == QueryGroupBy::Hour ? RollupGranularity::Hour : RollupGranularity::Day;
+    time_t step = granularity == RollupGranularity::Hour ? 3600 : 86400;
+
+    // 记录按出场时间排列，缓存当前时间段，只在跨段时重新计算本地时间
+    int64_t bucketStart = 0, bucketEnd = 0;
+    QueryAggregate* bucket = nullptr;
+
+    for (size_t begin = 0; begin < chunk.size(); begin += 64) {
+        size_t count = std::min<size_t>(64, chunk.size() - begin);
+        uint64_t mask = kernel(chunk, begin, count, compiled);
+        out.scannedRows += count;
+
+        while (mask != 0) {
+            size_t i = begin + static_cast<size_t>(__builtin_ctzll(mask));
+            mask &= mask - 1;
+
+            QueryAggregate row;
+            row.count = 1;
+            row.feeSum = chunk.fee[i];
+            row.durationSum = chunk.exitTime[i] - chunk.entryTime[i];
+            out.total.merge(row);
+
+            if (groupBy == QueryGroupBy::Type) {
+                out.byType[chunk.type[i]].merge(row);
+            } else if (groupBy != QueryGroupBy::None) {
+                int64_t exit = chunk.exitTime[i];
+                if (bucket == nullptr || exit < bucketStart || exit >= bucketEnd) {
+                    bucketStart = RevenueRollup::bucketStart(granularity, exit);
+                    // 加1.5个时间段后对齐得到下一段的开始，夏令时切换日也成立
+                    bucketEnd = RevenueRollup::bucketStart(granularity, bucketStart + step * 3 / 2);
+                    bucket = &out.byTime[bucketStart];
+                }
+                bucket->merge(row);
+            }
+        }
+    }
+}
+
+}
+
+HistoryQueryResult runHistoryQuery(const HistorySnapshot& snapshot, const HistoryQuery& query, unsigned maxThreads) {
+    HistoryQueryResult result;
+
+    if (query.plateId == HistoryQuery::NO_PLATE) {
+        return result;  // 没有该车牌的记录
+    }
+    CompiledQuery compiled{-1, query.plateId, query.exitMin, query.exitMax, query.entryMin, query.entryMax,
+                           query.durationMin, query.durationMax, query.feeMin, query.feeMax};
+    if (!query.type.empty()) {
+        auto it = std::find(snapshot.types.begin(), snapshot.types.end(), query.type);
+        if (it == snapshot.types.end()) {
+            return result;  // 没有该车型的记录
+        }
+        compiled.typeId = static_cast<int32_t>(it - snapshot.types.begin());
+    }
+
+    // 按出场时间范围和车牌的Bloom过滤器跳过整段，被跳过的冷段不会从磁盘加载
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < snapshot.segments.size(); ++i) {
+        const HistorySegment& segment = snapshot.segments[i];
+        if (segment.rows == 0 || segment.maxExit < query.exitMin || segment.minExit > query.exitMax) {
+            continue;
+        }
+        if (compiled.plateId >= 0 && segment.file && !segment.file->plateFilter.mayContain(compiled.plateId)) {
+            result.filteredSegments++;
+            continue;
+        }
+        candidates.push_back(i);
+    }
+    if (candidates.empty()) {
+        return result;
+    }
+
+    unsigned threads = maxThreads != 0 ? maxThreads : std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(candidates.size())));
+    result.threads = threads;
+
+    static const FilterKernel kernel = selectKernel();
+    std::vector<PartialResult> partials(threads);
+    auto work = [&](unsigned t) {
+        PartialResult& partial = partials[t];
+        partial.byType.resize(snapshot.types.size());
+        // 每个线程处理连续的若干段，按时间分组时缓存命中率更高
+        size_t first = candidates.size() * t / threads;
+        size_t last = candidates.size() * (t + 1) / threads;
+        for (size_t i = first; i < last; ++i) {
+            // 冷段在各线程中并行加载
+            auto chunk = snapshot.load(candidates[i]);
+            if (chunk) {
+                scanChunk(*chunk, compiled, query.groupBy, kernel, partial);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // 合并各线程的结果
+    for (const auto& partial : partials) {
+        result.total.merge(partial.total);
+        result.scannedRows += partial.scannedRows;
+        for (size_t id = 0; id < partial.byType.size(); ++id) {
+            if (partial.byType[id].count > 0) {
+                result.byType[snapshot.types[id]].merge(partial.byType[id]);
+            }
+        }
+        for (const auto& [start, aggregate] : partial.byTime) {
+            result.byTime[start].merge(aggregate);
+        }
+    }
+    return result;
+}
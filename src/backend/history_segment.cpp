@@ -0,0 +1,715 @@
+/**
+ * @file history_segment.cpp
+ * @brief 历史记录段的编码、解码和冷段缓存的具体实现
+ */
+#include "include/history_segment.h"
+#include "include/history_store.h"
+#include "include/crc32c.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <zlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HISTORY_SEGMENT_HAS_AVX2 1
+#endif
+
+namespace {
+// 段格式：
+//   uint32 标识"PKSG"，uint32 版本，uint32 压缩方式，uint32 行数，int64 最早/最晚出场时间，
+//   车牌字典、车型字典（各为uint32个数 + 每项uint32长度和内容；Packed格式为排序后前缀压缩），
+//   uint64 原始长度，uint64 存储长度，存储内容，uint32 之前全部内容的CRC32C（版本2起）。
+// 原始内容依次为车牌编号、车型编号（int32数组）和入场时间、出场时间、费用（int64数组）；
+// Packed格式的存储内容依次为车牌编号、车型编号、出场时间差、停车时长、费用五列，
+// 每列每128行一组：varint组内最小值、uint8位宽、按位宽打包的(值 - 最小值)（低位在前），
+// 最后补PACK_PADDING个零字节
+const uint32_t SEGMENT_MAGIC = 0x47534B50;  // "PKSG"
+const uint32_t SEGMENT_VERSION = 2;
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+void putArray(std::string& out, const std::vector<T>& values) {
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+void putDictionary(std::string& out, const std::vector<std::string>& dictionary) {
+    put<uint32_t>(out, static_cast<uint32_t>(dictionary.size()));
+    for (const auto& entry : dictionary) {
+        put<uint32_t>(out, static_cast<uint32_t>(entry.size()));
+        out += entry;
+    }
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// 前缀压缩的字典（须已排序）：uint32个数，每项为varint与上一项相同的前缀长度、varint其余部分的长度和内容
+void putFrontCoded(std::string& out, const std::vector<std::string>& dictionary) {
+    put<uint32_t>(out, static_cast<uint32_t>(dictionary.size()));
+    const std::string* previous = nullptr;
+    for (const auto& entry : dictionary) {
+        size_t shared = 0;
+        if (previous) {
+            size_t limit = std::min(previous->size(), entry.size());
+            while (shared < limit && (*previous)[shared] == entry[shared]) {
+                ++shared;
+            }
+        }
+        putVarint(out, shared);
+        putVarint(out, entry.size() - shared);
+        out.append(entry, shared, std::string::npos);
+        previous = &entry;
+    }
+}
+
+// 按顺序读取data的前end个字节，越界时ok置为false，之后的读取都不再生效
+struct Reader {
+    const std::string& data;
+    size_t end;
+    size_t pos = 0;
+    bool ok = true;
+
+    explicit Reader(const std::string& data) : data(data), end(data.size()) {}
+    Reader(const std::string& data, size_t end) : data(data), end(end) {}
+
+    bool take(void* target, size_t size) {
+        if (!ok || end - pos < size) {
+            ok = false;
+            return false;
+        }
+        std::memcpy(target, data.data() + pos, size);
+        pos += size;
+        return true;
+    }
+
+    template <typename T>
+    T get() {
+        T value{};
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    template <typename T>
+    void getArray(std::vector<T>& values, size_t count) {
+        values.resize(count);
+        take(values.data(), count * sizeof(T));
+    }
+
+    uint64_t getVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && ok; shift += 7) {
+            uint8_t byte = get<uint8_t>();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    void getFrontCoded(std::vector<std::string>& dictionary) {
+        uint32_t count = get<uint32_t>();
+        if (!ok || count > end - pos) {
+            ok = false;
+            return;
+        }
+        dictionary.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            uint64_t shared = getVarint();
+            uint64_t length = getVarint();
+            if (!ok || (i == 0 ? shared != 0 : shared > dictionary[i - 1].size()) || length > end - pos) {
+                ok = false;
+                return;
+            }
+            dictionary[i].reserve(shared + length);
+            if (shared > 0) {
+                dictionary[i].assign(dictionary[i - 1], 0, shared);
+            }
+            dictionary[i].append(data, pos, length);
+            pos += length;
+        }
+    }
+
+    void getDictionary(std::vector<std::string>& dictionary) {
+        uint32_t count = get<uint32_t>();
+        if (!ok || count > end - pos) {
+            ok = false;
+            return;
+        }
+        dictionary.resize(count);
+        for (auto& entry : dictionary) {
+            uint32_t length = get<uint32_t>();
+            if (!ok || length > end - pos) {
+                ok = false;
+                return;
+            }
+            entry.assign(data, pos, length);
+            pos += length;
+        }
+    }
+};
+
+// 把全局编号换成段内编号，并记录段内编号对应的全局编号
+std::vector<int32_t> localize(const std::vector<int32_t>& ids, const std::vector<std::string>& dictionary,
+                              std::vector<std::string>& localDictionary, std::vector<int32_t>& globalIds) {
+    std::unordered_map<int32_t, int32_t> localIds;
+    std::vector<int32_t> result;
+    result.reserve(ids.size());
+    for (int32_t id : ids) {
+        auto [it, inserted] = localIds.emplace(id, static_cast<int32_t>(globalIds.size()));
+        if (inserted) {
+            globalIds.push_back(id);
+            localDictionary.push_back(dictionary[id]);
+        }
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+// 段内字典按字符串排序（相邻项前缀相同的多，便于前缀压缩），同时调整编号列和全局编号映射
+void sortDictionary(std::vector<std::string>& dictionary, std::vector<int32_t>& globalIds, std::vector<int32_t>& column) {
+    std::vector<int32_t> order(dictionary.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<int32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](int32_t a, int32_t b) { return dictionary[a] < dictionary[b]; });
+
+    std::vector<int32_t> rank(order.size());
+    std::vector<std::string> sortedDictionary(order.size());
+    std::vector<int32_t> sortedGlobalIds(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        rank[order[i]] = static_cast<int32_t>(i);
+        sortedDictionary[i] = std::move(dictionary[order[i]]);
+        sortedGlobalIds[i] = globalIds[order[i]];
+    }
+    for (auto& id : column) {
+        id = rank[id];
+    }
+    dictionary = std::move(sortedDictionary);
+    globalIds = std::move(sortedGlobalIds);
+}
+
+bool validIds(const std::vector<int32_t>& ids, size_t dictionarySize) {
+    for (int32_t id : ids) {
+        if (id < 0 || static_cast<size_t>(id) >= dictionarySize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const size_t PACK_BLOCK = 128;    // 每组的行数
+const size_t PACK_PADDING = 16;   // 末尾补零，解包时可以按8字节读取而不越界
+
+// 有符号数映射为无符号数，绝对值小的数映射后也小
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// 差值和还原按64位回绕计算，任意取值都能无损往返
+int64_t wrappingSub(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+int64_t wrappingAdd(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+bool getVarint(const std::string& data, size_t& pos, size_t end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 按组打包一列
+void packColumn(std::string& out, const std::vector<uint64_t>& values) {
+    for (size_t begin = 0; begin < values.size(); begin += PACK_BLOCK) {
+        size_t count = std::min(PACK_BLOCK, values.size() - begin);
+        auto [low, high] = std::minmax_element(values.begin() + begin, values.begin() + begin + count);
+        uint64_t base = *low;
+        uint64_t range = *high - base;
+        int width = range == 0 ? 0 : 64 - __builtin_clzll(range);
+        putVarint(out, base);
+        out += static_cast<char>(width);
+
+        size_t start = out.size();
+        out.resize(start + (count * width + 7) / 8, '\0');
+        uint8_t* packed = reinterpret_cast<uint8_t*>(&out[start]);
+        for (size_t j = 0; j < count && width > 0; ++j) {
+            size_t bit = j * width;
+            unsigned __int128 shifted = static_cast<unsigned __int128>(values[begin + j] - base) << (bit % 8);
+            for (size_t k = 0; k * 8 < bit % 8 + width; ++k) {
+                packed[bit / 8 + k] |= static_cast<uint8_t>(shifted >> (8 * k));
+            }
+        }
+    }
+}
+
+// 解出一组中第first个起的count个值：out[j] = 第(first + j)个打包值 + base
+using UnpackKernel = void (*)(const uint8_t* packed, int width, uint64_t base, size_t first, size_t count, uint64_t* out);
+
+void unpackScalar(const uint8_t* packed, int width, uint64_t base, size_t first, size_t count, uint64_t* out) {
+    uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    for (size_t j = 0; j < count; ++j) {
+        size_t bit = (first + j) * width;
+        unsigned shift = bit % 8;
+        uint64_t word;
+        std::memcpy(&word, packed + bit / 8, sizeof(word));
+        uint64_t value = word >> shift;
+        if (shift + width > 64) {
+            value |= static_cast<uint64_t>(packed[bit / 8 + 8]) << (64 - shift);
+        }
+        out[j] = (value & mask) + base;
+    }
+}
+
+#ifdef HISTORY_SEGMENT_HAS_AVX2
+// 每次解4个值：按各自的字节偏移聚集读取8字节，再按位偏移右移、掩码、加最小值。
+// 位宽不超过56时一个值连同位偏移落在8字节之内
+__attribute__((target("avx2")))
+void unpackAvx2(const uint8_t* packed, int width, uint64_t base, size_t first, size_t count, uint64_t* out) {
+    if (width > 56) {
+        unpackScalar(packed, width, base, first, count, out);
+        return;
+    }
+
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>((1ULL << width) - 1));
+    const __m256i baseVector = _mm256_set1_epi64x(static_cast<long long>(base));
+    const __m256i step = _mm256_set1_epi64x(4LL * width);
+    const __m256i seven = _mm256_set1_epi64x(7);
+    long long start = static_cast<long long>(first * width);
+    __m256i bits = _mm256_setr_epi64x(start, start + width, start + 2LL * width, start + 3LL * width);
+
+    size_t j = 0;
+    for (; j + 4 <= count; j += 4) {
+        __m256i offsets = _mm256_srli_epi64(bits, 3);
+        __m256i shifts = _mm256_and_si256(bits, seven);
+        __m256i words = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(packed), offsets, 1);
+        __m256i values = _mm256_and_si256(_mm256_srlv_epi64(words, shifts), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + j), _mm256_add_epi64(values, baseVector));
+        bits = _mm256_add_epi64(bits, step);
+    }
+    if (j < count) {
+        unpackScalar(packed, width, base, first + j, count - j, out + j);
+    }
+}
+#endif
+
+UnpackKernel selectUnpackKernel() {
+#ifdef HISTORY_SEGMENT_HAS_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return unpackAvx2;
+    }
+#endif
+    return unpackScalar;
+}
+
+// 解包一列；end之后至少有PACK_PADDING个字节可读
+bool unpackColumn(const std::string& data, size_t& pos, size_t end, std::vector<uint64_t>& values) {
+    static const UnpackKernel kernel = selectUnpackKernel();
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    for (size_t begin = 0; begin < values.size(); begin += PACK_BLOCK) {
+        size_t count = std::min(PACK_BLOCK, values.size() - begin);
+        uint64_t base;
+        if (!getVarint(data, pos, end, base) || pos >= end) {
+            return false;
+        }
+        int width = static_cast<uint8_t>(data[pos++]);
+        size_t length = (count * width + 7) / 8;
+        if (width > 64 || end - pos < length) {
+            return false;
+        }
+        kernel(bytes + pos, width, base, 0, count, values.data() + begin);
+        pos += length;
+    }
+    return true;
+}
+
+// 解包字典编号列，编号越界时返回false
+bool unpackIds(const std::string& data, size_t& pos, size_t end, std::vector<uint64_t>& values,
+               size_t dictionarySize, std::vector<int32_t>& ids) {
+    if (!unpackColumn(data, pos, end, values)) {
+        return false;
+    }
+    ids.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] >= dictionarySize) {
+            return false;
+        }
+        ids[i] = static_cast<int32_t>(values[i]);
+    }
+    return true;
+}
+
+std::string packChunk(const HistoryChunk& chunk, const std::vector<int32_t>& plateColumn,
+                      const std::vector<int32_t>& typeColumn) {
+    std::string out;
+    std::vector<uint64_t> values(chunk.size());
+
+    std::copy(plateColumn.begin(), plateColumn.end(), values.begin());
+    packColumn(out, values);
+    std::copy(typeColumn.begin(), typeColumn.end(), values.begin());
+    packColumn(out, values);
+
+    // 记录按出场先后追加，相邻出场时间之差很小
+    int64_t previous = chunk.minExit;
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        values[i] = zigzag(wrappingSub(chunk.exitTime[i], previous));
+        previous = chunk.exitTime[i];
+    }
+    packColumn(out, values);
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        values[i] = zigzag(wrappingSub(chunk.exitTime[i], chunk.entryTime[i]));
+    }
+    packColumn(out, values);
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        values[i] = zigzag(chunk.fee[i]);
+    }
+    packColumn(out, values);
+
+    out.append(PACK_PADDING, '\0');
+    return out;
+}
+
+bool unpackChunk(const std::string& data, size_t pos, size_t storedSize, const DecodedSegment& segment,
+                 HistoryChunk& chunk, size_t rows) {
+    if (storedSize < PACK_PADDING) {
+        return false;
+    }
+    size_t end = pos + storedSize - PACK_PADDING;
+    std::vector<uint64_t> values(rows);
+    if (!unpackIds(data, pos, end, values, segment.plates.size(), chunk.plate) ||
+        !unpackIds(data, pos, end, values, segment.types.size(), chunk.type)) {
+        return false;
+    }
+
+    chunk.exitTime.resize(rows);
+    chunk.entryTime.resize(rows);
+    chunk.fee.resize(rows);
+    if (!unpackColumn(data, pos, end, values)) {
+        return false;
+    }
+    int64_t previous = chunk.minExit;
+    for (size_t i = 0; i < rows; ++i) {
+        previous = wrappingAdd(previous, unzigzag(values[i]));
+        chunk.exitTime[i] = previous;
+    }
+    if (!unpackColumn(data, pos, end, values)) {
+        return false;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        chunk.entryTime[i] = wrappingSub(chunk.exitTime[i], unzigzag(values[i]));
+    }
+    if (!unpackColumn(data, pos, end, values)) {
+        return false;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        chunk.fee[i] = unzigzag(values[i]);
+    }
+    return true;
+}
+}
+
+std::string encodeSegment(const HistoryChunk& chunk, const std::vector<std::string>& plates,
+                          const std::vector<std::string>& types, SegmentCodec codec,
+                          std::vector<int32_t>* plateIds, std::vector<int32_t>* typeIds) {
+    std::vector<std::string> localPlates, localTypes;
+    std::vector<int32_t> plateMapping, typeMapping;
+    std::vector<int32_t> plateColumn = localize(chunk.plate, plates, localPlates, plateMapping);
+    std::vector<int32_t> typeColumn = localize(chunk.type, types, localTypes, typeMapping);
+    if (codec == SegmentCodec::Packed) {
+        sortDictionary(localPlates, plateMapping, plateColumn);
+        sortDictionary(localTypes, typeMapping, typeColumn);
+    }
+
+    uint64_t rawSize = chunk.bytes();
+    std::string raw;
+    if (codec != SegmentCodec::Packed) {
+        raw.reserve(rawSize);
+        putArray(raw, plateColumn);
+        putArray(raw, typeColumn);
+        putArray(raw, chunk.entryTime);
+        putArray(raw, chunk.exitTime);
+        putArray(raw, chunk.fee);
+    }
+
+    std::string stored;
+    if (codec == SegmentCodec::Packed) {
+        stored = packChunk(chunk, plateColumn, typeColumn);
+    } else if (codec == SegmentCodec::Zlib) {
+        // 最快的压缩级别：时间列相邻值接近，已经能压缩到几分之一
+        uLongf storedSize = compressBound(raw.size());
+        stored.resize(storedSize);
+        if (compress2(reinterpret_cast<Bytef*>(&stored[0]), &storedSize,
+                      reinterpret_cast<const Bytef*>(raw.data()), raw.size(), 1) != Z_OK) {
+            codec = SegmentCodec::None;
+            stored = raw;
+        } else {
+            stored.resize(storedSize);
+        }
+    } else {
+        stored = std::move(raw);
+    }
+
+    std::string out;
+    out.reserve(stored.size() + 64);
+    put<uint32_t>(out, SEGMENT_MAGIC);
+    put<uint32_t>(out, SEGMENT_VERSION);
+    put<uint32_t>(out, static_cast<uint32_t>(codec));
+    put<uint32_t>(out, static_cast<uint32_t>(chunk.size()));
+    put<int64_t>(out, chunk.minExit);
+    put<int64_t>(out, chunk.maxExit);
+    if (codec == SegmentCodec::Packed) {
+        putFrontCoded(out, localPlates);
+        putFrontCoded(out, localTypes);
+    } else {
+        putDictionary(out, localPlates);
+        putDictionary(out, localTypes);
+    }
+    put<uint64_t>(out, rawSize);
+    put<uint64_t>(out, stored.size());
+    out += stored;
+    put<uint32_t>(out, crc32c(out.data(), out.size()));
+
+    if (plateIds) {
+        *plateIds = std::move(plateMapping);
+    }
+    if (typeIds) {
+        *typeIds = std::move(typeMapping);
+    }
+    return out;
+}
+
+bool decodeSegment(const std::string& data, DecodedSegment& out) {
+    // 版本2起末尾为整个段的校验和，先校验再解析；版本1没有校验和
+    Reader in(data);
+    uint32_t magic = in.get<uint32_t>();
+    uint32_t version = in.get<uint32_t>();
+    if (!in.ok || magic != SEGMENT_MAGIC || version < 1 || version > SEGMENT_VERSION) {
+        return false;
+    }
+    if (version >= 2) {
+        uint32_t checksum;
+        if (data.size() < in.pos + sizeof(checksum)) {
+            return false;
+        }
+        in.end = data.size() - sizeof(checksum);
+        std::memcpy(&checksum, data.data() + in.end, sizeof(checksum));
+        if (crc32c(data.data(), in.end) != checksum) {
+            return false;
+        }
+    }
+    uint32_t codec = in.get<uint32_t>();
+    uint32_t rows = in.get<uint32_t>();
+    int64_t minExit = in.get<int64_t>();
+    int64_t maxExit = in.get<int64_t>();
+    if (codec == static_cast<uint32_t>(SegmentCodec::Packed)) {
+        in.getFrontCoded(out.plates);
+        in.getFrontCoded(out.types);
+    } else {
+        in.getDictionary(out.plates);
+        in.getDictionary(out.types);
+    }
+    uint64_t rawSize = in.get<uint64_t>();
+    uint64_t storedSize = in.get<uint64_t>();
+    if (!in.ok || storedSize > in.end - in.pos ||
+        rawSize != static_cast<uint64_t>(rows) * (2 * sizeof(int32_t) + 3 * sizeof(int64_t))) {
+        return false;
+    }
+
+    auto chunk = std::make_unique<HistoryChunk>();
+    chunk->minExit = minExit;
+    chunk->maxExit = maxExit;
+    if (codec == static_cast<uint32_t>(SegmentCodec::Packed)) {
+        if (!unpackChunk(data, in.pos, storedSize, out, *chunk, rows)) {
+            return false;
+        }
+        out.chunk = std::move(chunk);
+        return true;
+    }
+
+    std::string raw;
+    if (codec == static_cast<uint32_t>(SegmentCodec::Zlib)) {
+        raw.resize(rawSize);
+        uLongf rawLength = rawSize;
+        if (uncompress(reinterpret_cast<Bytef*>(&raw[0]), &rawLength,
+                       reinterpret_cast<const Bytef*>(data.data() + in.pos), storedSize) != Z_OK ||
+            rawLength != rawSize) {
+            return false;
+        }
+    } else if (codec == static_cast<uint32_t>(SegmentCodec::None)) {
+        if (storedSize != rawSize) {
+            return false;
+        }
+        raw.assign(data, in.pos, storedSize);
+    } else {
+        return false;  // 不认识的压缩方式
+    }
+
+    Reader columns(raw);
+    columns.getArray(chunk->plate, rows);
+    columns.getArray(chunk->type, rows);
+    columns.getArray(chunk->entryTime, rows);
+    columns.getArray(chunk->exitTime, rows);
+    columns.getArray(chunk->fee, rows);
+    if (!columns.ok || !validIds(chunk->plate, out.plates.size()) || !validIds(chunk->type, out.types.size())) {
+        return false;
+    }
+    out.chunk = std::move(chunk);
+    return true;
+}
+
+namespace {
+const size_t FILTER_BITS_PER_KEY = 10;
+const unsigned FILTER_HASHES = 7;
+
+// 由编号得到两个独立的32位哈希值，第i个哈希函数取h1 + i * h2（双重哈希）
+void filterHashes(int32_t id, uint32_t& h1, uint32_t& h2) {
+    uint64_t x = static_cast<uint64_t>(static_cast<uint32_t>(id)) + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    h1 = static_cast<uint32_t>(x);
+    h2 = static_cast<uint32_t>(x >> 32) | 1;
+}
+}
+
+PlateFilter::PlateFilter(const std::vector<int32_t>& ids) {
+    if (ids.empty()) {
+        return;
+    }
+    bits.assign((ids.size() * FILTER_BITS_PER_KEY + 63) / 64, 0);
+    const uint64_t size = bits.size() * 64;
+    for (int32_t id : ids) {
+        uint32_t h1, h2;
+        filterHashes(id, h1, h2);
+        for (unsigned i = 0; i < FILTER_HASHES; ++i) {
+            uint64_t bit = (h1 + static_cast<uint64_t>(i) * h2) % size;
+            bits[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+}
+
+bool PlateFilter::mayContain(int32_t id) const {
+    if (bits.empty()) {
+        return true;
+    }
+    const uint64_t size = bits.size() * 64;
+    uint32_t h1, h2;
+    filterHashes(id, h1, h2);
+    for (unsigned i = 0; i < FILTER_HASHES; ++i) {
+        uint64_t bit = (h1 + static_cast<uint64_t>(i) * h2) % size;
+        if ((bits[bit / 64] & (1ull << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const HistoryChunk> readSegmentFile(const SegmentFile& file) {
+    std::ifstream in(file.path, std::ios::binary);
+    if (!in) {
+        return nullptr;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    DecodedSegment segment;
+    if (!decodeSegment(data, segment) || segment.plates.size() != file.plateIds.size() ||
+        segment.types.size() != file.typeIds.size()) {
+        return nullptr;
+    }
+    for (auto& id : segment.chunk->plate) {
+        id = file.plateIds[id];
+    }
+    for (auto& id : segment.chunk->type) {
+        id = file.typeIds[id];
+    }
+    return std::shared_ptr<const HistoryChunk>(std::move(segment.chunk));
+}
+
+void SegmentCache::evict() {
+    // 至少保留最近使用的一段，预算小于单个段时也能正常工作
+    while (used > budget && recency.size() > 1) {
+        auto it = entries.find(recency.back());
+        used -= it->second.bytes;
+        entries.erase(it);
+        recency.pop_back();
+    }
+}
+
+std::shared_ptr<const HistoryChunk> SegmentCache::get(const SegmentFile& file) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(file.path);
+        if (it != entries.end()) {
+            hits++;
+            recency.splice(recency.begin(), recency, it->second.position);
+            return it->second.chunk;
+        }
+        misses++;
+    }
+
+    auto chunk = readSegmentFile(file);
+    if (!chunk) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = entries.emplace(file.path, Entry{chunk, chunk->bytes(), recency.end()});
+    if (!inserted) {
+        return it->second.chunk;  // 其他线程已经加载
+    }
+    recency.push_front(file.path);
+    it->second.position = recency.begin();
+    used += it->second.bytes;
+    evict();
+    return chunk;
+}
+
+void SegmentCache::erase(const SegmentFile& file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(file.path);
+    if (it != entries.end()) {
+        used -= it->second.bytes;
+        recency.erase(it->second.position);
+        entries.erase(it);
+    }
+}
+
+void SegmentCache::setBudget(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+SegmentCacheStats SegmentCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    SegmentCacheStats result;
+    result.entries = entries.size();
+    result.bytes = used;
+    result.budget = budget;
+    result.hits = hits;
+    result.misses = misses;
+    return result;
+}
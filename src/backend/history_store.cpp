@@ -0,0 +1,992 @@
+/**
+ * @file history_store.cpp
+ * @brief HistoryStore类的具体实现
+ */
+#include "include/history_store.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+const std::string SEGMENT_SUFFIX = ".seg";
+const std::string TEMP_SUFFIX = ".tmp";
+
+bool endsWith(const std::string& name, const std::string& suffix) {
+    return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 解析段文件名（十位数字编号 + ".seg"，合并的段为"首编号-末编号.seg"），不是段文件时返回false
+bool parseSegmentName(const std::string& name, uint64_t& first, uint64_t& last) {
+    if (!endsWith(name, SEGMENT_SUFFIX)) {
+        return false;
+    }
+    const size_t length = name.size() - SEGMENT_SUFFIX.size();
+    size_t dash = name.find('-');
+    if (dash >= length) {
+        dash = length;
+    }
+    auto parse = [&](size_t begin, size_t end, uint64_t& id) {
+        id = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (name[i] < '0' || name[i] > '9') {
+                return false;
+            }
+            id = id * 10 + static_cast<uint64_t>(name[i] - '0');
+        }
+        return end > begin;
+    };
+    if (!parse(0, dash, first)) {
+        return false;
+    }
+    if (dash == length) {
+        last = first;
+        return true;
+    }
+    return parse(dash + 1, length, last) && last > first;
+}
+
+std::string segmentFileName(uint64_t first, uint64_t last) {
+    char name[48];
+    if (last > first) {
+        std::snprintf(name, sizeof(name), "%010llu-%010llu%s", static_cast<unsigned long long>(first),
+                      static_cast<unsigned long long>(last), SEGMENT_SUFFIX.c_str());
+    } else {
+        std::snprintf(name, sizeof(name), "%010llu%s", static_cast<unsigned long long>(first), SEGMENT_SUFFIX.c_str());
+    }
+    return name;
+}
+
+// 先写临时文件再改名，中断时不会留下不完整的段文件
+bool writeSegmentFile(const std::string& path, const std::string& data) {
+    std::string temp = path + TEMP_SUFFIX;
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+    out.close();
+    std::error_code error;
+    if (out) {
+        fs::rename(temp, path, error);
+    }
+    if (!out || error) {
+        std::cerr << "Failed to write history segment " << path << std::endl;
+        fs::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+// 倒排表中的行号差值以每字节7位的varint编码
+void putDelta(std::string& out, uint64_t delta) {
+    while (delta >= 0x80) {
+        out += static_cast<char>((delta & 0x7F) | 0x80);
+        delta >>= 7;
+    }
+    out += static_cast<char>(delta);
+}
+
+uint64_t getDelta(const std::string& data, size_t& pos) {
+    uint64_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return delta;
+        }
+    }
+}
+
+Cents feeOf(const HistoryChunk& chunk) {
+    Cents total = 0;
+    for (Cents fee : chunk.fee) {
+        total += fee;
+    }
+    return total;
+}
+
+bool readFile(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+const unsigned MAX_LOAD_THREADS = 8;  // 加载段文件的最多线程数
+
+// 读取并解码的一个段文件
+struct LoadedFile {
+    bool ok = false;          // 文件存在且格式正确
+    uint64_t bytes = 0;       // 文件大小
+    DecodedSegment decoded;   // 解码结果
+};
+
+// 由后台线程并行读取、解码段文件，在调用线程中按顺序交给consumer。
+// 解码最多领先consumer 2 × 线程数个段，内存占用与段文件总数无关；
+// 只有一个CPU时也至少有一个后台线程，磁盘读取和解码与consumer的处理重叠
+void loadFilesInOrder(const std::vector<std::pair<uint64_t, std::string>>& files,
+                      const std::function<void(size_t, LoadedFile&)>& consumer) {
+    unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_LOAD_THREADS));
+    threads = static_cast<unsigned>(std::min<size_t>(threads, files.size()));
+    const size_t window = 2 * static_cast<size_t>(threads);
+
+    std::vector<LoadedFile> loaded(files.size());
+    std::vector<char> ready(files.size(), 0);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t next = 0;       // 下一个待解码的文件
+    size_t consumed = 0;   // 已交给consumer的文件数
+    bool stop = false;
+
+    auto worker = [&]() {
+        std::string data;
+        for (;;) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return stop || next >= files.size() || next < consumed + window; });
+                if (stop || next >= files.size()) {
+                    return;
+                }
+                index = next++;
+            }
+            LoadedFile file;
+            file.ok = readFile(files[index].second, data) && decodeSegment(data, file.decoded);
+            file.bytes = data.size();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                loaded[index] = std::move(file);
+                ready[index] = 1;
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    auto finish = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    };
+
+    try {
+        for (size_t i = 0; i < files.size(); ++i) {
+            LoadedFile file;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return ready[i] != 0; });
+                file = std::move(loaded[i]);
+            }
+            consumer(i, file);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                consumed = i + 1;
+            }
+            changed.notify_all();
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+}
+}
+
+void HistoryChunk::append(int32_t plateId, int32_t typeId, int64_t entry, int64_t exit, int64_t feeCents) {
+    if (size() == 0) {
+        minExit = maxExit = exit;
+    } else {
+        minExit = std::min(minExit, exit);
+        maxExit = std::max(maxExit, exit);
+    }
+    plate.push_back(plateId);
+    type.push_back(typeId);
+    entryTime.push_back(entry);
+    exitTime.push_back(exit);
+    fee.push_back(feeCents);
+}
+
+HistoryChunk HistoryChunk::select(int64_t from, int64_t to) const {
+    HistoryChunk result;
+    for (size_t i = 0; i < size(); ++i) {
+        if (exitTime[i] >= from && exitTime[i] < to) {
+            result.append(plate[i], type[i], entryTime[i], exitTime[i], fee[i]);
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<const HistoryChunk> HistorySnapshot::load(size_t index) const {
+    const HistorySegment& segment = segments[index];
+    if (segment.resident) {
+        return segment.resident;
+    }
+    if (segment.file && cache) {
+        return cache->get(*segment.file);
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const HistoryChunk> HistorySnapshot::rowsOf(size_t index, int64_t from, int64_t to) const {
+    if (!segments[index].overlaps(from, to)) {
+        return nullptr;
+    }
+    auto chunk = load(index);
+    if (!chunk) {
+        std::cerr << "History segment unavailable, rows " << segments[index].firstRow << "+"
+                  << segments[index].rows << " skipped" << std::endl;
+        return nullptr;
+    }
+    if (chunk->within(from, to)) {
+        return chunk;
+    }
+    auto selected = std::make_shared<HistoryChunk>(chunk->select(from, to));
+    if (selected->size() == 0) {
+        return nullptr;
+    }
+    return selected;
+}
+
+HistoryStore::HistoryStore() : cache(std::make_shared<SegmentCache>(DEFAULT_CACHE_BYTES)) {
+}
+
+void HistoryStore::open(const std::string& dir) {
+    directory = dir;
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create history segment directory " << directory << ": " << error.message() << std::endl;
+    }
+}
+
+std::string HistoryStore::segmentPath(uint64_t id) const {
+    return (fs::path(directory) / segmentFileName(id, id)).string();
+}
+
+int32_t HistoryStore::typeIdOf(const std::string& type) {
+    auto it = std::find(types.begin(), types.end(), type);
+    if (it != types.end()) {
+        return static_cast<int32_t>(it - types.begin());
+    }
+    types.push_back(type);
+    return static_cast<int32_t>(types.size() - 1);
+}
+
+int32_t HistoryStore::plateIdOf(const std::string& plate) {
+    // 先查找再插入：emplace即使车牌已存在也会先分配节点、复制字符串，加载时每段字典都要查一遍
+    auto it = plateIds.find(plate);
+    if (it != plateIds.end()) {
+        return it->second;
+    }
+    int32_t id = static_cast<int32_t>(plates.size());
+    plateIds.emplace(plate, id);
+    plates.push_back(plate);
+    postings.emplace_back();
+    return id;
+}
+
+void HistoryStore::addPosting(int32_t plateId, uint64_t row) {
+    // 行号单调递增，差值通常很小，以每字节7位的varint编码
+    Postings& list = postings[plateId];
+    putDelta(list.deltas, row - list.lastRow);
+    list.lastRow = row;
+    list.count++;
+}
+
+void HistoryStore::appendRow(int32_t plateId, int32_t typeId, int64_t entry, int64_t exit, int64_t fee) {
+    // 出场时间跨入下一个周期时先封存当前段，使每段只覆盖一个周期，便于按时间分层和清理
+    if (current.size() > 0 && exit / SEGMENT_SPAN > current.maxExit / SEGMENT_SPAN) {
+        seal();
+    }
+
+    addPosting(plateId, sealedRows + current.size());
+
+    // 没有段目录时不合并，直接按整段大小封存
+    const size_t limit = directory.empty() ? CHUNK_ROWS : MEMTABLE_ROWS;
+    if (current.size() == 0) {
+        // 新段一次性预留空间，避免写入过程中反复扩容
+        current.plate.reserve(limit);
+        current.type.reserve(limit);
+        current.entryTime.reserve(limit);
+        current.exitTime.reserve(limit);
+        current.fee.reserve(limit);
+    }
+    current.append(plateId, typeId, entry, exit, fee);
+
+    if (current.size() >= limit) {
+        seal();
+    }
+}
+
+void HistoryStore::append(const std::string& plate, const std::string& type, time_t entryTime, time_t exitTime, Cents fee) {
+    appendRow(plateIdOf(plate), typeIdOf(type), entryTime, exitTime, fee);
+    demote(exitTime);
+}
+
+void HistoryStore::seal() {
+    std::shared_ptr<SegmentFile> file;
+    if (!directory.empty()) {
+        file = std::make_shared<SegmentFile>();
+        file->id = file->lastId = nextSegmentId;
+        file->path = segmentPath(file->id);
+        std::string data = encodeSegment(current, plates, types, SegmentCodec::Packed, &file->plateIds, &file->typeIds);
+        if (!writeSegmentFile(file->path, data)) {
+            // 写入失败时不封存，记录留在当前段中随数据文件保存，下次追加时重试
+            return;
+        }
+        file->bytes = data.size();
+        file->plateFilter = PlateFilter(file->plateIds);
+        nextSegmentId++;
+    }
+
+    HistorySegment segment;
+    segment.firstRow = sealedRows;
+    segment.rows = current.size();
+    segment.minExit = current.minExit;
+    segment.maxExit = current.maxExit;
+    segment.fee = feeOf(current);
+    segment.resident = std::make_shared<const HistoryChunk>(std::move(current));
+    segment.file = std::move(file);
+    current = HistoryChunk();
+
+    sealedRows += segment.rows;
+    sealed.push_back(std::move(segment));
+}
+
+void HistoryStore::demote(time_t now) {
+    // 段按出场时间先后封存，从上次检查到的位置往后看即可
+    while (firstHot < sealed.size() && sealed[firstHot].maxExit < now - hotWindow) {
+        if (sealed[firstHot].file) {
+            sealed[firstHot].resident.reset();
+        }
+        firstHot++;
+    }
+}
+
+std::shared_ptr<const HistoryChunk> HistoryStore::chunkOf(uint64_t row, size_t& offset) const {
+    if (row < firstLiveRow) {
+        return nullptr;  // 已清理
+    }
+    if (row >= sealedRows) {
+        offset = row - sealedRows;
+        // 当前段不由shared_ptr管理，返回不持有所有权的指针，只在锁内使用
+        return std::shared_ptr<const HistoryChunk>(std::shared_ptr<const HistoryChunk>(), &current);
+    }
+
+    auto it = std::upper_bound(sealed.begin(), sealed.end(), row, [](uint64_t r, const HistorySegment& segment) {
+        return r < segment.firstRow;
+    });
+    const HistorySegment& segment = *(it - 1);
+    offset = row - segment.firstRow;
+    if (segment.resident) {
+        return segment.resident;
+    }
+    return segment.file ? cache->get(*segment.file) : nullptr;
+}
+
+size_t HistoryStore::forEachVisit(const std::string& plate,
+                                  const std::function<void(const std::string& type, time_t entryTime,
+                                                           time_t exitTime, Cents fee)>& visitor) const {
+    auto it = plateIds.find(plate);
+    if (it == plateIds.end()) {
+        return 0;
+    }
+
+    const Postings& list = postings[it->second];
+    uint64_t row = 0;
+    size_t pos = 0;
+    size_t visited = 0;
+    std::shared_ptr<const HistoryChunk> chunk;
+    uint64_t chunkFirst = 0, chunkEnd = 0;  // chunk覆盖的行号范围，相邻记录通常在同一段
+    for (uint32_t i = 0; i < list.count; ++i) {
+        row += getDelta(list.deltas, pos);
+
+        size_t offset;
+        if (chunk && row >= chunkFirst && row < chunkEnd) {
+            offset = row - chunkFirst;
+        } else {
+            chunk = chunkOf(row, offset);
+            if (!chunk) {
+                continue;  // 已清理，或段文件丢失或损坏
+            }
+            chunkFirst = row - offset;
+            chunkEnd = chunkFirst + chunk->size();
+        }
+        visitor(types[chunk->type[offset]], chunk->entryTime[offset], chunk->exitTime[offset], chunk->fee[offset]);
+        visited++;
+    }
+    return visited;
+}
+
+bool HistoryStore::latestVisit(const std::string& plate,
+                               const std::function<void(const std::string& type, time_t entryTime,
+                                                        time_t exitTime, Cents fee)>& visitor) const {
+    auto it = plateIds.find(plate);
+    if (it == plateIds.end()) {
+        return false;
+    }
+    size_t offset;
+    auto chunk = chunkOf(postings[it->second].lastRow, offset);
+    if (!chunk) {
+        return false;
+    }
+    visitor(types[chunk->type[offset]], chunk->entryTime[offset], chunk->exitTime[offset], chunk->fee[offset]);
+    return true;
+}
+
+HistorySnapshot HistoryStore::snapshot(bool withPlates) const {
+    HistorySnapshot result;
+    result.segments.reserve(sealed.size() + 1);
+    result.segments = sealed;
+    if (current.size() > 0) {
+        HistorySegment open;
+        open.firstRow = sealedRows;
+        open.rows = current.size();
+        open.minExit = current.minExit;
+        open.maxExit = current.maxExit;
+        open.resident = std::make_shared<const HistoryChunk>(current);
+        result.segments.push_back(std::move(open));
+    }
+    if (withPlates) {
+        result.plates = plates;
+    }
+    result.types = types;
+    result.cache = cache;
+    return result;
+}
+
+size_t HistoryStore::size() const {
+    return sealedRows - firstLiveRow + current.size();
+}
+
+void HistoryStore::clear() {
+    sealed.clear();
+    sealedRows = 0;
+    firstLiveRow = 0;
+    firstHot = 0;
+    current = HistoryChunk();
+    plates.clear();
+    plateIds.clear();
+    postings.clear();
+    types.clear();
+    nextSegmentId = 0;
+    firstSegmentId = 0;
+    purgedRows = 0;
+    purgedFee = 0;
+    retired.clear();
+    damagedFiles.clear();
+    compactCursor = 0;
+    compacting = false;
+    // 段编号可能被重新使用，换一个新的缓存（旧快照仍持有旧缓存）
+    cache = std::make_shared<SegmentCache>(cache->stats().budget);
+}
+
+void HistoryStore::removeSegmentFiles() {
+    if (directory.empty()) {
+        return;
+    }
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(directory, error)) {
+        uint64_t first, last;
+        std::string name = entry.path().filename().string();
+        if (parseSegmentName(name, first, last) || endsWith(name, TEMP_SUFFIX)) {
+            fs::remove(entry.path(), error);
+        }
+    }
+}
+
+size_t HistoryStore::adoptSegmentFiles(const std::string& source) {
+    if (directory.empty()) {
+        return 0;
+    }
+    size_t adopted = 0;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(source, error)) {
+        std::string name = entry.path().filename().string();
+        if (!isSegmentFileName(name)) {
+            continue;
+        }
+        std::error_code renameError;
+        fs::rename(entry.path(), fs::path(directory) / name, renameError);
+        if (renameError) {
+            std::cerr << "Failed to move history segment " << entry.path().string() << ": " << renameError.message() << std::endl;
+        } else {
+            ++adopted;
+        }
+    }
+    return adopted;
+}
+
+bool HistoryStore::isSegmentFileName(const std::string& name) {
+    uint64_t first, last;
+    return parseSegmentName(name, first, last);
+}
+
+size_t HistoryStore::loadSegments(uint64_t endId, time_t now, const HistoryRowVisitor& visitor) {
+    if (directory.empty()) {
+        return 0;
+    }
+
+    struct Found {
+        uint64_t first, last;
+        std::string path;
+    };
+    std::vector<Found> found;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(directory, error)) {
+        uint64_t first, last;
+        std::string name = entry.path().filename().string();
+        if (!parseSegmentName(name, first, last)) {
+            if (endsWith(name, TEMP_SUFFIX)) {
+                fs::remove(entry.path(), error);  // 写入中断留下的临时文件
+            }
+            continue;
+        }
+        if (last < firstSegmentId) {
+            // 已清理，数据文件保存后、段文件删除前中断时残留
+            fs::remove(entry.path(), error);
+            continue;
+        }
+        if (last >= endId) {
+            // 封存后数据文件没有保存成功，这些记录仍在数据文件的未封存段中；
+            // 合并的段覆盖了未提交的编号时也删除，已提交的源段仍然保留
+            fs::remove(entry.path(), error);
+            continue;
+        }
+        found.push_back({first, last, entry.path().string()});
+    }
+
+    // 合并的段排在它覆盖的源段之前；合并后数据文件已保存、源段删除前中断时残留的源段被删除
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.first != b.first ? a.first < b.first : a.last > b.last;
+    });
+    std::vector<std::pair<uint64_t, std::string>> files;
+    std::vector<uint64_t> lastIds;
+    for (const auto& segment : found) {
+        if (!lastIds.empty() && segment.first <= lastIds.back()) {
+            fs::remove(segment.path, error);
+            continue;
+        }
+        files.emplace_back(segment.first, segment.path);
+        lastIds.push_back(segment.last);
+    }
+
+    // 读取和解码在后台线程中并行进行，字典合并、倒排表和回调按编号顺序在本线程中进行
+    size_t loaded = 0;
+    loadFilesInOrder(files, [&](size_t index, LoadedFile& result) {
+        const auto& [id, path] = files[index];
+        if (!result.ok) {
+            std::cerr << "Skipping damaged history segment " << path << std::endl;
+            return;
+        }
+        DecodedSegment& decoded = result.decoded;
+
+        auto file = std::make_shared<SegmentFile>();
+        file->id = id;
+        file->lastId = lastIds[index];
+        file->path = path;
+        file->bytes = result.bytes;
+        file->plateIds.reserve(decoded.plates.size());
+        for (const auto& plate : decoded.plates) {
+            file->plateIds.push_back(plateIdOf(plate));
+        }
+        for (const auto& type : decoded.types) {
+            file->typeIds.push_back(typeIdOf(type));
+        }
+        file->plateFilter = PlateFilter(file->plateIds);
+
+        HistoryChunk& chunk = *decoded.chunk;
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            chunk.plate[i] = file->plateIds[chunk.plate[i]];
+            chunk.type[i] = file->typeIds[chunk.type[i]];
+            addPosting(chunk.plate[i], sealedRows + i);
+            visitor(plates[chunk.plate[i]], types[chunk.type[i]], chunk.entryTime[i], chunk.exitTime[i], chunk.fee[i]);
+        }
+
+        HistorySegment segment;
+        segment.firstRow = sealedRows;
+        segment.rows = chunk.size();
+        segment.minExit = chunk.minExit;
+        segment.maxExit = chunk.maxExit;
+        segment.fee = feeOf(chunk);
+        segment.resident = std::shared_ptr<const HistoryChunk>(std::move(decoded.chunk));
+        segment.file = std::move(file);
+        sealedRows += segment.rows;
+        loaded += segment.rows;
+        sealed.push_back(std::move(segment));
+        demote(now);  // 逐段释放冷段，加载过程中的内存占用不超过热段加正在解码的段
+    });
+
+    nextSegmentId = std::max({nextSegmentId, firstSegmentId, endId == UINT64_MAX ? (lastIds.empty() ? 0 : lastIds.back() + 1) : endId});
+    return loaded;
+}
+
+std::string HistoryStore::saveOpenSegment() const {
+    std::string data(reinterpret_cast<const char*>(&nextSegmentId), sizeof(nextSegmentId));
+    data += encodeSegment(current, plates, types, SegmentCodec::Packed);
+    return data;
+}
+
+bool HistoryStore::readCommittedSegments(const std::string& data, uint64_t& endId) {
+    if (data.size() < sizeof(endId)) {
+        return false;
+    }
+    std::memcpy(&endId, data.data(), sizeof(endId));
+    return true;
+}
+
+bool HistoryStore::loadOpenSegment(const std::string& data, const HistoryRowVisitor& visitor) {
+    uint64_t endId;
+    DecodedSegment decoded;
+    if (!readCommittedSegments(data, endId) || !decodeSegment(data.substr(sizeof(endId)), decoded)) {
+        return false;
+    }
+    nextSegmentId = std::max(nextSegmentId, endId);
+
+    const HistoryChunk& chunk = *decoded.chunk;
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        const std::string& plate = decoded.plates[chunk.plate[i]];
+        const std::string& type = decoded.types[chunk.type[i]];
+        appendRow(plateIdOf(plate), typeIdOf(type), chunk.entryTime[i], chunk.exitTime[i], chunk.fee[i]);
+        visitor(plate, type, chunk.entryTime[i], chunk.exitTime[i], chunk.fee[i]);
+    }
+    return true;
+}
+
+void HistoryStore::setTiering(time_t window, uint64_t cacheBytes, time_t now) {
+    hotWindow = window;
+    cache->setBudget(cacheBytes);
+    demote(now);
+}
+
+void HistoryStore::setRetention(time_t window) {
+    retention = window;
+}
+
+HistoryExpiry HistoryStore::expire(time_t now) {
+    HistoryExpiry result;
+    removeRetiredFiles();  // 上一步清理后数据文件已保存，可以删除段文件
+    demote(now);
+
+    // 段按出场时间先后封存，只需检查最早的段
+    if (retention > 0 && !sealed.empty() && sealed.front().maxExit < now - retention) {
+        const HistorySegment& segment = sealed.front();
+        result.rows = segment.rows;
+        result.fee = segment.fee;
+        result.horizon = segment.maxExit + 1;
+        if (segment.file) {
+            cache->erase(*segment.file);
+            firstSegmentId = segment.file->lastId + 1;
+            retired.push_back(segment.file);
+        }
+        firstLiveRow = segment.firstRow + segment.rows;
+        purgedRows += segment.rows;
+        purgedFee += segment.fee;
+        sealed.erase(sealed.begin());
+        firstHot = firstHot > 0 ? firstHot - 1 : 0;
+        // 以剩余记录中最早的出场时间为界，使汇总数据的清理与重新加载后的结果一致
+        if (!sealed.empty()) {
+            result.horizon = sealed.front().minExit;
+        } else if (current.size() > 0) {
+            result.horizon = current.minExit;
+        }
+        compactCursor = 0;
+        compacting = true;
+    }
+
+    if (compacting) {
+        compactPostings(POSTINGS_BATCH);
+    }
+    result.more = compacting || (retention > 0 && !sealed.empty() && sealed.front().maxExit < now - retention);
+    return result;
+}
+
+int32_t HistoryStore::findPlate(const std::string& plate) const {
+    auto it = plateIds.find(plate);
+    return it != plateIds.end() ? it->second : -1;
+}
+
+size_t HistoryStore::indexOf(const std::shared_ptr<const SegmentFile>& file) const {
+    // 段文件按编号顺序排列，没有段文件的段（不写磁盘时）不参与合并
+    auto it = std::lower_bound(sealed.begin(), sealed.end(), file->id, [](const HistorySegment& segment, uint64_t id) {
+        return segment.file && segment.file->id < id;
+    });
+    return it != sealed.end() && it->file == file ? static_cast<size_t>(it - sealed.begin()) : sealed.size();
+}
+
+HistoryCompaction HistoryStore::planCompaction(time_t now) const {
+    HistoryCompaction result;
+    if (directory.empty()) {
+        return result;
+    }
+    // 最新记录所在的周期还在写入，更早的周期已经结束，不会再有新段
+    int64_t latest = current.size() > 0 ? current.maxExit : (sealed.empty() ? 0 : sealed.back().maxExit);
+    const int64_t openPeriod = std::max<int64_t>(latest, now) / SEGMENT_SPAN;
+
+    for (size_t begin = 0; begin < sealed.size();) {
+        const int64_t period = sealed[begin].maxExit / SEGMENT_SPAN;
+        size_t end = begin;
+        while (end < sealed.size() && sealed[end].maxExit / SEGMENT_SPAN == period) {
+            end++;
+        }
+        // 从周期内第一段起，贪心地取行数合计不超过CHUNK_ROWS的连续段
+        for (size_t first = begin; first < end;) {
+            size_t last = first, rows = 0, level0 = 0;
+            while (last < end && sealed[last].file && rows + sealed[last].rows <= CHUNK_ROWS &&
+                   damagedFiles.count(sealed[last].file->path) == 0) {
+                rows += sealed[last].rows;
+                level0 += sealed[last].file->level() == 0;
+                last++;
+            }
+            if (last - first >= 2 && (level0 >= COMPACTION_TRIGGER || period < openPeriod)) {
+                for (size_t i = first; i < last; ++i) {
+                    result.sources.push_back(sealed[i].file);
+                }
+                result.directory = directory;
+                return result;
+            }
+            first = std::max(last, first + 1);
+        }
+        begin = end;
+    }
+    return result;
+}
+
+bool HistoryCompaction::build() {
+    // 各源段的段内编号换成合并段内的编号，合并段的字典只包含用到的项
+    HistoryChunk merged;
+    std::vector<std::string> plateNames, typeNames;
+    std::vector<int32_t> plateGlobal, typeGlobal;           // 合并段内编号到全局编号
+    std::unordered_map<int32_t, int32_t> plateLocal, typeLocal;
+    std::string data;
+    for (const auto& source : sources) {
+        DecodedSegment decoded;
+        if (!readFile(source->path, data) || !decodeSegment(data, decoded) ||
+            decoded.plates.size() != source->plateIds.size() || decoded.types.size() != source->typeIds.size()) {
+            std::cerr << "Cannot compact damaged history segment " << source->path << std::endl;
+            damaged = source;
+            return false;
+        }
+        std::vector<int32_t> plateMap(decoded.plates.size()), typeMap(decoded.types.size());
+        for (size_t i = 0; i < decoded.plates.size(); ++i) {
+            auto [it, inserted] = plateLocal.emplace(source->plateIds[i], static_cast<int32_t>(plateNames.size()));
+            if (inserted) {
+                plateNames.push_back(std::move(decoded.plates[i]));
+                plateGlobal.push_back(source->plateIds[i]);
+            }
+            plateMap[i] = it->second;
+        }
+        for (size_t i = 0; i < decoded.types.size(); ++i) {
+            auto [it, inserted] = typeLocal.emplace(source->typeIds[i], static_cast<int32_t>(typeNames.size()));
+            if (inserted) {
+                typeNames.push_back(std::move(decoded.types[i]));
+                typeGlobal.push_back(source->typeIds[i]);
+            }
+            typeMap[i] = it->second;
+        }
+        const HistoryChunk& chunk = *decoded.chunk;
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            merged.append(plateMap[chunk.plate[i]], typeMap[chunk.type[i]], chunk.entryTime[i], chunk.exitTime[i],
+                          chunk.fee[i]);
+        }
+    }
+
+    auto result = std::make_shared<SegmentFile>();
+    result->id = sources.front()->id;
+    result->lastId = sources.back()->lastId;
+    result->path = (fs::path(directory) / segmentFileName(result->id, result->lastId)).string();
+    std::vector<int32_t> fileIds, fileTypeIds;
+    data = encodeSegment(merged, plateNames, typeNames, SegmentCodec::Packed, &fileIds, &fileTypeIds);
+    if (!writeSegmentFile(result->path, data)) {
+        return false;
+    }
+    result->bytes = data.size();
+    for (int32_t id : fileIds) {
+        result->plateIds.push_back(plateGlobal[id]);
+    }
+    for (int32_t id : fileTypeIds) {
+        result->typeIds.push_back(typeGlobal[id]);
+    }
+    result->plateFilter = PlateFilter(result->plateIds);
+
+    // 换回全局编号，替换源段后作为常驻数据
+    for (auto& id : merged.plate) {
+        id = plateGlobal[id];
+    }
+    for (auto& id : merged.type) {
+        id = typeGlobal[id];
+    }
+    chunk = std::make_shared<const HistoryChunk>(std::move(merged));
+    file = std::move(result);
+    return true;
+}
+
+bool HistoryStore::commitCompaction(const HistoryCompaction& compaction, time_t now) {
+    if (!compaction.file) {
+        if (compaction.damaged) {
+            damagedFiles.insert(compaction.damaged->path);
+        }
+        return false;
+    }
+    // 构建期间源段可能已被清理（或存储被重新加载），此时放弃这次合并
+    const size_t count = compaction.sources.size();
+    const size_t first = indexOf(compaction.sources.front());
+    bool unchanged = first + count <= sealed.size();
+    size_t rows = 0;
+    Cents fee = 0;
+    for (size_t i = 0; unchanged && i < count; ++i) {
+        unchanged = sealed[first + i].file == compaction.sources[i];
+        rows += unchanged ? sealed[first + i].rows : 0;
+        fee += unchanged ? sealed[first + i].fee : 0;
+    }
+    if (!unchanged || rows != compaction.chunk->size()) {
+        std::error_code error;
+        fs::remove(compaction.file->path, error);
+        return false;
+    }
+
+    HistorySegment segment;
+    segment.firstRow = sealed[first].firstRow;
+    segment.rows = rows;
+    segment.minExit = compaction.chunk->minExit;
+    segment.maxExit = compaction.chunk->maxExit;
+    segment.fee = fee;
+    segment.resident = compaction.chunk;
+    segment.file = compaction.file;
+    for (const auto& source : compaction.sources) {
+        cache->erase(*source);
+        retired.push_back(source);  // 与清理的段相同，数据文件保存后、没有快照引用时才删除
+    }
+    sealed.erase(sealed.begin() + first + 1, sealed.begin() + first + count);
+    sealed[first] = std::move(segment);
+
+    // 合并的段先常驻内存，超出热段窗口的由demote()重新释放
+    firstHot = std::min(firstHot, first);
+    demote(now);
+    compactions++;
+    compactedRows += rows;
+    return true;
+}
+
+void HistoryStore::compactPostings(size_t batch) {
+    size_t end = std::min(postings.size(), compactCursor + batch);
+    for (; compactCursor < end; ++compactCursor) {
+        Postings& list = postings[compactCursor];
+        if (list.count == 0) {
+            continue;
+        }
+        if (list.lastRow < firstLiveRow) {
+            // 该车牌的记录已全部清理，释放字典项（编号不再使用，之后再出现时分配新编号）
+            plateIds.erase(plates[compactCursor]);
+            std::string().swap(plates[compactCursor]);
+            list = Postings();
+            continue;
+        }
+        size_t pos = 0;
+        if (getDelta(list.deltas, pos) >= firstLiveRow) {
+            continue;  // 第一条记录未清理，其后的也都未清理
+        }
+
+        std::string deltas;
+        uint64_t row = 0, previous = 0;
+        uint32_t kept = 0;
+        pos = 0;
+        for (uint32_t i = 0; i < list.count; ++i) {
+            row += getDelta(list.deltas, pos);
+            if (row >= firstLiveRow) {
+                putDelta(deltas, row - previous);
+                previous = row;
+                kept++;
+            }
+        }
+        list.deltas = std::move(deltas);
+        list.count = kept;
+    }
+    compacting = compactCursor < postings.size();
+}
+
+void HistoryStore::removeRetiredFiles() {
+    // 已从段列表中移除，不会再有新的引用；只剩这里的引用时说明没有快照在读
+    auto unused = std::partition(retired.begin(), retired.end(), [](const std::shared_ptr<const SegmentFile>& file) {
+        return file.use_count() > 1;
+    });
+    for (auto it = unused; it != retired.end(); ++it) {
+        std::error_code error;
+        fs::remove((*it)->path, error);
+        if (error) {
+            std::cerr << "Failed to remove history segment " << (*it)->path << ": " << error.message() << std::endl;
+        }
+    }
+    retired.erase(unused, retired.end());
+}
+
+Cents HistoryStore::getPurgedFee() const {
+    return purgedFee;
+}
+
+std::string HistoryStore::saveRetention() const {
+    // int64 热段窗口，int64 保留期限，uint64 已清理的段编号下限，uint64 累计清理的记录数，int64 累计清理的费用
+    std::string data;
+    int64_t values[] = {static_cast<int64_t>(hotWindow), static_cast<int64_t>(retention),
+                        static_cast<int64_t>(firstSegmentId), static_cast<int64_t>(purgedRows), purgedFee};
+    data.append(reinterpret_cast<const char*>(values), sizeof(values));
+    return data;
+}
+
+bool HistoryStore::loadRetention(const std::string& data) {
+    int64_t values[5];
+    if (data.size() < sizeof(values)) {
+        return false;
+    }
+    std::memcpy(values, data.data(), sizeof(values));
+    if (values[0] <= 0 || values[1] < 0) {
+        return false;
+    }
+    hotWindow = static_cast<time_t>(values[0]);
+    retention = static_cast<time_t>(values[1]);
+    firstSegmentId = static_cast<uint64_t>(values[2]);
+    purgedRows = static_cast<uint64_t>(values[3]);
+    purgedFee = values[4];
+    return true;
+}
+
+HistoryStorageStats HistoryStore::stats() const {
+    HistoryStorageStats result;
+    result.rows = size();
+    result.segments = sealed.size();
+    for (const auto& segment : sealed) {
+        if (segment.resident) {
+            result.residentSegments++;
+            result.residentBytes += segment.resident->bytes();
+        }
+        if (segment.file) {
+            result.diskBytes += segment.file->bytes;
+            result.filterBytes += segment.file->plateFilter.bytes();
+            result.level0Segments += segment.file->level() == 0;
+        }
+    }
+    result.residentBytes += current.bytes();
+    result.openRows = current.size();
+    result.hotWindow = hotWindow;
+    result.retention = retention;
+    result.purgedRows = purgedRows;
+    result.compactions = compactions;
+    result.compactedRows = compactedRows;
+    result.cache = cache->stats();
+    return result;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file idempotency_cache.cpp
+ * @brief IdempotencyCache类的具体实现
+ */
+#include "include/idempotency_cache.h"
+#include <chrono>
+
+IdempotencyCache::IdempotencyCache(size_t maxEntries, time_t ttlSeconds)
+    : maxEntries(maxEntries)
+    , ttlSeconds(ttlSeconds)
+{
+}
+
+void IdempotencyCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    insertionOrder.erase(it->second.order);
+    entries.erase(it);
+}
+
+void IdempotencyCache::evict(time_t now) {
+    // 链表头部是最早插入（也是最早过期）的条目。执行中的条目不能淘汰，否则重试会被重复执行，
+    // 跳过它们继续淘汰其后已完成的条目；执行中的条目数不超过并发请求数，跳过的代价有限
+    for (auto pos = insertionOrder.begin(); pos != insertionOrder.end();) {
+        auto it = entries.find(*pos);
+        ++pos;
+        bool expired = it->second.expiresAt <= now;
+        bool overCapacity = entries.size() > maxEntries;
+        if (!expired && !overCapacity) {
+            break;
+        }
+        if (it->second.done) {
+            erase(it);
+        }
+    }
+}
+
+IdempotencyCache::Status IdempotencyCache::begin(const std::string& key, size_t fingerprint,
+                                                 HttpResponse& outResponse, int waitSeconds) {
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    time_t now = std::time(nullptr);
+    evict(now);
+
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.expiresAt <= now && it->second.done) {
+        erase(it);  // 已过期但未被淘汰
+        it = entries.end();
+    }
+
+    if (it == entries.end()) {
+        // 首次出现：占用该键
+        insertionOrder.push_back(key);
+        entries.emplace(key, Entry{fingerprint, false, HttpResponse(), now + ttlSeconds,
+                                   std::prev(insertionOrder.end())});
+        return Status::Acquired;
+    }
+
+    if (it->second.fingerprint != fingerprint) {
+        return Status::Mismatch;
+    }
+
+    // 原请求仍在执行，等待其完成
+    bool finished = completed.wait_for(lock, std::chrono::seconds(waitSeconds), [&]() {
+        auto current = entries.find(key);
+        return current == entries.end() || current->second.done;
+    });
+    it = entries.find(key);
+    if (!finished) {
+        return Status::InProgress;
+    }
+    if (it == entries.end()) {
+        // 原请求被放弃，由当前请求重新执行
+        insertionOrder.push_back(key);
+        entries.emplace(key, Entry{fingerprint, false, HttpResponse(), now + ttlSeconds,
+                                   std::prev(insertionOrder.end())});
+        return Status::Acquired;
+    }
+
+    outResponse = it->second.response;
+    return Status::Replayed;
+}
+
+void IdempotencyCache::complete(const std::string& key, const HttpResponse& response) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            it->second.done = true;
+            it->second.response = response;
+        }
+    }
+    completed.notify_all();
+}
+
+void IdempotencyCache::abandon(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = entries.find(key);
+        if (it != entries.end() && !it->second.done) {
+            erase(it);
+        }
+    }
+    completed.notify_all();
+}
@@ -1,36 +1,56 @@
 #pragma once
 #include "parking_lot.h"
+#include "http_message.h"
+#include "idempotency_cache.h"
+#include "occupancy_board.h"
+#include "partitioned_lot.h"
+#include "task_scheduler.h"
 #include <memory>
 #include <string>
 #include <map>
+#include <set>
 #include <functional>
 #include <sstream>
 #include <cstdint>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <shared_mutex>
+#include <chrono>
 
-class HttpRequest {
-public:
-    std::string method;
-    std::string path;
-    std::string body;
-    std::map<std::string, std::string> params;
-};
-
-class HttpResponse {
-public:
-    int status;
-    std::string body;
-    std::map<std::string, std::string> headers;
-
-    HttpResponse(int s = 200) : status(s) {
-        headers["Content-Type"] = "application/json";
-    }
-};
-
+/**
+ * @class ParkingApiServer
+ * @brief 停车场管理系统的HTTP服务器
+ *
+ * 一个服务器托管多个停车场，每个停车场是一个分片：独立的ParkingLot（锁、存储引擎、段目录和各类缓存）
+ * 和告警队列，请求/api/lots/{编号}/...由对应的分片处理，分片之间互不加锁。
+ * 车流量大的停车场可以在创建时按车牌再分为多个分区（PartitionedLot），同一停车场内的入场/出场也并行处理。
+ * 不带编号的旧接口/api/...访问默认停车场（数据文件为dataFile），主备复制和占用看板只作用于默认停车场。
+ * 全部停车场共用一组工作线程处理连接；超时检查、历史记录清理、后台快照等后台工作都是共用的任务调度器上的任务
+ */
 class ParkingApiServer {
 private:
-    // 定义路由处理器类型
-    using RouteHandler = std::function<HttpResponse(const HttpRequest&)>;
+    // 已触发的超时告警记录，seq单调递增，供客户端增量拉取
+    struct AlertRecord {
+        uint64_t seq;
+        OverstayEvent event;
+    };
+
+    // 一个停车场分片，创建后不再删除，地址不变
+    struct LotShard {
+        std::string id;                        // 停车场编号，默认停车场为"default"
+        std::unique_ptr<PartitionedLot> lot;   // 不分区的停车场只有一个分区
+        std::deque<AlertRecord> recentAlerts;  // 最近的超时告警（有上限）
+        uint64_t nextAlertSeq = 1;             // 下一条告警的序号
+        std::mutex alertMutex;                 // 保护recentAlerts和nextAlertSeq
+        std::atomic<bool> retentionQueued{false};  // 清理任务已提交或正在执行
+    };
+
+    // 定义路由处理器类型，参数为请求所属的停车场分片和请求
+    using RouteHandler = std::function<HttpResponse(LotShard&, const HttpRequest&)>;
     
     // 定义路由表项结构
     struct Route {
@@ -38,40 +58,142 @@ private:
         std::string path;
         RouteHandler handler;
         bool isPrefix;  // 是否是前缀匹配
+        std::string suffix = "";  // 前缀匹配时路径还须以此结尾，例如/api/vehicle/{车牌}/visits
+        bool perLot = true;  // 是否可以通过/api/lots/{编号}访问；为false时只有旧路径，处理默认停车场或整个服务器
     };
 
     std::vector<Route> routes;  // 路由表
-    std::unique_ptr<ParkingLot> parkingLot;
     int serverSocket;
-    bool running;
+    std::atomic<bool> running;
+
+    std::string storageEngine;                     // 各停车场的存储引擎
+    std::map<std::string, std::unique_ptr<LotShard>> lots;  // 停车场编号到分片
+    std::set<std::string> creatingLots;            // 正在创建（已占用编号、尚未加入lots）的停车场
+    mutable std::shared_mutex lotsMutex;           // 保护lots和creatingLots（只在创建停车场时加写锁）
+    LotShard* defaultShard;                        // 默认停车场
+
+    size_t workerCount;                            // 处理连接的工作线程数
+    std::vector<std::thread> workers;
+    std::deque<int> pendingClients;                // 已接受、等待工作线程处理的连接
+    std::mutex clientMutex;                        // 保护pendingClients
+    std::condition_variable clientReady;           // 有新连接，或要求退出
+
+    TaskScheduler scheduler;               // 后台任务调度器
+    TaskHandle alertTask;                  // 每秒检查超时车辆的周期任务
+    TaskHandle retentionTask;              // 每秒为各停车场提交清理任务的周期任务
+    TaskHandle seriesTask;                 // 定期保存各停车场占用时间序列的周期任务
+
+    IdempotencyCache idempotencyCache;     // 入场/出场请求的去重缓存
+
+    std::string dataFile;                          // 默认停车场的数据文件路径
+    std::string replicationSocket;                 // 复制socket路径，为空时不复制
+    std::atomic<bool> standby;                     // 备用节点只读，提升后才接受写请求
+    std::mutex replicationMutex;                   // 保护publisher和follower的创建、提升
+    std::unique_ptr<ReplicationPublisher> publisher;  // 主节点的复制发布者
+    std::unique_ptr<ReplicationFollower> follower;    // 备用节点的复制跟随者
+
+    std::unique_ptr<OccupancyBoard> occupancyBoard;   // 共享内存占用看板，未开启时为空
 
     // 初始化路由表
     void initializeRoutes();
 
     // API处理函数
-    HttpResponse handleAddVehicle(const HttpRequest& req);
-    HttpResponse handleRemoveVehicle(const HttpRequest& req);
-    HttpResponse handleQueryVehicle(const HttpRequest& req);
-    HttpResponse handleGetParkingStatus(const HttpRequest& req);
-    HttpResponse handleSetRate(const HttpRequest& req);
-    HttpResponse handleGetHistory(const HttpRequest& req);
-    HttpResponse handleGetCurrentVehicles(const HttpRequest& req);
+    HttpResponse handleAddVehicle(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleRemoveVehicle(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleQueryVehicle(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetVehicleVisits(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetParkingStatus(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleSetRate(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetHistory(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetCurrentVehicles(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetOverstayAlerts(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleSetOverstayLimit(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetRevenueStats(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetOccupancyStats(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetDistributionStats(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetFrequentVisitors(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetForecast(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleExportHistoryCsv(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleExportHistoryArrow(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleExportHistoryParquet(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleQueryHistory(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetHistoryStorage(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleSetHistoryStorage(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetReplication(LotShard& shard, const HttpRequest& req);
+    HttpResponse handlePromote(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetLots(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleCreateLot(LotShard& shard, const HttpRequest& req);
+    HttpResponse handleGetScheduler(LotShard& shard, const HttpRequest& req);
+
+    // 停车场分片
+    LotShard& addLot(const std::string& id, std::unique_ptr<PartitionedLot> lot);
+    LotShard* findLot(const std::string& id) const;
+    std::vector<LotShard*> allLots() const;
+    std::string lotDataFile(const std::string& id) const;
+    std::string lotDataFile(const std::string& id, size_t partition) const;
+    std::string lotSeriesFile(const std::string& id) const;
+    static bool isValidLotId(const std::string& id);
+
+    // 超时告警
+    void onOverstay(LotShard& shard, const OverstayEvent& event);
+    void checkOverstays();
+
+    // 历史记录清理和段合并
+    void scheduleRetention();
+    void runRetentionStep(LotShard& shard);
+
+    // 占用时间序列不随每个事件写入数据文件，定期保存
+    static constexpr std::chrono::seconds OCCUPANCY_SAVE_INTERVAL{10};
+    void saveOccupancySeries();
 
     // 静态文件处理
     HttpResponse handleStaticFile(const std::string& path);
 
+    // 工作线程：逐个处理已接受的连接
+    void runWorker();
+    void serveClient(int clientSocket);
+
     // 辅助函数
     HttpRequest parseRequest(int clientSocket);
     void sendResponse(int clientSocket, const HttpResponse& response);
+    static bool sendAll(int clientSocket, const std::string& data);
     std::string createJsonResponse(bool success, const std::string& message, const std::string& data = "");
 
     // 路由匹配和分发
     HttpResponse routeRequest(const HttpRequest& request);
+    HttpResponse dispatchIdempotent(const Route& route, LotShard& shard, const HttpRequest& request, const std::string& key);
 
 public:
-    ParkingApiServer(size_t capacity = 100, double smallRate = 5.0, double largeRate = 8.0);
+    static constexpr size_t DEFAULT_WORKER_THREADS = 16;   // 默认的工作线程数
+    static constexpr size_t MAX_PENDING_CLIENTS = 1024;    // 等待处理的连接超过这么多时直接返回503
+
+    /**
+     * @param capacity、smallRate、largeRate 默认停车场首次启动时的容量和费率
+     * @param storageEngine 各停车场的存储引擎（file、log或sqlite）
+     * @param dataFile 默认停车场的数据文件；其他停车场保存在dataFile + ".lots/{编号}/"下，启动时全部载入
+     * @param workerThreads 处理连接的工作线程数
+     * @param taskThreads 后台任务调度器的线程数，0表示按CPU核数
+     */
+    ParkingApiServer(size_t capacity = 100, Cents smallRate = 500, Cents largeRate = 800,
+                     const std::string& storageEngine = "file", const std::string& dataFile = "parking_data.dat",
+                     size_t workerThreads = DEFAULT_WORKER_THREADS, size_t taskThreads = 0);
     ~ParkingApiServer();
 
+    /**
+     * @brief 开启主备复制，须在start()之前调用
+     * @param socketPath 主节点监听的Unix域socket路径
+     * @param asStandby true时作为备用节点跟随该socket上的主节点，只读直到提升
+     * @throw std::runtime_error 主节点无法监听socket
+     */
+    void startReplication(const std::string& socketPath, bool asStandby);
+
+    /**
+     * @brief 把占用数发布到共享内存看板，须在start()之前调用
+     * @param name 共享内存对象名称（以'/'开头），本机程序用OccupancyBoardReader读取
+     * @throw std::runtime_error 无法创建共享内存
+     */
+    void startOccupancyBoard(const std::string& name);
+
     void start(uint16_t port = 8080);
     void stop();
 };
\ No newline at end of file
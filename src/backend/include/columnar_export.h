@@ -0,0 +1,73 @@
+/**
+ * @file columnar_export.h
+ * @brief 历史记录的列式导出：Apache Arrow IPC流格式和Parquet文件格式
+ */
+#pragma once
+#include "history_store.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * @class ExportSink
+ * @brief 导出数据的输出缓冲
+ *
+ * 攒够一定大小后交给输出函数（例如HTTP的chunked响应），并记录已输出的总字节数，
+ * 供文件格式中需要绝对偏移量的字段使用
+ */
+class ExportSink {
+public:
+    using Writer = std::function<bool(const std::string& data)>;
+
+private:
+    Writer writer;
+    std::string buffer;
+    size_t flushSize;
+    uint64_t written;   // 已写入的总字节数（包括缓冲中尚未输出的）
+    bool failed;        // 输出函数返回过false（例如客户端已断开）
+
+public:
+    explicit ExportSink(Writer writer, size_t flushSize = 64 * 1024);
+
+    /**
+     * @brief 写入一段数据
+     * @return 输出是否仍然有效
+     */
+    bool write(const void* data, size_t size);
+
+    /**
+     * @brief 写入若干个0字节，使总字节数对齐到alignment
+     */
+    bool pad(size_t alignment);
+
+    /**
+     * @brief 输出缓冲中的全部数据
+     */
+    bool flush();
+
+    uint64_t offset() const { return written; }
+    bool ok() const { return !failed; }
+};
+
+/**
+ * @brief 以Arrow IPC流格式导出出场时间在[from, to)内的历史记录
+ *
+ * 依次输出Schema、车牌和车型的字典批（DictionaryBatch），以及每段一个记录批
+ * （RecordBatch）。列：plate(dictionary<int32, utf8>)、type(dictionary<int32, utf8>)、
+ * entry_time / exit_time(timestamp[s, UTC])、fee_cents(int64)，均不可为空。
+ * 完全在范围内的段直接输出各列数组，与范围不相交的冷段不会被加载
+ *
+ * @return 是否全部输出成功
+ */
+bool exportArrowStream(const HistorySnapshot& snapshot, int64_t from, int64_t to, ExportSink& sink);
+
+/**
+ * @brief 以Parquet格式导出出场时间在[from, to)内的历史记录
+ *
+ * 每个行组（row group）最多包含16段（最多约100万行），每段一个数据页，不压缩。
+ * 车牌和车型使用字典编码（每个列块一个PLAIN字典页，数据页为位宽32的RLE_DICTIONARY，
+ * 即直接输出字典编号数组），时间列为INT64 TIMESTAMP(MILLIS, UTC)，费用列为INT64（分）
+ *
+ * @return 是否全部输出成功
+ */
+bool exportParquet(const HistorySnapshot& snapshot, int64_t from, int64_t to, ExportSink& sink);
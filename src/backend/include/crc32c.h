@@ -0,0 +1,19 @@
+/**
+ * @file crc32c.h
+ * @brief CRC32C（Castagnoli多项式）校验和，用于数据文件和段文件的完整性检查
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 计算CRC32C校验和
+ * @param data 数据
+ * @param length 字节数
+ * @param crc 之前各部分的校验和，分段计算时传入上一段的结果，首段为0
+ * @return 校验和，crc32c("123456789") == 0xE3069283
+ *
+ * CPU支持SSE4.2时使用crc32指令，长数据分三段并行计算后合并（约10GB/s）；
+ * 否则使用查表实现（每次8字节），结果相同
+ */
+uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0);
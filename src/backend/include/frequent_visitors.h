@@ -0,0 +1,119 @@
+/**
+ * @file frequent_visitors.h
+ * @brief 常客统计的声明：Count-Min Sketch估计车牌入场次数，按天滚动窗口求Top-K
+ */
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class CountMinSketch
+ * @brief Count-Min Sketch频次估计
+ *
+ * depth行、每行width个计数器，每个键在每行映射到一个计数器。
+ * 估计值为各行计数器的最小值，只会高估不会低估，
+ * 误差上限约为 总次数 × e / width（以1 - e^-depth的概率成立）
+ */
+class CountMinSketch {
+private:
+    size_t depth;                    // 行数（哈希函数个数）
+    size_t width;                    // 每行计数器个数
+    std::vector<uint32_t> counters;  // depth × width 的计数器矩阵（按行存放）
+
+public:
+    CountMinSketch(size_t depth = 4, size_t width = 2048);
+
+    /**
+     * @brief 计算键在第row行的计数器位置
+     * @param hash 键的64位哈希
+     * @param row 行号
+     */
+    size_t cellIndex(uint64_t hash, size_t row) const;
+
+    /**
+     * @brief 计数加一
+     * @param hash 键的64位哈希
+     * @return 加一后的估计值
+     */
+    uint32_t add(uint64_t hash);
+
+    /**
+     * @brief 读取某个计数器
+     */
+    uint32_t cell(size_t index) const { return counters[index]; }
+
+    size_t getDepth() const { return depth; }
+    void clear();
+};
+
+/**
+ * @struct VisitorCount
+ * @brief 一个车牌在窗口内的入场次数估计
+ */
+struct VisitorCount {
+    std::string licensePlate;  // 车牌号
+    uint64_t visits;           // 入场次数（估计值，可能略微偏高）
+};
+
+/**
+ * @class FrequentVisitorTracker
+ * @brief 按天滚动窗口的常客Top-K统计
+ *
+ * 每天一个Count-Min Sketch和一个候选集合，保存在按天编号取模的环形数组中：
+ * 1. 入场时更新当天的Sketch，并用估计值更新当天的候选集合（按次数排序，
+ *    容量固定，新车牌的估计值超过集合中最小值时替换之）
+ * 2. 查询最近N天时，合并这些天的候选车牌，用N天Sketch逐行求和后的最小值重新估计，
+ *    再取前K个
+ * 3. 超出窗口的天会被新的一天覆盖，内存占用与车牌总数无关
+ */
+class FrequentVisitorTracker {
+public:
+    static constexpr int MAX_WINDOW_DAYS = 31;  // 最长窗口（天）
+
+private:
+    struct DaySlot {
+        int64_t day = -1;                                    // 天编号，-1表示空
+        CountMinSketch sketch;                               // 当天的入场次数
+        std::map<std::string, uint32_t> candidates;          // 当天的候选车牌及其估计值
+        std::set<std::pair<uint32_t, std::string>> ranking;  // 候选车牌按估计值排序（首元素最小）
+    };
+
+    std::vector<DaySlot> slots;   // 按天编号取模的环形数组
+    size_t candidatesPerDay;      // 每天最多保留的候选车牌数
+
+    static int64_t dayNumber(time_t time);
+    static uint64_t hashPlate(const std::string& plate);
+
+public:
+    /**
+     * @brief 构造函数
+     * @param candidatesPerDay 每天保留的候选车牌数，应不小于查询的K
+     */
+    explicit FrequentVisitorTracker(size_t candidatesPerDay = 256);
+
+    /**
+     * @brief 记录一次入场
+     * @param plate 车牌号
+     * @param time 入场时间
+     */
+    void record(const std::string& plate, time_t time);
+
+    /**
+     * @brief 查询窗口内入场次数最多的车牌
+     * @param k 返回的车牌数
+     * @param windowDays 窗口天数（包含今天，1到MAX_WINDOW_DAYS）
+     * @param now 当前时间
+     * @return 按入场次数从多到少排列
+     */
+    std::vector<VisitorCount> topK(size_t k, int windowDays, time_t now) const;
+
+    /**
+     * @brief 清空所有统计数据
+     */
+    void clear();
+};
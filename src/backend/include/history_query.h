@@ -0,0 +1,89 @@
+/**
+ * @file history_query.h
+ * @brief 历史记录的过滤/聚合查询：在列式块上按位图批量求值谓词，多线程并行
+ */
+#pragma once
+#include "history_store.h"
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @enum QueryGroupBy
+ * @brief 聚合的分组方式
+ */
+enum class QueryGroupBy {
+    None,   // 不分组
+    Type,   // 按车型
+    Day,    // 按出场日期（本地时间）
+    Hour    // 按出场小时（本地时间）
+};
+
+/**
+ * @struct HistoryQuery
+ * @brief 查询条件，所有范围均为闭区间，默认不限制
+ */
+struct HistoryQuery {
+    static constexpr int64_t NO_MIN = std::numeric_limits<int64_t>::min();
+    static constexpr int64_t NO_MAX = std::numeric_limits<int64_t>::max();
+    static constexpr int32_t ANY_PLATE = -1;  // 不限车牌
+    static constexpr int32_t NO_PLATE = -2;   // 车牌不在字典中，没有记录命中
+
+    std::string type;                  // 车型，空串表示不限
+    int32_t plateId = ANY_PLATE;       // 车牌字典编号，由ParkingLot::findHistoryPlate()取得
+    int64_t exitMin = NO_MIN;          // 出场时间
+    int64_t exitMax = NO_MAX;
+    int64_t entryMin = NO_MIN;         // 入场时间
+    int64_t entryMax = NO_MAX;
+    int64_t durationMin = NO_MIN;      // 停车时长（秒）
+    int64_t durationMax = NO_MAX;
+    int64_t feeMin = NO_MIN;           // 费用（分）
+    int64_t feeMax = NO_MAX;
+    QueryGroupBy groupBy = QueryGroupBy::None;
+};
+
+/**
+ * @struct QueryAggregate
+ * @brief 一组记录的聚合值
+ */
+struct QueryAggregate {
+    uint64_t count = 0;        // 记录数
+    int64_t feeSum = 0;        // 费用合计（分）
+    int64_t durationSum = 0;   // 停车时长合计（秒）
+
+    void merge(const QueryAggregate& other) {
+        count += other.count;
+        feeSum += other.feeSum;
+        durationSum += other.durationSum;
+    }
+};
+
+/**
+ * @struct HistoryQueryResult
+ * @brief 查询结果
+ */
+struct HistoryQueryResult {
+    QueryAggregate total;                           // 全部符合条件的记录
+    std::map<std::string, QueryAggregate> byType;   // 按车型分组（groupBy为Type时）
+    std::map<int64_t, QueryAggregate> byTime;       // 按时间段开始时间分组（groupBy为Day/Hour时）
+    uint64_t scannedRows = 0;                       // 实际检查的行数（整段跳过的不计）
+    uint64_t filteredSegments = 0;                  // 按车牌的Bloom过滤器跳过的段数
+    unsigned threads = 1;                           // 使用的线程数
+};
+
+/**
+ * @brief 在历史记录快照上执行过滤/聚合查询
+ *
+ * 1. 先用每段的出场时间范围跳过不可能命中的段，按车牌过滤时再用各段的Bloom过滤器跳过，
+ *    冷段只在可能命中时才加载
+ * 2. 每64行为一组，对各列连续数组求值谓词，得到64位的命中位图；
+ *    CPU支持AVX2时每条指令比较4个int64，否则使用标量实现，结果相同
+ * 3. 按位图聚合命中行；段较多时分给多个线程，各自加载、聚合后合并
+ *
+ * @param snapshot 历史记录快照（不需要车牌字典）
+ * @param query 查询条件
+ * @param maxThreads 最多使用的线程数，0表示按CPU核数
+ */
+HistoryQueryResult runHistoryQuery(const HistorySnapshot& snapshot, const HistoryQuery& query, unsigned maxThreads = 0);
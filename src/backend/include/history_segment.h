@@ -0,0 +1,177 @@
+/**
+ * @file history_segment.h
+ * @brief 历史记录段的磁盘格式和冷段缓存的声明
+ */
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct HistoryChunk;
+
+/**
+ * @enum SegmentCodec
+ * @brief 段内各列数据的压缩方式
+ */
+enum class SegmentCodec : uint32_t {
+    None = 0,   // 不压缩，各列为定长数组
+    Zlib = 1,   // 定长数组再经zlib压缩（早期封存的段，只读取不再写入）
+    Packed = 2  // 按列轻量编码：每128行一组，组内减去最小值后按最大位宽打包
+};
+
+/**
+ * @struct DecodedSegment
+ * @brief 解码后的段：块中的车牌、车型编号是段内字典的编号
+ */
+struct DecodedSegment {
+    std::unique_ptr<HistoryChunk> chunk;  // 各列数据
+    std::vector<std::string> plates;      // 段内车牌字典
+    std::vector<std::string> types;       // 段内车型字典
+};
+
+/**
+ * @brief 将一块记录编码为自包含的段
+ * @param chunk 各列数据，编号是全局字典的编号
+ * @param plates 全局车牌字典
+ * @param types 全局车型字典
+ * @param codec 压缩方式
+ * @param[out] plateIds 段内车牌编号到全局编号的映射，可为空
+ * @param[out] typeIds 段内车型编号到全局编号的映射，可为空
+ *
+ * 段内只保存用到的字典项，段文件可以独立读取，不依赖其他文件。
+ * Packed格式中车牌、车型保存段内字典编号，出场时间保存与上一行之差，入场时间保存停车时长，
+ * 费用保存整数分；有符号的值先做zigzag变换，再每128行按组内最小值和位宽打包。
+ * 车型通常只占1位，车牌、时间差、时长、费用各占十几位，一行约7字节；
+ * 段内字典按字符串排序后前缀压缩，相邻车牌通常只差最后几个字符
+ */
+std::string encodeSegment(const HistoryChunk& chunk, const std::vector<std::string>& plates,
+                          const std::vector<std::string>& types, SegmentCodec codec,
+                          std::vector<int32_t>* plateIds = nullptr, std::vector<int32_t>* typeIds = nullptr);
+
+/**
+ * @brief 解码encodeSegment()的输出
+ * @return 格式错误、数据不完整、校验和不符或编号越界时返回false
+ *
+ * Packed格式的位宽解包在CPU支持AVX2时每次处理4个值，否则使用标量实现，结果相同
+ */
+bool decodeSegment(const std::string& data, DecodedSegment& out);
+
+/**
+ * @class PlateFilter
+ * @brief 一个段内车牌（全局字典编号）的Bloom过滤器
+ *
+ * 每个车牌10位、7个哈希函数，误判率约1%；判断为不包含时段内一定没有该车牌，
+ * 按车牌查询时不必加载、扫描这个段。过滤器不写入磁盘，加载段文件时由段内字典重建
+ */
+class PlateFilter {
+private:
+    std::vector<uint64_t> bits;
+
+public:
+    PlateFilter() = default;
+
+    /**
+     * @param ids 段内出现的全部车牌编号
+     */
+    explicit PlateFilter(const std::vector<int32_t>& ids);
+
+    /**
+     * @brief 段内是否可能有该车牌；空过滤器总是返回true
+     */
+    bool mayContain(int32_t id) const;
+
+    uint64_t bytes() const { return bits.size() * sizeof(uint64_t); }
+};
+
+/**
+ * @struct SegmentFile
+ * @brief 封存到磁盘的一个段，创建后不再修改
+ *
+ * 封存的段文件名为"编号.seg"；后台合并产生的段覆盖若干个编号连续的段，
+ * 文件名为"首编号-末编号.seg"
+ */
+struct SegmentFile {
+    uint64_t id = 0;                // 段编号，按封存先后递增；合并的段为其中第一个段的编号
+    uint64_t lastId = 0;            // 覆盖的最后一个段编号，未经合并的段与id相同
+    std::string path;               // 文件路径
+    uint64_t bytes = 0;             // 文件大小
+    std::vector<int32_t> plateIds;  // 段内车牌编号到全局编号的映射
+    std::vector<int32_t> typeIds;   // 段内车型编号到全局编号的映射
+    PlateFilter plateFilter;        // 段内车牌的Bloom过滤器
+
+    // 合并层级：0为内存表写满后直接封存的段，1为合并产生的段
+    int level() const { return lastId > id ? 1 : 0; }
+};
+
+/**
+ * @brief 读取段文件并把编号换成全局字典的编号
+ * @return 文件不存在或损坏时返回空指针
+ */
+std::shared_ptr<const HistoryChunk> readSegmentFile(const SegmentFile& file);
+
+/**
+ * @struct SegmentCacheStats
+ * @brief 冷段缓存的统计信息
+ */
+struct SegmentCacheStats {
+    size_t entries = 0;      // 缓存的段数
+    uint64_t bytes = 0;      // 缓存占用的内存
+    uint64_t budget = 0;     // 内存预算
+    uint64_t hits = 0;       // 命中次数
+    uint64_t misses = 0;     // 未命中（从磁盘加载）次数
+};
+
+/**
+ * @class SegmentCache
+ * @brief 按需从磁盘加载的冷段的LRU缓存
+ *
+ * 缓存占用超过内存预算时淘汰最久未使用的段；被淘汰的段如果仍被快照引用，
+ * 要等快照释放后才真正释放内存。
+ * 本类内部加锁，可在ParkingLot的锁外由导出、查询线程并发调用；
+ * 磁盘读取和解码在锁外进行，同一段可能被两个线程同时加载，结果相同
+ */
+class SegmentCache {
+private:
+    struct Entry {
+        std::shared_ptr<const HistoryChunk> chunk;
+        uint64_t bytes;
+        std::list<std::string>::iterator position;  // 在recency中的位置
+    };
+
+    mutable std::mutex mutex;
+    // 以文件路径为键：合并的段与其中第一个源段编号相同，旧快照可能仍在读取源段
+    std::unordered_map<std::string, Entry> entries;  // 段文件路径到缓存项
+    std::list<std::string> recency;                   // 段文件路径，最近使用的在前
+    uint64_t budget;
+    uint64_t used = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    // 淘汰最久未使用的段，直到占用不超过预算（调用者持有锁）
+    void evict();
+
+public:
+    explicit SegmentCache(uint64_t budget) : budget(budget) {}
+
+    /**
+     * @brief 取一个段的数据，不在缓存中时从磁盘加载
+     * @return 加载失败时返回空指针
+     */
+    std::shared_ptr<const HistoryChunk> get(const SegmentFile& file);
+
+    /**
+     * @brief 从缓存中移除一个段
+     */
+    void erase(const SegmentFile& file);
+
+    /**
+     * @brief 修改内存预算，超出部分立即淘汰
+     */
+    void setBudget(uint64_t bytes);
+
+    SegmentCacheStats stats() const;
+};
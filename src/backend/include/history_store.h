@@ -0,0 +1,423 @@
+/**
+ * @file history_store.h
+ * @brief 列式历史记录存储的声明：按出场顺序追加，分段保存各列数据，较早的段只保存在磁盘上
+ */
+#pragma once
+#include "money.h"
+#include "history_segment.h"
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @struct HistoryChunk
+ * @brief 一块历史记录的列式数据
+ *
+ * 每列是一段连续数组，第i行由各列的第i个元素组成。
+ * 车牌和车型以字典编号保存，字符串在HistoryStore的字典中
+ */
+struct HistoryChunk {
+    std::vector<int32_t> plate;      // 车牌字典编号
+    std::vector<int32_t> type;       // 车型字典编号
+    std::vector<int64_t> entryTime;  // 入场时间（Unix秒）
+    std::vector<int64_t> exitTime;   // 出场时间（Unix秒）
+    std::vector<int64_t> fee;        // 费用（分）
+    int64_t minExit = 0;             // 块内最早的出场时间
+    int64_t maxExit = 0;             // 块内最晚的出场时间
+
+    size_t size() const { return exitTime.size(); }
+
+    // 各列数据占用的内存（字节）
+    uint64_t bytes() const { return size() * (2 * sizeof(int32_t) + 3 * sizeof(int64_t)); }
+
+    /**
+     * @brief 追加一行
+     */
+    void append(int32_t plateId, int32_t typeId, int64_t entry, int64_t exit, int64_t feeCents);
+
+    /**
+     * @brief 块内是否可能有出场时间在[from, to)内的记录
+     */
+    bool overlaps(int64_t from, int64_t to) const {
+        return size() > 0 && maxExit >= from && minExit < to;
+    }
+
+    /**
+     * @brief 块内记录是否全部在[from, to)内
+     */
+    bool within(int64_t from, int64_t to) const {
+        return minExit >= from && maxExit < to;
+    }
+
+    /**
+     * @brief 复制出场时间在[from, to)内的行
+     */
+    HistoryChunk select(int64_t from, int64_t to) const;
+};
+
+/**
+ * @struct HistorySegment
+ * @brief 一段历史记录的位置和出场时间范围
+ *
+ * 热段的数据常驻内存；冷段只保存在磁盘上，读取时经过SegmentCache加载
+ */
+struct HistorySegment {
+    uint64_t firstRow = 0;                         // 段内第一行的行号
+    size_t rows = 0;                               // 行数
+    int64_t minExit = 0;                           // 段内最早的出场时间
+    int64_t maxExit = 0;                           // 段内最晚的出场时间
+    Cents fee = 0;                                 // 段内费用合计（分）
+    std::shared_ptr<const HistoryChunk> resident;  // 常驻内存的数据，冷段为空
+    std::shared_ptr<const SegmentFile> file;       // 磁盘上的段文件，未封存的段为空
+
+    bool overlaps(int64_t from, int64_t to) const {
+        return rows > 0 && maxExit >= from && minExit < to;
+    }
+};
+
+/**
+ * @struct HistorySnapshot
+ * @brief 历史记录在某一时刻的只读快照
+ *
+ * 封存的段不会再被修改，快照与存储共享这些段；
+ * 字典只会追加，快照中段引用的编号都小于快照字典的大小
+ */
+struct HistorySnapshot {
+    std::vector<HistorySegment> segments;  // 按追加顺序排列
+    std::vector<std::string> plates;       // 车牌字典
+    std::vector<std::string> types;        // 车型字典
+    std::shared_ptr<SegmentCache> cache;   // 冷段缓存
+
+    /**
+     * @brief 取第index段的数据，冷段从缓存或磁盘加载
+     * @return 段文件丢失或损坏时返回空指针
+     */
+    std::shared_ptr<const HistoryChunk> load(size_t index) const;
+
+    /**
+     * @brief 取出第index段中出场时间在[from, to)内的记录
+     * @return 段完全在范围内时直接返回原数据，没有符合条件的记录时返回空指针；
+     *         先按段的出场时间范围判断，不相交的冷段不会被加载
+     */
+    std::shared_ptr<const HistoryChunk> rowsOf(size_t index, int64_t from, int64_t to) const;
+};
+
+/**
+ * @struct HistoryStorageStats
+ * @brief 历史记录各层存储的统计信息
+ */
+struct HistoryStorageStats {
+    uint64_t rows = 0;              // 记录总数
+    size_t segments = 0;            // 封存的段数
+    size_t level0Segments = 0;      // 其中内存表直接封存、尚未合并的段数
+    size_t residentSegments = 0;    // 常驻内存的段数
+    uint64_t residentBytes = 0;     // 常驻内存的段（含未封存的段）占用的内存
+    uint64_t diskBytes = 0;         // 段文件总大小
+    size_t openRows = 0;            // 未封存的段的行数
+    time_t hotWindow = 0;           // 热段时间窗口（秒）
+    time_t retention = 0;           // 保留期限（秒），0表示永久保留
+    uint64_t purgedRows = 0;        // 超出保留期限已清理的记录数
+    uint64_t compactions = 0;       // 本次运行以来完成的合并次数
+    uint64_t compactedRows = 0;     // 本次运行以来合并重写的记录数
+    uint64_t filterBytes = 0;       // 各段Bloom过滤器占用的内存
+    SegmentCacheStats cache;        // 冷段缓存
+};
+
+/**
+ * @struct HistoryExpiry
+ * @brief 一次后台清理的结果
+ */
+struct HistoryExpiry {
+    uint64_t rows = 0;     // 本次清理的记录数
+    Cents fee = 0;         // 本次清理的记录的费用合计（分）
+    time_t horizon = 0;    // 剩余记录中最早的出场时间，更早的记录已全部清理
+    bool more = false;     // 是否还有待处理的工作
+};
+
+/**
+ * @struct HistoryCompaction
+ * @brief 一次后台合并：在锁内由planCompaction()选出源段，在锁外build()写出合并后的段文件，
+ *        再在锁内由commitCompaction()替换源段
+ */
+struct HistoryCompaction {
+    std::vector<std::shared_ptr<const SegmentFile>> sources;  // 源段文件，编号连续、属于同一周期
+    std::string directory;                                     // 段文件目录
+    std::shared_ptr<SegmentFile> file;                         // 合并后的段文件，build()成功后非空
+    std::shared_ptr<const HistoryChunk> chunk;                 // 合并后的数据（全局字典编号）
+    std::shared_ptr<const SegmentFile> damaged;                // build()失败时读不出的源段
+
+    bool empty() const { return sources.empty(); }
+
+    /**
+     * @brief 读取源段文件，按顺序拼接后写入新的段文件
+     * @return 源段文件丢失、损坏或写入失败时返回false，不留下文件
+     *
+     * 只读取创建后不再修改的段文件，不访问HistoryStore，可以在锁外执行
+     */
+    bool build();
+};
+
+// 加载历史记录时逐行回调：车牌、车型、入场时间、出场时间、费用
+using HistoryRowVisitor = std::function<void(const std::string& plate, const std::string& type,
+                                             time_t entryTime, time_t exitTime, Cents fee)>;
+
+/**
+ * @class HistoryStore
+ * @brief 已出场记录的分层列式存储
+ *
+ * 1. 记录按出场顺序追加到当前段（内存表），写满MEMTABLE_ROWS行或出场时间跨入下一个SEGMENT_SPAN周期时
+ *    封存，封存的段不再修改，并以压缩格式写入段目录（每段一个文件，只写一次，顺序写入）；
+ *    未封存的段随每次快照重新编码，内存表较小时快照的开销也小
+ * 2. 后台把同一周期内编号连续的小段合并为至多CHUNK_ROWS行的段（LSM式的分层合并）：
+ *    0层是内存表直接封存的段，1层是合并产生的段，一个周期内0层段达到COMPACTION_TRIGGER个、
+ *    或周期已经结束时合并；合并只拼接各段、不改变行号，倒排表不需要更新。
+ *    段按出场时间排列、时间范围互不重叠，按时间查询时读放大不超过每周期的段数
+ * 3. 最晚出场时间在热段窗口内的段常驻内存；更早的段释放内存，只保留出场时间范围和段文件信息，
+ *    读取时经过有内存预算的LRU缓存从磁盘加载
+ * 4. 每段记录出场时间的最小值和最大值，按时间段查询时可整段跳过，不需要加载冷段；
+ *    每段另有车牌的Bloom过滤器，按车牌过滤的查询可跳过不含该车牌的段
+ * 5. 导出等耗时操作先在锁内取快照（共享封存的段，只复制未封存的段和字典），
+ *    之后在锁外直接读取各列的连续数组，不需要逐行构造Vehicle对象
+ * 6. 每个车牌维护一个倒排表（行号的差值编码），按车牌查询全部记录时不需要扫描
+ * 7. 设置保留期限后，由后台调用expire()逐段清理最晚出场时间超出期限的段，
+ *    每次只清理一段、整理一批倒排表，段文件在没有快照引用后才删除
+ *
+ * 未封存的段由ParkingLot随数据文件保存，数据文件同时记录已提交的段编号上限，
+ * 封存后数据文件还没来得及保存就中断时，加载时丢弃多出的段文件，避免记录重复；
+ * 清理同理，数据文件记录已清理的段编号下限，加载时删除残留的已清理段文件。
+ * 合并后的段文件名记录了覆盖的编号范围，加载时它覆盖的编号都已提交才使用它并删除残留的源段，
+ * 否则删除它、仍使用源段；源段和被清理的段一样，在数据文件保存之后才删除。
+ * 本类不加锁，由ParkingLot的dataMutex保护；冷段缓存自带锁，可在锁外通过快照访问
+ */
+class HistoryStore {
+public:
+    static constexpr size_t CHUNK_ROWS = 65536;                  // 每段最多的行数
+    static constexpr size_t MEMTABLE_ROWS = 4096;                // 内存表写满这么多行后封存
+    static constexpr size_t COMPACTION_TRIGGER = 4;              // 一个周期内0层段达到这个数时合并
+    static constexpr time_t SEGMENT_SPAN = 7 * 86400;            // 每段覆盖的出场时间周期（秒）
+    static constexpr time_t DEFAULT_HOT_WINDOW = 30 * 86400;     // 默认热段窗口（秒）
+    static constexpr uint64_t DEFAULT_CACHE_BYTES = 64ull << 20; // 默认冷段缓存预算（字节）
+    static constexpr size_t POSTINGS_BATCH = 4096;               // 每次清理最多整理的倒排表数
+
+private:
+    std::vector<HistorySegment> sealed;                       // 已封存的段
+    uint64_t sealedRows = 0;                                  // 已封存的行数（含已清理的）
+    uint64_t firstLiveRow = 0;                                // 第一条未清理记录的行号
+    size_t firstHot = 0;                                      // sealed中第一个可能常驻内存的段
+    HistoryChunk current;                                     // 正在写入的段
+    std::vector<std::string> plates;                          // 车牌字典
+    std::unordered_map<std::string, int32_t> plateIds;        // 车牌到字典编号
+    std::vector<std::string> types;                           // 车型字典（车型很少，顺序查找）
+
+    std::string directory;                                    // 段文件目录，为空时不写磁盘、全部常驻
+    uint64_t nextSegmentId = 0;                               // 下一个封存的段的编号
+    time_t hotWindow = DEFAULT_HOT_WINDOW;                    // 热段窗口
+    std::shared_ptr<SegmentCache> cache;                      // 冷段缓存
+
+    time_t retention = 0;                                     // 保留期限，0表示永久保留
+    uint64_t firstSegmentId = 0;                              // 编号更小的段已清理
+    uint64_t purgedRows = 0;                                  // 累计清理的记录数
+    Cents purgedFee = 0;                                      // 累计清理的记录的费用合计
+    std::vector<std::shared_ptr<const SegmentFile>> retired;  // 已清理、等待快照释放后删除的段文件
+    size_t compactCursor = 0;                                 // 倒排表整理进度（车牌字典编号）
+    bool compacting = false;                                  // 是否有倒排表待整理
+    uint64_t compactions = 0;                                 // 完成的段合并次数
+    std::unordered_set<std::string> damagedFiles;             // 合并时读不出的段文件，不再参与合并
+    uint64_t compactedRows = 0;                               // 段合并重写的记录数
+
+    // 每个车牌的倒排表：该车牌各条记录的行号，按相邻行号之差以变长整数编码
+    struct Postings {
+        std::string deltas;     // 行号差值的varint序列
+        uint64_t lastRow = 0;   // 最后一条记录的行号
+        uint32_t count = 0;     // 记录条数
+    };
+    std::vector<Postings> postings;                           // 按车牌字典编号
+
+    int32_t typeIdOf(const std::string& type);
+    int32_t plateIdOf(const std::string& plate);
+    // 在车牌的倒排表末尾加入一个行号
+    void addPosting(int32_t plateId, uint64_t row);
+    // 追加一行（编号已换成全局字典的编号），需要时封存当前段
+    void appendRow(int32_t plateId, int32_t typeId, int64_t entry, int64_t exit, int64_t fee);
+    // 封存当前段并写入段文件
+    void seal();
+    // 释放超出热段窗口的段的内存（已写入磁盘的段才释放）
+    void demote(time_t now);
+    // 从倒排表中去掉已清理的行号，记录全部清理的车牌从字典中移除
+    void compactPostings(size_t batch);
+    // 删除不再被快照引用的已清理段文件
+    void removeRetiredFiles();
+    std::string segmentPath(uint64_t id) const;
+    // 段在sealed中的位置，已不在段列表中时返回sealed.size()
+    size_t indexOf(const std::shared_ptr<const SegmentFile>& file) const;
+    // 取行号所在段的数据，offset为段内位置；记录已清理、段文件丢失或损坏时返回空指针
+    std::shared_ptr<const HistoryChunk> chunkOf(uint64_t row, size_t& offset) const;
+
+public:
+    HistoryStore();
+
+    /**
+     * @brief 设置段文件目录，目录不存在时创建
+     */
+    void open(const std::string& directory);
+
+    /**
+     * @brief 追加一条出场记录
+     */
+    void append(const std::string& plate, const std::string& type, time_t entryTime, time_t exitTime, Cents fee);
+
+    /**
+     * @brief 按时间先后遍历某个车牌的全部记录
+     * @param plate 车牌号
+     * @param visitor 接收每条记录的车型、入场时间、出场时间和费用
+     * @return 该车牌的记录条数
+     *
+     * 通过倒排表直接定位各条记录，耗时与该车牌的记录数成正比；记录在冷段中时按需加载该段
+     */
+    size_t forEachVisit(const std::string& plate,
+                        const std::function<void(const std::string& type, time_t entryTime,
+                                                 time_t exitTime, Cents fee)>& visitor) const;
+
+    /**
+     * @brief 读取某个车牌最近一条记录
+     * @return 没有该车牌的记录时返回false
+     */
+    bool latestVisit(const std::string& plate,
+                     const std::function<void(const std::string& type, time_t entryTime,
+                                              time_t exitTime, Cents fee)>& visitor) const;
+
+    /**
+     * @brief 取当前数据的只读快照
+     * @param withPlates 是否复制车牌字典（只做聚合查询时不需要）
+     */
+    HistorySnapshot snapshot(bool withPlates = true) const;
+
+    /**
+     * @brief 记录总数（不含已清理的记录）
+     */
+    size_t size() const;
+
+    /**
+     * @brief 清空内存中的记录、字典和清理进度，不删除段文件，不改变分层和保留设置
+     */
+    void clear();
+
+    /**
+     * @brief 删除段目录中的全部段文件（从旧格式数据文件导入前调用）
+     */
+    void removeSegmentFiles();
+
+    /**
+     * @brief 把另一个目录中的段文件移入段目录（备用节点载入主节点的基准），同名文件被替换
+     * @return 移入的段文件数
+     */
+    size_t adoptSegmentFiles(const std::string& source);
+
+    /**
+     * @brief 是否为段文件名（不含目录）
+     */
+    static bool isSegmentFileName(const std::string& name);
+
+    /**
+     * @brief 按编号顺序加载段目录中编号小于endId的段
+     * @param endId 数据文件中记录的已提交段编号上限，覆盖了更大编号的段文件被删除；
+     *              编号小于loadRetention()读到的下限的段已清理，也被删除；
+     *              合并的段与它覆盖的源段同时存在时只加载合并的段，删除源段
+     * @param now 当前时间，超出热段窗口的段加载后即释放内存
+     * @param visitor 逐行回调，用于重建营收等汇总数据
+     * @return 加载的记录数；损坏的段文件被跳过
+     */
+    size_t loadSegments(uint64_t endId, time_t now, const HistoryRowVisitor& visitor);
+
+    /**
+     * @brief 编码未封存的段，随数据文件保存
+     */
+    std::string saveOpenSegment() const;
+
+    /**
+     * @brief 读取数据文件中未封存的段中的已提交段编号上限
+     * @return 数据损坏时返回false
+     */
+    static bool readCommittedSegments(const std::string& data, uint64_t& endId);
+
+    /**
+     * @brief 加载saveOpenSegment()的输出，追加到已加载的段之后
+     * @return 数据损坏时返回false
+     */
+    bool loadOpenSegment(const std::string& data, const HistoryRowVisitor& visitor);
+
+    /**
+     * @brief 设置热段窗口和冷段缓存的内存预算
+     * @param window 最晚出场时间早于now - window的段只保存在磁盘上
+     * @param cacheBytes 冷段缓存的内存预算
+     * @param now 当前时间，超出新窗口的段立即释放内存
+     */
+    void setTiering(time_t window, uint64_t cacheBytes, time_t now);
+
+    /**
+     * @brief 设置保留期限
+     * @param window 最晚出场时间早于now - window的段由expire()清理，0表示永久保留
+     */
+    void setRetention(time_t window);
+
+    /**
+     * @brief 按车牌查找字典编号
+     * @return 没有该车牌的记录时返回-1
+     */
+    int32_t findPlate(const std::string& plate) const;
+
+    /**
+     * @brief 选出下一次后台合并的源段
+     * @param now 当前时间，用于判断周期是否已经结束
+     * @return 没有需要合并的段时返回空的合并任务
+     *
+     * 在同一周期内找编号连续、行数合计不超过CHUNK_ROWS的段，其中0层段达到COMPACTION_TRIGGER个，
+     * 或者周期已经结束且至少有两个段；没有段目录时不合并
+     */
+    HistoryCompaction planCompaction(time_t now) const;
+
+    /**
+     * @brief 用build()写好的段替换源段
+     * @return build()失败时返回false，损坏的源段之后不再参与合并；
+     *         源段已被清理或替换时返回false并删除新写的段文件；
+     *         返回true时调用者应立即保存数据文件，此后的expire()才删除源段文件
+     */
+    bool commitCompaction(const HistoryCompaction& compaction, time_t now);
+
+    /**
+     * @brief 执行一步后台清理
+     * @param now 当前时间
+     * @return 本次清理的结果；清理了记录时，调用者应立即保存数据文件，
+     *         此后的调用才会删除对应的段文件
+     *
+     * 释放超出热段窗口的段的内存，清理至多一个超出保留期限的段，整理至多POSTINGS_BATCH个倒排表，
+     * 每步耗时有上限，后台线程可以每步之间释放锁，不阻塞入场/出场
+     */
+    HistoryExpiry expire(time_t now);
+
+    /**
+     * @brief 累计清理的记录的费用合计，用于重建累计营收
+     */
+    Cents getPurgedFee() const;
+
+    /**
+     * @brief 编码分层、保留设置和清理进度，随数据文件保存
+     */
+    std::string saveRetention() const;
+
+    /**
+     * @brief 加载saveRetention()的输出，须在clear()之后、loadSegments()之前调用
+     * @return 数据损坏时返回false
+     */
+    bool loadRetention(const std::string& data);
+
+    /**
+     * @brief 各层存储的统计信息
+     */
+    HistoryStorageStats stats() const;
+};
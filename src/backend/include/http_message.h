@@ -0,0 +1,54 @@
+/**
+ * @file http_message.h
+ * @brief HTTP请求和响应对象的声明
+ */
+#pragma once
+#include <functional>
+#include <map>
+#include <string>
+#include <strings.h>
+
+class HttpRequest {
+public:
+    std::string method;
+    std::string path;
+    std::string body;
+    std::map<std::string, std::string> params;  // 请求头字段
+    std::map<std::string, std::string> query;   // URL查询参数（已解码）
+
+    /**
+     * @brief 按名称查找请求头（不区分大小写）
+     * @param name 请求头名称
+     * @return 请求头的值，不存在时返回空串
+     */
+    std::string getHeader(const std::string& name) const {
+        for (const auto& [key, value] : params) {
+            if (strcasecmp(key.c_str(), name.c_str()) == 0) {
+                return value;
+            }
+        }
+        return "";
+    }
+};
+
+class HttpResponse {
+public:
+    /**
+     * @brief 流式响应体的输出函数
+     * @param chunk 一块响应数据
+     * @return 发送成功返回true，客户端已断开返回false
+     */
+    using ChunkWriter = std::function<bool(const std::string& chunk)>;
+
+    int status;
+    std::string body;
+    std::map<std::string, std::string> headers;
+
+    // 流式响应体：设置后忽略body，以chunked编码边生成边发送，
+    // 用于导出等响应体过大、不宜整体放在内存中的场景
+    std::function<void(const ChunkWriter& write)> stream;
+
+    HttpResponse(int s = 200) : status(s) {
+        headers["Content-Type"] = "application/json";
+    }
+};
@@ -0,0 +1,89 @@
+/**
+ * @file idempotency_cache.h
+ * @brief 幂等请求去重缓存的声明，用于安全地重放闸机重试的入场/出场请求
+ */
+#pragma once
+#include "http_message.h"
+#include <condition_variable>
+#include <ctime>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @class IdempotencyCache
+ * @brief 有容量上限、按时间过期的幂等键缓存
+ *
+ * 闸机控制器在超时后会携带相同的Idempotency-Key重试请求：
+ * 1. 第一次请求获得执行权，执行完成后保存响应
+ * 2. 之后的重试直接重放保存的响应，不再访问停车场
+ * 3. 原请求仍在执行时到达的重试会等待其完成
+ *
+ * 条目按插入顺序保存在链表中，由于所有条目的有效期相同，
+ * 链表头部既是最旧的条目也是最早过期的条目，淘汰和过期都是O(1)
+ */
+class IdempotencyCache {
+public:
+    /**
+     * @brief begin()的查询结果
+     */
+    enum class Status {
+        Acquired,   // 首次出现，调用者负责执行请求并调用complete()或abandon()
+        Replayed,   // 已有保存的响应，输出参数中为原响应
+        Mismatch,   // 同一个键被用于不同的请求内容
+        InProgress  // 原请求仍在执行且等待超时
+    };
+
+private:
+    struct Entry {
+        size_t fingerprint;       // 请求内容（方法、路径、请求体）的哈希
+        bool done;                // 原请求是否已执行完成
+        HttpResponse response;    // 原请求的响应（done为true时有效）
+        time_t expiresAt;         // 过期时间
+        std::list<std::string>::iterator order;  // 在插入顺序链表中的位置
+    };
+
+    std::unordered_map<std::string, Entry> entries;  // 幂等键到条目的映射
+    std::list<std::string> insertionOrder;           // 按插入顺序排列的幂等键
+    size_t maxEntries;                               // 最多保存的条目数
+    time_t ttlSeconds;                               // 条目有效期（秒）
+
+    std::mutex cacheMutex;
+    std::condition_variable completed;               // 有请求执行完成时通知等待者
+
+    // 移除过期条目和超出容量的最旧条目（调用时需持有锁）
+    void evict(time_t now);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+public:
+    /**
+     * @brief 构造函数
+     * @param maxEntries 最多保存的条目数（默认10000）
+     * @param ttlSeconds 条目有效期（默认24小时）
+     */
+    explicit IdempotencyCache(size_t maxEntries = 10000, time_t ttlSeconds = 24 * 3600);
+
+    /**
+     * @brief 查询幂等键，首次出现时占用该键
+     * @param key 幂等键（调用者应把请求方法和路径也拼接进去）
+     * @param fingerprint 请求内容的哈希，用于发现键被误用于不同请求
+     * @param[out] outResponse Replayed时为原响应
+     * @param waitSeconds 原请求仍在执行时最多等待的秒数
+     * @return 查询结果
+     */
+    Status begin(const std::string& key, size_t fingerprint, HttpResponse& outResponse, int waitSeconds = 10);
+
+    /**
+     * @brief 保存请求的响应，唤醒等待中的重试
+     * @param key 幂等键
+     * @param response 要保存的响应
+     */
+    void complete(const std::string& key, const HttpResponse& response);
+
+    /**
+     * @brief 放弃执行权（例如处理过程中抛出异常），允许之后的重试重新执行
+     * @param key 幂等键
+     */
+    void abandon(const std::string& key);
+};
@@ -0,0 +1,68 @@
+/**
+ * @file money.h
+ * @brief 金额的定点整数表示（单位：分）及其格式化、解析工具
+ *
+ * 系统内部所有金额（费用、费率、营收）都以整数分保存和累加，
+ * 只在输入输出时与"元"的十进制字符串互相转换，避免浮点累加误差
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+
+using Cents = int64_t;  // 金额（单位：分）
+
+/**
+ * @brief 将金额格式化为两位小数的"元"字符串
+ * @param cents 金额（分）
+ * @return 例如1250格式化为"12.50"，可直接作为JSON数字输出
+ */
+inline std::string formatCents(Cents cents) {
+    std::string sign = cents < 0 ? "-" : "";
+    uint64_t abs = cents < 0 ? static_cast<uint64_t>(-(cents + 1)) + 1 : static_cast<uint64_t>(cents);
+    std::string fraction = std::to_string(abs % 100);
+    return sign + std::to_string(abs / 100) + "." + (fraction.size() < 2 ? "0" : "") + fraction;
+}
+
+/**
+ * @brief 将"元"的十进制字符串解析为金额
+ * @param text 例如"6"、"6.5"、"6.05"
+ * @param[out] outCents 解析结果（分），第三位小数四舍五入
+ * @return 是否解析成功（只接受非负的十进制数）
+ */
+inline bool parseCents(const std::string& text, Cents& outCents) {
+    size_t pos = 0;
+    Cents whole = 0;
+    bool hasDigit = false;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        whole = whole * 10 + (text[pos++] - '0');
+        hasDigit = true;
+        if (whole > INT64_MAX / 1000) {
+            return false;  // 溢出
+        }
+    }
+
+    Cents fraction = 0;
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        int digits = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            if (digits < 3) {
+                fraction = fraction * 10 + (text[pos] - '0');
+            }
+            ++digits;
+            ++pos;
+            hasDigit = true;
+        }
+        // 补齐到三位小数（厘），再四舍五入到分
+        for (; digits < 3; ++digits) {
+            fraction *= 10;
+        }
+        fraction = (fraction + 5) / 10;
+    }
+
+    if (!hasDigit || pos != text.size()) {
+        return false;
+    }
+    outCents = whole * 100 + fraction;
+    return true;
+}
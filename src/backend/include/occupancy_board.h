@@ -0,0 +1,244 @@
+/**
+ * @file occupancy_board.h
+ * @brief 共享内存中的车位占用看板：服务器写入，本机的显示屏、道闸等程序直接读取
+ *
+ * 看板是一个POSIX共享内存对象，内容为OccupancyBoardLayout，以顺序锁（seqlock）保护：
+ * 写入者先把sequence加1（变为奇数），写入各字段，再加1（变为偶数）；
+ * 读取者读sequence、复制各字段、再读sequence，两次相同且为偶数时复制的内容是一致的，否则重试。
+ * 读取者只需映射一次，之后每次读取都只访问内存，不进行系统调用，也不占用HTTP服务器。
+ *
+ * 读取端只需要本头文件（OccupancyBoardReader全部内联，不依赖服务器的其他代码）：
+ *
+ *     OccupancyBoardReader board;
+ *     OccupancyBoardSnapshot snapshot;
+ *     if (board.open("/parking_board") && board.read(snapshot) && board.alive(snapshot)) {
+ *         显示 snapshot.available ...
+ *     }
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @struct OccupancyBoardLayout
+ * @brief 共享内存中的数据布局（版本1）
+ *
+ * 各字段都是无锁的原子整数，读取与写入并发时没有数据竞争，一致性由sequence保证。
+ * 分区为各车型（小型、大型）的在场车辆数，名称为UTF-8，按字节打包在name中
+ */
+struct OccupancyBoardLayout {
+    static constexpr uint32_t MAGIC = 0x424F4B50;   // "PKOB"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t MAX_ZONES = 8;            // 最多的分区数
+    static constexpr size_t NAME_WORDS = 4;           // 分区名称占用的64位字数（最长32字节）
+
+    struct Zone {
+        std::atomic<uint64_t> name[NAME_WORDS];       // 分区名称，不足部分补0
+        std::atomic<uint32_t> occupied;               // 在场车辆数
+        std::atomic<uint32_t> reserved;
+    };
+
+    std::atomic<uint32_t> magic;                      // 初始化完成后才写入
+    std::atomic<uint32_t> version;
+    std::atomic<uint32_t> sequence;                   // 顺序锁，奇数表示正在写入
+    std::atomic<uint32_t> zoneCount;
+    std::atomic<uint32_t> capacity;                   // 总车位数
+    std::atomic<uint32_t> occupied;                   // 已占用车位数
+    std::atomic<int64_t> updatedAt;                   // 上次变化的时间（Unix毫秒）
+    std::atomic<int64_t> heartbeatAt;                 // 写入者每秒更新一次（不经过sequence），停止更新说明服务器已退出
+    Zone zones[MAX_ZONES];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free &&
+              std::atomic<int64_t>::is_always_lock_free,
+              "occupancy board requires lock-free atomics to be shared between processes");
+
+/**
+ * @struct OccupancyBoardSnapshot
+ * @brief 一次读取得到的一致的占用数据
+ */
+struct OccupancyBoardSnapshot {
+    uint32_t capacity = 0;
+    uint32_t occupied = 0;
+    uint32_t available = 0;
+    int64_t updatedAt = 0;
+    int64_t heartbeatAt = 0;
+    uint32_t zoneCount = 0;
+    struct Zone {
+        char name[OccupancyBoardLayout::NAME_WORDS * 8 + 1];  // 以'\0'结尾
+        uint32_t occupied;
+    } zones[OccupancyBoardLayout::MAX_ZONES];
+    uint32_t retries = 0;   // 与写入冲突而重读的次数
+};
+
+/**
+ * @class OccupancyBoardReader
+ * @brief 看板的读取端，open()之后read()不进行系统调用
+ */
+class OccupancyBoardReader {
+private:
+    const OccupancyBoardLayout* board = nullptr;
+
+public:
+    static constexpr int64_t STALE_MILLIS = 5000;   // 心跳超过这么久没有更新时认为服务器已退出
+
+    OccupancyBoardReader() = default;
+    ~OccupancyBoardReader() { close(); }
+
+    OccupancyBoardReader(const OccupancyBoardReader&) = delete;
+    OccupancyBoardReader& operator=(const OccupancyBoardReader&) = delete;
+
+    /**
+     * @brief 以只读方式映射看板
+     * @param name 共享内存对象名称（以'/'开头，如"/parking_board"）
+     * @return 对象不存在、大小或版本不符时返回false，可稍后重试（服务器可能尚未启动）
+     */
+    bool open(const std::string& name) {
+        close();
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        void* memory = ::mmap(nullptr, sizeof(OccupancyBoardLayout), PROT_READ, MAP_SHARED, fd, 0);
+        struct stat info;
+        bool sized = ::fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(OccupancyBoardLayout);
+        ::close(fd);  // 映射不依赖文件描述符
+        if (memory == MAP_FAILED) {
+            return false;
+        }
+        board = static_cast<const OccupancyBoardLayout*>(memory);
+        if (!sized || board->magic.load(std::memory_order_acquire) != OccupancyBoardLayout::MAGIC ||
+            board->version.load(std::memory_order_relaxed) != OccupancyBoardLayout::VERSION) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (board != nullptr) {
+            ::munmap(const_cast<OccupancyBoardLayout*>(board), sizeof(OccupancyBoardLayout));
+            board = nullptr;
+        }
+    }
+
+    bool isOpen() const { return board != nullptr; }
+
+    /**
+     * @brief 读取一份一致的数据，与写入冲突时自旋重读
+     * @return 未打开时返回false
+     */
+    bool read(OccupancyBoardSnapshot& out) const {
+        if (board == nullptr) {
+            return false;
+        }
+        out.retries = 0;
+        for (;; ++out.retries) {
+            uint32_t before = board->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;  // 正在写入
+            }
+            out.capacity = board->capacity.load(std::memory_order_relaxed);
+            out.occupied = board->occupied.load(std::memory_order_relaxed);
+            out.updatedAt = board->updatedAt.load(std::memory_order_relaxed);
+            out.zoneCount = board->zoneCount.load(std::memory_order_relaxed);
+            if (out.zoneCount > OccupancyBoardLayout::MAX_ZONES) {
+                out.zoneCount = OccupancyBoardLayout::MAX_ZONES;  // 读到写入中途的值，下面的检查会重读
+            }
+            for (uint32_t i = 0; i < out.zoneCount; ++i) {
+                const OccupancyBoardLayout::Zone& zone = board->zones[i];
+                for (size_t w = 0; w < OccupancyBoardLayout::NAME_WORDS; ++w) {
+                    uint64_t word = zone.name[w].load(std::memory_order_relaxed);
+                    std::memcpy(out.zones[i].name + w * 8, &word, 8);
+                }
+                out.zones[i].name[OccupancyBoardLayout::NAME_WORDS * 8] = '\0';
+                out.zones[i].occupied = zone.occupied.load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (board->sequence.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        out.available = out.capacity > out.occupied ? out.capacity - out.occupied : 0;
+        out.heartbeatAt = board->heartbeatAt.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief 写入者是否仍在运行（心跳在STALE_MILLIS内更新过）
+     */
+    static bool alive(const OccupancyBoardSnapshot& snapshot) {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        return snapshot.heartbeatAt > 0 && now - snapshot.heartbeatAt <= STALE_MILLIS;
+    }
+};
+
+/**
+ * @class OccupancyBoard
+ * @brief 看板的写入端（服务器），同一看板只能有一个写入者
+ *
+ * 共享内存对象已存在时（服务器重启）在原处继续写入，sequence继续递增，
+ * 已映射它的读取者不需要重新打开
+ */
+class OccupancyBoard {
+private:
+    std::string name;
+    OccupancyBoardLayout* board = nullptr;
+
+public:
+    /**
+     * @param name 共享内存对象名称（以'/'开头）
+     * @throw std::runtime_error 无法创建或映射共享内存
+     */
+    explicit OccupancyBoard(const std::string& name);
+    ~OccupancyBoard();
+
+    OccupancyBoard(const OccupancyBoard&) = delete;
+    OccupancyBoard& operator=(const OccupancyBoard&) = delete;
+
+    /**
+     * @brief 写入新的占用数据
+     * @param zones 各分区的名称和在场车辆数，超出MAX_ZONES的部分不写入，名称超长时截断
+     *
+     * 不加锁，由调用者保证同一时刻只有一个线程写入
+     */
+    template <typename ZoneMap>
+    void publish(size_t capacity, size_t occupied, const ZoneMap& zones);
+
+    /**
+     * @brief 更新心跳
+     */
+    void heartbeat();
+
+    const std::string& getName() const { return name; }
+
+private:
+    void beginWrite();
+    void endWrite();
+    void writeZone(size_t index, const std::string& zoneName, size_t occupied);
+};
+
+template <typename ZoneMap>
+void OccupancyBoard::publish(size_t capacity, size_t occupied, const ZoneMap& zones) {
+    beginWrite();
+    board->capacity.store(static_cast<uint32_t>(capacity), std::memory_order_relaxed);
+    board->occupied.store(static_cast<uint32_t>(occupied), std::memory_order_relaxed);
+    size_t count = 0;
+    for (const auto& [zoneName, zoneOccupied] : zones) {
+        if (count == OccupancyBoardLayout::MAX_ZONES) {
+            break;
+        }
+        writeZone(count++, zoneName, zoneOccupied);
+    }
+    board->zoneCount.store(static_cast<uint32_t>(count), std::memory_order_relaxed);
+    endWrite();
+}
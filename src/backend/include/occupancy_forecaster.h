@@ -0,0 +1,89 @@
+/**
+ * @file occupancy_forecaster.h
+ * @brief 占用车位数在线预测器的声明，按"一周中的时段"做季节性指数加权平均
+ */
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+/**
+ * @struct OccupancyForecast
+ * @brief 一次预测的结果
+ */
+struct OccupancyForecast {
+    double predicted;     // 预测的占用车位数
+    time_t fullIn;        // 预计多少秒后车位占满，-1表示24小时内不会占满
+    uint32_t samples;     // 目标时段已学习的周数（0表示没有历史数据，预测值即当前值）
+};
+
+/**
+ * @class OccupancyForecaster
+ * @brief 季节性EWMA占用预测器
+ *
+ * 把一周按本地时间划分为672个15分钟时段，每个时段保存该时段平均占用数的
+ * 指数加权移动平均（EWMA）：
+ * 1. 每次入场/出场时累加当前时段的"占用数×持续秒数"，时段结束时
+ *    用时段平均值更新该时段的EWMA，每个事件均摊O(1)
+ * 2. 预测时采用加法季节模型：预测值 = 当前占用数 +（目标时段EWMA - 当前时段EWMA），
+ *    即以历史同期的变化量修正当前值
+ * 3. 不需要离线批处理，学习结果随数据文件保存
+ */
+class OccupancyForecaster {
+public:
+    static constexpr time_t BUCKET_SECONDS = 15 * 60;        // 时段长度
+    static constexpr int BUCKETS_PER_WEEK = 7 * 24 * 4;      // 一周的时段数
+
+private:
+    struct Bucket {
+        double level = 0;      // 该时段平均占用数的EWMA
+        uint32_t samples = 0;  // 已学习的次数
+    };
+
+    std::vector<Bucket> profile;  // 按一周中的时段编号排列
+    double alpha;                 // EWMA平滑系数（新数据的权重）
+
+    // 正在累计的时段（本地时间秒数 / BUCKET_SECONDS），-1表示尚未开始
+    int64_t currentPeriod;
+    int64_t lastLocalTime;        // 上一个事件的本地时间（秒）
+    int64_t observedSince;        // 当前时段开始观测的本地时间（启动后的第一个时段不完整）
+    uint32_t lastValue;           // 上一个事件之后的占用数
+    double weightedSum;           // 当前时段内 占用数×秒数 的累加
+
+    static int64_t toLocalSeconds(time_t time);
+    static int bucketOf(int64_t localSeconds);
+    void closePeriod();
+
+public:
+    explicit OccupancyForecaster(double alpha = 0.3);
+
+    /**
+     * @brief 记录占用数变化（入场/出场后调用）
+     * @param time 事件时间
+     * @param occupied 事件发生后的占用车位数
+     */
+    void record(time_t time, uint32_t occupied);
+
+    /**
+     * @brief 预测未来的占用数
+     * @param now 当前时间
+     * @param horizon 预测多少秒之后
+     * @param current 当前占用车位数
+     * @param capacity 总车位数，用于限定预测值并估计占满时间
+     * @return 预测结果
+     */
+    OccupancyForecast forecast(time_t now, time_t horizon, uint32_t current, uint32_t capacity) const;
+
+    /**
+     * @brief 以二进制格式写入学习结果
+     */
+    void write(std::ostream& out) const;
+
+    /**
+     * @brief 读取二进制格式的学习结果
+     * @return 是否读取成功
+     */
+    bool read(std::istream& in);
+};
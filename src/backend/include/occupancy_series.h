@@ -0,0 +1,116 @@
+/**
+ * @file occupancy_series.h
+ * @brief 占用车位数时间序列的声明，固定内存的多分辨率环形缓冲区
+ */
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 时间序列分辨率
+ */
+enum class OccupancyResolution {
+    Second,  // 每秒一个点，保留1小时
+    Minute,  // 每分钟一个点，保留1周
+    Hour     // 每小时一个点，保留1年
+};
+
+/**
+ * @struct OccupancyPoint
+ * @brief 一个时间段内的占用车位数
+ */
+struct OccupancyPoint {
+    time_t start;    // 时间段起点
+    uint32_t min;    // 时间段内的最少占用数
+    uint32_t max;    // 时间段内的最多占用数
+    uint32_t last;   // 时间段结束时的占用数
+};
+
+/**
+ * @class OccupancySeries
+ * @brief 多分辨率占用时间序列
+ *
+ * 三个分辨率各有一个固定长度的环形缓冲区（共约2.2万个槽位，约500KB）：
+ * 1. 每次入场/出场时同时更新三个缓冲区中当前时间段的槽位，复杂度O(1)
+ * 2. 槽位记录所属时间段编号，编号不符的槽位表示该时间段内没有事件，
+ *    查询时沿用前一个时间段结束时的占用数
+ * 3. 旧数据被新时间段自然覆盖，内存占用与运行时长和车流量无关
+ */
+class OccupancySeries {
+private:
+    struct Slot {
+        int64_t period = -1;  // 时间段编号（时间 / 分辨率秒数），-1表示空槽
+        uint32_t open = 0;    // 时间段开始时的占用数（即上一个事件之后的值）
+        uint32_t min = 0;
+        uint32_t max = 0;
+        uint32_t last = 0;
+    };
+
+    struct Tier {
+        time_t step;              // 每个时间段的秒数
+        std::vector<Slot> slots;  // 环形缓冲区
+    };
+
+    Tier tiers[3];        // 按OccupancyResolution顺序排列
+    uint32_t lastValue;   // 最近一次记录的占用数
+
+    const Tier& tierOf(OccupancyResolution resolution) const;
+
+public:
+    OccupancySeries();
+
+    /**
+     * @brief 记录某时刻的占用数（入场/出场后调用）
+     * @param time 事件时间
+     * @param occupied 事件发生后的占用车位数
+     */
+    void record(time_t time, uint32_t occupied);
+
+    /**
+     * @brief 查询时间序列
+     * @param resolution 分辨率
+     * @param from 起始时间
+     * @param to 结束时间（不包含）
+     * @param now 当前时间，用于限定保留窗口
+     * @return 按时间排序的点，没有事件的时间段沿用之前的占用数
+     */
+    std::vector<OccupancyPoint> query(OccupancyResolution resolution, time_t from, time_t to, time_t now) const;
+
+    /**
+     * @brief 获取某分辨率的时间段秒数
+     */
+    time_t stepOf(OccupancyResolution resolution) const { return tierOf(resolution).step; }
+
+    /**
+     * @brief 获取某分辨率的保留时长（秒）
+     */
+    time_t retentionOf(OccupancyResolution resolution) const;
+
+    /**
+     * @brief 以二进制格式写入三个环形缓冲区（固定大小，约500KB）
+     */
+    void write(std::ostream& out) const;
+
+    /**
+     * @brief 读取二进制格式的环形缓冲区
+     * @return 是否读取成功，失败时保留原有数据
+     */
+    bool read(std::istream& in);
+
+    /**
+     * @brief 保存到文件：uint32 "PKOS"、write()的内容、内容的uint32 CRC32C
+     * 先写临时文件再改名替换，写入中断时原文件保持完整
+     * @return 是否写入成功
+     */
+    bool save(const std::string& path) const;
+
+    /**
+     * @brief 从save()写入的文件载入
+     * @return 是否载入成功；文件不存在、损坏或分辨率不一致时返回false，保留原有数据
+     */
+    bool load(const std::string& path);
+};
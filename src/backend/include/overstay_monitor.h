@@ -0,0 +1,103 @@
+/**
+ * @file overstay_monitor.h
+ * @brief 超时停车监测器的声明，按到期时间维护在场车辆的有序队列
+ */
+#pragma once
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct OverstayEvent
+ * @brief 一次超时停车告警
+ */
+struct OverstayEvent {
+    std::string licensePlate;  // 车牌号
+    std::string type;          // 车型（小型/大型）
+    time_t entryTime;          // 入场时间
+    time_t deadline;           // 超时时刻（入场时间 + 该车型的停车时限）
+};
+
+/**
+ * @class OverstayMonitor
+ * @brief 超时停车监测器
+ *
+ * 在场车辆按(到期时间, 车牌号)排序保存在有序集合中，集合头部即最早到期的车辆：
+ * 1. 入场/出场时插入或删除，复杂度O(log n)
+ * 2. poll()只弹出已到期的车辆，每辆车只触发一次告警，复杂度O(k log n)
+ * 3. 不需要周期性扫描全部在场车辆，也不需要复制Vehicle对象
+ */
+class OverstayMonitor {
+private:
+    std::set<std::pair<time_t, std::string>> pending;  // 尚未超时的车辆，按到期时间排序
+    std::map<std::string, OverstayEvent> tracked;      // 车牌号到监测信息的映射（含已超时车辆）
+    std::map<std::string, OverstayEvent> overstaying;  // 已触发告警且仍在场的车辆
+    std::map<std::string, time_t> limits;              // 车型到停车时限（秒）的映射
+    time_t defaultLimit;                               // 未单独配置车型时使用的时限（秒）
+
+public:
+    /**
+     * @brief 构造函数
+     * @param defaultLimitSeconds 默认停车时限（默认24小时）
+     */
+    explicit OverstayMonitor(time_t defaultLimitSeconds = 24 * 3600);
+
+    /**
+     * @brief 设置某个车型的停车时限
+     * @param type 车型
+     * @param seconds 时限（秒），必须为正数
+     *
+     * 尚未告警的在场车辆会按新时限重新计算到期时间，
+     * 新时限下已经到期的车辆会在下一次poll()时触发告警；
+     * 已触发告警的车辆保持告警状态直到出场
+     */
+    void setLimit(const std::string& type, time_t seconds);
+
+    /**
+     * @brief 获取某个车型的停车时限
+     * @param type 车型
+     * @return 时限（秒）
+     */
+    time_t getLimit(const std::string& type) const;
+
+    /**
+     * @brief 获取所有单独配置过的车型时限
+     * @return 车型到时限（秒）的映射
+     */
+    const std::map<std::string, time_t>& getLimits() const { return limits; }
+
+    /**
+     * @brief 开始监测一辆车（车辆入场时调用）
+     * @param plate 车牌号
+     * @param type 车型
+     * @param entryTime 入场时间
+     */
+    void track(const std::string& plate, const std::string& type, time_t entryTime);
+
+    /**
+     * @brief 停止监测一辆车（车辆出场时调用）
+     * @param plate 车牌号
+     */
+    void untrack(const std::string& plate);
+
+    /**
+     * @brief 弹出所有在now之前到期的车辆
+     * @param now 当前时间
+     * @return 本次新触发的超时告警，按到期时间排序
+     */
+    std::vector<OverstayEvent> poll(time_t now);
+
+    /**
+     * @brief 获取已超时且仍在场的车辆
+     * @return 超时告警列表，按到期时间排序
+     */
+    std::vector<OverstayEvent> getOverstaying() const;
+
+    /**
+     * @brief 清空所有监测数据（保留时限配置）
+     */
+    void clear();
+};
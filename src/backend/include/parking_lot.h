@@ -4,9 +4,27 @@
  */
 #pragma once
 #include "vehicle.h"
+#include "overstay_monitor.h"
+#include "revenue_rollup.h"
+#include "occupancy_series.h"
+#include "quantile_histogram.h"
+#include "frequent_visitors.h"
+#include "occupancy_forecaster.h"
+#include "history_store.h"
+#include "storage_engine.h"
+#include "replication.h"
 #include <vector>
+#include <atomic>
 #include <map>
 #include <string>
+#include <mutex>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <utility>
+
+// (日期零点, 车型) 到停车时长和费用分布的映射
+using StayDistributionTable = std::map<std::pair<time_t, std::string>, StayDistribution>;
 
 /**
  * @class ParkingLot
@@ -16,33 +34,104 @@
  * 1. 管理车位资源（车位分配和释放）
  * 2. 处理车辆进出（入场登记和出场结算）
  * 3. 费率管理（不同类型车辆的收费标准）
- * 4. 数据持久化（停车记录的存储和加载）
+ * 4. 数据持久化（快照加入场/出场事件，存储引擎可选数据文件、追加日志或SQLite）
+ * 5. 超时停车监测（按车型配置停车时限）
+ * 6. 营收和车流量汇总（出场时增量更新）
+ * 7. 占用车位数时间序列（入场/出场时增量更新）
+ * 8. 按天、车型的停车时长和费用分布（出场时增量更新，随数据文件保存）
+ * 9. 常客统计（入场时增量更新，内存占用与车牌总数无关）
+ * 10. 占用预测（入场/出场时在线学习，随数据文件保存）
+ * 11. 已出场记录的分层列式存储（近期的段常驻内存，较早的段压缩保存在磁盘上按需加载）及车牌倒排表
+ * 12. 历史记录保留策略（超出保留期限的段及对应的汇总数据由后台逐步清理）
+ * 13. 主备复制（变更按提交顺序编号后交给复制发布者，备用节点应用主节点的记录）
+ * 14. 按车型的占用数（每次变化时通知占用监听者，如共享内存看板）
+ *
+ * 所有公有方法都在内部加锁，可被多个请求线程和后台线程同时调用
  */
 class ParkingLot {
 private:
-    std::map<std::string, Vehicle> vehicles;   // 车牌号到车辆信息的映射表
+    std::map<std::string, Vehicle> vehicles;   // 车牌号到在场车辆的映射表（已出场的记录在history中）
     size_t capacity;                           // 停车场总车位数
     size_t currentCount;                       // 当前占用的车位数
-    double hourlyRateSmall;                    // 小型车每小时费率（元/小时）
-    double hourlyRateLarge;                    // 大型车每小时费率（元/小时）
+    Cents hourlyRateSmall;                     // 小型车每小时费率（分/小时）
+    Cents hourlyRateLarge;                     // 大型车每小时费率（分/小时）
+    Cents totalRevenue;                        // 累计营收（分），出场时累加
     
     std::string dataFilePath;                  // 数据文件路径，用于持久化存储
+    std::unique_ptr<StorageEngine> storage;    // 存储引擎，保存快照和快照之后的事件
+
+    OverstayMonitor overstayMonitor;           // 在场车辆的超时到期队列
+    std::function<void(const OverstayEvent&)> overstayListener;  // 超时告警回调
+    RevenueRollup revenueRollup;               // 按小时/天/车型的营收和车次汇总
+    OccupancySeries occupancySeries;           // 占用车位数的多分辨率时间序列
+    bool occupancySeriesDirty = false;         // 上次保存后时间序列有变化
+    StayDistributionTable stayDistributions;   // 按天、车型的停车时长和费用分布
+    FrequentVisitorTracker frequentVisitors;   // 按天滚动窗口的常客Top-K
+    OccupancyForecaster occupancyForecaster;   // 按一周时段学习的占用预测器
+    HistoryStore history;                      // 已出场记录的分层列式存储（按出场顺序）
+    std::function<void(const ReplicationRecord&)> replicationListener;  // 复制记录的接收者（主节点）
+    uint64_t replicationPosition = 0;          // 最近一条复制记录的位置
+    std::map<std::string, size_t> occupiedByType;  // 各车型的在场车辆数（小型、大型始终存在）
+    std::function<void(size_t, size_t, const std::map<std::string, size_t>&)> occupancyListener;  // 占用变化回调
+    std::function<bool(const std::string&, std::function<void()>)> backgroundExecutor;  // 后台任务的执行者
+    std::atomic<bool> snapshotQueued{false};   // 已提交尚未开始的后台快照
+
+    mutable std::recursive_mutex dataMutex;    // 保护以上所有数据（saveData等方法会被内部重入调用）
+    std::mutex compactionMutex;                // 段合并与载入复制基准互斥（两者都在锁外写段目录）
+
+    // 将一条出场记录计入停车时长和费用分布
+    void recordStay(const std::string& type, time_t entryTime, time_t exitTime, Cents fee);
+    // 读取数据文件中的分布数据段
+    bool loadStayDistributions(std::istream& in);
+    // 从数据文件旁的.occupancy文件载入时间序列，文件缺失或损坏时从空序列开始
+    void loadOccupancySeries();
+    // 删除出场时间早于horizon所在那一天的分布数据
+    void pruneStayDistributions(time_t horizon);
+    // 登记入场，更新在场车辆和相关统计（不保存，入场和重放事件共用）
+    void applyEntry(const std::string& plate, const std::string& type, time_t entryTime);
+    // 按给定的出场时间和费用登记出场，记录移入历史记录（不保存，出场和重放事件共用）
+    void applyExit(std::map<std::string, Vehicle>::iterator it, time_t exitTime, Cents fee);
+    // 把事件追加到存储引擎，积累到快照间隔时写快照；返回事件序号
+    uint64_t persist(StorageEvent& event);
+    // 在锁外等待事件写入磁盘，后台写入失败时改为写快照
+    void waitDurable(uint64_t sequence);
+    // 重放存储引擎中序号大于after的事件
+    void replayEvents(const StorageEngine& source, uint64_t after);
+    // 按在场车辆重新统计各车型的占用数（载入快照后调用）
+    void recountOccupancy();
+    // 把当前占用数交给占用监听者（调用者持有锁）
+    void notifyOccupancy();
+    // 为复制记录分配位置并交给接收者（调用者持有锁）
+    void publish(ReplicationRecord& record);
+    // 按数据文件格式编码快照
+    std::string encodeSnapshot() const;
+    // 从快照恢复停车场状态，replay为true时再重放快照之后追加的事件
+    bool loadSnapshot(std::istream& in, bool replay);
 
 public:
+    static constexpr size_t MAX_CAPACITY = 1000000;  // 车位数上限，创建和载入时都按此检查
+    // 每小时费率上限（100万元）：按秒计费的中间结果在停车约2900年内不会溢出int64，
+    // 设置、创建、载入和应用复制记录时都按此检查
+    static constexpr Cents MAX_HOURLY_RATE = 100000000;
+    static bool isValidRate(Cents rate) { return rate > 0 && rate <= MAX_HOURLY_RATE; }
+
     /**
      * @brief 构造函数
      * @param capacity 停车场容量（默认100个车位）
-     * @param smallRate 小型车每小时费率（默认5.0元）
-     * @param largeRate 大型车每小时费率（默认8.0元）
-     * @param filePath 数据文件路径（默认为"parking_data.dat"）
+     * @param smallRate 小型车每小时费率（默认500分，即5元）
+     * @param largeRate 大型车每小时费率（默认800分，即8元）
+     * @param filePath 数据文件路径（默认为"parking_data.dat"），已出场记录的段文件保存在filePath + ".segments"目录
+     * @param storageEngine 存储引擎（file、log或sqlite，默认为file），见createStorageEngine()
+     * @throw std::invalid_argument 存储引擎名称不认识
      * 
      * 初始化停车场，并尝试从文件加载历史数据
      * 如果加载失败，则使用默认参数初始化
      */
     ParkingLot(size_t capacity = 100, 
-              double smallRate = 5.0, 
-              double largeRate = 8.0,
-              const std::string& filePath = "parking_data.dat");
+              Cents smallRate = 500, 
+              Cents largeRate = 800,
+              const std::string& filePath = "parking_data.dat",
+              const std::string& storageEngine = "file");
     
     /**
      * @brief 处理车辆入场
@@ -53,27 +142,43 @@ public:
      * 返回false的情况：
      * 1. 停车场已满
      * 2. 该车牌号的车辆已在场内
+     *
+     * 已出场的车辆再次入场时新增一条停车记录，之前的记录保留在历史中。
+     * 存储引擎成组提交时，释放锁后等到入场事件所在的提交组写入磁盘才返回
      */
     bool addVehicle(const std::string& plate, const std::string& type);
     
     /**
      * @brief 处理车辆出场
      * @param plate 车牌号
+     * @param outVehicle 成功时为本次出场的记录（车型、入场/出场时间和费用）
      * @return 是否成功移除
      * 
      * 返回false的情况：
      * 1. 找不到该车牌号的车辆
      * 2. 该车辆已经出场
+     *
+     * 与入场相同，等到出场事件写入磁盘才返回。等待期间同一车牌可能再次入场，
+     * 调用者应使用outVehicle，而不是出场后再按车牌查询
      */
-    bool removeVehicle(const std::string& plate);
+    bool removeVehicle(const std::string& plate, Vehicle& outVehicle);
     
     /**
      * @brief 查询车辆信息
      * @param plate 车牌号
-     * @param[out] outVehicle 输出参数，用于存储查询结果
+     * @param[out] outVehicle 输出参数，用于存储该车牌最近一次停车记录
      * @return 是否找到该车辆
      */
     bool queryVehicle(const std::string& plate, Vehicle& outVehicle) const;
+
+    /**
+     * @brief 查询某个车牌的全部停车记录
+     * @param plate 车牌号
+     * @return 按入场先后排列的各次停车记录，车辆在场时最后一条的出场时间为0
+     *
+     * 已出场的记录通过列式存储中的车牌倒排表定位，耗时与该车牌的记录数成正比
+     */
+    std::vector<Vehicle> getVehicleVisits(const std::string& plate) const;
     
     /**
      * @brief 获取空余车位数
@@ -88,35 +193,41 @@ public:
     size_t getOccupiedSpaces() const;
     
     /**
-     * @brief 保存停车场数据到文件
+     * @brief 保存停车场数据的快照
      * @return 是否成功保存
      * 
-     * 将当前所有数据（包括配置和车辆信息）保存到文件
+     * 将配置、在场车辆、汇总数据和历史记录中未封存的段作为快照交给存储引擎，引擎随后丢弃之前的事件；
+     * 已封存的段在封存时已写入段目录，不随每次保存重写。
+     * 入场、出场只追加事件，积累到引擎的快照间隔才调用本方法（数据文件引擎每次都调用）
      */
     bool saveData() const;
 
     /**
-     * @brief 从文件加载停车场数据
+     * @brief 从存储引擎加载停车场数据
      * @return 是否成功加载
      * 
-     * 从文件恢复停车场状态，包括：
+     * 从快照恢复停车场状态，包括：
      * 1. 场地配置（容量、费率等）
-     * 2. 车辆信息（在场车辆和历史记录）
+     * 2. 在场车辆
+     * 3. 历史记录（段目录中的段文件和数据文件中未封存的段；旧版本文件中的已出场记录导入段目录）
+     * 之后按原来的时间和费用重放快照之后的入场、出场事件
      */
     bool loadData();
     
     /**
      * @brief 更新停车费率
-     * @param smallRate 小型车新费率
-     * @param largeRate 大型车新费率
+     * @param smallRate 小型车新费率（分/小时）
+     * @param largeRate 大型车新费率（分/小时）
      * 
      * 更新费率后会自动保存到文件
      */
-    void setRate(double smallRate, double largeRate);
+    void setRate(Cents smallRate, Cents largeRate);
     
     /**
      * @brief 获取历史停车记录
-     * @return 包含所有已离场车辆信息的vector
+     * @return 包含所有已离场车辆信息的vector，按出场先后排列
+     *
+     * 会把冷段逐一从磁盘加载，记录很多时应改用scanHistory()或导出接口
      */
     std::vector<Vehicle> getHistoryVehicles() const;
     
@@ -126,15 +237,237 @@ public:
      */
     std::vector<Vehicle> getCurrentVehicles() const;
 
+    /**
+     * @brief 分批遍历指定时间段内的历史停车记录
+     * @param from 出场时间下限（包含）
+     * @param to 出场时间上限（不包含）
+     * @param batchSize 每批最多检查的记录数
+     * @param consumer 处理一批记录，返回false时停止遍历
+     *
+     * 只在取快照时加锁，之后在锁外逐段读取（与时间段不相交的冷段不加载），按出场先后交给consumer，
+     * 内存占用与历史记录总数无关，导出期间也不会阻塞入场/出场
+     */
+    void scanHistory(time_t from, time_t to, size_t batchSize,
+                     const std::function<bool(const std::vector<Vehicle>&)>& consumer) const;
+
+    /**
+     * @brief 获取列式历史记录的只读快照
+     *
+     * 快照与存储共享已封存的段，取快照之后可以在锁外读取（冷段按需加载），用于Arrow/Parquet导出和聚合查询
+     * @param withPlates 是否复制车牌字典
+     */
+    HistorySnapshot getHistorySnapshot(bool withPlates = true) const;
+
+    /**
+     * @brief 设置历史记录的分层参数
+     * @param hotWindow 热段窗口（秒），最晚出场时间更早的段只保存在磁盘上
+     * @param cacheBytes 按需加载的冷段缓存的内存预算（字节）
+     *
+     * 热段窗口随数据文件保存
+     */
+    void setHistoryTiering(time_t hotWindow, uint64_t cacheBytes);
+
+    /**
+     * @brief 设置历史记录的保留期限
+     * @param retention 保留期限（秒），0表示永久保留；随数据文件保存
+     *
+     * 超出期限的记录由expireHistory()在后台清理
+     */
+    void setHistoryRetention(time_t retention);
+
+    /**
+     * @brief 执行一步历史记录的后台清理
+     * @param now 当前时间
+     * @return 是否还有待处理的工作，后台线程应继续调用
+     *
+     * 每步至多清理一个段并整理一批倒排表，只在这一步内持有锁。
+     * 清理的记录同时从营收汇总和停车时长分布中删除（按时间桶对齐）；
+     * 累计营收不变，已清理记录的费用随数据文件保存，加载时计入
+     */
+    bool expireHistory(time_t now);
+
+    /**
+     * @brief 执行一次历史记录段的后台合并
+     * @param now 当前时间
+     * @return 是否完成了一次合并，后台线程应继续调用
+     *
+     * 只在选出源段和替换源段时持有锁，读取源段、合并和写入段文件在锁外进行；
+     * 替换后立即保存数据文件，之后的清理步骤才删除源段文件
+     */
+    bool compactHistory(time_t now);
+
+    /**
+     * @brief 查找车牌在历史记录字典中的编号，用于按车牌过滤的聚合查询
+     * @return 没有该车牌的记录时返回-1
+     */
+    int32_t findHistoryPlate(const std::string& plate) const;
+
+    /**
+     * @brief 获取历史记录各层存储的统计信息
+     */
+    HistoryStorageStats getHistoryStorageStats() const;
+
+    /**
+     * @brief 注册复制记录的接收者（主节点的复制发布者）
+     * @param listener 在锁内按提交顺序调用，不应做I/O
+     */
+    void setReplicationListener(std::function<void(const ReplicationRecord&)> listener);
+
+    /**
+     * @brief 注册占用变化回调
+     * @param listener 参数为总车位数、已占用车位数和各车型的在场车辆数；
+     *                 注册时立即调用一次，之后每次入场、出场（包括应用复制记录）和载入复制基准后调用。
+     *                 在锁内调用，调用之间不会并发，不应做I/O
+     */
+    void setOccupancyListener(std::function<void(size_t, size_t, const std::map<std::string, size_t>&)> listener);
+
+    /**
+     * @brief 注册后台任务的执行者
+     * @param executor 参数为任务类型和任务，返回false表示未接受（由调用者自己执行）。
+     *                 注册后，事件已写入日志的存储引擎（log、sqlite）积累到快照间隔时，
+     *                 快照交给执行者在后台写入，不再由触发的入场/出场请求同步写入；
+     *                 数据文件引擎的快照就是持久化本身，仍同步写入
+     */
+    void setBackgroundExecutor(std::function<bool(const std::string&, std::function<void()>)> executor);
+
+    /**
+     * @brief 最近一条复制记录的位置（备用节点为已应用的位置）
+     */
+    uint64_t getReplicationPosition() const;
+
+    /**
+     * @brief 取当前复制位置上的基准，在锁内编码快照并固定已封存的段
+     */
+    ReplicationBase getReplicationBase() const;
+
+    /**
+     * @brief 按顺序应用主节点的一批复制记录（备用节点）
+     *
+     * 入场、出场按记录中的时间和费用应用并追加到本地存储引擎，与重放事件相同，
+     * 与本地状态不一致的入场、出场被跳过；整批在一次加锁内应用，需要时只写一次快照
+     */
+    void applyReplicated(const std::vector<ReplicationRecord>& records);
+
+    /**
+     * @brief 以主节点的基准替换本地状态（备用节点）
+     * @param position 基准的复制位置
+     * @param snapshot 数据文件格式的快照
+     * @param segmentDirectory 暂存基准段文件的目录，其中的段文件被移入本地段目录
+     * @return 快照无法识别时返回false，此时本地段文件已被替换，应重新接收基准
+     *
+     * 载入后立即以本地存储引擎写快照，之前的本地事件随之丢弃
+     */
+    bool loadReplicationBase(uint64_t position, const std::string& snapshot, const std::string& segmentDirectory);
+
     /**
      * @brief 获取小型车费率
-     * @return 小型车每小时费率
+     * @return 小型车每小时费率（分/小时）
      */
-    double getSmallRate() const { return hourlyRateSmall; }
+    Cents getSmallRate() const;
 
     /**
      * @brief 获取大型车费率
-     * @return 大型车每小时费率
+     * @return 大型车每小时费率（分/小时）
+     */
+    Cents getLargeRate() const;
+
+    /**
+     * @brief 获取累计营收
+     * @return 所有已出场车辆的费用总和（分），整数累加无舍入误差
+     */
+    Cents getTotalRevenue() const;
+
+    /**
+     * @brief 查询营收和车次汇总
+     * @param granularity 汇总粒度（小时/天）
+     * @param from 起始时间
+     * @param to 结束时间
+     * @return 按时间排序的汇总桶，不扫描历史记录
+     */
+    std::vector<RollupBucket> getRevenueRollup(RollupGranularity granularity, time_t from, time_t to) const;
+
+    /**
+     * @brief 查询占用车位数时间序列
+     * @param resolution 分辨率（秒/分钟/小时）
+     * @param from 起始时间
+     * @param to 结束时间（不包含）
+     * @return 按时间排序的点，超出该分辨率保留时长的部分被截去
+     */
+    std::vector<OccupancyPoint> getOccupancySeries(OccupancyResolution resolution, time_t from, time_t to) const;
+
+    /**
+     * @brief 获取某分辨率时间序列的保留时长
+     * @param resolution 分辨率
+     * @return 保留时长（秒）
+     */
+    time_t getOccupancyRetention(OccupancyResolution resolution) const;
+
+    /**
+     * @brief 把占用时间序列保存到数据文件旁的.occupancy文件
+     * @return 是否写入了文件；上次保存后没有变化或写入失败时返回false
+     *
+     * 时间序列是三个固定大小的环形缓冲区（约500KB），不随每个事件的快照写入，
+     * 由后台任务定期调用；在锁内复制缓冲区，在锁外写文件。进程异常退出时丢失上次保存之后的点
+     */
+    bool saveOccupancySeries();
+
+    /**
+     * @brief 查询按天、车型的停车时长和费用分布
+     * @param from 起始时间（包含from所在的一天）
+     * @param to 结束时间（不包含）
+     * @return 范围内每天每个车型的分布，调用者可按需合并
+     */
+    StayDistributionTable getStayDistributions(time_t from, time_t to) const;
+
+    /**
+     * @brief 查询最近若干天入场次数最多的车牌
+     * @param k 返回的车牌数
+     * @param windowDays 窗口天数（包含今天，最多31天）
+     * @return 按入场次数从多到少排列，次数为Count-Min Sketch估计值
+     */
+    std::vector<VisitorCount> getFrequentVisitors(size_t k, int windowDays) const;
+
+    /**
+     * @brief 预测未来的占用车位数
+     * @param horizon 预测多少秒之后
+     * @return 预测的占用数、预计占满时间和历史样本数
+     */
+    OccupancyForecast forecastOccupancy(time_t horizon) const;
+
+    /**
+     * @brief 设置某个车型的最长停车时限
+     * @param type 车型（小型/大型）
+     * @param seconds 时限（秒）
+     */
+    void setOverstayLimit(const std::string& type, time_t seconds);
+
+    /**
+     * @brief 获取某个车型的最长停车时限
+     * @param type 车型（小型/大型）
+     * @return 时限（秒）
+     */
+    time_t getOverstayLimit(const std::string& type) const;
+
+    /**
+     * @brief 注册超时告警回调
+     * @param listener 每辆车首次超时时调用一次
+     *
+     * 回调在checkOverstays()的调用线程中执行，执行时不持有停车场的锁
+     */
+    void setOverstayListener(std::function<void(const OverstayEvent&)> listener);
+
+    /**
+     * @brief 检查并触发到期的超时告警
+     * @param now 当前时间
+     * @return 本次新触发的告警
+     *
+     * 只处理到期队列头部已到期的车辆，复杂度与新告警数量相关，与在场车辆数无关
+     */
+    std::vector<OverstayEvent> checkOverstays(time_t now);
+
+    /**
+     * @brief 获取已超时且仍在场的车辆
+     * @return 超时告警列表，按超时时刻排序
      */
-    double getLargeRate() const { return hourlyRateLarge; }
+    std::vector<OverstayEvent> getOverstayingVehicles() const;
 };
\ No newline at end of file
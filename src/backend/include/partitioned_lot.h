@@ -0,0 +1,130 @@
+/**
+ * @file partitioned_lot.h
+ * @brief 按车牌哈希分区的停车场：多个互不共享状态的ParkingLot合起来作为一个停车场对外服务
+ */
+#pragma once
+#include "parking_lot.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @class PartitionedLot
+ * @brief 分区停车场
+ *
+ * 每个分区是一个完整的ParkingLot，拥有自己的锁、存储引擎（事件日志）、段目录和各类统计，
+ * 车辆按车牌的FNV-1a哈希固定落在一个分区，入场、出场和按车牌查询只访问该分区，
+ * 不同分区的请求互不加锁，入场/出场吞吐量随分区数（和CPU核数）增加。
+ *
+ * 需要全局状态的操作很少，单独处理：
+ * - 容量：分区的容量都设为整个停车场的容量，入场前在原子计数器上预占一个车位，
+ *   入场失败（车辆已在场）时归还，出场时释放；
+ * - 费率、停车时限、热段窗口和保留期限：依次写入每个分区（冷段缓存预算按分区数均分）；
+ * - 查询：状态、在场车辆、历史记录、营收汇总、停车时长分布、常客和占用预测由各分区的结果合并；
+ * - 占用时间序列：各分区的极值出现在不同时刻，不能相加，由停车场自己记录：
+ *   各分区占用数变化时（入场、出场、应用复制记录）回调，在停车场的锁内更新该分区的占用数，
+ *   按全部分区之和记录一个点，min/max是准确值。该序列保存在seriesFile中。
+ *
+ * 只有一个分区时所有方法直接转发给该分区，行为与单个ParkingLot完全相同。
+ * 分区数在创建时确定，之后不能修改（车辆的分区由哈希决定，修改需要重新分布全部数据）
+ */
+class PartitionedLot {
+private:
+    std::vector<std::unique_ptr<ParkingLot>> partitions;
+    size_t capacity;                  // 整个停车场的容量
+    std::atomic<size_t> occupied;     // 已占用（含正在入场的预占）的车位数，只在多个分区时使用
+
+    // 以下只在多个分区时使用
+    std::string seriesFile;                  // 整个停车场的占用时间序列文件
+    mutable std::mutex seriesMutex;          // 保护以下数据，在分区的锁内获取
+    OccupancySeries series;                  // 按全部分区的占用数之和记录
+    std::vector<size_t> partitionOccupied;   // 各分区最近一次回调时的占用数
+    size_t seriesOccupied = 0;               // partitionOccupied之和
+    bool seriesDirty = false;                // 上次保存后时间序列有变化
+
+    void onPartitionOccupancy(size_t index, size_t partitionOccupancy);
+
+public:
+    static constexpr size_t MAX_PARTITIONS = 64;
+
+    /**
+     * @param partitions 各分区，顺序即分区编号，不能为空；多个分区时各分区的容量应为整个停车场的容量
+     * @param seriesFile 多个分区时整个停车场的占用时间序列文件，为空时不保存
+     *
+     * 多个分区时占用各分区的占用变化回调（setOccupancyListener）
+     */
+    explicit PartitionedLot(std::vector<std::unique_ptr<ParkingLot>> partitions, const std::string& seriesFile = "");
+
+    /**
+     * @brief 由单个停车场构成（不分区）
+     */
+    explicit PartitionedLot(std::unique_ptr<ParkingLot> lot);
+
+    ~PartitionedLot();
+
+    PartitionedLot(const PartitionedLot&) = delete;
+    PartitionedLot& operator=(const PartitionedLot&) = delete;
+
+    /**
+     * @brief 车牌所在的分区编号
+     */
+    static size_t partitionIndex(const std::string& plate, size_t partitionCount);
+
+    size_t partitionCount() const { return partitions.size(); }
+    ParkingLot& partition(size_t index) { return *partitions[index]; }
+    const ParkingLot& partition(size_t index) const { return *partitions[index]; }
+    ParkingLot& partitionOf(const std::string& plate) { return *partitions[partitionIndex(plate, partitions.size())]; }
+    const ParkingLot& partitionOf(const std::string& plate) const {
+        return *partitions[partitionIndex(plate, partitions.size())];
+    }
+
+    // 以下方法与ParkingLot的同名方法含义相同
+
+    bool addVehicle(const std::string& plate, const std::string& type);
+    bool removeVehicle(const std::string& plate, Vehicle& outVehicle);
+    bool queryVehicle(const std::string& plate, Vehicle& outVehicle) const;
+    std::vector<Vehicle> getVehicleVisits(const std::string& plate) const;
+    size_t getAvailableSpaces() const;
+    size_t getOccupiedSpaces() const;
+    bool saveData() const;
+    void setRate(Cents smallRate, Cents largeRate);
+    Cents getSmallRate() const;
+    Cents getLargeRate() const;
+    Cents getTotalRevenue() const;
+
+    // 按出场时间排序
+    std::vector<Vehicle> getHistoryVehicles() const;
+    // 按车牌排序
+    std::vector<Vehicle> getCurrentVehicles() const;
+    // 依次遍历各分区，每个分区内按出场先后
+    void scanHistory(time_t from, time_t to, size_t batchSize,
+                     const std::function<bool(const std::vector<Vehicle>&)>& consumer) const;
+
+    void setHistoryTiering(time_t hotWindow, uint64_t cacheBytes);
+    void setHistoryRetention(time_t retention);
+    bool expireHistory(time_t now);
+    bool compactHistory(time_t now);
+    HistoryStorageStats getHistoryStorageStats() const;
+
+    std::vector<RollupBucket> getRevenueRollup(RollupGranularity granularity, time_t from, time_t to) const;
+    std::vector<OccupancyPoint> getOccupancySeries(OccupancyResolution resolution, time_t from, time_t to) const;
+    time_t getOccupancyRetention(OccupancyResolution resolution) const;
+    // 只有一个分区时由该分区保存，否则保存整个停车场的时间序列
+    bool saveOccupancySeries();
+    StayDistributionTable getStayDistributions(time_t from, time_t to) const;
+    std::vector<VisitorCount> getFrequentVisitors(size_t k, int windowDays) const;
+    OccupancyForecast forecastOccupancy(time_t horizon) const;
+
+    void setOverstayLimit(const std::string& type, time_t seconds);
+    time_t getOverstayLimit(const std::string& type) const;
+    void setOverstayListener(std::function<void(const OverstayEvent&)> listener);
+    void setBackgroundExecutor(std::function<bool(const std::string&, std::function<void()>)> executor);
+    std::vector<OverstayEvent> checkOverstays(time_t now);
+    // 按到期时间排序
+    std::vector<OverstayEvent> getOverstayingVehicles() const;
+};
@@ -0,0 +1,87 @@
+/**
+ * @file quantile_histogram.h
+ * @brief 可合并的对数分桶直方图声明，用于流式估计停车时长和费用的分位数
+ */
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+
+/**
+ * @class QuantileHistogram
+ * @brief HDR风格的对数-线性分桶直方图
+ *
+ * 非负整数按以下规则映射到桶：
+ * 1. 小于256的值每个值一个桶（精确）
+ * 2. 更大的值在每个2的幂区间内再均分为128个桶，相对误差小于0.8%
+ *
+ * 只保存非空桶，停车时长和费用通常集中在少数几个数量级内，
+ * 每个直方图只有几百个桶。两个直方图按桶相加即可合并，
+ * 因此可以按天、按车型分别统计，查询时再合并任意时间范围
+ */
+class QuantileHistogram {
+private:
+    static const int PRECISION_BITS = 8;  // 线性区间大小为2^8
+
+    std::map<uint32_t, uint64_t> buckets;  // 桶编号到计数的映射（只保存非空桶）
+    uint64_t totalCount;                   // 样本总数
+
+    static uint32_t bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(uint32_t index);
+    static uint64_t bucketWidth(uint32_t index);
+
+public:
+    QuantileHistogram();
+
+    /**
+     * @brief 记录一个样本
+     * @param value 样本值（负数按0处理）
+     */
+    void record(int64_t value);
+
+    /**
+     * @brief 合并另一个直方图
+     * @param other 要合并的直方图
+     */
+    void merge(const QuantileHistogram& other);
+
+    /**
+     * @brief 估计分位数
+     * @param q 分位点（0到1之间，例如0.99）
+     * @return 分位数的估计值（所在桶的中点），没有样本时返回0
+     */
+    int64_t quantile(double q) const;
+
+    /**
+     * @brief 获取样本总数
+     */
+    uint64_t count() const { return totalCount; }
+
+    /**
+     * @brief 以二进制格式写入输出流
+     * @param out 输出流
+     */
+    void write(std::ostream& out) const;
+
+    /**
+     * @brief 从输入流读取二进制格式的直方图
+     * @param in 输入流
+     * @return 是否读取成功
+     */
+    bool read(std::istream& in);
+};
+
+/**
+ * @struct StayDistribution
+ * @brief 一组停车记录的时长和费用分布
+ */
+struct StayDistribution {
+    QuantileHistogram duration;  // 停车时长（秒）
+    QuantileHistogram fee;       // 费用（分）
+
+    void merge(const StayDistribution& other) {
+        duration.merge(other.duration);
+        fee.merge(other.fee);
+    }
+};
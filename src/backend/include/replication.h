@@ -0,0 +1,213 @@
+/**
+ * @file replication.h
+ * @brief 主备复制：主节点通过本地socket发布变更日志，备用节点跟随并应用到自己的停车场，可随时提升为主节点
+ */
+#pragma once
+#include "money.h"
+#include "history_store.h"
+#include "storage_engine.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ParkingLot;
+
+/**
+ * @enum ReplicationRecordKind
+ * @brief 复制记录类型
+ */
+enum class ReplicationRecordKind : uint8_t {
+    Entry = 1,             // 车辆入场
+    Exit = 2,              // 车辆出场
+    Rates = 3,             // 修改费率
+    HistoryTiering = 4,    // 修改热段窗口和冷段缓存预算
+    HistoryRetention = 5,  // 修改保留期限
+    OverstayLimit = 6      // 修改某车型的停车时限
+};
+
+/**
+ * @struct ReplicationRecord
+ * @brief 主节点的一次变更，按提交顺序编号
+ *
+ * 入场、出场与存储引擎中的事件相同（备用节点按原来的时间和费用应用，不重新计费）；
+ * 设置类的变更在主节点只写快照、不产生事件，复制时单独作为记录发送
+ */
+struct ReplicationRecord {
+    uint64_t position = 0;       // 复制位置，由ParkingLot在锁内分配，从1开始递增
+    int64_t committedAt = 0;     // 主节点提交时间（Unix毫秒），用于计算复制延迟
+    ReplicationRecordKind kind = ReplicationRecordKind::Entry;
+    StorageEvent event;          // 入场、出场（sequence不复制，由备用节点自己的引擎分配）
+    Cents smallRate = 0;         // 费率
+    Cents largeRate = 0;
+    time_t hotWindow = 0;        // 热段窗口
+    uint64_t cacheBytes = 0;     // 冷段缓存预算
+    time_t retention = 0;        // 保留期限
+    std::string limitType;       // 停车时限的车型
+    time_t limit = 0;            // 停车时限（秒）
+};
+
+/**
+ * @struct ReplicationBase
+ * @brief 备用节点首次连接（或落后太多）时的基准：某个复制位置上的快照和段文件
+ */
+struct ReplicationBase {
+    uint64_t position = 0;     // 快照包含位置不超过它的全部记录
+    std::string snapshot;      // 数据文件格式的快照
+    HistorySnapshot history;   // 快照引用的已封存段；持有期间段文件不会被清理或合并删除
+};
+
+/**
+ * @struct ReplicationFollowerStatus
+ * @brief 主节点上一个已连接的备用节点
+ */
+struct ReplicationFollowerStatus {
+    uint64_t sentPosition = 0;   // 已发送的复制位置
+    time_t connectedAt = 0;      // 连接时间
+    bool syncingBase = false;    // 是否正在发送基准
+};
+
+/**
+ * @struct ReplicationStatus
+ * @brief 复制状态和延迟
+ */
+struct ReplicationStatus {
+    bool standby = false;               // 是否为备用节点
+    std::string socketPath;             // 主节点监听（备用节点连接）的socket路径
+    uint64_t epoch = 0;                 // 主节点本次运行的标识，备用节点重连时据此判断能否续传
+    uint64_t position = 0;              // 本节点已应用的复制位置
+
+    // 主节点
+    uint64_t backlogFirst = 0;          // 内存中保留的最早一条记录的位置，更早的需要重新发送基准
+    std::vector<ReplicationFollowerStatus> followers;
+
+    // 备用节点
+    bool connected = false;             // 是否已连接主节点
+    uint64_t primaryPosition = 0;       // 主节点最近报告的位置
+    uint64_t lagRecords = 0;            // 落后主节点的记录数
+    int64_t lagMillis = 0;              // 最近应用的记录从主节点提交到本节点应用的时间
+    int64_t lastContactMillis = -1;     // 距离上次收到主节点消息的时间，从未连接时为-1
+    uint64_t baseSyncs = 0;             // 接收基准的次数
+    uint64_t appliedRecords = 0;        // 本次运行应用的记录数
+};
+
+/**
+ * @class ReplicationPublisher
+ * @brief 主节点：在本地socket上发布复制记录
+ *
+ * ParkingLot在锁内把每条记录交给append()，放入内存中的积压队列（最多BACKLOG_RECORDS条），
+ * 每个备用节点由一个发送线程从积压队列中按位置读取，成批写入socket，空闲时每秒发送心跳。
+ * 备用节点连接时报告它上次的主节点标识和位置，积压队列中还有之后的全部记录时直接续传，
+ * 否则先发送基准：在锁内编码快照并取历史记录快照（固定段文件），之后在锁外读取段文件发送。
+ * 备用节点落后超出积压队列时断开，它重连后重新接收基准
+ */
+class ReplicationPublisher {
+private:
+    struct Follower {
+        int fd = -1;
+        ReplicationFollowerStatus status;
+        std::thread sender;
+        bool finished = false;   // 发送线程已退出，可以回收
+    };
+
+    ParkingLot& lot;
+    std::string socketPath;
+    uint64_t epoch;
+    int listenFd = -1;
+    std::thread acceptor;
+
+    mutable std::mutex mutex;                   // 保护以下成员
+    std::condition_variable appended;           // 有新记录，或要求退出
+    std::deque<ReplicationRecord> backlog;      // 最近的记录，按位置递增
+    uint64_t lastPosition = 0;                  // 最新一条记录的位置
+    std::list<Follower> followers;
+    bool stopping = false;
+
+    void runAcceptor();
+    void runSender(Follower& follower);
+    // 发送基准，返回基准的位置；连接断开时返回false
+    bool sendBase(Follower& follower, uint64_t& position);
+    // 回收已退出的发送线程（调用者持有mutex）
+    void reapFollowers();
+
+public:
+    static constexpr size_t BACKLOG_RECORDS = 65536;       // 积压队列保留的记录数
+    static constexpr size_t BATCH_RECORDS = 1024;          // 每次写入socket的最多记录数
+    static constexpr int HEARTBEAT_MILLIS = 1000;          // 空闲时的心跳间隔
+
+    /**
+     * @param lot 停车场，构造后所有变更都交给本对象发布
+     * @param socketPath Unix域socket路径，已存在的文件（上次运行残留）被删除
+     * @throw std::runtime_error 无法监听socket
+     */
+    ReplicationPublisher(ParkingLot& lot, const std::string& socketPath);
+    ~ReplicationPublisher();
+
+    ReplicationPublisher(const ReplicationPublisher&) = delete;
+    ReplicationPublisher& operator=(const ReplicationPublisher&) = delete;
+
+    /**
+     * @brief 加入一条记录，在ParkingLot的锁内调用，不做I/O
+     */
+    void append(const ReplicationRecord& record);
+
+    /**
+     * @brief 停止监听，断开全部备用节点
+     */
+    void stop();
+
+    ReplicationStatus status() const;
+};
+
+/**
+ * @class ReplicationFollower
+ * @brief 备用节点：连接主节点的socket，把收到的记录应用到本地停车场
+ *
+ * 断开后每秒重连一次，同一次运行内报告上次的主节点标识和位置以便续传。
+ * 基准中的段文件先写入暂存目录，全部收到后由ParkingLot::loadReplicationBase()一次替换本地状态。
+ * 记录照常写入本地存储引擎，提升后直接以本地数据继续服务
+ */
+class ReplicationFollower {
+private:
+    ParkingLot& lot;
+    std::string socketPath;
+    std::string stagingDirectory;
+    std::thread receiver;
+    std::atomic<bool> running{true};
+
+    mutable std::mutex mutex;           // 保护以下成员
+    int fd = -1;                        // 当前连接，stop()时shutdown以唤醒接收线程
+    int64_t lastContactAt = 0;          // 上次收到主节点消息的时刻（Unix毫秒）
+    ReplicationStatus state;
+
+    void run();
+    // 处理一次连接，直到断开或停止
+    void follow(int connection);
+
+public:
+    static constexpr int RECEIVE_TIMEOUT_SECONDS = 5;   // 超过这么久没有收到心跳时断开重连
+
+    /**
+     * @param lot 本地停车场
+     * @param socketPath 主节点的socket路径
+     * @param stagingDirectory 接收基准时暂存段文件的目录
+     */
+    ReplicationFollower(ParkingLot& lot, const std::string& socketPath, const std::string& stagingDirectory);
+    ~ReplicationFollower();
+
+    ReplicationFollower(const ReplicationFollower&) = delete;
+    ReplicationFollower& operator=(const ReplicationFollower&) = delete;
+
+    /**
+     * @brief 断开主节点并停止接收，返回后不会再应用任何记录
+     */
+    void stop();
+
+    ReplicationStatus status() const;
+};
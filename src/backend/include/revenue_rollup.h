@@ -0,0 +1,97 @@
+/**
+ * @file revenue_rollup.h
+ * @brief 营收和车流量的增量汇总表声明，按小时/天和车型统计
+ */
+#pragma once
+#include "money.h"
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 汇总粒度
+ */
+enum class RollupGranularity {
+    Hour,  // 按小时（本地时间整点）
+    Day    // 按天（本地时间零点）
+};
+
+/**
+ * @struct RollupCounters
+ * @brief 一组汇总计数
+ */
+struct RollupCounters {
+    uint64_t visits = 0;  // 出场车次
+    Cents revenue = 0;    // 营收（分）
+};
+
+/**
+ * @struct RollupBucket
+ * @brief 一个时间桶内的汇总数据
+ */
+struct RollupBucket {
+    time_t start = 0;                               // 时间桶起点（本地时间整点或零点）
+    RollupCounters total;                           // 全部车型合计
+    std::map<std::string, RollupCounters> byType;   // 按车型细分
+};
+
+/**
+ * @class RevenueRollup
+ * @brief 营收汇总表
+ *
+ * 每次车辆出场时按出场时间累加到对应的小时桶和天桶：
+ * 1. 出场时间基本单调递增，新数据总是落在最后一个桶或其后，
+ *    利用有序表尾部的插入提示，每次更新为均摊O(1)
+ * 2. 查询只遍历范围内的桶，与历史记录条数无关
+ * 3. 缓存上一次出场时间所在的小时桶，同一小时内的出场不再做本地时间转换（加载大量历史记录时是主要开销）
+ */
+class RevenueRollup {
+private:
+    std::map<time_t, RollupBucket> hourly;  // 小时桶，按起点排序
+    std::map<time_t, RollupBucket> daily;   // 天桶，按起点排序
+    time_t cachedHour = 0;                  // 上一次出场时间所在小时桶的起点
+    time_t cachedDay = 0;                   // 该小时所在天桶的起点
+    bool hasCachedHour = false;             // cachedHour是否有效
+
+    // 找到（或创建）起点为start的桶
+    static RollupBucket& bucketAt(std::map<time_t, RollupBucket>& table, time_t start);
+
+public:
+    /**
+     * @brief 计算时间点所在时间桶的起点
+     * @param granularity 汇总粒度
+     * @param time 时间点
+     * @return 本地时间的整点（Hour）或零点（Day）
+     */
+    static time_t bucketStart(RollupGranularity granularity, time_t time);
+
+    /**
+     * @brief 记录一次出场
+     * @param type 车型
+     * @param exitTime 出场时间
+     * @param fee 费用（分）
+     */
+    void record(const std::string& type, time_t exitTime, Cents fee);
+
+    /**
+     * @brief 查询时间范围内的汇总数据
+     * @param granularity 汇总粒度
+     * @param from 起始时间（包含from所在的桶）
+     * @param to 结束时间（不包含起点不早于to的桶）
+     * @return 按时间排序的非空时间桶
+     */
+    std::vector<RollupBucket> query(RollupGranularity granularity, time_t from, time_t to) const;
+
+    /**
+     * @brief 删除早于before所在时间桶的汇总数据
+     * @param before 时间点，所在的小时桶、天桶及之后的桶保留
+     */
+    void prune(time_t before);
+
+    /**
+     * @brief 清空所有汇总数据
+     */
+    void clear();
+};
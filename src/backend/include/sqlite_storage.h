@@ -0,0 +1,57 @@
+/**
+ * @file sqlite_storage.h
+ * @brief 基于嵌入式SQLite（WAL模式）的存储引擎
+ */
+#pragma once
+#include "storage_engine.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/**
+ * @class SqliteStorage
+ * @brief SQLite引擎：快照和事件都保存在path + ".sqlite"数据库中
+ *
+ * 数据库使用WAL日志模式（synchronous=NORMAL），每个事件是一次只追加WAL的小事务；
+ * 快照保存在snapshot表（只有一行），事件保存在events表（按序号为主键，另有车牌索引），
+ * 写快照时在同一事务中替换快照并删除已包含的事件。
+ * 数据库中还没有快照时读取数据文件，从其他引擎切换过来时不丢失数据
+ */
+class SqliteStorage : public StorageEngine {
+private:
+    FileStorage legacy;                  // 数据库中没有快照时读取的数据文件
+    sqlite3* db = nullptr;
+    sqlite3_stmt* insertEvent = nullptr; // 预编译的插入语句
+    uint64_t last = 0;
+    size_t pending = 0;
+    size_t interval;
+    bool hasStoredSnapshot = false;
+
+    // 执行不返回结果的语句
+    bool execute(const char* sql);
+
+public:
+    static const size_t DEFAULT_SNAPSHOT_INTERVAL = 4096;
+
+    /**
+     * @param path 数据文件路径
+     * @param interval 积累多少个事件后写一次快照
+     * @throw std::runtime_error 数据库无法打开或初始化
+     */
+    explicit SqliteStorage(const std::string& path, size_t interval = DEFAULT_SNAPSHOT_INTERVAL);
+    ~SqliteStorage() override;
+
+    SqliteStorage(const SqliteStorage&) = delete;
+    SqliteStorage& operator=(const SqliteStorage&) = delete;
+
+    std::string name() const override { return "sqlite"; }
+    bool append(StorageEvent& event) override;
+    uint64_t lastSequence() const override { return last; }
+    size_t pendingEvents() const override { return pending; }
+    size_t snapshotInterval() const override { return interval; }
+    bool writeSnapshot(const std::string& data) override;
+    bool hasSnapshot() const override;
+    std::unique_ptr<std::istream> openSnapshot() const override;
+    void scan(uint64_t after, uint64_t upTo, const std::function<bool(const StorageEvent&)>& consumer) const override;
+    std::vector<StorageEvent> lookup(const std::string& plate) const override;
+};
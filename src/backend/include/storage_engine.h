@@ -0,0 +1,235 @@
+/**
+ * @file storage_engine.h
+ * @brief 停车场数据的存储引擎接口：快照加事件，以及数据文件、追加日志两种实现
+ */
+#pragma once
+#include "money.h"
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @enum StorageEventKind
+ * @brief 事件类型
+ */
+enum class StorageEventKind : uint8_t {
+    Entry = 1,  // 车辆入场
+    Exit = 2    // 车辆出场
+};
+
+/**
+ * @struct StorageEvent
+ * @brief 一次入场或出场，重放时按原来的时间和费用恢复，不重新计费
+ */
+struct StorageEvent {
+    uint64_t sequence = 0;                          // 事件序号，由引擎在追加时分配，从1开始递增
+    StorageEventKind kind = StorageEventKind::Entry;
+    std::string plate;                              // 车牌号
+    std::string type;                               // 车型
+    time_t entryTime = 0;                           // 入场时间
+    time_t exitTime = 0;                            // 出场时间（入场事件为0）
+    Cents fee = 0;                                  // 费用（入场事件为0）
+};
+
+/**
+ * @class StorageEngine
+ * @brief 存储引擎接口
+ *
+ * 停车场状态保存为快照（数据文件格式，见ParkingLot::saveData()），两次快照之间的入场、出场
+ * 以事件追加，启动时加载快照后重放快照之后的事件。快照中记录了写快照时的事件序号，
+ * 写入快照后引擎丢弃序号不超过它的事件。
+ * 已出场记录的段文件不经过存储引擎，由HistoryStore写入段目录。
+ * 引擎本身不加锁，由ParkingLot在自己的锁内调用（waitDurable()除外）。
+ * 数据文件和SQLite引擎的写入在返回前交给操作系统，进程崩溃不丢数据，断电时可能丢失最后一部分；
+ * 追加日志引擎由后台线程成组写入并fdatasync，waitDurable()返回后事件在断电后也不会丢失
+ */
+class StorageEngine {
+public:
+    virtual ~StorageEngine() = default;
+
+    /**
+     * @brief 引擎名称（file、log、sqlite），随快照保存，加载时用于判断事件是否接续该快照
+     */
+    virtual std::string name() const = 0;
+
+    /**
+     * @brief 追加一个事件并分配序号
+     * @return 写入失败时返回false，调用者应改为立即写快照
+     */
+    virtual bool append(StorageEvent& event) = 0;
+
+    /**
+     * @brief 最近追加的事件序号，没有事件时为上次快照时的序号
+     */
+    virtual uint64_t lastSequence() const = 0;
+
+    /**
+     * @brief 上次快照之后追加的事件数
+     */
+    virtual size_t pendingEvents() const = 0;
+
+    /**
+     * @brief 积累多少个事件后应写一次快照
+     */
+    virtual size_t snapshotInterval() const = 0;
+
+    /**
+     * @brief 写入快照并丢弃已追加的全部事件（它们已包含在快照中）
+     * @param data 快照内容
+     * @return 是否成功；失败时原快照和事件保持不变
+     */
+    virtual bool writeSnapshot(const std::string& data) = 0;
+
+    /**
+     * @brief 是否存在快照（首次运行或快照被删除以重置数据时为false）
+     */
+    virtual bool hasSnapshot() const = 0;
+
+    /**
+     * @brief 打开快照供读取
+     * @return 没有快照或无法读取时返回空指针
+     */
+    virtual std::unique_ptr<std::istream> openSnapshot() const = 0;
+
+    /**
+     * @brief 按序号顺序遍历序号在(after, upTo]内的事件
+     * @param consumer 返回false时停止遍历
+     */
+    virtual void scan(uint64_t after, uint64_t upTo, const std::function<bool(const StorageEvent&)>& consumer) const = 0;
+
+    /**
+     * @brief 查找某个车牌在上次快照之后的事件，按序号排列
+     */
+    virtual std::vector<StorageEvent> lookup(const std::string& plate) const = 0;
+
+    /**
+     * @brief 等待序号不超过sequence的事件写入磁盘
+     * @return 已写入（或已包含在写入磁盘的快照中）时返回true；后台写入失败时返回false，
+     *         调用者应改为写快照
+     *
+     * 可以在ParkingLot的锁外调用。默认实现认为append()返回时事件已交给操作系统，直接返回true
+     */
+    virtual bool waitDurable(uint64_t sequence) const {
+        (void)sequence;
+        return true;
+    }
+};
+
+/**
+ * @class FileStorage
+ * @brief 数据文件引擎：每个事件之后都重写整个数据文件，不单独记录事件
+ *
+ * 数据文件先写入临时文件再改名替换，写入中断时原文件保持完整
+ */
+class FileStorage : public StorageEngine {
+private:
+    std::string path;     // 数据文件路径
+    bool sync;            // 改名前fsync临时文件，改名后fsync目录
+    size_t pending = 0;   // 上次快照之后的事件数
+
+public:
+    /**
+     * @param path 数据文件路径
+     * @param sync 是否在替换前把快照写入磁盘（作为日志引擎的快照时需要，之后日志会被清空）
+     */
+    explicit FileStorage(const std::string& path, bool sync = false) : path(path), sync(sync) {}
+
+    std::string name() const override { return "file"; }
+    bool append(StorageEvent& event) override;
+    uint64_t lastSequence() const override { return 0; }
+    size_t pendingEvents() const override { return pending; }
+    size_t snapshotInterval() const override { return 1; }
+    bool writeSnapshot(const std::string& data) override;
+    bool hasSnapshot() const override;
+    std::unique_ptr<std::istream> openSnapshot() const override;
+    void scan(uint64_t after, uint64_t upTo, const std::function<bool(const StorageEvent&)>& consumer) const override;
+    std::vector<StorageEvent> lookup(const std::string& plate) const override;
+};
+
+/**
+ * @class LogStorage
+ * @brief 追加日志引擎：快照仍是数据文件，事件追加到path + ".log"
+ *
+ * 日志格式：uint32 标识"PKEV"，uint32 版本，uint64 写快照时的事件序号，之后每条事件为
+ * uint32 长度、内容、uint32 长度和内容的CRC32C；内容为uint64 序号，uint8 类型，int64 入场时间、
+ * 出场时间、费用，uint32 车牌长度和车牌，uint32 车型长度和车型。
+ * 打开时截去末尾不完整或校验和不符的事件（追加中断）。
+ * 每个事件只追加几十字节，写快照时先替换数据文件，再以空日志替换日志文件。
+ *
+ * 成组提交：append()只把编码好的事件放入内存队列，不进入内核；后台写入线程每次取走队列中的
+ * 全部事件，一次write加一次fdatasync写入磁盘（一个提交组），再唤醒waitDurable()中等待的请求。
+ * 写入期间到达的事件进入下一组，并发越高每组越大，每个事件分摊的fdatasync越少。
+ * 某一组写入失败时截回失败前的长度，之后的事件不再写入（避免日志中出现缺口），
+ * append()返回false、waitDurable()返回false，由调用者写快照后恢复
+ */
+class LogStorage : public StorageEngine {
+private:
+    FileStorage snapshot;       // 快照（数据文件，替换前写入磁盘）
+    std::string logPath;        // 日志文件路径
+    int fd = -1;                // 以追加方式打开的日志文件，只由写入线程或写入线程空闲时使用
+    uint64_t logBytes = 0;      // 日志文件长度，追加失败时截回这个长度
+    uint64_t snapshotSequence = 0;
+    uint64_t last = 0;          // 最近追加的事件序号
+    size_t pending = 0;
+    size_t interval;
+    bool hasBase = false;       // 是否有日志接续的快照；没有时（初始快照写入失败）不追加事件
+
+    // 以下由writerMutex保护
+    mutable std::mutex writerMutex;
+    std::condition_variable queued;           // 队列中有新事件，或要求写入线程退出
+    mutable std::condition_variable flushed;  // 一个提交组写完（或失败）
+    std::string queue;                        // 等待写入的事件记录
+    uint64_t queuedLast = 0;                  // 队列中最后一个事件的序号
+    uint64_t durable = 0;                     // 已写入磁盘的最大事件序号
+    uint64_t failedThrough = 0;               // 写入失败的最大事件序号
+    bool writing = false;                     // 写入线程正在写一个提交组
+    bool broken = false;                      // 写入失败后停止写入，直到写快照
+    bool stopping = false;
+    std::thread writer;
+
+    // 以空日志（只有文件头）替换日志文件
+    bool resetLog(uint64_t sequence);
+    // 后台写入线程
+    void runWriter();
+
+public:
+    static const size_t DEFAULT_SNAPSHOT_INTERVAL = 4096;
+
+    /**
+     * @param path 数据文件路径
+     * @param interval 积累多少个事件后写一次快照
+     */
+    explicit LogStorage(const std::string& path, size_t interval = DEFAULT_SNAPSHOT_INTERVAL);
+    ~LogStorage() override;
+
+    LogStorage(const LogStorage&) = delete;
+    LogStorage& operator=(const LogStorage&) = delete;
+
+    std::string name() const override { return "log"; }
+    bool append(StorageEvent& event) override;
+    uint64_t lastSequence() const override { return last; }
+    size_t pendingEvents() const override { return pending; }
+    size_t snapshotInterval() const override { return interval; }
+    bool writeSnapshot(const std::string& data) override;
+    bool hasSnapshot() const override { return snapshot.hasSnapshot(); }
+    std::unique_ptr<std::istream> openSnapshot() const override { return snapshot.openSnapshot(); }
+    void scan(uint64_t after, uint64_t upTo, const std::function<bool(const StorageEvent&)>& consumer) const override;
+    std::vector<StorageEvent> lookup(const std::string& plate) const override;
+    bool waitDurable(uint64_t sequence) const override;
+};
+
+/**
+ * @brief 按名称创建存储引擎
+ * @param name file、log或sqlite
+ * @param path 数据文件路径，其他引擎的文件以它为前缀
+ * @throw std::invalid_argument 名称不认识
+ * @throw std::runtime_error 引擎的文件无法打开
+ */
+std::unique_ptr<StorageEngine> createStorageEngine(const std::string& name, const std::string& path);
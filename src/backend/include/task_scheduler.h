@@ -0,0 +1,181 @@
+/**
+ * @file task_scheduler.h
+ * @brief 后台任务调度器：工作窃取线程池，支持优先级、延迟/周期执行、取消和按任务类型统计CPU时间
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @enum TaskPriority
+ * @brief 任务优先级，数值越小越先执行
+ */
+enum class TaskPriority {
+    High = 0,    // 对时效敏感的短任务，例如超时检查
+    Normal = 1,  // 例如快照
+    Low = 2      // 可以延后的维护任务，例如历史记录清理和段合并
+};
+
+/**
+ * @struct TaskTypeStats
+ * @brief 一类任务的累计统计
+ */
+struct TaskTypeStats {
+    std::string type;
+    uint64_t submitted = 0;       // 提交次数（周期任务每次执行算一次）
+    uint64_t completed = 0;       // 正常执行完成
+    uint64_t failed = 0;          // 抛出异常
+    uint64_t cancelled = 0;       // 取消后未执行
+    uint64_t running = 0;         // 正在执行
+    uint64_t cpuNanos = 0;        // 执行线程消耗的CPU时间
+    uint64_t wallNanos = 0;       // 执行耗时
+    uint64_t queueWaitNanos = 0;  // 从可以执行到开始执行的等待时间
+};
+
+/**
+ * @struct TaskSchedulerStats
+ * @brief 调度器的整体状态
+ */
+struct TaskSchedulerStats {
+    size_t workers = 0;
+    size_t queued[3] = {0, 0, 0};   // 各优先级等待执行的任务数
+    size_t delayed = 0;             // 等待到期的延迟/周期任务数
+    uint64_t steals = 0;            // 从其他线程队列窃取的任务数
+    std::vector<TaskTypeStats> types;
+};
+
+/**
+ * @class TaskHandle
+ * @brief 已提交任务的句柄，用于取消
+ *
+ * 取消后尚未开始的执行不再进行，周期任务不再重新安排；正在执行的任务不会被打断，
+ * 需要分步执行的任务可以在步骤之间检查cancelled()
+ */
+class TaskHandle {
+    friend class TaskScheduler;
+    struct State;
+    std::shared_ptr<State> state;
+
+public:
+    TaskHandle() = default;
+
+    void cancel();
+    bool cancelled() const;
+    bool valid() const { return state != nullptr; }
+};
+
+/**
+ * @class TaskScheduler
+ * @brief 工作窃取线程池
+ *
+ * 每个工作线程有自己的队列（每个优先级一个双端队列）：
+ * 1. 工作线程内提交的任务放入自己队列的尾部，其他线程提交的任务轮流放入各线程的队列
+ * 2. 工作线程按优先级从高到低取任务：先从自己队列的尾部取（刚提交的任务，数据还在缓存中），
+ *    没有时从其他线程队列的头部窃取同一优先级的任务，高优先级的任务总是先于低优先级的任务执行
+ * 3. 延迟任务和周期任务由一个定时线程按到期时间放入队列；周期任务每次执行结束后再间隔interval
+ *
+ * 每次执行用CLOCK_THREAD_CPUTIME_ID统计执行线程的CPU时间，按任务类型累计，供监控接口查看。
+ * 任务应是短小的计算或I/O，不应长时间阻塞（阻塞在套接字上的复制线程、日志写入线程仍是独立线程）
+ */
+class TaskScheduler {
+private:
+    using TaskPtr = std::shared_ptr<TaskHandle::State>;
+    using Clock = std::chrono::steady_clock;
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<TaskPtr> tasks[3];   // 按优先级
+    };
+
+    struct TimerEntry {
+        Clock::time_point due;
+        uint64_t order;                 // 到期时间相同时按安排的先后
+        TaskPtr task;
+        bool operator>(const TimerEntry& other) const {
+            return due != other.due ? due > other.due : order > other.order;
+        }
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};       // 外部提交时轮流选择的队列
+    std::atomic<size_t> queuedCount{0};     // 全部队列中的任务数
+    std::atomic<uint64_t> steals{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable taskReady;      // 有任务入队，或要求工作线程退出
+
+    mutable std::mutex timerMutex;
+    std::condition_variable timerChanged;   // 有更早到期的任务，或要求定时线程退出
+    std::vector<TimerEntry> timers;         // 最小堆，按到期时间
+    uint64_t timerOrder = 0;
+    std::thread timerThread;
+
+    mutable std::mutex statsMutex;
+    std::map<std::string, TaskTypeStats> typeStats;
+
+    std::atomic<bool> stopping{false};
+
+    TaskPtr makeTask(const std::string& type, TaskPriority priority, std::function<void()> function,
+                     std::chrono::milliseconds interval);
+    // 放入工作线程的队列
+    void enqueue(const TaskPtr& task);
+    // 安排在due时放入队列
+    void arm(const TaskPtr& task, Clock::time_point due);
+    // 取一个任务：自己的队列优先，其次窃取，高优先级优先
+    TaskPtr take(size_t self);
+    void execute(const TaskPtr& task);
+    void countCancelled(const TaskPtr& task);
+    void runWorker(size_t index);
+    void runTimer();
+
+public:
+    /**
+     * @param threads 工作线程数，0表示按CPU核数（2-8个）
+     */
+    explicit TaskScheduler(size_t threads = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief 提交一个立即执行的任务
+     * @param type 任务类型，用于统计
+     * @return 任务句柄；调度器已停止时任务不会执行，返回的句柄已取消
+     */
+    TaskHandle submit(const std::string& type, TaskPriority priority, std::function<void()> function);
+
+    /**
+     * @brief 提交一个延迟执行的任务
+     */
+    TaskHandle schedule(const std::string& type, TaskPriority priority, std::chrono::milliseconds delay,
+                        std::function<void()> function);
+
+    /**
+     * @brief 提交一个周期任务：立即执行一次，之后每次执行结束后间隔interval再执行，直到取消或调度器停止
+     * 同一个周期任务不会并发执行
+     */
+    TaskHandle scheduleEvery(const std::string& type, TaskPriority priority, std::chrono::milliseconds interval,
+                             std::function<void()> function);
+
+    /**
+     * @brief 停止调度器：取消全部尚未执行的任务，等待正在执行的任务结束后退出全部线程
+     * 之后提交的任务不会执行。可以重复调用
+     */
+    void shutdown();
+
+    size_t workerCount() const { return queues.size(); }
+
+    TaskSchedulerStats getStats() const;
+};
@@ -3,6 +3,7 @@
  * @brief 车辆类的声明，管理停车场中的车辆信息
  */
 #pragma once
+#include "money.h"
 #include <string>
 #include <ctime>
 
@@ -19,14 +20,14 @@ private:
     std::string type;          // 车型（小型/大型）
     time_t entryTime;          // 入场时间（Unix时间戳）
     time_t exitTime;           // 离场时间（0表示未离场）
-    double fee;                // 费用（单位：元）
+    Cents fee;                 // 费用（单位：分）
 
 public:
     /**
      * @brief 默认构造函数
-     * 初始化一个空的车辆对象，所有时间字段设为0，费用设为0.0
+     * 初始化一个空的车辆对象，所有时间字段设为0，费用设为0
      */
-    Vehicle() : entryTime(0), exitTime(0), fee(0.0) {}
+    Vehicle() : entryTime(0), exitTime(0), fee(0) {}
     
     /**
      * @brief 带参数的构造函数
@@ -62,9 +63,9 @@ public:
 
     /**
      * @brief 获取停车费用
-     * @return 当前计算的停车费用
+     * @return 当前计算的停车费用（分）
      */
-    double getFee() const;
+    Cents getFeeCents() const;
     
     /**
      * @brief 登记车辆出场
@@ -75,17 +76,18 @@ public:
     /**
      * @brief 计算停车费用
      * @param currentTime 计算费用时的时间点
-     * @return 停车时长（小时）
+     * @param hourlyRate 每小时费率（分/小时）
+     * @return 停车费用（分），按秒计费并四舍五入到分
      * 
      * 虚函数设计允许不同计费策略的扩展实现
      */
-    virtual double calculateFee(time_t currentTime) const;
+    virtual Cents calculateFee(time_t currentTime, Cents hourlyRate) const;
     
     /**
      * @brief 设置停车费用
-     * @param newFee 新的费用金额
+     * @param newFee 新的费用金额（分）
      */
-    void setFee(double newFee);
+    void setFeeCents(Cents newFee);
     
     /**
      * @brief 设置入场时间
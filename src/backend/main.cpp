@@ -8,8 +8,11 @@
  * 3. 处理异常情况
  */
 #include "include/api_server.h"
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <stdexcept>
+#include <string>
 
 /**
  * @brief 打印车辆详细信息到控制台
@@ -38,7 +41,7 @@ void printVehicleInfo(const Vehicle& vehicle) {
     }
     
     // 打印费用信息
-    std::cout << "费用: " << vehicle.getFee() << " 元" << std::endl;
+    std::cout << "费用: " << formatCents(vehicle.getFeeCents()) << " 元" << std::endl;
     std::cout << "------------------------" << std::endl;
 }
 
@@ -57,25 +60,104 @@ int main() {
     try {
         std::cout << "Starting Parking Management API Server..." << std::endl;
         
+        // 存储引擎由环境变量PARKING_STORAGE选择：file（默认）、log或sqlite
+        const char* storageEngine = std::getenv("PARKING_STORAGE");
+        if (storageEngine == nullptr || *storageEngine == '\0') {
+            storageEngine = "file";
+        }
+
+        // 数据文件路径和监听端口，同一台机器上运行备用节点时须与主节点不同
+        const char* dataFile = std::getenv("PARKING_DATA");
+        if (dataFile == nullptr || *dataFile == '\0') {
+            dataFile = "parking_data.dat";
+        }
+        const char* portValue = std::getenv("PARKING_PORT");
+        int port = portValue != nullptr && *portValue != '\0' ? std::atoi(portValue) : 8080;
+        if (port <= 0 || port > 65535) {
+            throw std::runtime_error("PARKING_PORT must be between 1 and 65535");
+        }
+
+        // 处理连接的工作线程数，全部停车场共用
+        const char* workersValue = std::getenv("PARKING_WORKERS");
+        long workers = workersValue != nullptr && *workersValue != '\0'
+                           ? std::atol(workersValue)
+                           : static_cast<long>(ParkingApiServer::DEFAULT_WORKER_THREADS);
+        if (workers <= 0 || workers > 1024) {
+            throw std::runtime_error("PARKING_WORKERS must be between 1 and 1024");
+        }
+
+        // 后台任务调度器的线程数，未设置时按CPU核数
+        const char* taskThreadsValue = std::getenv("PARKING_TASK_THREADS");
+        long taskThreads = 0;
+        if (taskThreadsValue != nullptr && *taskThreadsValue != '\0') {
+            taskThreads = std::atol(taskThreadsValue);
+            if (taskThreads <= 0 || taskThreads > 64) {
+                throw std::runtime_error("PARKING_TASK_THREADS must be between 1 and 64");
+            }
+        }
+
         // 创建服务器实例
         // 参数：
         // - 容量：100个车位
-        // - 小型车费率：5.0元/小时
-        // - 大型车费率：8.0元/小时
-        ParkingApiServer server(100, 5.0, 8.0);
+        // - 小型车费率：500分（5元）/小时
+        // - 大型车费率：800分（8元）/小时
+        // - 存储引擎
+        // - 默认停车场的数据文件（其他停车场在它旁边的.lots目录中）
+        // - 工作线程数
+        // - 后台任务调度器的线程数
+        ParkingApiServer server(100, 500, 800, storageEngine, dataFile, static_cast<size_t>(workers),
+                                static_cast<size_t>(taskThreads));
+        std::cout << "Storage engine: " << storageEngine << std::endl;
+
+        // 主备复制：PARKING_REPLICATION_SOCKET为主节点监听的Unix域socket，
+        // PARKING_ROLE=standby时作为备用节点跟随该socket上的主节点
+        const char* replicationSocket = std::getenv("PARKING_REPLICATION_SOCKET");
+        if (replicationSocket != nullptr && *replicationSocket != '\0') {
+            const char* role = std::getenv("PARKING_ROLE");
+            bool standby = role != nullptr && std::string(role) == "standby";
+            server.startReplication(replicationSocket, standby);
+            std::cout << "Replication: " << (standby ? "standby of " : "primary on ") << replicationSocket << std::endl;
+        }
+
+        // 共享内存占用看板：PARKING_BOARD为共享内存对象名称（如/parking_board）
+        const char* boardName = std::getenv("PARKING_BOARD");
+        if (boardName != nullptr && *boardName != '\0') {
+            server.startOccupancyBoard(boardName);
+            std::cout << "Occupancy board: " << boardName << std::endl;
+        }
         
         // 打印服务器信息和API接口说明
-        std::cout << "Server is running on http://localhost:8080" << std::endl;
+        std::cout << "Server is running on http://localhost:" << port << std::endl;
         std::cout << "Available endpoints:" << std::endl;
         std::cout << "POST   /api/vehicle       - Add a new vehicle" << std::endl;
         std::cout << "DELETE /api/vehicle/:plate - Remove a vehicle" << std::endl;
         std::cout << "GET    /api/vehicle/:plate - Query vehicle info" << std::endl;
+        std::cout << "GET    /api/vehicle/:plate/visits - All visits of a vehicle" << std::endl;
         std::cout << "GET    /api/status        - Get parking lot status" << std::endl;
         std::cout << "PUT    /api/rate          - Update parking rates" << std::endl;
         std::cout << "GET    /api/history       - Get parking history" << std::endl;
+        std::cout << "GET    /api/alerts/overstay - Get overstay alerts" << std::endl;
+        std::cout << "PUT    /api/alerts/overstay - Update overstay limit" << std::endl;
+        std::cout << "GET    /api/stats/revenue - Get revenue rollups" << std::endl;
+        std::cout << "GET    /api/stats/occupancy - Get occupancy time series" << std::endl;
+        std::cout << "GET    /api/stats/distribution - Get stay duration and fee quantiles" << std::endl;
+        std::cout << "GET    /api/stats/frequent-visitors - Get most frequent visitors" << std::endl;
+        std::cout << "GET    /api/forecast      - Forecast occupancy" << std::endl;
+        std::cout << "GET    /api/history/query - Filter and aggregate history" << std::endl;
+        std::cout << "GET    /api/history/storage - Get history storage tiers" << std::endl;
+        std::cout << "PUT    /api/history/storage - Update hot window, cache budget and retention" << std::endl;
+        std::cout << "GET    /api/export/history.csv - Export history as CSV" << std::endl;
+        std::cout << "GET    /api/export/history.arrow - Export history as Arrow IPC stream" << std::endl;
+        std::cout << "GET    /api/export/history.parquet - Export history as Parquet" << std::endl;
+        std::cout << "GET    /api/replication   - Get replication role and lag" << std::endl;
+        std::cout << "POST   /api/replication/promote - Promote a standby to primary" << std::endl;
+        std::cout << "GET    /api/lots          - List parking lots with aggregated status" << std::endl;
+        std::cout << "POST   /api/lots          - Create a parking lot" << std::endl;
+        std::cout << "*      /api/lots/:id/...  - Any lot endpoint above for lot :id (plain /api/... is lot default)" << std::endl;
+        std::cout << "GET    /api/scheduler     - Background task queues and CPU time per task type" << std::endl;
         
-        // 启动服务器并监听8080端口
-        server.start(8080);
+        // 启动服务器并监听端口（默认8080）
+        server.start(static_cast<uint16_t>(port));
         return 0;  // 正常退出
         
     } catch (const std::exception& e) {
@@ -0,0 +1,87 @@
+/**
+ * @file occupancy_board.cpp
+ * @brief 占用看板写入端的具体实现
+ */
+#include "include/occupancy_board.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+int64_t nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+}
+
+OccupancyBoard::OccupancyBoard(const std::string& boardName) : name(boardName) {
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create shared memory " + name + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    bool existing = ::fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(OccupancyBoardLayout);
+    if (!existing && ::ftruncate(fd, sizeof(OccupancyBoardLayout)) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to resize shared memory " + name + ": " + std::strerror(error));
+    }
+    void* memory = ::mmap(nullptr, sizeof(OccupancyBoardLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Failed to map shared memory " + name + ": " + std::strerror(error));
+    }
+
+    // 原子类型是无锁的，其对象表示就是整数本身；新建的共享内存全为0，直接在上面使用
+    board = static_cast<OccupancyBoardLayout*>(memory);
+    if (board->magic.load(std::memory_order_acquire) == OccupancyBoardLayout::MAGIC &&
+        board->version.load(std::memory_order_relaxed) == OccupancyBoardLayout::VERSION) {
+        // 上次运行留下的看板：sequence可能停在奇数（写入中途退出），补成偶数后继续递增
+        uint32_t sequence = board->sequence.load(std::memory_order_relaxed);
+        if (sequence & 1) {
+            board->sequence.store(sequence + 1, std::memory_order_release);
+        }
+    } else {
+        board->magic.store(0, std::memory_order_relaxed);
+        board->sequence.store(0, std::memory_order_relaxed);
+        board->version.store(OccupancyBoardLayout::VERSION, std::memory_order_relaxed);
+        board->zoneCount.store(0, std::memory_order_relaxed);
+        board->magic.store(OccupancyBoardLayout::MAGIC, std::memory_order_release);
+    }
+    heartbeat();
+}
+
+OccupancyBoard::~OccupancyBoard() {
+    // 不删除共享内存对象：读取者通过心跳判断服务器已退出，服务器重启后在原处继续写入
+    ::munmap(board, sizeof(OccupancyBoardLayout));
+}
+
+void OccupancyBoard::heartbeat() {
+    board->heartbeatAt.store(nowMillis(), std::memory_order_relaxed);
+}
+
+void OccupancyBoard::beginWrite() {
+    uint32_t sequence = board->sequence.load(std::memory_order_relaxed);
+    board->sequence.store(sequence + 1, std::memory_order_relaxed);
+    // 保证读取者看到任何新写入的字段时也能看到奇数的sequence
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void OccupancyBoard::endWrite() {
+    board->updatedAt.store(nowMillis(), std::memory_order_relaxed);
+    board->sequence.store(board->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void OccupancyBoard::writeZone(size_t index, const std::string& zoneName, size_t occupied) {
+    OccupancyBoardLayout::Zone& zone = board->zones[index];
+    char packed[OccupancyBoardLayout::NAME_WORDS * 8] = {};
+    std::memcpy(packed, zoneName.data(), std::min(zoneName.size(), sizeof(packed)));
+    for (size_t w = 0; w < OccupancyBoardLayout::NAME_WORDS; ++w) {
+        uint64_t word;
+        std::memcpy(&word, packed + w * 8, 8);
+        zone.name[w].store(word, std::memory_order_relaxed);
+    }
+    zone.occupied.store(static_cast<uint32_t>(occupied), std::memory_order_relaxed);
+}
@@ -0,0 +1,139 @@
+/**
+ * @file occupancy_forecaster.cpp
+ * @brief OccupancyForecaster类的具体实现
+ */
+#include "include/occupancy_forecaster.h"
+#include <algorithm>
+
+OccupancyForecaster::OccupancyForecaster(double alpha)
+    : profile(BUCKETS_PER_WEEK)
+    , alpha(alpha)
+    , currentPeriod(-1)
+    , lastLocalTime(0)
+    , observedSince(0)
+    , lastValue(0)
+    , weightedSum(0)
+{
+}
+
+int64_t OccupancyForecaster::toLocalSeconds(time_t time) {
+    std::tm local{};
+    localtime_r(&time, &local);
+    return static_cast<int64_t>(time) + local.tm_gmtoff;
+}
+
+int OccupancyForecaster::bucketOf(int64_t localSeconds) {
+    return static_cast<int>((localSeconds / BUCKET_SECONDS) % BUCKETS_PER_WEEK);
+}
+
+void OccupancyForecaster::closePeriod() {
+    int64_t end = (currentPeriod + 1) * BUCKET_SECONDS;
+    int64_t observed = end - observedSince;
+    if (observed * 3 < BUCKET_SECONDS) {
+        return;  // 观测时间不足三分之一个时段（例如刚启动），不参与学习
+    }
+
+    double average = weightedSum / static_cast<double>(observed);
+    Bucket& bucket = profile[bucketOf(currentPeriod * BUCKET_SECONDS)];
+    bucket.level = bucket.samples == 0 ? average : alpha * average + (1 - alpha) * bucket.level;
+    bucket.samples++;
+}
+
+void OccupancyForecaster::record(time_t time, uint32_t occupied) {
+    int64_t local = toLocalSeconds(time);
+    if (currentPeriod < 0) {
+        // 第一个事件：开始观测
+        currentPeriod = local / BUCKET_SECONDS;
+        lastLocalTime = observedSince = local;
+        lastValue = occupied;
+        weightedSum = 0;
+        return;
+    }
+    local = std::max(local, lastLocalTime);  // 系统时钟回拨时视为同一时刻
+    int64_t period = local / BUCKET_SECONDS;
+
+    // 超过一周没有事件时，只需要学习最近一周（期间占用数一直为lastValue）
+    if (period - currentPeriod > BUCKETS_PER_WEEK) {
+        currentPeriod = period - BUCKETS_PER_WEEK;
+        lastLocalTime = observedSince = currentPeriod * BUCKET_SECONDS;
+        weightedSum = 0;
+    }
+
+    // 结束之前的时段（中间没有事件的时段占用数保持不变）
+    while (currentPeriod < period) {
+        int64_t end = (currentPeriod + 1) * BUCKET_SECONDS;
+        weightedSum += static_cast<double>(lastValue) * (end - lastLocalTime);
+        closePeriod();
+
+        currentPeriod++;
+        lastLocalTime = observedSince = end;
+        weightedSum = 0;
+    }
+
+    weightedSum += static_cast<double>(lastValue) * (local - lastLocalTime);
+    lastLocalTime = local;
+    lastValue = occupied;
+}
+
+OccupancyForecast OccupancyForecaster::forecast(time_t now, time_t horizon, uint32_t current, uint32_t capacity) const {
+    int64_t local = toLocalSeconds(now);
+    const Bucket& from = profile[bucketOf(local)];
+
+    // 历史同期从当前时段到目标时段的变化量
+    auto seasonalDelta = [&](time_t ahead) -> double {
+        const Bucket& to = profile[bucketOf(local + ahead)];
+        if (from.samples == 0 || to.samples == 0) {
+            return 0;  // 缺少历史数据时假设占用数不变
+        }
+        return to.level - from.level;
+    };
+    auto clamp = [&](double value) {
+        return std::max(0.0, std::min(value, static_cast<double>(capacity)));
+    };
+
+    OccupancyForecast result;
+    result.predicted = clamp(current + seasonalDelta(horizon));
+    result.samples = profile[bucketOf(local + horizon)].samples;
+
+    // 逐个时段向后查找第一个预计占满的时刻（最多24小时）
+    result.fullIn = -1;
+    if (current >= capacity) {
+        result.fullIn = 0;
+    } else {
+        for (time_t ahead = BUCKET_SECONDS; ahead <= 24 * 3600; ahead += BUCKET_SECONDS) {
+            if (current + seasonalDelta(ahead) >= capacity) {
+                result.fullIn = ahead;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+void OccupancyForecaster::write(std::ostream& out) const {
+    uint32_t bucketCount = static_cast<uint32_t>(profile.size());
+    out.write(reinterpret_cast<const char*>(&bucketCount), sizeof(bucketCount));
+    for (const Bucket& bucket : profile) {
+        out.write(reinterpret_cast<const char*>(&bucket.level), sizeof(bucket.level));
+        out.write(reinterpret_cast<const char*>(&bucket.samples), sizeof(bucket.samples));
+    }
+}
+
+bool OccupancyForecaster::read(std::istream& in) {
+    uint32_t bucketCount = 0;
+    in.read(reinterpret_cast<char*>(&bucketCount), sizeof(bucketCount));
+    if (!in || bucketCount != profile.size()) {
+        return false;  // 时段划分不一致或数据损坏
+    }
+
+    std::vector<Bucket> loaded(bucketCount);
+    for (Bucket& bucket : loaded) {
+        in.read(reinterpret_cast<char*>(&bucket.level), sizeof(bucket.level));
+        in.read(reinterpret_cast<char*>(&bucket.samples), sizeof(bucket.samples));
+    }
+    if (!in) {
+        return false;
+    }
+    profile = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file occupancy_series.cpp
+ * @brief OccupancySeries类的具体实现
+ */
+#include "include/occupancy_series.h"
+#include "include/crc32c.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+const uint32_t SERIES_FILE_MAGIC = 0x534F4B50;  // "PKOS"
+}
+
+OccupancySeries::OccupancySeries()
+    : tiers{{1, std::vector<Slot>(3600)},       // 每秒，1小时
+            {60, std::vector<Slot>(7 * 1440)},  // 每分钟，1周
+            {3600, std::vector<Slot>(8760)}}    // 每小时，1年
+    , lastValue(0)
+{
+}
+
+const OccupancySeries::Tier& OccupancySeries::tierOf(OccupancyResolution resolution) const {
+    return tiers[static_cast<int>(resolution)];
+}
+
+time_t OccupancySeries::retentionOf(OccupancyResolution resolution) const {
+    const Tier& tier = tierOf(resolution);
+    return tier.step * static_cast<time_t>(tier.slots.size());
+}
+
+void OccupancySeries::write(std::ostream& out) const {
+    // 槽位按内存布局整块读写，布局变化时须同时修改数据文件格式
+    static_assert(sizeof(Slot) == 24, "unexpected slot layout");
+    out.write(reinterpret_cast<const char*>(&lastValue), sizeof(lastValue));
+    for (const Tier& tier : tiers) {
+        int64_t step = tier.step;
+        uint32_t slotCount = static_cast<uint32_t>(tier.slots.size());
+        out.write(reinterpret_cast<const char*>(&step), sizeof(step));
+        out.write(reinterpret_cast<const char*>(&slotCount), sizeof(slotCount));
+        out.write(reinterpret_cast<const char*>(tier.slots.data()), slotCount * sizeof(Slot));
+    }
+}
+
+bool OccupancySeries::read(std::istream& in) {
+    uint32_t loadedValue = 0;
+    in.read(reinterpret_cast<char*>(&loadedValue), sizeof(loadedValue));
+
+    std::vector<Slot> loaded[3];
+    for (int i = 0; i < 3; ++i) {
+        int64_t step = 0;
+        uint32_t slotCount = 0;
+        in.read(reinterpret_cast<char*>(&step), sizeof(step));
+        in.read(reinterpret_cast<char*>(&slotCount), sizeof(slotCount));
+        if (!in || step != tiers[i].step || slotCount != tiers[i].slots.size()) {
+            return false;  // 分辨率或保留时长不一致，或数据损坏
+        }
+        loaded[i].resize(slotCount);
+        in.read(reinterpret_cast<char*>(loaded[i].data()), slotCount * sizeof(Slot));
+    }
+    if (!in) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        tiers[i].slots = std::move(loaded[i]);
+    }
+    lastValue = loadedValue;
+    return true;
+}
+
+bool OccupancySeries::save(const std::string& path) const {
+    std::ostringstream encoded;
+    write(encoded);
+    const std::string payload = encoded.str();
+    uint32_t checksum = crc32c(payload.data(), payload.size());
+
+    const std::string temp = path + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&SERIES_FILE_MAGIC), sizeof(SERIES_FILE_MAGIC));
+    file.write(payload.data(), payload.size());
+    file.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    file.close();
+    std::error_code error;
+    if (file) {
+        std::filesystem::rename(temp, path, error);
+    }
+    if (!file || error) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+bool OccupancySeries::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    uint32_t magic = 0;
+    if (!file.read(reinterpret_cast<char*>(&magic), sizeof(magic)) || magic != SERIES_FILE_MAGIC) {
+        return false;
+    }
+    std::string payload((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    uint32_t storedChecksum = 0;
+    if (payload.size() < sizeof(storedChecksum)) {
+        return false;
+    }
+    std::memcpy(&storedChecksum, payload.data() + payload.size() - sizeof(storedChecksum), sizeof(storedChecksum));
+    payload.resize(payload.size() - sizeof(storedChecksum));
+    if (crc32c(payload.data(), payload.size()) != storedChecksum) {
+        return false;
+    }
+    std::istringstream in(payload, std::ios::binary);
+    return read(in);
+}
+
+void OccupancySeries::record(time_t time, uint32_t occupied) {
+    for (Tier& tier : tiers) {
+        int64_t period = time / tier.step;
+        Slot& slot = tier.slots[period % static_cast<int64_t>(tier.slots.size())];
+
+        if (slot.period == period) {
+            // 同一时间段内的后续事件
+            slot.min = std::min(slot.min, occupied);
+            slot.max = std::max(slot.max, occupied);
+            slot.last = occupied;
+        } else if (slot.period < period) {
+            // 进入新的时间段，覆盖环形缓冲区中的旧数据
+            slot.period = period;
+            slot.open = lastValue;
+            slot.min = std::min(lastValue, occupied);
+            slot.max = std::max(lastValue, occupied);
+            slot.last = occupied;
+        }
+        // slot.period > period：系统时钟回拨，忽略该分辨率下的这次更新
+    }
+    lastValue = occupied;
+}
+
+std::vector<OccupancyPoint> OccupancySeries::query(OccupancyResolution resolution, time_t from, time_t to, time_t now) const {
+    const Tier& tier = tierOf(resolution);
+    const int64_t size = static_cast<int64_t>(tier.slots.size());
+    auto slotAt = [&](int64_t period) -> const Slot* {
+        const Slot& slot = tier.slots[period % size];
+        return slot.period == period ? &slot : nullptr;
+    };
+
+    std::vector<OccupancyPoint> points;
+    if (to <= from) {
+        return points;
+    }
+
+    // 限定在保留窗口内
+    int64_t nowPeriod = now / tier.step;
+    int64_t windowStart = std::max<int64_t>(nowPeriod - size + 1, 0);
+    int64_t first = std::max<int64_t>(from / tier.step, windowStart);
+    int64_t last = std::min<int64_t>((to - 1) / tier.step, nowPeriod);
+    if (first > last) {
+        return points;
+    }
+
+    // 确定查询起点之前的占用数：
+    // 优先取之前最近一个时间段的结束值，否则取之后第一个时间段的开始值，
+    // 窗口内都没有事件则说明占用数一直没有变化
+    uint32_t carry = lastValue;
+    bool found = false;
+    for (int64_t period = first - 1; period >= windowStart && !found; --period) {
+        if (const Slot* slot = slotAt(period)) {
+            carry = slot->last;
+            found = true;
+        }
+    }
+    for (int64_t period = first; period <= nowPeriod && !found; ++period) {
+        if (const Slot* slot = slotAt(period)) {
+            carry = slot->open;
+            found = true;
+        }
+    }
+
+    points.reserve(static_cast<size_t>(last - first + 1));
+    for (int64_t period = first; period <= last; ++period) {
+        time_t start = static_cast<time_t>(period * tier.step);
+        if (const Slot* slot = slotAt(period)) {
+            points.push_back({start, slot->min, slot->max, slot->last});
+            carry = slot->last;
+        } else {
+            points.push_back({start, carry, carry, carry});
+        }
+    }
+    return points;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file overstay_monitor.cpp
+ * @brief OverstayMonitor类的具体实现
+ */
+#include "include/overstay_monitor.h"
+#include <algorithm>
+
+OverstayMonitor::OverstayMonitor(time_t defaultLimitSeconds)
+    : defaultLimit(defaultLimitSeconds)
+{
+}
+
+void OverstayMonitor::setLimit(const std::string& type, time_t seconds) {
+    if (seconds <= 0) {
+        return;  // 忽略非法时限
+    }
+    limits[type] = seconds;
+
+    // 重新计算该车型所有未超时车辆的到期时间
+    for (auto& [plate, event] : tracked) {
+        if (event.type != type || overstaying.count(plate)) {
+            continue;
+        }
+        pending.erase({event.deadline, plate});
+        event.deadline = event.entryTime + seconds;
+        pending.emplace(event.deadline, plate);
+    }
+}
+
+time_t OverstayMonitor::getLimit(const std::string& type) const {
+    auto it = limits.find(type);
+    return it != limits.end() ? it->second : defaultLimit;
+}
+
+void OverstayMonitor::track(const std::string& plate, const std::string& type, time_t entryTime) {
+    untrack(plate);  // 防止重复监测同一车牌
+
+    OverstayEvent event{plate, type, entryTime, entryTime + getLimit(type)};
+    pending.emplace(event.deadline, plate);
+    tracked.emplace(plate, std::move(event));
+}
+
+void OverstayMonitor::untrack(const std::string& plate) {
+    auto it = tracked.find(plate);
+    if (it == tracked.end()) {
+        return;
+    }
+    pending.erase({it->second.deadline, plate});
+    overstaying.erase(plate);
+    tracked.erase(it);
+}
+
+std::vector<OverstayEvent> OverstayMonitor::poll(time_t now) {
+    std::vector<OverstayEvent> fired;
+
+    // 有序集合的头部即最早到期的车辆，遇到未到期的车辆即可停止
+    while (!pending.empty() && pending.begin()->first <= now) {
+        const std::string plate = pending.begin()->second;
+        pending.erase(pending.begin());
+
+        const OverstayEvent& event = tracked.at(plate);
+        overstaying.emplace(plate, event);
+        fired.push_back(event);
+    }
+    return fired;
+}
+
+std::vector<OverstayEvent> OverstayMonitor::getOverstaying() const {
+    std::vector<OverstayEvent> result;
+    result.reserve(overstaying.size());
+    for (const auto& [_, event] : overstaying) {
+        result.push_back(event);
+    }
+
+    std::sort(result.begin(), result.end(), [](const OverstayEvent& a, const OverstayEvent& b) {
+        return a.deadline < b.deadline;
+    });
+    return result;
+}
+
+void OverstayMonitor::clear() {
+    pending.clear();
+    tracked.clear();
+    overstaying.clear();
+}
@@ -3,17 +3,92 @@
  * @brief ParkingLot类的具体实现
  */
 #include "include/parking_lot.h"
-#include <fstream>
+#include "include/crc32c.h"
+#include <chrono>
 #include <ctime>
-#include <cmath> // 用于std::round函数
+#include <cmath> // 用于std::llround函数（读取旧格式文件）
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <limits>
 
-ParkingLot::ParkingLot(size_t cap, double smallRate, double largeRate, const std::string& filePath)
+namespace {
+// 数据文件格式标识。旧格式（版本1）没有文件头，直接以size_t容量开头，
+// 费率和费用以double（元）保存；版本2起以文件头开头，金额以int64（分）保存；
+// 版本3在车辆记录之后追加若干数据段，每段为(uint32标签, uint64长度, 内容)，
+// 加载时跳过不认识的标签；版本4起车辆记录只包含在场车辆，已出场记录由HistoryStore
+// 分段保存在段目录中，未封存的段作为数据段随数据文件保存；版本5起车辆记录之后有一个uint32，
+// 为文件头和车辆记录的CRC32C，每个数据段之后有一个uint32，为该段标签、长度和内容的CRC32C
+const uint32_t DATA_FILE_MAGIC = 0x544C4B50;  // "PKLT"
+const uint32_t DATA_FILE_VERSION = 5;
+const uint32_t FIRST_CHECKSUM_VERSION = 5;    // 带校验和的第一个版本
+const uint64_t MAX_FIELD_LENGTH = 256;        // 车牌、车型字符串的最大长度，超出说明数据损坏
+
+// 数据段标签
+const uint32_t SECTION_STAY_DISTRIBUTION = 1;  // 按天、车型的停车时长和费用分布
+const uint32_t SECTION_OCCUPANCY_FORECAST = 2; // 占用预测器的学习结果
+const uint32_t SECTION_HISTORY_OPEN_SEGMENT = 3; // 历史记录中未封存的段及已提交的段编号上限
+const uint32_t SECTION_HISTORY_RETENTION = 4;  // 历史记录的分层、保留设置和清理进度
+const uint32_t SECTION_STORAGE = 5;            // 写快照的存储引擎名称和当时的事件序号
+const uint32_t SECTION_OVERSTAY_LIMITS = 6;    // 各车型的停车时限
+
+// 数据段标签、长度和内容的校验和
+uint32_t sectionChecksum(uint32_t tag, uint64_t length, const std::string& payload) {
+    uint32_t crc = crc32c(&tag, sizeof(tag));
+    crc = crc32c(&length, sizeof(length), crc);
+    return crc32c(payload.data(), payload.size(), crc);
+}
+
+// 写入一个数据段
+void writeSection(std::ostream& out, uint32_t tag, const std::string& payload) {
+    uint64_t length = payload.size();
+    uint32_t checksum = sectionChecksum(tag, length, payload);
+    out.write(reinterpret_cast<const char*>(&tag), sizeof(tag));
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(payload.data(), payload.size());
+    out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+}
+
+// 读取长度前缀的字符串，长度不合理或数据不完整时返回false（不会按损坏的长度分配内存）
+bool readField(std::istream& in, std::string& value) {
+    size_t length = 0;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > MAX_FIELD_LENGTH) {
+        return false;
+    }
+    value.assign(length, '\0');
+    return static_cast<bool>(in.read(&value[0], length));
+}
+
+// 旧格式中以double保存的"元"转换为分
+Cents legacyYuanToCents(double yuan) {
+    return static_cast<Cents>(std::llround(yuan * 100));
+}
+
+// 由历史记录中的一行构造已出场的Vehicle
+Vehicle departedVehicle(const std::string& plate, const std::string& type, time_t entryTime, time_t exitTime, Cents fee) {
+    Vehicle vehicle(plate, type);
+    vehicle.setEntryTime(entryTime);
+    vehicle.setExitTime(exitTime);
+    vehicle.setFeeCents(fee);
+    return vehicle;
+}
+}
+
+ParkingLot::ParkingLot(size_t cap, Cents smallRate, Cents largeRate, const std::string& filePath,
+                       const std::string& storageEngine)
     : capacity(cap)           // 初始化停车场容量
     , currentCount(0)         // 初始化当前车辆数为0
     , hourlyRateSmall(smallRate)  // 设置小型车费率
     , hourlyRateLarge(largeRate)  // 设置大型车费率
+    , totalRevenue(0)             // 初始化累计营收为0
     , dataFilePath(filePath)      // 设置数据文件路径
+    , storage(createStorageEngine(storageEngine, filePath))  // 创建存储引擎，名称不认识时抛出异常
 {
+    history.open(filePath + ".segments");
+
     // 尝试从文件加载历史数据
     if (!loadData()) {
         // 如果加载失败，使用传入的初始值
@@ -22,75 +97,254 @@ ParkingLot::ParkingLot(size_t cap, double smallRate, double largeRate, const std
         currentCount = 0;
         hourlyRateSmall = smallRate;
         hourlyRateLarge = largeRate;
+        totalRevenue = 0;
+        recountOccupancy();
     }
+    loadOccupancySeries();
+
+    // 以启动时的占用数作为时间序列和预测器的起点
+    time_t now = std::time(nullptr);
+    occupancySeries.record(now, static_cast<uint32_t>(currentCount));
+    occupancyForecaster.record(now, static_cast<uint32_t>(currentCount));
 }
 
 bool ParkingLot::addVehicle(const std::string& plate, const std::string& type) {
-    // 检查停车场是否已满或车辆是否已存在
-    if (currentCount >= capacity || vehicles.find(plate) != vehicles.end()) {
-        return false;  // 无法添加车辆
+    uint64_t sequence;
+    {
+        std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+        // 检查停车场是否已满或车辆是否已在场内（已出场的车辆可以再次入场）
+        if (currentCount >= capacity || vehicles.count(plate) > 0) {
+            return false;  // 无法添加车辆
+        }
+
+        StorageEvent event;
+        event.kind = StorageEventKind::Entry;
+        event.plate = plate;
+        event.type = type;
+        event.entryTime = std::time(nullptr);
+        applyEntry(plate, type, event.entryTime);
+
+        // 保存更新后的数据
+        sequence = persist(event);
+
+        ReplicationRecord record;
+        record.kind = ReplicationRecordKind::Entry;
+        record.event = event;
+        publish(record);
     }
+    // 等待期间其他请求可以继续入场/出场，它们的事件进入同一个或下一个提交组
+    waitDurable(sequence);
+    return true;
+}
 
+void ParkingLot::applyEntry(const std::string& plate, const std::string& type, time_t entryTime) {
     // 使用emplace创建新的Vehicle对象
     // emplace比insert更高效，因为它直接在map中构造对象
-    vehicles.emplace(plate, Vehicle(plate, type));
+    auto inserted = vehicles.emplace(plate, Vehicle(plate, type)).first;
+    inserted->second.setEntryTime(entryTime);
     currentCount++;  // 更新当前车辆数
-    
-    // 保存更新后的数据到文件
-    saveData();
-    return true;
+    occupiedByType[type]++;
+
+    // 加入超时到期队列，记录占用数变化和常客统计
+    overstayMonitor.track(plate, type, entryTime);
+    occupancySeries.record(entryTime, static_cast<uint32_t>(currentCount));
+    occupancySeriesDirty = true;
+    occupancyForecaster.record(entryTime, static_cast<uint32_t>(currentCount));
+    frequentVisitors.record(plate, entryTime);
+    notifyOccupancy();
 }
 
-bool ParkingLot::removeVehicle(const std::string& plate) {
-    // 查找车辆
-    auto it = vehicles.find(plate);
-    if (it == vehicles.end() || it->second.getExitTime() != 0) {
-        // 车辆不存在或已经出场
-        return false;
+bool ParkingLot::removeVehicle(const std::string& plate, Vehicle& outVehicle) {
+    uint64_t sequence;
+    {
+        std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+        // 查找在场车辆
+        auto it = vehicles.find(plate);
+        if (it == vehicles.end()) {
+            // 车辆不存在或已经出场
+            return false;
+        }
+
+        Vehicle& vehicle = it->second;
+        vehicle.checkout();  // 登记出场时间
+
+        // 根据车型和停车时长计算费用（整数分，按秒计费并四舍五入）
+        Cents hourlyRate = (vehicle.getType() == "小型") ? hourlyRateSmall : hourlyRateLarge;
+        Cents fee = vehicle.calculateFee(std::time(nullptr), hourlyRate);
+
+        StorageEvent event;
+        event.kind = StorageEventKind::Exit;
+        event.plate = plate;
+        event.type = vehicle.getType();
+        event.entryTime = vehicle.getEntryTime();
+        event.exitTime = vehicle.getExitTime();
+        event.fee = fee;
+        outVehicle = vehicle;
+        outVehicle.setFeeCents(fee);
+        applyExit(it, event.exitTime, fee);
+
+        sequence = persist(event);  // 保存更新后的数据
+
+        ReplicationRecord record;
+        record.kind = ReplicationRecordKind::Exit;
+        record.event = event;
+        publish(record);
     }
+    waitDurable(sequence);
+    return true;
+}
 
+void ParkingLot::applyExit(std::map<std::string, Vehicle>::iterator it, time_t exitTime, Cents fee) {
+    const std::string plate = it->first;
     Vehicle& vehicle = it->second;
-    vehicle.checkout();  // 登记出场时间
-
-    // 根据车型和停车时长计算费用
-    double hourlyRate = (vehicle.getType() == "小型") ? hourlyRateSmall : hourlyRateLarge;
-    double hours = vehicle.calculateFee(std::time(nullptr));
-    double fee = hours * hourlyRate;
-    
-    // 将费用四舍五入到2位小数
-    fee = std::round(fee * 100) / 100.0;
-    vehicle.setFee(fee);
+    vehicle.setExitTime(exitTime);
+    vehicle.setFeeCents(fee);
+    totalRevenue += fee;
+    revenueRollup.record(vehicle.getType(), vehicle.getExitTime(), fee);
+    recordStay(vehicle.getType(), vehicle.getEntryTime(), vehicle.getExitTime(), fee);
+    // 出场记录移入历史记录存储，在场车辆表只保留在场的车辆
+    history.append(plate, vehicle.getType(), vehicle.getEntryTime(), vehicle.getExitTime(), fee);
 
+    overstayMonitor.untrack(plate);  // 出场车辆不再参与超时监测
     currentCount--;  // 更新当前车辆数
-    saveData();     // 保存更新后的数据
-    return true;
+    occupiedByType[vehicle.getType()]--;
+    vehicles.erase(it);
+    occupancySeries.record(exitTime, static_cast<uint32_t>(currentCount));
+    occupancySeriesDirty = true;
+    occupancyForecaster.record(exitTime, static_cast<uint32_t>(currentCount));
+    notifyOccupancy();
+}
+
+uint64_t ParkingLot::persist(StorageEvent& event) {
+    // 追加失败或积累的事件达到间隔时写快照（数据文件引擎每个事件都写），快照包含该事件
+    if (!storage->append(event)) {
+        saveData();
+        return 0;
+    }
+    if (storage->pendingEvents() >= storage->snapshotInterval()) {
+        // 事件已在日志中，快照只是缩短重放，可以在后台写；同时只排队一个
+        if (backgroundExecutor && storage->snapshotInterval() > 1) {
+            if (!snapshotQueued.exchange(true) &&
+                !backgroundExecutor("snapshot", [this] {
+                    snapshotQueued = false;
+                    saveData();
+                })) {
+                snapshotQueued = false;
+                saveData();
+            }
+        } else {
+            saveData();
+        }
+    }
+    return event.sequence;
+}
+
+void ParkingLot::waitDurable(uint64_t sequence) {
+    if (storage->waitDurable(sequence)) {
+        return;
+    }
+    // 提交组写入失败：写快照，快照包含内存中的全部事件；其他等待者随后发现事件已包含在快照中
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    if (!storage->waitDurable(sequence)) {
+        saveData();
+    }
+}
+
+void ParkingLot::publish(ReplicationRecord& record) {
+    record.position = ++replicationPosition;
+    record.committedAt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (replicationListener) {
+        replicationListener(record);
+    }
+}
+
+void ParkingLot::replayEvents(const StorageEngine& source, uint64_t after) {
+    size_t replayed = 0, skipped = 0;
+    source.scan(after, source.lastSequence(), [&](const StorageEvent& event) {
+        auto it = vehicles.find(event.plate);
+        if (event.kind == StorageEventKind::Entry && it == vehicles.end()) {
+            applyEntry(event.plate, event.type, event.entryTime);
+            ++replayed;
+        } else if (event.kind == StorageEventKind::Exit && it != vehicles.end()) {
+            applyExit(it, event.exitTime, event.fee);
+            ++replayed;
+        } else {
+            ++skipped;  // 与快照不一致（快照的车辆记录损坏时），跳过
+        }
+        return true;
+    });
+    if (replayed > 0) {
+        std::cout << "Replayed " << replayed << " " << source.name() << " storage events" << std::endl;
+    }
+    if (skipped > 0) {
+        std::cerr << "Skipped " << skipped << " storage events inconsistent with the snapshot" << std::endl;
+    }
 }
 
 bool ParkingLot::queryVehicle(const std::string& plate, Vehicle& outVehicle) const {
-    // 查找并返回车辆信息
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    // 在场时返回本次停车记录
     auto it = vehicles.find(plate);
     if (it != vehicles.end()) {
         outVehicle = it->second;  // 复制车辆信息到输出参数
         return true;
     }
-    return false;
+
+    // 不在场时通过倒排表取最近一次出场记录
+    return history.latestVisit(plate, [&](const std::string& type, time_t entryTime, time_t exitTime, Cents fee) {
+        outVehicle = departedVehicle(plate, type, entryTime, exitTime, fee);
+    });
+}
+
+std::vector<Vehicle> ParkingLot::getVehicleVisits(const std::string& plate) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    std::vector<Vehicle> visits;
+    history.forEachVisit(plate, [&](const std::string& type, time_t entryTime, time_t exitTime, Cents fee) {
+        visits.push_back(departedVehicle(plate, type, entryTime, exitTime, fee));
+    });
+
+    // 历史记录按出场先后排列，停车时段互不重叠，因此也是按入场先后排列；再补上在场的这一次
+    auto current = vehicles.find(plate);
+    if (current != vehicles.end()) {
+        visits.push_back(current->second);
+    }
+    return visits;
 }
 
 size_t ParkingLot::getAvailableSpaces() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
     // 返回空余车位数
     return capacity - currentCount;
 }
 
 size_t ParkingLot::getOccupiedSpaces() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
     // 返回已占用车位数
     return currentCount;
 }
 
 bool ParkingLot::saveData() const {
-    // 以二进制模式打开文件
-    std::ofstream outFile(dataFilePath, std::ios::binary);
-    if (!outFile) return false;  // 文件打开失败
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    // 数据文件引擎先写临时文件再改名替换原文件，保存中断时原文件保持完整
+    return storage->writeSnapshot(encodeSnapshot());
+}
+
+std::string ParkingLot::encodeSnapshot() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    // 先在内存中组装，计算校验和后整体作为快照
+    std::ostringstream outFile(std::ios::binary);
     
+    // 0. 写入文件头（格式标识和版本号）
+    outFile.write(reinterpret_cast<const char*>(&DATA_FILE_MAGIC), sizeof(DATA_FILE_MAGIC));
+    outFile.write(reinterpret_cast<const char*>(&DATA_FILE_VERSION), sizeof(DATA_FILE_VERSION));
+
     // 1. 写入停车场配置信息
     // 使用reinterpret_cast进行类型转换，确保正确写入二进制数据
     outFile.write(reinterpret_cast<const char*>(&capacity), sizeof(capacity));
@@ -98,7 +352,7 @@ bool ParkingLot::saveData() const {
     outFile.write(reinterpret_cast<const char*>(&hourlyRateSmall), sizeof(hourlyRateSmall));
     outFile.write(reinterpret_cast<const char*>(&hourlyRateLarge), sizeof(hourlyRateLarge));
     
-    // 2. 写入车辆数量
+    // 2. 写入在场车辆数量
     size_t vehicleCount = vehicles.size();
     outFile.write(reinterpret_cast<const char*>(&vehicleCount), sizeof(vehicleCount));
     
@@ -118,114 +372,781 @@ bool ParkingLot::saveData() const {
         // 写入时间和费用信息
         time_t entryTime = vehicle.getEntryTime();
         time_t exitTime = vehicle.getExitTime();
-        double fee = vehicle.getFee();
+        Cents fee = vehicle.getFeeCents();
         
         outFile.write(reinterpret_cast<const char*>(&entryTime), sizeof(entryTime));
         outFile.write(reinterpret_cast<const char*>(&exitTime), sizeof(exitTime));
         outFile.write(reinterpret_cast<const char*>(&fee), sizeof(fee));
     }
-    
-    return true;  // 保存成功
+    uint32_t bodyChecksum = crc32c(outFile.str().data(), static_cast<size_t>(outFile.tellp()));
+    outFile.write(reinterpret_cast<const char*>(&bodyChecksum), sizeof(bodyChecksum));
+
+    // 4. 写入停车时长和费用分布
+    std::ostringstream distributions;
+    uint64_t distributionCount = stayDistributions.size();
+    distributions.write(reinterpret_cast<const char*>(&distributionCount), sizeof(distributionCount));
+    for (const auto& [key, distribution] : stayDistributions) {
+        const auto& [day, type] = key;
+        uint64_t typeLength = type.length();
+        distributions.write(reinterpret_cast<const char*>(&day), sizeof(day));
+        distributions.write(reinterpret_cast<const char*>(&typeLength), sizeof(typeLength));
+        distributions.write(type.c_str(), typeLength);
+        distribution.duration.write(distributions);
+        distribution.fee.write(distributions);
+    }
+    writeSection(outFile, SECTION_STAY_DISTRIBUTION, distributions.str());
+
+    // 5. 写入占用预测器的学习结果
+    std::ostringstream forecaster;
+    occupancyForecaster.write(forecaster);
+    writeSection(outFile, SECTION_OCCUPANCY_FORECAST, forecaster.str());
+
+    // 6. 写入历史记录中未封存的段（已封存的段在段目录中）
+    writeSection(outFile, SECTION_HISTORY_OPEN_SEGMENT, history.saveOpenSegment());
+
+    // 7. 写入历史记录的保留设置和清理进度
+    writeSection(outFile, SECTION_HISTORY_RETENTION, history.saveRetention());
+
+    // 8. 写入存储引擎名称和事件序号，之前的事件都已包含在快照中
+    std::string engine;
+    uint64_t sequence = storage->lastSequence();
+    engine.append(reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+    engine += storage->name();
+    writeSection(outFile, SECTION_STORAGE, engine);
+
+    // 9. 写入单独设置过的停车时限：uint64 条数，每条为uint64 车型长度、车型、int64 秒数
+    std::ostringstream limits;
+    uint64_t limitCount = overstayMonitor.getLimits().size();
+    limits.write(reinterpret_cast<const char*>(&limitCount), sizeof(limitCount));
+    for (const auto& [type, seconds] : overstayMonitor.getLimits()) {
+        uint64_t typeLength = type.length();
+        int64_t limit = seconds;
+        limits.write(reinterpret_cast<const char*>(&typeLength), sizeof(typeLength));
+        limits.write(type.c_str(), typeLength);
+        limits.write(reinterpret_cast<const char*>(&limit), sizeof(limit));
+    }
+    writeSection(outFile, SECTION_OVERSTAY_LIMITS, limits.str());
+    return outFile.str();
 }
 
 bool ParkingLot::loadData() {
-    // 以二进制模式打开文件
-    std::ifstream inFile(dataFilePath, std::ios::binary);
-    if (!inFile) return false;  // 文件打开失败
-    
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    // 打开存储引擎中的快照
+    std::unique_ptr<std::istream> snapshot = storage->openSnapshot();
+    if (!snapshot) {
+        // 没有快照（首次运行或数据文件被删除以重置数据）时，段目录中残留的段文件和引擎中的事件也不再有效；
+        // 立即写入初始快照，之后的事件都接续这个快照
+        if (!storage->hasSnapshot()) {
+            history.removeSegmentFiles();
+            saveData();
+        }
+        return false;  // 快照读取失败
+    }
+    return loadSnapshot(*snapshot, true);
+}
+
+bool ParkingLot::loadSnapshot(std::istream& inFile, bool replay) {
+    inFile.seekg(0, std::ios::end);
+    const std::streamoff fileSize = inFile.tellg();
+    inFile.seekg(0);
+
+    // 启动参数，文件头和车辆记录校验失败时恢复
+    const size_t defaultCapacity = capacity;
+    const Cents defaultSmallRate = hourlyRateSmall;
+    const Cents defaultLargeRate = hourlyRateLarge;
+
+    // 0. 读取文件头，没有文件头的是旧格式（版本1）
+    uint32_t magic = 0, version = 1;
+    inFile.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    if (magic == DATA_FILE_MAGIC) {
+        inFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if (version < 2 || version > DATA_FILE_VERSION) return false;  // 不认识的版本
+    } else {
+        inFile.seekg(0);  // 旧格式：从头开始读取
+    }
+
     // 1. 读取停车场配置信息
     size_t savedCapacity;
     inFile.read(reinterpret_cast<char*>(&savedCapacity), sizeof(savedCapacity));
     
     // 验证容量合法性（设置上限防止异常数据）
-    if (savedCapacity > 0 && savedCapacity <= 1000) {
+    if (savedCapacity > 0 && savedCapacity <= MAX_CAPACITY) {
         capacity = savedCapacity;
     }
 
     // 读取其他配置信息
     inFile.read(reinterpret_cast<char*>(&currentCount), sizeof(currentCount));
-    inFile.read(reinterpret_cast<char*>(&hourlyRateSmall), sizeof(hourlyRateSmall));
-    inFile.read(reinterpret_cast<char*>(&hourlyRateLarge), sizeof(hourlyRateLarge));
+    if (version == 1) {
+        double smallRate, largeRate;
+        inFile.read(reinterpret_cast<char*>(&smallRate), sizeof(smallRate));
+        inFile.read(reinterpret_cast<char*>(&largeRate), sizeof(largeRate));
+        hourlyRateSmall = legacyYuanToCents(smallRate);
+        hourlyRateLarge = legacyYuanToCents(largeRate);
+    } else {
+        inFile.read(reinterpret_cast<char*>(&hourlyRateSmall), sizeof(hourlyRateSmall));
+        inFile.read(reinterpret_cast<char*>(&hourlyRateLarge), sizeof(hourlyRateLarge));
+    }
+    // 与容量相同，超出范围的费率按异常数据处理，使用启动参数
+    if (!isValidRate(hourlyRateSmall) || !isValidRate(hourlyRateLarge)) {
+        hourlyRateSmall = defaultSmallRate;
+        hourlyRateLarge = defaultLargeRate;
+    }
     
     // 2. 读取车辆数量
     size_t vehicleCount;
     inFile.read(reinterpret_cast<char*>(&vehicleCount), sizeof(vehicleCount));
     
-    // 3. 读取每个车辆的信息
+    // 3. 读取每个车辆的信息（版本4起只有在场车辆）
     vehicles.clear();  // 清空现有数据
-    for (size_t i = 0; i < vehicleCount; ++i) {
-        // 读取车牌号
-        size_t plateLength;
-        inFile.read(reinterpret_cast<char*>(&plateLength), sizeof(plateLength));
-        std::string plate(plateLength, '\0');
-        inFile.read(&plate[0], plateLength);
-        
-        // 读取车型
-        size_t typeLength;
-        inFile.read(reinterpret_cast<char*>(&typeLength), sizeof(typeLength));
-        std::string type(typeLength, '\0');
-        inFile.read(&type[0], typeLength);
+    overstayMonitor.clear();
+    revenueRollup.clear();
+    frequentVisitors.clear();
+    stayDistributions.clear();
+    history.clear();
+    totalRevenue = 0;
+    std::vector<Vehicle> departed;  // 旧版本文件中的已出场记录
+    bool torn = !inFile;            // 数据不完整或损坏，之后的内容不再读取
+    for (size_t i = 0; i < vehicleCount && !torn; ++i) {
+        // 读取车牌号和车型（长度不合理时视为损坏，不按该长度分配内存）
+        std::string plate, type;
+        if (!readField(inFile, plate) || !readField(inFile, type)) {
+            torn = true;
+            break;
+        }
         
         // 读取时间和费用信息
         time_t entryTime, exitTime;
-        double fee;
+        Cents fee;
         inFile.read(reinterpret_cast<char*>(&entryTime), sizeof(entryTime));
         inFile.read(reinterpret_cast<char*>(&exitTime), sizeof(exitTime));
-        inFile.read(reinterpret_cast<char*>(&fee), sizeof(fee));
+        if (version == 1) {
+            double legacyFee;
+            inFile.read(reinterpret_cast<char*>(&legacyFee), sizeof(legacyFee));
+            fee = legacyYuanToCents(legacyFee);
+        } else {
+            inFile.read(reinterpret_cast<char*>(&fee), sizeof(fee));
+        }
+        if (!inFile) {
+            torn = true;
+            break;
+        }
         
-        // 创建并设置车辆对象
-        Vehicle vehicle(plate, type);
         if (exitTime != 0) {
-            // 已出场车辆需要设置完整信息
-            vehicle.setEntryTime(entryTime);
-            vehicle.setExitTime(exitTime);
-            vehicle.setFee(fee);
+            // 已出场车辆稍后按出场时间排序导入历史记录存储
+            departed.push_back(departedVehicle(plate, type, entryTime, exitTime, fee));
         } else {
-            // 在场车辆只需设置入场时间
+            // 在场车辆只需设置入场时间，并重新加入超时到期队列
+            Vehicle vehicle(plate, type);
             vehicle.setEntryTime(entryTime);
+            overstayMonitor.track(plate, type, entryTime);
+            frequentVisitors.record(plate, entryTime);
+            vehicles.emplace(plate, vehicle);
+        }
+    }
+    if (torn && version < FIRST_CHECKSUM_VERSION) {
+        std::cerr << "Truncated vehicle records in " << dataFilePath << ", kept "
+                  << vehicles.size() + departed.size() << " of " << vehicleCount << std::endl;
+    }
+
+    // 版本5起校验文件头和车辆记录；不符时丢弃其中的配置和在场车辆，数据段和历史记录各有校验和，照常读取
+    if (version >= FIRST_CHECKSUM_VERSION) {
+        bool valid = false;
+        if (!torn) {
+            const std::streamoff bodyEnd = inFile.tellg();
+            uint32_t storedChecksum = 0;
+            inFile.read(reinterpret_cast<char*>(&storedChecksum), sizeof(storedChecksum));
+            std::string body(static_cast<size_t>(bodyEnd), '\0');
+            inFile.seekg(0);
+            inFile.read(&body[0], bodyEnd);
+            inFile.seekg(bodyEnd + static_cast<std::streamoff>(sizeof(storedChecksum)));
+            valid = inFile && crc32c(body.data(), body.size()) == storedChecksum;
+        }
+        if (!valid) {
+            std::cerr << "Checksum mismatch in vehicle records of " << dataFilePath
+                      << ", discarding " << vehicles.size() << " parked vehicles" << std::endl;
+            inFile.clear();
+            capacity = defaultCapacity;
+            hourlyRateSmall = defaultSmallRate;
+            hourlyRateLarge = defaultLargeRate;
+            vehicles.clear();
+            overstayMonitor.clear();
+            frequentVisitors.clear();
         }
-        
-        // 将车辆信息添加到map中
-        vehicles.emplace(plate, vehicle);
+    }
+    currentCount = vehicles.size();  // 车辆记录不完整或被丢弃时以实际读到的为准
+    recountOccupancy();
+
+    // 4. 读取数据段（版本3起），长度超出文件末尾的视为写入中断，不再往后读取；
+    //    版本5起校验和不符的数据段同样处理（长度字段可能已损坏，无法定位下一段）
+    bool hasDistributions = false;
+    bool hasOpenSegment = false;
+    bool damagedSection = false;
+    std::string openSegment;
+    std::string snapshotEngine;     // 写快照的存储引擎，旧文件中没有
+    uint64_t snapshotSequence = 0;  // 写快照时的事件序号
+    uint32_t tag;
+    uint64_t length;
+    while (version >= 3 && !torn &&
+           inFile.read(reinterpret_cast<char*>(&tag), sizeof(tag)) &&
+           inFile.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        if (length > static_cast<uint64_t>(fileSize - inFile.tellg())) {
+            damagedSection = true;
+            break;
+        }
+        std::string payload(length, '\0');
+        inFile.read(&payload[0], length);
+        if (version >= FIRST_CHECKSUM_VERSION) {
+            uint32_t storedChecksum = 0;
+            if (!inFile.read(reinterpret_cast<char*>(&storedChecksum), sizeof(storedChecksum)) ||
+                sectionChecksum(tag, length, payload) != storedChecksum) {
+                damagedSection = true;
+                break;
+            }
+        }
+        if (tag == SECTION_STAY_DISTRIBUTION) {
+            std::istringstream section(payload, std::ios::binary);
+            hasDistributions = loadStayDistributions(section);
+        } else if (tag == SECTION_OCCUPANCY_FORECAST) {
+            std::istringstream section(payload, std::ios::binary);
+            occupancyForecaster.read(section);  // 读取失败时保留原有数据，重新学习
+        } else if (tag == SECTION_HISTORY_OPEN_SEGMENT) {
+            openSegment = std::move(payload);
+            hasOpenSegment = true;
+        } else if (tag == SECTION_HISTORY_RETENTION) {
+            if (!history.loadRetention(payload)) {
+                std::cerr << "Damaged history retention section in " << dataFilePath << std::endl;
+            }
+        } else if (tag == SECTION_OVERSTAY_LIMITS) {
+            // 在场车辆已载入，setLimit()按新时限重新计算它们的到期时间
+            std::istringstream section(payload, std::ios::binary);
+            uint64_t limitCount = 0;
+            section.read(reinterpret_cast<char*>(&limitCount), sizeof(limitCount));
+            for (uint64_t i = 0; section && i < limitCount; ++i) {
+                uint64_t typeLength = 0;
+                int64_t limit = 0;
+                section.read(reinterpret_cast<char*>(&typeLength), sizeof(typeLength));
+                if (!section || typeLength > payload.size()) {
+                    break;
+                }
+                std::string type(typeLength, '\0');
+                section.read(&type[0], typeLength);
+                section.read(reinterpret_cast<char*>(&limit), sizeof(limit));
+                if (section) {
+                    overstayMonitor.setLimit(type, static_cast<time_t>(limit));
+                }
+            }
+        } else if (tag == SECTION_STORAGE && payload.size() >= sizeof(snapshotSequence)) {
+            std::memcpy(&snapshotSequence, payload.data(), sizeof(snapshotSequence));
+            snapshotEngine = payload.substr(sizeof(snapshotSequence));
+        }
+        // 不认识的数据段直接跳过
+    }
+    if (damagedSection) {
+        std::cerr << "Damaged or truncated section in " << dataFilePath << ", ignoring the rest" << std::endl;
+    }
+
+    // 5. 重建历史记录存储，同时重建由已出场记录汇总的数据（旧版本文件没有分布数据，也由历史记录重建）；
+    //    累计营收包含已清理记录的费用
+    totalRevenue = history.getPurgedFee();
+    // 常客统计只查询最近MAX_WINDOW_DAYS天，更早的入场记录加载后也会被覆盖，直接跳过（多留一天容纳时区偏移）
+    time_t visitorHorizon = std::time(nullptr) - (FrequentVisitorTracker::MAX_WINDOW_DAYS + 1) * 86400;
+    auto rebuild = [&](const std::string& plate, const std::string& type, time_t entryTime, time_t exitTime, Cents fee) {
+        totalRevenue += fee;
+        revenueRollup.record(type, exitTime, fee);
+        if (entryTime >= visitorHorizon) {
+            frequentVisitors.record(plate, entryTime);
+        }
+        if (!hasDistributions) {
+            recordStay(type, entryTime, exitTime, fee);
+        }
+    };
+    if (version < 4) {
+        // 旧版本文件包含全部记录，段目录中的文件不属于该数据文件；
+        // 文件中的记录按车牌排列，按出场时间排序后导入，使各段的时间范围互不重叠
+        history.removeSegmentFiles();
+        std::stable_sort(departed.begin(), departed.end(), [](const Vehicle& a, const Vehicle& b) {
+            return a.getExitTime() < b.getExitTime();
+        });
+        for (const Vehicle& vehicle : departed) {
+            history.append(vehicle.getLicensePlate(), vehicle.getType(), vehicle.getEntryTime(),
+                           vehicle.getExitTime(), vehicle.getFeeCents());
+            rebuild(vehicle.getLicensePlate(), vehicle.getType(), vehicle.getEntryTime(),
+                    vehicle.getExitTime(), vehicle.getFeeCents());
+        }
+        saveData();  // 立即按新格式保存，下次启动直接加载段文件
+    } else {
+        // 未封存的段记录了已提交的段编号上限，缺失时加载段目录中的全部段
+        uint64_t committed = std::numeric_limits<uint64_t>::max();
+        hasOpenSegment = hasOpenSegment && HistoryStore::readCommittedSegments(openSegment, committed);
+        history.loadSegments(committed, std::time(nullptr), rebuild);
+        if (hasOpenSegment && !history.loadOpenSegment(openSegment, rebuild)) {
+            std::cerr << "Damaged open history segment in " << dataFilePath << std::endl;
+        }
+    }
+
+    // 6. 重放快照之后追加的事件。快照不是当前引擎写的（切换了引擎）时，从写快照的引擎重放，
+    //    再写一次快照，当前引擎中不属于这个快照的事件随之丢弃；事件序号不接续快照时不重放。
+    //    复制基准中的事件序号属于主节点的引擎，不重放
+    if (!replay) {
+        return true;
+    }
+    if (snapshotEngine == storage->name()) {
+        if (snapshotSequence <= storage->lastSequence()) {
+            replayEvents(*storage, snapshotSequence);
+        } else {
+            saveData();
+        }
+    } else {
+        if (!snapshotEngine.empty()) {
+            try {
+                std::unique_ptr<StorageEngine> previous = createStorageEngine(snapshotEngine, dataFilePath);
+                if (snapshotSequence <= previous->lastSequence()) {
+                    replayEvents(*previous, snapshotSequence);
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Cannot replay events of storage engine " << snapshotEngine << ": " << e.what() << std::endl;
+            }
+        }
+        saveData();
     }
     
     return true;  // 加载成功
 }
 
-void ParkingLot::setRate(double smallRate, double largeRate) {
+bool ParkingLot::loadStayDistributions(std::istream& in) {
+    uint64_t count = 0;
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+    bool ok = static_cast<bool>(in);
+    for (uint64_t i = 0; ok && i < count; ++i) {
+        time_t day;
+        uint64_t typeLength;
+        in.read(reinterpret_cast<char*>(&day), sizeof(day));
+        in.read(reinterpret_cast<char*>(&typeLength), sizeof(typeLength));
+        if (!in || typeLength > 256) {
+            ok = false;  // 数据损坏
+            break;
+        }
+        std::string type(typeLength, '\0');
+        in.read(&type[0], typeLength);
+
+        StayDistribution& distribution = stayDistributions[{day, type}];
+        ok = distribution.duration.read(in) && distribution.fee.read(in);
+    }
+
+    if (!ok) {
+        stayDistributions.clear();  // 读取失败时丢弃不完整的数据，由调用者重建
+        in.clear();
+    }
+    return ok;
+}
+
+void ParkingLot::pruneStayDistributions(time_t horizon) {
+    time_t day = RevenueRollup::bucketStart(RollupGranularity::Day, horizon);
+    stayDistributions.erase(stayDistributions.begin(), stayDistributions.lower_bound({day, std::string()}));
+}
+
+void ParkingLot::recordStay(const std::string& type, time_t entryTime, time_t exitTime, Cents fee) {
+    time_t day = RevenueRollup::bucketStart(RollupGranularity::Day, exitTime);
+    StayDistribution& distribution = stayDistributions[{day, type}];
+    distribution.duration.record(exitTime - entryTime);
+    distribution.fee.record(fee);
+}
+
+void ParkingLot::setRate(Cents smallRate, Cents largeRate) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
     // 更新费率
     hourlyRateSmall = smallRate;
     hourlyRateLarge = largeRate;
     // 保存更新后的配置
     saveData();
+
+    ReplicationRecord record;
+    record.kind = ReplicationRecordKind::Rates;
+    record.smallRate = smallRate;
+    record.largeRate = largeRate;
+    publish(record);
 }
 
 std::vector<Vehicle> ParkingLot::getHistoryVehicles() const {
-    // 创建结果vector，预留足够空间避免重复分配
-    std::vector<Vehicle> history;
-    history.reserve(vehicles.size());
-    
-    // 遍历所有车辆，筛选已出场的车辆
-    for (const auto& [_, vehicle] : vehicles) {
-        if (vehicle.getExitTime() != 0) {  // exitTime非0表示已出场
-            history.push_back(vehicle);
-        }
-    }
-    
-    return history;
+    std::vector<Vehicle> departed;
+    scanHistory(std::numeric_limits<time_t>::min(), std::numeric_limits<time_t>::max(), HistoryStore::CHUNK_ROWS,
+                [&](const std::vector<Vehicle>& batch) {
+                    departed.insert(departed.end(), batch.begin(), batch.end());
+                    return true;
+                });
+    return departed;
 }
 
 std::vector<Vehicle> ParkingLot::getCurrentVehicles() const {
-    // 创建结果vector，预留空间为当前在场车辆数
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    // 车辆表中只有在场车辆
     std::vector<Vehicle> current;
-    current.reserve(currentCount);
-    
-    // 遍历所有车辆，筛选在场的车辆
+    current.reserve(vehicles.size());
     for (const auto& [_, vehicle] : vehicles) {
-        if (vehicle.getExitTime() == 0) {  // exitTime为0表示在场
-            current.push_back(vehicle);
-        }
+        current.push_back(vehicle);
     }
     
     return current;
-}
\ No newline at end of file
+}
+
+void ParkingLot::scanHistory(time_t from, time_t to, size_t batchSize,
+                             const std::function<bool(const std::vector<Vehicle>&)>& consumer) const {
+    batchSize = std::max<size_t>(batchSize, 1);
+    std::vector<Vehicle> batch;
+    batch.reserve(batchSize);
+
+    // 快照共享已封存的段，之后逐段读取，同一时刻最多加载一段
+    HistorySnapshot snapshot = getHistorySnapshot(true);
+    for (size_t i = 0; i < snapshot.segments.size(); ++i) {
+        auto rows = snapshot.rowsOf(i, from, to);
+        if (!rows) {
+            continue;
+        }
+        for (size_t row = 0; row < rows->size(); ++row) {
+            batch.push_back(departedVehicle(snapshot.plates[rows->plate[row]], snapshot.types[rows->type[row]],
+                                            rows->entryTime[row], rows->exitTime[row], rows->fee[row]));
+            if (batch.size() == batchSize) {
+                if (!consumer(batch)) {
+                    return;
+                }
+                batch.clear();
+            }
+        }
+    }
+
+    if (!batch.empty()) {
+        consumer(batch);
+    }
+}
+
+HistorySnapshot ParkingLot::getHistorySnapshot(bool withPlates) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return history.snapshot(withPlates);
+}
+
+void ParkingLot::setHistoryTiering(time_t hotWindow, uint64_t cacheBytes) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    history.setTiering(hotWindow, cacheBytes, std::time(nullptr));
+    saveData();
+
+    ReplicationRecord record;
+    record.kind = ReplicationRecordKind::HistoryTiering;
+    record.hotWindow = hotWindow;
+    record.cacheBytes = cacheBytes;
+    publish(record);
+}
+
+void ParkingLot::setHistoryRetention(time_t retention) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    history.setRetention(retention);
+    saveData();
+
+    ReplicationRecord record;
+    record.kind = ReplicationRecordKind::HistoryRetention;
+    record.retention = retention;
+    publish(record);
+}
+
+bool ParkingLot::expireHistory(time_t now) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    HistoryExpiry expiry = history.expire(now);
+    if (expiry.rows > 0) {
+        revenueRollup.prune(expiry.horizon);
+        pruneStayDistributions(expiry.horizon);
+        // 先保存数据文件记录清理进度，之后的步骤才删除段文件
+        saveData();
+    }
+    return expiry.more;
+}
+
+bool ParkingLot::compactHistory(time_t now) {
+    std::lock_guard<std::mutex> compactionLock(compactionMutex);
+    HistoryCompaction compaction;
+    {
+        std::lock_guard<std::recursive_mutex> lock(dataMutex);
+        compaction = history.planCompaction(now);
+    }
+    if (compaction.empty()) {
+        return false;
+    }
+    // 源段文件创建后不再修改，读取、合并和写入都在锁外进行，不阻塞入场/出场
+    compaction.build();
+
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    if (!history.commitCompaction(compaction, now)) {
+        return false;
+    }
+    // 先保存数据文件，之后的清理步骤才删除源段文件
+    saveData();
+    return true;
+}
+
+void ParkingLot::setReplicationListener(std::function<void(const ReplicationRecord&)> listener) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    replicationListener = std::move(listener);
+}
+
+void ParkingLot::setOccupancyListener(std::function<void(size_t, size_t, const std::map<std::string, size_t>&)> listener) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    occupancyListener = std::move(listener);
+    notifyOccupancy();
+}
+
+void ParkingLot::setBackgroundExecutor(std::function<bool(const std::string&, std::function<void()>)> executor) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    backgroundExecutor = std::move(executor);
+}
+
+void ParkingLot::recountOccupancy() {
+    occupiedByType.clear();
+    occupiedByType["小型"] = 0;
+    occupiedByType["大型"] = 0;
+    for (const auto& entry : vehicles) {
+        occupiedByType[entry.second.getType()]++;
+    }
+}
+
+void ParkingLot::notifyOccupancy() {
+    if (occupancyListener) {
+        occupancyListener(capacity, currentCount, occupiedByType);
+    }
+}
+
+uint64_t ParkingLot::getReplicationPosition() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return replicationPosition;
+}
+
+ReplicationBase ParkingLot::getReplicationBase() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    ReplicationBase base;
+    base.position = replicationPosition;
+    base.snapshot = encodeSnapshot();
+    base.history = history.snapshot(false);
+    return base;
+}
+
+void ParkingLot::applyReplicated(const std::vector<ReplicationRecord>& records) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    bool snapshot = false;  // 设置类的记录和追加失败的事件都由批末的一次快照保存
+    size_t skipped = 0;
+    time_t now = std::time(nullptr);
+    for (const ReplicationRecord& record : records) {
+        replicationPosition = record.position;
+        switch (record.kind) {
+            case ReplicationRecordKind::Entry:
+            case ReplicationRecordKind::Exit: {
+                auto it = vehicles.find(record.event.plate);
+                if (record.kind == ReplicationRecordKind::Entry && it == vehicles.end()) {
+                    applyEntry(record.event.plate, record.event.type, record.event.entryTime);
+                } else if (record.kind == ReplicationRecordKind::Exit && it != vehicles.end()) {
+                    applyExit(it, record.event.exitTime, record.event.fee);
+                } else {
+                    ++skipped;
+                    break;
+                }
+                // 序号由本地引擎重新分配；不等待写入磁盘，提升时内存中的状态已是最新
+                StorageEvent event = record.event;
+                snapshot = !storage->append(event) || snapshot;
+                break;
+            }
+            case ReplicationRecordKind::Rates:
+                if (!isValidRate(record.smallRate) || !isValidRate(record.largeRate)) {
+                    std::cerr << "Ignoring out-of-range replicated rates " << record.smallRate << "/"
+                              << record.largeRate << std::endl;
+                    break;
+                }
+                hourlyRateSmall = record.smallRate;
+                hourlyRateLarge = record.largeRate;
+                snapshot = true;
+                break;
+            case ReplicationRecordKind::HistoryTiering:
+                history.setTiering(record.hotWindow, record.cacheBytes, now);
+                snapshot = true;
+                break;
+            case ReplicationRecordKind::HistoryRetention:
+                history.setRetention(record.retention);
+                snapshot = true;
+                break;
+            case ReplicationRecordKind::OverstayLimit:
+                overstayMonitor.setLimit(record.limitType, record.limit);
+                snapshot = true;
+                break;
+        }
+    }
+    if (snapshot || storage->pendingEvents() >= storage->snapshotInterval()) {
+        saveData();
+    }
+    if (skipped > 0) {
+        std::cerr << "Skipped " << skipped << " replicated events inconsistent with local state" << std::endl;
+    }
+}
+
+bool ParkingLot::loadReplicationBase(uint64_t position, const std::string& snapshot, const std::string& segmentDirectory) {
+    // 合并在锁外写段目录，载入期间不能进行
+    std::lock_guard<std::mutex> compactionLock(compactionMutex);
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    history.removeSegmentFiles();
+    history.adoptSegmentFiles(segmentDirectory);
+    std::istringstream in(snapshot, std::ios::binary);
+    if (!loadSnapshot(in, false)) {
+        return false;
+    }
+    replicationPosition = position;
+    saveData();
+
+    // 与构造时相同，以载入后的占用数作为时间序列和预测器的新起点
+    time_t now = std::time(nullptr);
+    occupancySeries.record(now, static_cast<uint32_t>(currentCount));
+    occupancyForecaster.record(now, static_cast<uint32_t>(currentCount));
+    notifyOccupancy();
+    return true;
+}
+
+int32_t ParkingLot::findHistoryPlate(const std::string& plate) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return history.findPlate(plate);
+}
+
+HistoryStorageStats ParkingLot::getHistoryStorageStats() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return history.stats();
+}
+
+Cents ParkingLot::getSmallRate() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return hourlyRateSmall;
+}
+
+Cents ParkingLot::getLargeRate() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return hourlyRateLarge;
+}
+
+Cents ParkingLot::getTotalRevenue() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return totalRevenue;
+}
+
+std::vector<RollupBucket> ParkingLot::getRevenueRollup(RollupGranularity granularity, time_t from, time_t to) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return revenueRollup.query(granularity, from, to);
+}
+
+std::vector<OccupancyPoint> ParkingLot::getOccupancySeries(OccupancyResolution resolution, time_t from, time_t to) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return occupancySeries.query(resolution, from, to, std::time(nullptr));
+}
+
+OccupancyForecast ParkingLot::forecastOccupancy(time_t horizon) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return occupancyForecaster.forecast(std::time(nullptr), horizon,
+                                        static_cast<uint32_t>(currentCount), static_cast<uint32_t>(capacity));
+}
+
+std::vector<VisitorCount> ParkingLot::getFrequentVisitors(size_t k, int windowDays) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return frequentVisitors.topK(k, windowDays, std::time(nullptr));
+}
+
+StayDistributionTable ParkingLot::getStayDistributions(time_t from, time_t to) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+
+    StayDistributionTable result;
+    time_t firstDay = RevenueRollup::bucketStart(RollupGranularity::Day, from);
+    auto end = stayDistributions.lower_bound({to, std::string()});
+    for (auto it = stayDistributions.lower_bound({firstDay, std::string()}); it != end && firstDay < to; ++it) {
+        result.insert(*it);
+    }
+    return result;
+}
+
+time_t ParkingLot::getOccupancyRetention(OccupancyResolution resolution) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return occupancySeries.retentionOf(resolution);
+}
+
+void ParkingLot::loadOccupancySeries() {
+    const std::string path = dataFilePath + ".occupancy";
+    std::error_code error;
+    if (!storage->hasSnapshot()) {
+        // 与段文件相同，没有快照时残留的时间序列也不再有效
+        std::filesystem::remove(path, error);
+        return;
+    }
+    if (std::filesystem::exists(path, error) && !occupancySeries.load(path)) {
+        std::cerr << "Damaged occupancy series file " << path << std::endl;
+    }
+}
+
+bool ParkingLot::saveOccupancySeries() {
+    // 在锁内只复制缓冲区，在锁外写文件
+    OccupancySeries series;
+    {
+        std::lock_guard<std::recursive_mutex> lock(dataMutex);
+        if (!occupancySeriesDirty) {
+            return false;
+        }
+        series = occupancySeries;
+        occupancySeriesDirty = false;
+    }
+    const std::string path = dataFilePath + ".occupancy";
+    if (!series.save(path)) {
+        std::cerr << "Failed to save occupancy series to " << path << std::endl;
+        std::lock_guard<std::recursive_mutex> lock(dataMutex);
+        occupancySeriesDirty = true;  // 下次重试
+        return false;
+    }
+    return true;
+}
+
+void ParkingLot::setOverstayLimit(const std::string& type, time_t seconds) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    overstayMonitor.setLimit(type, seconds);
+    saveData();
+
+    ReplicationRecord record;
+    record.kind = ReplicationRecordKind::OverstayLimit;
+    record.limitType = type;
+    record.limit = seconds;
+    publish(record);
+}
+
+time_t ParkingLot::getOverstayLimit(const std::string& type) const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return overstayMonitor.getLimit(type);
+}
+
+void ParkingLot::setOverstayListener(std::function<void(const OverstayEvent&)> listener) {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    overstayListener = std::move(listener);
+}
+
+std::vector<OverstayEvent> ParkingLot::checkOverstays(time_t now) {
+    std::vector<OverstayEvent> fired;
+    std::function<void(const OverstayEvent&)> listener;
+    {
+        std::lock_guard<std::recursive_mutex> lock(dataMutex);
+        fired = overstayMonitor.poll(now);
+        listener = overstayListener;
+    }
+
+    // 在锁外通知监听者，避免回调中再访问停车场时产生死锁或阻塞请求线程
+    if (listener) {
+        for (const auto& event : fired) {
+            listener(event);
+        }
+    }
+    return fired;
+}
+
+std::vector<OverstayEvent> ParkingLot::getOverstayingVehicles() const {
+    std::lock_guard<std::recursive_mutex> lock(dataMutex);
+    return overstayMonitor.getOverstaying();
+}
@@ -0,0 +1,432 @@
+/**
+ * @file partitioned_lot.cpp
+ * @brief 分区停车场的具体实现：按车牌转发，全局操作写入每个分区，查询结果合并
+ */
+#include "include/partitioned_lot.h"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+PartitionedLot::PartitionedLot(std::vector<std::unique_ptr<ParkingLot>> lots, const std::string& seriesFile)
+    : partitions(std::move(lots))
+    , capacity(0)
+    , occupied(0)
+    , seriesFile(seriesFile) {
+    if (partitions.empty() || partitions.size() > MAX_PARTITIONS) {
+        throw std::invalid_argument("Partition count must be between 1 and " + std::to_string(MAX_PARTITIONS));
+    }
+    capacity = partitions[0]->getAvailableSpaces() + partitions[0]->getOccupiedSpaces();
+    size_t total = 0;
+    for (const auto& lot : partitions) {
+        total += lot->getOccupiedSpaces();
+    }
+    occupied = total;
+    if (partitions.size() > 1) {
+        // 各分区默认各有一份冷段缓存，改为共用一份预算
+        HistoryStorageStats stats = partitions[0]->getHistoryStorageStats();
+        setHistoryTiering(stats.hotWindow, stats.cache.budget);
+
+        // 整个停车场的占用时间序列：载入上次保存的点，以启动时的占用数为起点，之后随各分区的回调记录
+        std::error_code error;
+        if (!seriesFile.empty() && std::filesystem::exists(seriesFile, error) && !series.load(seriesFile)) {
+            std::cerr << "Damaged occupancy series file " << seriesFile << std::endl;
+        }
+        // 先填好各分区的占用数，设置回调时立即回调一次，记录的仍是总数
+        for (const auto& lot : partitions) {
+            partitionOccupied.push_back(lot->getOccupiedSpaces());
+        }
+        seriesOccupied = total;
+        for (size_t k = 0; k < partitions.size(); ++k) {
+            partitions[k]->setOccupancyListener([this, k](size_t, size_t partitionOccupancy,
+                                                          const std::map<std::string, size_t>&) {
+                onPartitionOccupancy(k, partitionOccupancy);
+            });
+        }
+    }
+}
+
+PartitionedLot::~PartitionedLot() {
+    if (partitions.size() > 1) {
+        for (const auto& lot : partitions) {
+            lot->setOccupancyListener(nullptr);
+        }
+    }
+}
+
+void PartitionedLot::onPartitionOccupancy(size_t index, size_t partitionOccupancy) {
+    // 在该分区的锁内调用，同一分区的回调按发生顺序；不同分区的回调由seriesMutex排队，
+    // 每次记录的都是某一时刻各分区占用数之和
+    std::lock_guard<std::mutex> lock(seriesMutex);
+    seriesOccupied = seriesOccupied - partitionOccupied[index] + partitionOccupancy;
+    partitionOccupied[index] = partitionOccupancy;
+    series.record(std::time(nullptr), static_cast<uint32_t>(seriesOccupied));
+    seriesDirty = true;
+}
+
+PartitionedLot::PartitionedLot(std::unique_ptr<ParkingLot> lot)
+    : PartitionedLot([&lot] {
+        std::vector<std::unique_ptr<ParkingLot>> single;
+        single.push_back(std::move(lot));
+        return single;
+    }()) {}
+
+size_t PartitionedLot::partitionIndex(const std::string& plate, size_t partitionCount) {
+    // 分区编号随数据保存，必须在不同版本、不同平台上保持不变，因此不用std::hash
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : plate) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash % partitionCount);
+}
+
+bool PartitionedLot::addVehicle(const std::string& plate, const std::string& type) {
+    if (partitions.size() == 1) {
+        return partitions[0]->addVehicle(plate, type);
+    }
+    // 先预占车位，满了直接拒绝；车辆已在场等原因入场失败时归还
+    size_t current = occupied.load();
+    do {
+        if (current >= capacity) {
+            return false;
+        }
+    } while (!occupied.compare_exchange_weak(current, current + 1));
+    if (!partitionOf(plate).addVehicle(plate, type)) {
+        occupied.fetch_sub(1);
+        return false;
+    }
+    return true;
+}
+
+bool PartitionedLot::removeVehicle(const std::string& plate, Vehicle& outVehicle) {
+    if (!partitionOf(plate).removeVehicle(plate, outVehicle)) {
+        return false;
+    }
+    if (partitions.size() > 1) {
+        occupied.fetch_sub(1);
+    }
+    return true;
+}
+
+bool PartitionedLot::queryVehicle(const std::string& plate, Vehicle& outVehicle) const {
+    return partitionOf(plate).queryVehicle(plate, outVehicle);
+}
+
+std::vector<Vehicle> PartitionedLot::getVehicleVisits(const std::string& plate) const {
+    return partitionOf(plate).getVehicleVisits(plate);
+}
+
+size_t PartitionedLot::getAvailableSpaces() const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getAvailableSpaces();
+    }
+    return capacity - std::min(capacity, occupied.load());
+}
+
+size_t PartitionedLot::getOccupiedSpaces() const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getOccupiedSpaces();
+    }
+    return std::min(capacity, occupied.load());
+}
+
+bool PartitionedLot::saveData() const {
+    bool saved = true;
+    for (const auto& lot : partitions) {
+        saved = lot->saveData() && saved;
+    }
+    return saved;
+}
+
+void PartitionedLot::setRate(Cents smallRate, Cents largeRate) {
+    for (const auto& lot : partitions) {
+        lot->setRate(smallRate, largeRate);
+    }
+}
+
+Cents PartitionedLot::getSmallRate() const {
+    return partitions[0]->getSmallRate();
+}
+
+Cents PartitionedLot::getLargeRate() const {
+    return partitions[0]->getLargeRate();
+}
+
+Cents PartitionedLot::getTotalRevenue() const {
+    Cents total = 0;
+    for (const auto& lot : partitions) {
+        total += lot->getTotalRevenue();
+    }
+    return total;
+}
+
+std::vector<Vehicle> PartitionedLot::getHistoryVehicles() const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getHistoryVehicles();
+    }
+    std::vector<Vehicle> departed;
+    for (const auto& lot : partitions) {
+        std::vector<Vehicle> part = lot->getHistoryVehicles();
+        departed.insert(departed.end(), part.begin(), part.end());
+    }
+    std::stable_sort(departed.begin(), departed.end(), [](const Vehicle& a, const Vehicle& b) {
+        return a.getExitTime() < b.getExitTime();
+    });
+    return departed;
+}
+
+std::vector<Vehicle> PartitionedLot::getCurrentVehicles() const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getCurrentVehicles();
+    }
+    std::vector<Vehicle> current;
+    for (const auto& lot : partitions) {
+        std::vector<Vehicle> part = lot->getCurrentVehicles();
+        current.insert(current.end(), part.begin(), part.end());
+    }
+    std::sort(current.begin(), current.end(), [](const Vehicle& a, const Vehicle& b) {
+        return a.getLicensePlate() < b.getLicensePlate();
+    });
+    return current;
+}
+
+void PartitionedLot::scanHistory(time_t from, time_t to, size_t batchSize,
+                                 const std::function<bool(const std::vector<Vehicle>&)>& consumer) const {
+    bool more = true;
+    for (const auto& lot : partitions) {
+        lot->scanHistory(from, to, batchSize, [&](const std::vector<Vehicle>& batch) {
+            more = consumer(batch);
+            return more;
+        });
+        if (!more) {
+            break;
+        }
+    }
+}
+
+void PartitionedLot::setHistoryTiering(time_t hotWindow, uint64_t cacheBytes) {
+    // 缓存预算是整个停车场的，按分区均分
+    uint64_t share = std::max<uint64_t>(1, cacheBytes / partitions.size());
+    for (const auto& lot : partitions) {
+        lot->setHistoryTiering(hotWindow, share);
+    }
+}
+
+void PartitionedLot::setHistoryRetention(time_t retention) {
+    for (const auto& lot : partitions) {
+        lot->setHistoryRetention(retention);
+    }
+}
+
+bool PartitionedLot::expireHistory(time_t now) {
+    bool more = false;
+    for (const auto& lot : partitions) {
+        more = lot->expireHistory(now) || more;
+    }
+    return more;
+}
+
+bool PartitionedLot::compactHistory(time_t now) {
+    bool more = false;
+    for (const auto& lot : partitions) {
+        more = lot->compactHistory(now) || more;
+    }
+    return more;
+}
+
+HistoryStorageStats PartitionedLot::getHistoryStorageStats() const {
+    HistoryStorageStats total = partitions[0]->getHistoryStorageStats();
+    for (size_t i = 1; i < partitions.size(); ++i) {
+        HistoryStorageStats part = partitions[i]->getHistoryStorageStats();
+        total.rows += part.rows;
+        total.segments += part.segments;
+        total.level0Segments += part.level0Segments;
+        total.residentSegments += part.residentSegments;
+        total.residentBytes += part.residentBytes;
+        total.diskBytes += part.diskBytes;
+        total.openRows += part.openRows;
+        total.purgedRows += part.purgedRows;
+        total.compactions += part.compactions;
+        total.compactedRows += part.compactedRows;
+        total.filterBytes += part.filterBytes;
+        total.cache.entries += part.cache.entries;
+        total.cache.bytes += part.cache.bytes;
+        total.cache.budget += part.cache.budget;
+        total.cache.hits += part.cache.hits;
+        total.cache.misses += part.cache.misses;
+    }
+    return total;
+}
+
+std::vector<RollupBucket> PartitionedLot::getRevenueRollup(RollupGranularity granularity, time_t from, time_t to) const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getRevenueRollup(granularity, from, to);
+    }
+    std::map<time_t, RollupBucket> merged;
+    for (const auto& lot : partitions) {
+        for (const RollupBucket& bucket : lot->getRevenueRollup(granularity, from, to)) {
+            RollupBucket& target = merged[bucket.start];
+            target.start = bucket.start;
+            target.total.visits += bucket.total.visits;
+            target.total.revenue += bucket.total.revenue;
+            for (const auto& [type, counters] : bucket.byType) {
+                target.byType[type].visits += counters.visits;
+                target.byType[type].revenue += counters.revenue;
+            }
+        }
+    }
+    std::vector<RollupBucket> result;
+    result.reserve(merged.size());
+    for (auto& entry : merged) {
+        result.push_back(std::move(entry.second));
+    }
+    return result;
+}
+
+std::vector<OccupancyPoint> PartitionedLot::getOccupancySeries(OccupancyResolution resolution, time_t from, time_t to) const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getOccupancySeries(resolution, from, to);
+    }
+    std::lock_guard<std::mutex> lock(seriesMutex);
+    return series.query(resolution, from, to, std::time(nullptr));
+}
+
+time_t PartitionedLot::getOccupancyRetention(OccupancyResolution resolution) const {
+    return partitions[0]->getOccupancyRetention(resolution);
+}
+
+bool PartitionedLot::saveOccupancySeries() {
+    if (partitions.size() == 1) {
+        return partitions[0]->saveOccupancySeries();
+    }
+    // 各分区自己的时间序列不再被查询，不必保存
+    OccupancySeries copy;
+    {
+        std::lock_guard<std::mutex> lock(seriesMutex);
+        if (!seriesDirty || seriesFile.empty()) {
+            return false;
+        }
+        copy = series;
+        seriesDirty = false;
+    }
+    if (!copy.save(seriesFile)) {
+        std::cerr << "Failed to save occupancy series to " << seriesFile << std::endl;
+        std::lock_guard<std::mutex> lock(seriesMutex);
+        seriesDirty = true;
+        return false;
+    }
+    return true;
+}
+
+StayDistributionTable PartitionedLot::getStayDistributions(time_t from, time_t to) const {
+    StayDistributionTable merged = partitions[0]->getStayDistributions(from, to);
+    for (size_t i = 1; i < partitions.size(); ++i) {
+        for (const auto& [key, distribution] : partitions[i]->getStayDistributions(from, to)) {
+            merged[key].merge(distribution);
+        }
+    }
+    return merged;
+}
+
+std::vector<VisitorCount> PartitionedLot::getFrequentVisitors(size_t k, int windowDays) const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getFrequentVisitors(k, windowDays);
+    }
+    // 同一车牌只在一个分区出现，合并各分区的前k名再取前k名即为整体的前k名
+    std::vector<VisitorCount> merged;
+    for (const auto& lot : partitions) {
+        std::vector<VisitorCount> part = lot->getFrequentVisitors(k, windowDays);
+        merged.insert(merged.end(), part.begin(), part.end());
+    }
+    std::sort(merged.begin(), merged.end(), [](const VisitorCount& a, const VisitorCount& b) {
+        return a.visits != b.visits ? a.visits > b.visits : a.licensePlate < b.licensePlate;
+    });
+    if (merged.size() > k) {
+        merged.resize(k);
+    }
+    return merged;
+}
+
+OccupancyForecast PartitionedLot::forecastOccupancy(time_t horizon) const {
+    if (partitions.size() == 1) {
+        return partitions[0]->forecastOccupancy(horizon);
+    }
+    // 各分区的预测值相加；分区的容量是整个停车场的，各自的fullIn没有意义，按合计重新查找
+    auto predictAt = [this](time_t ahead, uint32_t* samples) {
+        double total = 0;
+        for (const auto& lot : partitions) {
+            OccupancyForecast part = lot->forecastOccupancy(ahead);
+            total += part.predicted;
+            if (samples != nullptr) {
+                *samples = std::min(*samples, part.samples);
+            }
+        }
+        return std::min(total, static_cast<double>(capacity));
+    };
+
+    OccupancyForecast result;
+    result.samples = UINT32_MAX;
+    result.predicted = predictAt(horizon, &result.samples);
+    result.fullIn = -1;
+    if (getOccupiedSpaces() >= capacity) {
+        result.fullIn = 0;
+    } else {
+        for (time_t ahead = OccupancyForecaster::BUCKET_SECONDS; ahead <= 24 * 3600;
+             ahead += OccupancyForecaster::BUCKET_SECONDS) {
+            if (predictAt(ahead, nullptr) >= capacity) {
+                result.fullIn = ahead;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+void PartitionedLot::setOverstayLimit(const std::string& type, time_t seconds) {
+    for (const auto& lot : partitions) {
+        lot->setOverstayLimit(type, seconds);
+    }
+}
+
+time_t PartitionedLot::getOverstayLimit(const std::string& type) const {
+    return partitions[0]->getOverstayLimit(type);
+}
+
+void PartitionedLot::setOverstayListener(std::function<void(const OverstayEvent&)> listener) {
+    for (const auto& lot : partitions) {
+        lot->setOverstayListener(listener);
+    }
+}
+
+void PartitionedLot::setBackgroundExecutor(std::function<bool(const std::string&, std::function<void()>)> executor) {
+    for (const auto& lot : partitions) {
+        lot->setBackgroundExecutor(executor);
+    }
+}
+
+std::vector<OverstayEvent> PartitionedLot::checkOverstays(time_t now) {
+    std::vector<OverstayEvent> fired;
+    for (const auto& lot : partitions) {
+        std::vector<OverstayEvent> part = lot->checkOverstays(now);
+        fired.insert(fired.end(), part.begin(), part.end());
+    }
+    return fired;
+}
+
+std::vector<OverstayEvent> PartitionedLot::getOverstayingVehicles() const {
+    if (partitions.size() == 1) {
+        return partitions[0]->getOverstayingVehicles();
+    }
+    std::vector<OverstayEvent> overstaying;
+    for (const auto& lot : partitions) {
+        std::vector<OverstayEvent> part = lot->getOverstayingVehicles();
+        overstaying.insert(overstaying.end(), part.begin(), part.end());
+    }
+    std::sort(overstaying.begin(), overstaying.end(), [](const OverstayEvent& a, const OverstayEvent& b) {
+        return a.deadline < b.deadline;
+    });
+    return overstaying;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file quantile_histogram.cpp
+ * @brief QuantileHistogram类的具体实现
+ */
+#include "include/quantile_histogram.h"
+#include <cmath>
+
+namespace {
+const uint32_t LINEAR_BUCKETS = 1u << 8;           // 精确区间的桶数（与PRECISION_BITS一致）
+const uint32_t SUB_BUCKETS = LINEAR_BUCKETS / 2;   // 每个2的幂区间内的桶数
+const uint32_t MAX_BUCKETS = LINEAR_BUCKETS + 56 * SUB_BUCKETS;  // 覆盖全部uint64取值
+}
+
+QuantileHistogram::QuantileHistogram()
+    : totalCount(0)
+{
+}
+
+uint32_t QuantileHistogram::bucketIndex(uint64_t value) {
+    if (value < LINEAR_BUCKETS) {
+        return static_cast<uint32_t>(value);
+    }
+    // 最高有效位决定所在的2的幂区间，其后PRECISION_BITS-1位决定区间内的桶
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (PRECISION_BITS - 1);
+    uint32_t sub = static_cast<uint32_t>(value >> shift);  // 范围[SUB_BUCKETS, LINEAR_BUCKETS)
+    return LINEAR_BUCKETS + (shift - 1) * SUB_BUCKETS + (sub - SUB_BUCKETS);
+}
+
+uint64_t QuantileHistogram::bucketLowerBound(uint32_t index) {
+    if (index < LINEAR_BUCKETS) {
+        return index;
+    }
+    uint32_t offset = index - LINEAR_BUCKETS;
+    int shift = static_cast<int>(offset / SUB_BUCKETS) + 1;
+    uint64_t sub = offset % SUB_BUCKETS + SUB_BUCKETS;
+    return sub << shift;
+}
+
+uint64_t QuantileHistogram::bucketWidth(uint32_t index) {
+    if (index < LINEAR_BUCKETS) {
+        return 1;
+    }
+    int shift = static_cast<int>((index - LINEAR_BUCKETS) / SUB_BUCKETS) + 1;
+    return uint64_t(1) << shift;
+}
+
+void QuantileHistogram::record(int64_t value) {
+    buckets[bucketIndex(value > 0 ? static_cast<uint64_t>(value) : 0)]++;
+    totalCount++;
+}
+
+void QuantileHistogram::merge(const QuantileHistogram& other) {
+    for (const auto& [index, count] : other.buckets) {
+        buckets[index] += count;
+    }
+    totalCount += other.totalCount;
+}
+
+int64_t QuantileHistogram::quantile(double q) const {
+    if (totalCount == 0) {
+        return 0;
+    }
+    q = q < 0 ? 0 : (q > 1 ? 1 : q);
+
+    // 第rank个样本（从1开始）所在的桶
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(totalCount)));
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (const auto& [index, count] : buckets) {
+        seen += count;
+        if (seen >= rank) {
+            return static_cast<int64_t>(bucketLowerBound(index) + (bucketWidth(index) - 1) / 2);
+        }
+    }
+    return static_cast<int64_t>(bucketLowerBound(buckets.rbegin()->first));
+}
+
+void QuantileHistogram::write(std::ostream& out) const {
+    uint64_t bucketCount = buckets.size();
+    out.write(reinterpret_cast<const char*>(&bucketCount), sizeof(bucketCount));
+    for (const auto& [index, count] : buckets) {
+        out.write(reinterpret_cast<const char*>(&index), sizeof(index));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+}
+
+bool QuantileHistogram::read(std::istream& in) {
+    buckets.clear();
+    totalCount = 0;
+
+    uint64_t bucketCount = 0;
+    in.read(reinterpret_cast<char*>(&bucketCount), sizeof(bucketCount));
+    if (!in || bucketCount > MAX_BUCKETS) {
+        return false;  // 数据损坏
+    }
+
+    for (uint64_t i = 0; i < bucketCount; ++i) {
+        uint32_t index;
+        uint64_t count;
+        in.read(reinterpret_cast<char*>(&index), sizeof(index));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!in || index >= MAX_BUCKETS) {
+            return false;
+        }
+        buckets[index] += count;
+        totalCount += count;
+    }
+    return true;
+}
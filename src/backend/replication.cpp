@@ -0,0 +1,685 @@
+/**
+ * @file replication.cpp
+ * @brief 复制发布者（主节点）和复制跟随者（备用节点）的具体实现
+ */
+#include "include/replication.h"
+#include "include/parking_lot.h"
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+// 连接协议：备用节点连接后先发送握手（uint32 标识"PKRP"，uint32 版本，uint64 上次的主节点标识，
+// uint64 上次应用的位置，首次连接时都为0）；之后主节点发送帧，每帧为uint8 类型、uint64 长度、内容
+const uint32_t REPLICATION_MAGIC = 0x50524B50;  // "PKRP"
+const uint32_t REPLICATION_VERSION = 1;
+const uint64_t MAX_FRAME_BYTES = 1ull << 32;    // 单帧内容的上限，超出说明数据损坏
+
+enum class FrameType : uint8_t {
+    Base = 1,       // 基准开始：uint64 主节点标识，uint64 位置，快照
+    Segment = 2,    // 基准中的一个段文件：uint32 文件名长度和文件名，文件内容
+    BaseEnd = 3,    // 基准结束，之后发送位置大于基准的记录
+    Resume = 4,     // 续传：uint64 主节点标识，uint64 位置，之后发送位置大于它的记录
+    Records = 5,    // 一批记录：uint64 主节点最新位置，uint32 条数，各条记录
+    Heartbeat = 6   // 心跳：uint64 主节点最新位置，int64 主节点时间（毫秒）
+};
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool get(const char*& p, const char* end, T& value) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+void putString(std::string& out, const std::string& value) {
+    put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+bool getString(const char*& p, const char* end, std::string& value) {
+    uint32_t length;
+    if (!get(p, end, length) || static_cast<size_t>(end - p) < length) {
+        return false;
+    }
+    value.assign(p, length);
+    p += length;
+    return true;
+}
+
+int64_t nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void encodeRecord(std::string& out, const ReplicationRecord& record) {
+    put<uint64_t>(out, record.position);
+    put<int64_t>(out, record.committedAt);
+    put<uint8_t>(out, static_cast<uint8_t>(record.kind));
+    switch (record.kind) {
+        case ReplicationRecordKind::Entry:
+        case ReplicationRecordKind::Exit:
+            put<int64_t>(out, record.event.entryTime);
+            put<int64_t>(out, record.event.exitTime);
+            put<int64_t>(out, record.event.fee);
+            putString(out, record.event.plate);
+            putString(out, record.event.type);
+            break;
+        case ReplicationRecordKind::Rates:
+            put<int64_t>(out, record.smallRate);
+            put<int64_t>(out, record.largeRate);
+            break;
+        case ReplicationRecordKind::HistoryTiering:
+            put<int64_t>(out, record.hotWindow);
+            put<uint64_t>(out, record.cacheBytes);
+            break;
+        case ReplicationRecordKind::HistoryRetention:
+            put<int64_t>(out, record.retention);
+            break;
+        case ReplicationRecordKind::OverstayLimit:
+            putString(out, record.limitType);
+            put<int64_t>(out, record.limit);
+            break;
+    }
+}
+
+bool decodeRecord(const char*& p, const char* end, ReplicationRecord& record) {
+    uint8_t kind;
+    if (!get(p, end, record.position) || !get(p, end, record.committedAt) || !get(p, end, kind)) {
+        return false;
+    }
+    record.kind = static_cast<ReplicationRecordKind>(kind);
+    int64_t first, second;
+    switch (record.kind) {
+        case ReplicationRecordKind::Entry:
+        case ReplicationRecordKind::Exit: {
+            int64_t fee;
+            if (!get(p, end, first) || !get(p, end, second) || !get(p, end, fee) ||
+                !getString(p, end, record.event.plate) || !getString(p, end, record.event.type)) {
+                return false;
+            }
+            record.event.kind = record.kind == ReplicationRecordKind::Entry ? StorageEventKind::Entry : StorageEventKind::Exit;
+            record.event.entryTime = static_cast<time_t>(first);
+            record.event.exitTime = static_cast<time_t>(second);
+            record.event.fee = fee;
+            return true;
+        }
+        case ReplicationRecordKind::Rates:
+            if (!get(p, end, first) || !get(p, end, second)) {
+                return false;
+            }
+            record.smallRate = first;
+            record.largeRate = second;
+            return true;
+        case ReplicationRecordKind::HistoryTiering:
+            if (!get(p, end, first) || !get(p, end, record.cacheBytes)) {
+                return false;
+            }
+            record.hotWindow = static_cast<time_t>(first);
+            return true;
+        case ReplicationRecordKind::HistoryRetention:
+            if (!get(p, end, first)) {
+                return false;
+            }
+            record.retention = static_cast<time_t>(first);
+            return true;
+        case ReplicationRecordKind::OverstayLimit:
+            if (!getString(p, end, record.limitType) || !get(p, end, first)) {
+                return false;
+            }
+            record.limit = static_cast<time_t>(first);
+            return true;
+    }
+    return false;  // 不认识的类型
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool receiveAll(int fd, char* buffer, size_t length) {
+    size_t received = 0;
+    while (received < length) {
+        ssize_t n = recv(fd, buffer + received, length - received, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;  // 连接断开或超时
+        }
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sendFrame(int fd, FrameType type, const std::string& payload) {
+    std::string header;
+    put<uint8_t>(header, static_cast<uint8_t>(type));
+    put<uint64_t>(header, payload.size());
+    return sendAll(fd, header) && sendAll(fd, payload);
+}
+
+bool receiveFrame(int fd, FrameType& type, std::string& payload) {
+    uint8_t rawType;
+    uint64_t length;
+    if (!receiveAll(fd, reinterpret_cast<char*>(&rawType), sizeof(rawType)) ||
+        !receiveAll(fd, reinterpret_cast<char*>(&length), sizeof(length)) || length > MAX_FRAME_BYTES) {
+        return false;
+    }
+    type = static_cast<FrameType>(rawType);
+    payload.assign(length, '\0');
+    return receiveAll(fd, &payload[0], payload.size());
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid replication socket path: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+void setReceiveTimeout(int fd, int seconds) {
+    timeval timeout{};
+    timeout.tv_sec = seconds;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+std::string readWholeFile(const std::string& path, bool& ok) {
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ok = static_cast<bool>(in) || in.eof();
+    return data;
+}
+}
+
+ReplicationPublisher::ReplicationPublisher(ParkingLot& lot, const std::string& socketPath)
+    : lot(lot), socketPath(socketPath) {
+    // 主节点标识每次运行不同，备用节点据此发现主节点重启（位置从头编号）而重新接收基准
+    std::random_device random;
+    epoch = (static_cast<uint64_t>(random()) << 32) ^ random() ^ static_cast<uint64_t>(nowMillis());
+
+    sockaddr_un address = socketAddress(socketPath);
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error("Failed to create replication socket");
+    }
+    ::unlink(socketPath.c_str());  // 上次运行（或已失效的主节点）残留的socket文件
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 4) < 0) {
+        std::string error = std::strerror(errno);
+        close(listenFd);
+        throw std::runtime_error("Failed to listen on replication socket " + socketPath + ": " + error);
+    }
+
+    // 先注册再读取位置：两者之间提交的记录已进入积压队列，lastPosition取较大者
+    lot.setReplicationListener([this](const ReplicationRecord& record) {
+        append(record);
+    });
+    uint64_t position = lot.getReplicationPosition();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lastPosition = std::max(lastPosition, position);
+    }
+    acceptor = std::thread(&ReplicationPublisher::runAcceptor, this);
+}
+
+ReplicationPublisher::~ReplicationPublisher() {
+    stop();
+}
+
+void ReplicationPublisher::append(const ReplicationRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    backlog.push_back(record);
+    if (backlog.size() > BACKLOG_RECORDS) {
+        backlog.pop_front();
+    }
+    lastPosition = record.position;
+    appended.notify_all();
+}
+
+void ReplicationPublisher::stop() {
+    lot.setReplicationListener(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+        for (Follower& follower : followers) {
+            if (follower.fd >= 0) {
+                shutdown(follower.fd, SHUT_RDWR);
+            }
+        }
+    }
+    appended.notify_all();
+
+    // 唤醒阻塞在accept()中的监听线程
+    shutdown(listenFd, SHUT_RDWR);
+    if (acceptor.joinable()) {
+        acceptor.join();
+    }
+    close(listenFd);
+    ::unlink(socketPath.c_str());
+
+    // 监听线程已退出，不会再加入新的备用节点
+    for (Follower& follower : followers) {
+        if (follower.sender.joinable()) {
+            follower.sender.join();
+        }
+    }
+    followers.clear();
+}
+
+void ReplicationPublisher::runAcceptor() {
+    while (true) {
+        int connection = accept(listenFd, nullptr, nullptr);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping) {
+            if (connection >= 0) {
+                close(connection);
+            }
+            return;
+        }
+        if (connection < 0) {
+            // 文件描述符用尽等错误，稍后重试
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        reapFollowers();
+        followers.emplace_back();
+        Follower& follower = followers.back();
+        follower.fd = connection;
+        follower.status.connectedAt = std::time(nullptr);
+        follower.sender = std::thread(&ReplicationPublisher::runSender, this, std::ref(follower));
+    }
+}
+
+void ReplicationPublisher::reapFollowers() {
+    for (auto it = followers.begin(); it != followers.end();) {
+        if (it->finished) {
+            it->sender.join();
+            it = followers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ReplicationPublisher::runSender(Follower& follower) {
+    const int fd = follower.fd;
+
+    // 握手：备用节点上次的主节点标识和位置
+    char hello[2 * sizeof(uint32_t) + 2 * sizeof(uint64_t)];
+    setReceiveTimeout(fd, ReplicationFollower::RECEIVE_TIMEOUT_SECONDS);
+    bool ok = receiveAll(fd, hello, sizeof(hello));
+    const char* p = hello;
+    const char* end = hello + sizeof(hello);
+    uint32_t magic = 0, version = 0;
+    uint64_t followerEpoch = 0, followerPosition = 0;
+    ok = ok && get(p, end, magic) && get(p, end, version) && get(p, end, followerEpoch) && get(p, end, followerPosition) &&
+         magic == REPLICATION_MAGIC && version == REPLICATION_VERSION;
+
+    uint64_t next = 0;  // 下一条要发送的记录
+    if (ok) {
+        bool resume;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            resume = followerEpoch == epoch && followerPosition <= lastPosition &&
+                     (followerPosition == lastPosition ||
+                      (!backlog.empty() && backlog.front().position <= followerPosition + 1));
+        }
+        uint64_t position = followerPosition;
+        if (resume) {
+            std::string payload;
+            put<uint64_t>(payload, epoch);
+            put<uint64_t>(payload, position);
+            ok = sendFrame(fd, FrameType::Resume, payload);
+        } else {
+            ok = sendBase(follower, position);
+        }
+        next = position + 1;
+        std::cout << "Replication follower " << (resume ? "resumed" : "synchronized") << " at position " << position << std::endl;
+    }
+
+    std::vector<ReplicationRecord> batch;
+    while (ok) {
+        uint64_t primaryPosition;
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            appended.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_MILLIS), [&] {
+                return stopping || lastPosition >= next;
+            });
+            if (stopping) {
+                break;
+            }
+            if (lastPosition >= next) {
+                if (backlog.empty() || backlog.front().position > next) {
+                    // 落后超出积压队列，断开后由备用节点重连并重新接收基准
+                    std::cerr << "Replication follower fell behind the backlog at position " << next << std::endl;
+                    break;
+                }
+                size_t index = static_cast<size_t>(next - backlog.front().position);
+                size_t count = std::min(BATCH_RECORDS, backlog.size() - index);
+                batch.assign(backlog.begin() + index, backlog.begin() + index + count);
+            }
+            primaryPosition = lastPosition;
+        }
+
+        std::string payload;
+        if (batch.empty()) {
+            put<uint64_t>(payload, primaryPosition);
+            put<int64_t>(payload, nowMillis());
+            ok = sendFrame(fd, FrameType::Heartbeat, payload);
+            continue;
+        }
+        put<uint64_t>(payload, primaryPosition);
+        put<uint32_t>(payload, static_cast<uint32_t>(batch.size()));
+        for (const ReplicationRecord& record : batch) {
+            encodeRecord(payload, record);
+        }
+        ok = sendFrame(fd, FrameType::Records, payload);
+        next = batch.back().position + 1;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        follower.status.sentPosition = batch.back().position;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    close(fd);
+    follower.fd = -1;
+    follower.finished = true;
+}
+
+bool ReplicationPublisher::sendBase(Follower& follower, uint64_t& position) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        follower.status.syncingBase = true;
+    }
+
+    // 快照和段列表在锁内一次取得；段文件在锁外读取，基准持有期间不会被删除
+    ReplicationBase base = lot.getReplicationBase();
+    std::string payload;
+    put<uint64_t>(payload, epoch);
+    put<uint64_t>(payload, base.position);
+    payload += base.snapshot;
+    if (!sendFrame(follower.fd, FrameType::Base, payload)) {
+        return false;
+    }
+    for (const HistorySegment& segment : base.history.segments) {
+        if (!segment.file) {
+            continue;
+        }
+        bool ok = false;
+        payload.clear();
+        putString(payload, fs::path(segment.file->path).filename().string());
+        payload += readWholeFile(segment.file->path, ok);
+        if (!ok) {
+            std::cerr << "Failed to read history segment " << segment.file->path << " for replication" << std::endl;
+            continue;  // 备用节点载入时跳过缺失的段，与本地加载损坏段文件相同
+        }
+        if (!sendFrame(follower.fd, FrameType::Segment, payload)) {
+            return false;
+        }
+    }
+    if (!sendFrame(follower.fd, FrameType::BaseEnd, std::string())) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    follower.status.syncingBase = false;
+    follower.status.sentPosition = base.position;
+    position = base.position;
+    return true;
+}
+
+ReplicationStatus ReplicationPublisher::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReplicationStatus result;
+    result.standby = false;
+    result.socketPath = socketPath;
+    result.epoch = epoch;
+    result.position = lastPosition;
+    result.backlogFirst = backlog.empty() ? lastPosition + 1 : backlog.front().position;
+    for (const Follower& follower : followers) {
+        if (!follower.finished) {
+            result.followers.push_back(follower.status);
+        }
+    }
+    return result;
+}
+
+ReplicationFollower::ReplicationFollower(ParkingLot& lot, const std::string& socketPath, const std::string& stagingDirectory)
+    : lot(lot), socketPath(socketPath), stagingDirectory(stagingDirectory) {
+    socketAddress(socketPath);  // 路径不合法时在启动时报错
+    state.standby = true;
+    state.socketPath = socketPath;
+    state.position = lot.getReplicationPosition();
+    receiver = std::thread(&ReplicationFollower::run, this);
+}
+
+ReplicationFollower::~ReplicationFollower() {
+    stop();
+}
+
+void ReplicationFollower::stop() {
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fd >= 0) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    if (receiver.joinable()) {
+        receiver.join();
+    }
+    std::error_code error;
+    fs::remove_all(stagingDirectory, error);
+}
+
+void ReplicationFollower::run() {
+    const sockaddr_un address = socketAddress(socketPath);
+    bool reported = false;  // 连接失败只报告一次
+    while (running) {
+        int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection >= 0 && connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            reported = false;
+            bool stopped;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                fd = connection;
+                stopped = !running;  // stop()在记录连接之前调用时不会shutdown这个连接
+            }
+            if (!stopped) {
+                follow(connection);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            fd = -1;
+            if (state.connected) {
+                std::cerr << "Lost connection to replication primary at position " << state.position << std::endl;
+            }
+            state.connected = false;
+        } else if (!reported) {
+            std::cerr << "Cannot connect to replication primary " << socketPath << ": " << std::strerror(errno) << std::endl;
+            reported = true;
+        }
+        if (connection >= 0) {
+            close(connection);
+        }
+        // 每秒重连一次，期间及时响应stop()
+        for (int i = 0; i < 10 && running; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+void ReplicationFollower::follow(int connection) {
+    setReceiveTimeout(connection, RECEIVE_TIMEOUT_SECONDS);
+    std::string hello;
+    put<uint32_t>(hello, REPLICATION_MAGIC);
+    put<uint32_t>(hello, REPLICATION_VERSION);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        put<uint64_t>(hello, state.epoch);
+        put<uint64_t>(hello, state.position);
+    }
+    if (!sendAll(connection, hello)) {
+        return;
+    }
+
+    bool receivingBase = false;
+    uint64_t baseEpoch = 0, basePosition = 0;
+    std::string baseSnapshot;
+    FrameType type;
+    std::string payload;
+    while (running && receiveFrame(connection, type, payload)) {
+        const char* p = payload.data();
+        const char* end = p + payload.size();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            lastContactAt = nowMillis();
+        }
+
+        if (type == FrameType::Base) {
+            if (!get(p, end, baseEpoch) || !get(p, end, basePosition)) {
+                break;
+            }
+            baseSnapshot.assign(p, end);
+            receivingBase = true;
+            std::error_code error;
+            fs::remove_all(stagingDirectory, error);
+            fs::create_directories(stagingDirectory, error);
+            if (error) {
+                std::cerr << "Cannot create replication staging directory " << stagingDirectory << ": " << error.message() << std::endl;
+                break;
+            }
+        } else if (type == FrameType::Segment) {
+            std::string name;
+            if (!receivingBase || !getString(p, end, name) || !HistoryStore::isSegmentFileName(name)) {
+                break;  // 文件名只能是段文件名，不会写到暂存目录之外
+            }
+            std::ofstream out((fs::path(stagingDirectory) / name).string(), std::ios::binary | std::ios::trunc);
+            out.write(p, end - p);
+            if (!out) {
+                std::cerr << "Failed to stage replicated history segment " << name << std::endl;
+                break;
+            }
+        } else if (type == FrameType::BaseEnd) {
+            if (!receivingBase) {
+                break;
+            }
+            receivingBase = false;
+            bool loaded = lot.loadReplicationBase(basePosition, baseSnapshot, stagingDirectory);
+            baseSnapshot.clear();
+            std::error_code error;
+            fs::remove_all(stagingDirectory, error);
+            if (!loaded) {
+                std::cerr << "Cannot load replication base at position " << basePosition << std::endl;
+                break;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            state.epoch = baseEpoch;
+            state.position = basePosition;
+            state.primaryPosition = std::max(state.primaryPosition, basePosition);
+            state.baseSyncs++;
+            state.connected = true;
+            std::cout << "Loaded replication base at position " << basePosition << std::endl;
+        } else if (type == FrameType::Resume) {
+            uint64_t epoch, position;
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!get(p, end, epoch) || !get(p, end, position) || epoch != state.epoch || position != state.position) {
+                break;
+            }
+            state.connected = true;
+        } else if (type == FrameType::Records) {
+            uint64_t primaryPosition;
+            uint32_t count;
+            if (receivingBase || !get(p, end, primaryPosition) || !get(p, end, count)) {
+                break;
+            }
+            uint64_t expected;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                expected = state.position + 1;
+            }
+            std::vector<ReplicationRecord> records(count);
+            bool consistent = true;
+            for (ReplicationRecord& record : records) {
+                if (!decodeRecord(p, end, record) || record.position != expected) {
+                    consistent = false;
+                    break;
+                }
+                ++expected;
+            }
+            if (!consistent) {
+                // 记录损坏或位置不连续：清除主节点标识，重连后重新接收基准
+                std::cerr << "Unexpected replication record at position " << expected << std::endl;
+                std::lock_guard<std::mutex> lock(mutex);
+                state.epoch = 0;
+                break;
+            }
+            if (!running || records.empty()) {
+                break;
+            }
+            lot.applyReplicated(records);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            state.position = records.back().position;
+            state.primaryPosition = std::max(state.position, primaryPosition);
+            state.lagMillis = std::max<int64_t>(0, nowMillis() - records.back().committedAt);
+            state.appliedRecords += records.size();
+        } else if (type == FrameType::Heartbeat) {
+            uint64_t position;
+            int64_t sentAt;
+            if (!get(p, end, position) || !get(p, end, sentAt)) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            state.primaryPosition = position;
+            if (position <= state.position) {
+                state.lagMillis = 0;  // 已追上主节点
+            }
+        } else {
+            break;  // 不认识的帧
+        }
+    }
+}
+
+ReplicationStatus ReplicationFollower::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReplicationStatus result = state;
+    result.lagRecords = state.primaryPosition > state.position ? state.primaryPosition - state.position : 0;
+    result.lastContactMillis = lastContactAt > 0 ? nowMillis() - lastContactAt : -1;
+    return result;
+}
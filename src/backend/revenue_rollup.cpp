@@ -0,0 +1,85 @@
+/**
+ * @file revenue_rollup.cpp
+ * @brief RevenueRollup类的具体实现
+ */
+#include "include/revenue_rollup.h"
+#include <iterator>
+
+time_t RevenueRollup::bucketStart(RollupGranularity granularity, time_t time) {
+    // 按本地时间对齐，时区偏移不是整小时时也能对齐到本地整点
+    std::tm local{};
+    localtime_r(&time, &local);
+
+    time_t offset = local.tm_min * 60 + local.tm_sec;
+    if (granularity == RollupGranularity::Day) {
+        offset += local.tm_hour * 3600;
+    }
+    return time - offset;
+}
+
+RollupBucket& RevenueRollup::bucketAt(std::map<time_t, RollupBucket>& table, time_t start) {
+    // 常见情况：落在最后一个桶中
+    if (!table.empty()) {
+        auto last = std::prev(table.end());
+        if (last->first == start) {
+            return last->second;
+        }
+        if (last->first < start) {
+            // 在尾部追加新桶，带提示的插入为均摊O(1)
+            auto it = table.emplace_hint(table.end(), start, RollupBucket());
+            it->second.start = start;
+            return it->second;
+        }
+    }
+
+    // 乱序数据（例如加载历史记录时）退化为O(log n)查找
+    RollupBucket& bucket = table[start];
+    bucket.start = start;
+    return bucket;
+}
+
+void RevenueRollup::record(const std::string& type, time_t exitTime, Cents fee) {
+    // 本地时间的一小时总在同一天内，天桶的起点随小时桶一起缓存
+    if (!hasCachedHour || exitTime < cachedHour || exitTime >= cachedHour + 3600) {
+        cachedHour = bucketStart(RollupGranularity::Hour, exitTime);
+        cachedDay = bucketStart(RollupGranularity::Day, exitTime);
+        hasCachedHour = true;
+    }
+
+    for (auto granularity : {RollupGranularity::Hour, RollupGranularity::Day}) {
+        auto& table = granularity == RollupGranularity::Hour ? hourly : daily;
+        RollupBucket& bucket = bucketAt(table, granularity == RollupGranularity::Hour ? cachedHour : cachedDay);
+
+        bucket.total.visits++;
+        bucket.total.revenue += fee;
+        RollupCounters& counters = bucket.byType[type];
+        counters.visits++;
+        counters.revenue += fee;
+    }
+}
+
+std::vector<RollupBucket> RevenueRollup::query(RollupGranularity granularity, time_t from, time_t to) const {
+    const auto& table = granularity == RollupGranularity::Hour ? hourly : daily;
+
+    std::vector<RollupBucket> result;
+    time_t first = bucketStart(granularity, from);
+    if (first >= to) {
+        return result;
+    }
+
+    auto end = table.lower_bound(to);
+    for (auto it = table.lower_bound(first); it != end; ++it) {
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+void RevenueRollup::prune(time_t before) {
+    hourly.erase(hourly.begin(), hourly.lower_bound(bucketStart(RollupGranularity::Hour, before)));
+    daily.erase(daily.begin(), daily.lower_bound(bucketStart(RollupGranularity::Day, before)));
+}
+
+void RevenueRollup::clear() {
+    hourly.clear();
+    daily.clear();
+}
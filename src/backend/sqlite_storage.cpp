@@ -0,0 +1,206 @@
+/**
+ * @file sqlite_storage.cpp
+ * @brief SQLite存储引擎的具体实现
+ */
+#include "include/sqlite_storage.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+const char* const SCHEMA =
+    "CREATE TABLE IF NOT EXISTS snapshot ("
+    "  id INTEGER PRIMARY KEY CHECK (id = 0),"
+    "  sequence INTEGER NOT NULL,"
+    "  data BLOB NOT NULL);"
+    "CREATE TABLE IF NOT EXISTS events ("
+    "  sequence INTEGER PRIMARY KEY,"
+    "  kind INTEGER NOT NULL,"
+    "  plate TEXT NOT NULL,"
+    "  type TEXT NOT NULL,"
+    "  entry_time INTEGER NOT NULL,"
+    "  exit_time INTEGER NOT NULL,"
+    "  fee INTEGER NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS events_plate ON events (plate);";
+
+const char* const EVENT_COLUMNS = "sequence, kind, plate, type, entry_time, exit_time, fee";
+
+// 语句句柄的RAII包装，析构时释放
+class Statement {
+private:
+    sqlite3_stmt* statement = nullptr;
+
+public:
+    Statement(sqlite3* db, const char* sql) {
+        if (sqlite3_prepare_v2(db, sql, -1, &statement, nullptr) != SQLITE_OK) {
+            std::cerr << "SQLite prepare failed: " << sqlite3_errmsg(db) << std::endl;
+            statement = nullptr;
+        }
+    }
+    ~Statement() { sqlite3_finalize(statement); }
+
+    Statement(const Statement&) = delete;
+    Statement& operator=(const Statement&) = delete;
+
+    sqlite3_stmt* get() const { return statement; }
+    explicit operator bool() const { return statement != nullptr; }
+};
+
+std::string textColumn(sqlite3_stmt* statement, int column) {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(statement, column));
+    return std::string(text ? text : "", static_cast<size_t>(sqlite3_column_bytes(statement, column)));
+}
+
+StorageEvent readEvent(sqlite3_stmt* statement) {
+    StorageEvent event;
+    event.sequence = static_cast<uint64_t>(sqlite3_column_int64(statement, 0));
+    event.kind = static_cast<StorageEventKind>(sqlite3_column_int(statement, 1));
+    event.plate = textColumn(statement, 2);
+    event.type = textColumn(statement, 3);
+    event.entryTime = static_cast<time_t>(sqlite3_column_int64(statement, 4));
+    event.exitTime = static_cast<time_t>(sqlite3_column_int64(statement, 5));
+    event.fee = sqlite3_column_int64(statement, 6);
+    return event;
+}
+}
+
+SqliteStorage::SqliteStorage(const std::string& path, size_t interval)
+    : legacy(path), interval(std::max<size_t>(interval, 1)) {
+    const std::string dbPath = path + ".sqlite";
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+        std::string message = db ? sqlite3_errmsg(db) : "out of memory";
+        sqlite3_close(db);
+        db = nullptr;
+        throw std::runtime_error("Cannot open " + dbPath + ": " + message);
+    }
+    // WAL模式下每次提交只追加WAL，synchronous=NORMAL时只在检查点fsync
+    if (!execute("PRAGMA journal_mode=WAL;") || !execute("PRAGMA synchronous=NORMAL;") || !execute(SCHEMA) ||
+        sqlite3_prepare_v2(db, "INSERT INTO events (sequence, kind, plate, type, entry_time, exit_time, fee) "
+                               "VALUES (?, ?, ?, ?, ?, ?, ?)", -1, &insertEvent, nullptr) != SQLITE_OK) {
+        std::string message = sqlite3_errmsg(db);
+        sqlite3_finalize(insertEvent);
+        sqlite3_close(db);
+        throw std::runtime_error("Cannot initialize " + dbPath + ": " + message);
+    }
+
+    Statement snapshotSequence(db, "SELECT sequence FROM snapshot WHERE id = 0");
+    if (snapshotSequence && sqlite3_step(snapshotSequence.get()) == SQLITE_ROW) {
+        hasStoredSnapshot = true;
+        last = static_cast<uint64_t>(sqlite3_column_int64(snapshotSequence.get(), 0));
+    }
+    Statement eventRange(db, "SELECT COUNT(*), MAX(sequence) FROM events");
+    if (eventRange && sqlite3_step(eventRange.get()) == SQLITE_ROW) {
+        pending = static_cast<size_t>(sqlite3_column_int64(eventRange.get(), 0));
+        last = std::max(last, static_cast<uint64_t>(sqlite3_column_int64(eventRange.get(), 1)));
+    }
+}
+
+SqliteStorage::~SqliteStorage() {
+    sqlite3_finalize(insertEvent);
+    sqlite3_close(db);
+}
+
+bool SqliteStorage::execute(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::cerr << "SQLite error: " << (error ? error : "unknown") << std::endl;
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+bool SqliteStorage::append(StorageEvent& event) {
+    event.sequence = last + 1;
+    sqlite3_reset(insertEvent);
+    sqlite3_bind_int64(insertEvent, 1, static_cast<sqlite3_int64>(event.sequence));
+    sqlite3_bind_int(insertEvent, 2, static_cast<int>(event.kind));
+    sqlite3_bind_text(insertEvent, 3, event.plate.data(), static_cast<int>(event.plate.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_text(insertEvent, 4, event.type.data(), static_cast<int>(event.type.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_int64(insertEvent, 5, event.entryTime);
+    sqlite3_bind_int64(insertEvent, 6, event.exitTime);
+    sqlite3_bind_int64(insertEvent, 7, event.fee);
+    if (sqlite3_step(insertEvent) != SQLITE_DONE) {
+        std::cerr << "SQLite insert failed: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    last = event.sequence;
+    ++pending;
+    return true;
+}
+
+bool SqliteStorage::writeSnapshot(const std::string& data) {
+    if (!execute("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    Statement replace(db, "INSERT OR REPLACE INTO snapshot (id, sequence, data) VALUES (0, ?, ?)");
+    Statement discard(db, "DELETE FROM events WHERE sequence <= ?");
+    bool ok = replace && discard;
+    if (ok) {
+        sqlite3_bind_int64(replace.get(), 1, static_cast<sqlite3_int64>(last));
+        sqlite3_bind_blob64(replace.get(), 2, data.data(), data.size(), SQLITE_STATIC);
+        sqlite3_bind_int64(discard.get(), 1, static_cast<sqlite3_int64>(last));
+        ok = sqlite3_step(replace.get()) == SQLITE_DONE && sqlite3_step(discard.get()) == SQLITE_DONE;
+    }
+    if (!ok) {
+        std::cerr << "SQLite snapshot failed: " << sqlite3_errmsg(db) << std::endl;
+        execute("ROLLBACK;");
+        return false;
+    }
+    if (!execute("COMMIT;")) {
+        execute("ROLLBACK;");
+        return false;
+    }
+    hasStoredSnapshot = true;
+    pending = 0;
+    return true;
+}
+
+bool SqliteStorage::hasSnapshot() const {
+    return hasStoredSnapshot || legacy.hasSnapshot();
+}
+
+std::unique_ptr<std::istream> SqliteStorage::openSnapshot() const {
+    if (!hasStoredSnapshot) {
+        return legacy.openSnapshot();
+    }
+    Statement select(db, "SELECT data FROM snapshot WHERE id = 0");
+    if (!select || sqlite3_step(select.get()) != SQLITE_ROW) {
+        return nullptr;
+    }
+    const char* blob = static_cast<const char*>(sqlite3_column_blob(select.get(), 0));
+    std::string data(blob ? blob : "", static_cast<size_t>(sqlite3_column_bytes(select.get(), 0)));
+    return std::make_unique<std::istringstream>(std::move(data), std::ios::binary);
+}
+
+void SqliteStorage::scan(uint64_t after, uint64_t upTo, const std::function<bool(const StorageEvent&)>& consumer) const {
+    std::string sql = std::string("SELECT ") + EVENT_COLUMNS +
+                      " FROM events WHERE sequence > ? AND sequence <= ? ORDER BY sequence";
+    Statement select(db, sql.c_str());
+    if (!select) {
+        return;
+    }
+    sqlite3_bind_int64(select.get(), 1, static_cast<sqlite3_int64>(after));
+    sqlite3_bind_int64(select.get(), 2, static_cast<sqlite3_int64>(std::min<uint64_t>(upTo, INT64_MAX)));
+    while (sqlite3_step(select.get()) == SQLITE_ROW) {
+        if (!consumer(readEvent(select.get()))) {
+            return;
+        }
+    }
+}
+
+std::vector<StorageEvent> SqliteStorage::lookup(const std::string& plate) const {
+    std::vector<StorageEvent> events;
+    std::string sql = std::string("SELECT ") + EVENT_COLUMNS + " FROM events WHERE plate = ? ORDER BY sequence";
+    Statement select(db, sql.c_str());
+    if (!select) {
+        return events;
+    }
+    sqlite3_bind_text(select.get(), 1, plate.data(), static_cast<int>(plate.size()), SQLITE_TRANSIENT);
+    while (sqlite3_step(select.get()) == SQLITE_ROW) {
+        events.push_back(readEvent(select.get()));
+    }
+    return events;
+}
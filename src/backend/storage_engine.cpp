@@ -0,0 +1,407 @@
+/**
+ * @file storage_engine.cpp
+ * @brief 数据文件、追加日志两种存储引擎和引擎工厂的具体实现
+ */
+#include "include/storage_engine.h"
+#include "include/sqlite_storage.h"
+#include "include/crc32c.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+const uint32_t LOG_MAGIC = 0x56454B50;  // "PKEV"
+const uint32_t LOG_VERSION = 1;
+const size_t LOG_HEADER_BYTES = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+const uint32_t MAX_EVENT_BYTES = 4096;  // 单条事件内容的上限，超出说明长度字段已损坏
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool get(const char*& p, const char* end, T& value) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+bool getString(const char*& p, const char* end, std::string& value) {
+    uint32_t length;
+    if (!get(p, end, length) || static_cast<size_t>(end - p) < length) {
+        return false;
+    }
+    value.assign(p, length);
+    p += length;
+    return true;
+}
+
+// 编码一条日志记录（长度、内容、校验和）
+std::string encodeEvent(const StorageEvent& event) {
+    std::string payload;
+    put<uint64_t>(payload, event.sequence);
+    put<uint8_t>(payload, static_cast<uint8_t>(event.kind));
+    put<int64_t>(payload, event.entryTime);
+    put<int64_t>(payload, event.exitTime);
+    put<int64_t>(payload, event.fee);
+    put<uint32_t>(payload, static_cast<uint32_t>(event.plate.size()));
+    payload += event.plate;
+    put<uint32_t>(payload, static_cast<uint32_t>(event.type.size()));
+    payload += event.type;
+
+    std::string record;
+    put<uint32_t>(record, static_cast<uint32_t>(payload.size()));
+    record += payload;
+    put<uint32_t>(record, crc32c(record.data(), record.size()));
+    return record;
+}
+
+bool decodeEvent(const std::string& payload, StorageEvent& event) {
+    const char* p = payload.data();
+    const char* end = p + payload.size();
+    uint8_t kind;
+    int64_t entryTime, exitTime, fee;
+    if (!get(p, end, event.sequence) || !get(p, end, kind) || !get(p, end, entryTime) ||
+        !get(p, end, exitTime) || !get(p, end, fee) ||
+        !getString(p, end, event.plate) || !getString(p, end, event.type) ||
+        (kind != static_cast<uint8_t>(StorageEventKind::Entry) && kind != static_cast<uint8_t>(StorageEventKind::Exit))) {
+        return false;
+    }
+    event.kind = static_cast<StorageEventKind>(kind);
+    event.entryTime = static_cast<time_t>(entryTime);
+    event.exitTime = static_cast<time_t>(exitTime);
+    event.fee = fee;
+    return true;
+}
+
+// 读取下一条日志记录，末尾不完整或校验和不符时返回false
+bool readEvent(std::istream& in, StorageEvent& event) {
+    uint32_t length;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > MAX_EVENT_BYTES) {
+        return false;
+    }
+    std::string payload(length, '\0');
+    uint32_t checksum;
+    if (!in.read(&payload[0], length) || !in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum))) {
+        return false;
+    }
+    uint32_t expected = crc32c(&length, sizeof(length));
+    expected = crc32c(payload.data(), payload.size(), expected);
+    return expected == checksum && decodeEvent(payload, event);
+}
+
+// 读取日志文件头，返回写快照时的事件序号
+bool readLogHeader(std::istream& in, uint64_t& sequence) {
+    uint32_t magic = 0, version = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&sequence), sizeof(sequence));
+    return in && magic == LOG_MAGIC && version == LOG_VERSION;
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 把文件（或目录项）写入磁盘
+bool syncPath(const std::string& path, bool directory) {
+    int flags = (directory ? O_RDONLY | O_DIRECTORY : O_WRONLY) | O_CLOEXEC;
+    int syncFd = ::open(path.c_str(), flags);
+    if (syncFd < 0) {
+        return false;
+    }
+    bool ok = ::fsync(syncFd) == 0;
+    ::close(syncFd);
+    return ok;
+}
+}
+
+bool FileStorage::append(StorageEvent& event) {
+    event.sequence = 0;  // 不单独记录事件，调用者每次都写快照
+    ++pending;
+    return true;
+}
+
+bool FileStorage::writeSnapshot(const std::string& data) {
+    const std::string temp = path + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+    std::error_code error;
+    if (!file || (sync && !syncPath(temp, false))) {
+        fs::remove(temp, error);
+        return false;  // 文件写入失败，原文件不变
+    }
+    fs::rename(temp, path, error);
+    if (error) {
+        return false;
+    }
+    if (sync) {
+        // 改名本身也要落盘，否则断电后目录中可能仍是旧文件
+        fs::path parent = fs::path(path).parent_path();
+        syncPath(parent.empty() ? "." : parent.string(), true);
+    }
+    pending = 0;
+    return true;
+}
+
+bool FileStorage::hasSnapshot() const {
+    std::error_code error;
+    return fs::exists(path, error);
+}
+
+std::unique_ptr<std::istream> FileStorage::openSnapshot() const {
+    auto file = std::make_unique<std::ifstream>(path, std::ios::binary);
+    if (!*file) {
+        return nullptr;
+    }
+    return file;
+}
+
+void FileStorage::scan(uint64_t, uint64_t, const std::function<bool(const StorageEvent&)>&) const {
+    // 每个事件都已写入快照，没有待重放的事件
+}
+
+std::vector<StorageEvent> FileStorage::lookup(const std::string&) const {
+    return {};
+}
+
+LogStorage::LogStorage(const std::string& path, size_t interval)
+    : snapshot(path, true), logPath(path + ".log"), interval(std::max<size_t>(interval, 1)),
+      hasBase(snapshot.hasSnapshot()) {
+    std::ifstream in(logPath, std::ios::binary);
+    const bool exists = static_cast<bool>(in);
+    if (!exists || !readLogHeader(in, snapshotSequence)) {
+        if (exists) {
+            std::cerr << "Damaged event log header in " << logPath << ", starting a new log" << std::endl;
+        }
+        snapshotSequence = 0;
+        if (!resetLog(0)) {
+            throw std::runtime_error("Cannot create event log " + logPath);
+        }
+        writer = std::thread(&LogStorage::runWriter, this);
+        return;
+    }
+
+    // 找到最后一条完整的事件，截去之后追加中断留下的内容
+    last = snapshotSequence;
+    uint64_t validBytes = LOG_HEADER_BYTES;
+    StorageEvent event;
+    while (readEvent(in, event)) {
+        last = event.sequence;
+        ++pending;
+        validBytes = static_cast<uint64_t>(in.tellg());
+    }
+    in.close();
+
+    std::error_code error;
+    uint64_t fileBytes = fs::file_size(logPath, error);
+    if (!error && fileBytes > validBytes) {
+        std::cerr << "Truncating " << fileBytes - validBytes << " bytes of torn events in " << logPath << std::endl;
+        fs::resize_file(logPath, validBytes, error);
+    }
+    logBytes = validBytes;
+    fd = ::open(logPath.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open event log " + logPath);
+    }
+    durable = last;
+    writer = std::thread(&LogStorage::runWriter, this);
+}
+
+LogStorage::~LogStorage() {
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    writer.join();  // 写入线程退出前写完队列中的事件
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+void LogStorage::runWriter() {
+    std::unique_lock<std::mutex> lock(writerMutex);
+    for (;;) {
+        queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        // 取走队列中的全部事件作为一个提交组，写入期间到达的事件进入下一组
+        std::string group;
+        group.swap(queue);
+        const uint64_t groupLast = queuedLast;
+        const bool skip = broken;
+        writing = true;
+        lock.unlock();
+
+        bool ok = false;
+        if (!skip) {
+            ok = writeAll(fd, group) && ::fdatasync(fd) == 0;
+            if (!ok) {
+                // 截去写了一部分的提交组，之后的事件仍接在完整的事件之后
+                std::cerr << "Cannot write event log " << logPath << ": " << std::strerror(errno) << std::endl;
+                if (::ftruncate(fd, static_cast<off_t>(logBytes)) != 0) {
+                    std::cerr << "Cannot truncate event log " << logPath << std::endl;
+                }
+            }
+        }
+
+        lock.lock();
+        writing = false;
+        if (ok) {
+            logBytes += group.size();
+            durable = groupLast;
+        } else {
+            broken = true;
+            failedThrough = groupLast;
+        }
+        flushed.notify_all();
+    }
+}
+
+bool LogStorage::resetLog(uint64_t sequence) {
+    std::string header;
+    put<uint32_t>(header, LOG_MAGIC);
+    put<uint32_t>(header, LOG_VERSION);
+    put<uint64_t>(header, sequence);
+
+    const std::string temp = logPath + ".tmp";
+    int tempFd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (tempFd < 0) {
+        return false;
+    }
+    bool ok = writeAll(tempFd, header) && ::fsync(tempFd) == 0;
+    ::close(tempFd);
+    std::error_code error;
+    if (ok) {
+        fs::rename(temp, logPath, error);
+    }
+    if (!ok || error) {
+        fs::remove(temp, error);
+        return false;
+    }
+    // 改名落盘后，之后fdatasync的事件才一定在新日志中
+    fs::path parent = fs::path(logPath).parent_path();
+    syncPath(parent.empty() ? "." : parent.string(), true);
+
+    int newFd = ::open(logPath.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (newFd < 0) {
+        return false;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = newFd;
+    logBytes = header.size();
+    return true;
+}
+
+bool LogStorage::append(StorageEvent& event) {
+    if (!hasBase) {
+        return false;  // 没有快照时日志中的事件无法重放，调用者改为写快照
+    }
+    event.sequence = last + 1;
+    std::string record = encodeEvent(event);
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (broken) {
+            return false;  // 之前的提交组写入失败，写快照后才继续追加
+        }
+        queue += record;
+        queuedLast = event.sequence;
+    }
+    queued.notify_one();
+    last = event.sequence;
+    ++pending;
+    return true;
+}
+
+bool LogStorage::waitDurable(uint64_t sequence) const {
+    std::unique_lock<std::mutex> lock(writerMutex);
+    flushed.wait(lock, [&]() { return durable >= sequence || failedThrough >= sequence; });
+    return durable >= sequence;
+}
+
+bool LogStorage::writeSnapshot(const std::string& data) {
+    // 调用者持有ParkingLot的锁，不会再有新事件；等写入线程处理完已提交给它的事件后再替换日志
+    std::unique_lock<std::mutex> lock(writerMutex);
+    flushed.wait(lock, [&]() { return queue.empty() && !writing; });
+    if (!snapshot.writeSnapshot(data)) {
+        return false;
+    }
+    // 快照已包含全部事件并已写入磁盘；替换日志失败时旧事件的序号都不超过快照中的序号，重放时跳过
+    snapshotSequence = last;
+    pending = 0;
+    if (!resetLog(last)) {
+        std::cerr << "Cannot reset event log " << logPath << std::endl;
+    }
+    durable = last;
+    broken = false;
+    hasBase = true;
+    flushed.notify_all();
+    return true;
+}
+
+void LogStorage::scan(uint64_t after, uint64_t upTo, const std::function<bool(const StorageEvent&)>& consumer) const {
+    waitDurable(std::min(upTo, last));  // 队列中还没写入的事件先写入日志
+    std::ifstream in(logPath, std::ios::binary);
+    uint64_t sequence;
+    if (!in || !readLogHeader(in, sequence)) {
+        return;
+    }
+    StorageEvent event;
+    while (readEvent(in, event) && event.sequence <= upTo) {
+        if (event.sequence > after && !consumer(event)) {
+            return;
+        }
+    }
+}
+
+std::vector<StorageEvent> LogStorage::lookup(const std::string& plate) const {
+    std::vector<StorageEvent> events;
+    scan(snapshotSequence, last, [&](const StorageEvent& event) {
+        if (event.plate == plate) {
+            events.push_back(event);
+        }
+        return true;
+    });
+    return events;
+}
+
+std::unique_ptr<StorageEngine> createStorageEngine(const std::string& name, const std::string& path) {
+    if (name == "file") {
+        return std::make_unique<FileStorage>(path);
+    }
+    if (name == "log") {
+        return std::make_unique<LogStorage>(path);
+    }
+    if (name == "sqlite") {
+        return std::make_unique<SqliteStorage>(path);
+    }
+    throw std::invalid_argument("Unknown storage engine: " + name);
+}
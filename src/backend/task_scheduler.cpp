@@ -0,0 +1,317 @@
+/**
+ * @file task_scheduler.cpp
+ * @brief 后台任务调度器的具体实现
+ */
+#include "include/task_scheduler.h"
+#include <algorithm>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <iostream>
+
+struct TaskHandle::State {
+    std::string type;
+    TaskPriority priority;
+    std::function<void()> function;
+    std::chrono::milliseconds interval;             // 周期任务的间隔，0表示只执行一次
+    std::atomic<bool> cancelled{false};
+    std::chrono::steady_clock::time_point readyAt;  // 最近一次放入队列的时间
+};
+
+void TaskHandle::cancel() {
+    if (state) {
+        state->cancelled = true;
+    }
+}
+
+bool TaskHandle::cancelled() const {
+    return state && state->cancelled;
+}
+
+namespace {
+// 当前线程所属的调度器和工作线程编号，工作线程内提交的任务放入自己的队列
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local size_t currentWorker = 0;
+
+uint64_t threadCpuNanos() {
+    timespec ts;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint64_t elapsedNanos(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return static_cast<uint64_t>(std::max<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count()));
+}
+
+const size_t MAX_DEFAULT_THREADS = 8;
+}
+
+TaskScheduler::TaskScheduler(size_t threads) {
+    if (threads == 0) {
+        threads = std::min<size_t>(MAX_DEFAULT_THREADS, std::max(2u, std::thread::hardware_concurrency()));
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    // 队列全部创建后再启动线程，窃取时遍历的队列列表不再变化
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&TaskScheduler::runWorker, this, i);
+    }
+    timerThread = std::thread(&TaskScheduler::runTimer, this);
+}
+
+TaskScheduler::~TaskScheduler() {
+    shutdown();
+}
+
+TaskScheduler::TaskPtr TaskScheduler::makeTask(const std::string& type, TaskPriority priority,
+                                               std::function<void()> function, std::chrono::milliseconds interval) {
+    auto task = std::make_shared<TaskHandle::State>();
+    task->type = type;
+    task->priority = priority;
+    task->function = std::move(function);
+    task->interval = interval;
+    return task;
+}
+
+TaskHandle TaskScheduler::submit(const std::string& type, TaskPriority priority, std::function<void()> function) {
+    TaskHandle handle;
+    handle.state = makeTask(type, priority, std::move(function), std::chrono::milliseconds(0));
+    enqueue(handle.state);
+    return handle;
+}
+
+TaskHandle TaskScheduler::schedule(const std::string& type, TaskPriority priority, std::chrono::milliseconds delay,
+                                   std::function<void()> function) {
+    TaskHandle handle;
+    handle.state = makeTask(type, priority, std::move(function), std::chrono::milliseconds(0));
+    if (delay.count() <= 0) {
+        enqueue(handle.state);
+    } else {
+        arm(handle.state, Clock::now() + delay);
+    }
+    return handle;
+}
+
+TaskHandle TaskScheduler::scheduleEvery(const std::string& type, TaskPriority priority,
+                                        std::chrono::milliseconds interval, std::function<void()> function) {
+    TaskHandle handle;
+    handle.state = makeTask(type, priority, std::move(function), std::max(interval, std::chrono::milliseconds(1)));
+    enqueue(handle.state);
+    return handle;
+}
+
+void TaskScheduler::enqueue(const TaskPtr& task) {
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        TaskTypeStats& stats = typeStats[task->type];
+        stats.type = task->type;
+        ++stats.submitted;
+    }
+    if (stopping) {
+        task->cancelled = true;
+        countCancelled(task);
+        return;
+    }
+
+    task->readyAt = Clock::now();
+    size_t index = currentScheduler == this ? currentWorker : nextQueue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks[static_cast<int>(task->priority)].push_back(task);
+    }
+    ++queuedCount;
+    {
+        // 加锁后再通知，避免工作线程检查完queuedCount、尚未等待时错过通知
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    taskReady.notify_one();
+}
+
+void TaskScheduler::arm(const TaskPtr& task, Clock::time_point due) {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    if (stopping) {
+        task->cancelled = true;
+        return;
+    }
+    timers.push_back(TimerEntry{due, timerOrder++, task});
+    std::push_heap(timers.begin(), timers.end(), std::greater<TimerEntry>());
+    if (timers.front().task == task) {
+        timerChanged.notify_one();  // 新任务最早到期，定时线程需要提前醒来
+    }
+}
+
+TaskScheduler::TaskPtr TaskScheduler::take(size_t self) {
+    size_t count = queues.size();
+    for (int priority = 0; priority < 3; ++priority) {
+        {
+            WorkerQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks[priority].empty()) {
+                TaskPtr task = std::move(own.tasks[priority].back());
+                own.tasks[priority].pop_back();
+                return task;
+            }
+        }
+        for (size_t k = 1; k < count; ++k) {
+            WorkerQueue& victim = *queues[(self + k) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks[priority].empty()) {
+                TaskPtr task = std::move(victim.tasks[priority].front());
+                victim.tasks[priority].pop_front();
+                ++steals;
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void TaskScheduler::countCancelled(const TaskPtr& task) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    ++typeStats[task->type].cancelled;
+}
+
+void TaskScheduler::execute(const TaskPtr& task) {
+    if (task->cancelled) {
+        countCancelled(task);
+        return;
+    }
+    Clock::time_point started = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        TaskTypeStats& stats = typeStats[task->type];
+        ++stats.running;
+        stats.queueWaitNanos += elapsedNanos(task->readyAt, started);
+    }
+
+    uint64_t cpuStarted = threadCpuNanos();
+    bool succeeded = true;
+    try {
+        task->function();
+    } catch (const std::exception& e) {
+        succeeded = false;
+        std::cerr << "Background task " << task->type << " failed: " << e.what() << std::endl;
+    } catch (...) {
+        succeeded = false;
+        std::cerr << "Background task " << task->type << " failed" << std::endl;
+    }
+    uint64_t cpu = threadCpuNanos() - cpuStarted;
+    Clock::time_point finished = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        TaskTypeStats& stats = typeStats[task->type];
+        --stats.running;
+        ++(succeeded ? stats.completed : stats.failed);
+        stats.cpuNanos += cpu;
+        stats.wallNanos += elapsedNanos(started, finished);
+    }
+
+    // 周期任务执行结束后才重新安排，同一个周期任务不会并发执行
+    if (task->interval.count() > 0 && !task->cancelled) {
+        arm(task, finished + task->interval);
+    }
+}
+
+void TaskScheduler::runWorker(size_t index) {
+    currentScheduler = this;
+    currentWorker = index;
+    while (!stopping) {
+        TaskPtr task = take(index);
+        if (task) {
+            --queuedCount;
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        taskReady.wait(lock, [this] { return stopping || queuedCount > 0; });
+    }
+}
+
+void TaskScheduler::runTimer() {
+    std::unique_lock<std::mutex> lock(timerMutex);
+    while (!stopping) {
+        if (timers.empty()) {
+            timerChanged.wait(lock);
+            continue;
+        }
+        Clock::time_point due = timers.front().due;
+        if (due > Clock::now()) {
+            timerChanged.wait_until(lock, due);
+            continue;
+        }
+        std::pop_heap(timers.begin(), timers.end(), std::greater<TimerEntry>());
+        TaskPtr task = std::move(timers.back().task);
+        timers.pop_back();
+        if (!task->cancelled) {
+            lock.unlock();
+            enqueue(task);
+            lock.lock();
+        }
+    }
+}
+
+void TaskScheduler::shutdown() {
+    if (stopping.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    taskReady.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+    }
+    timerChanged.notify_all();
+    for (std::thread& worker : workers) {
+        if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+            worker.join();
+        }
+    }
+    if (timerThread.joinable()) {
+        timerThread.join();
+    }
+
+    // 线程都已退出，丢弃尚未执行的任务
+    for (const auto& queue : queues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        for (auto& tasks : queue->tasks) {
+            for (const TaskPtr& task : tasks) {
+                task->cancelled = true;
+                countCancelled(task);
+            }
+            tasks.clear();
+        }
+    }
+    queuedCount = 0;
+    std::lock_guard<std::mutex> lock(timerMutex);
+    for (const TimerEntry& entry : timers) {
+        entry.task->cancelled = true;
+    }
+    timers.clear();
+}
+
+TaskSchedulerStats TaskScheduler::getStats() const {
+    TaskSchedulerStats result;
+    result.workers = queues.size();
+    for (const auto& queue : queues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        for (int priority = 0; priority < 3; ++priority) {
+            result.queued[priority] += queue->tasks[priority].size();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        result.delayed = timers.size();
+    }
+    result.steals = steals;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    for (const auto& entry : typeStats) {
+        result.types.push_back(entry.second);
+    }
+    return result;
+}
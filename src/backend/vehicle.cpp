@@ -9,7 +9,7 @@ Vehicle::Vehicle(const std::string& plate, const std::string& vType)
     , type(vType)            // 初始化车型
     , entryTime(std::time(nullptr))  // 获取当前系统时间作为入场时间
     , exitTime(0)            // 初始化出场时间为0（表示未出场）
-    , fee(0.0)              // 初始化费用为0
+    , fee(0)                // 初始化费用为0
 {
     // 使用初始化列表完成所有成员初始化
     // 这样做比在构造函数体内赋值更高效
@@ -35,8 +35,8 @@ time_t Vehicle::getExitTime() const {
     return exitTime;
 }
 
-double Vehicle::getFee() const {
-    // 返回当前计算的停车费用
+Cents Vehicle::getFeeCents() const {
+    // 返回当前计算的停车费用（分）
     return fee;
 }
 
@@ -48,20 +48,18 @@ void Vehicle::checkout() {
     }
 }
 
-double Vehicle::calculateFee(time_t currentTime) const {
-    // 计算停车时长（小时）
+Cents Vehicle::calculateFee(time_t currentTime, Cents hourlyRate) const {
+    // 计算停车时长（秒）
     // 如果车辆已出场，使用exitTime计算
     // 如果车辆在场，使用传入的currentTime计算
     time_t endTime = exitTime > 0 ? exitTime : currentTime;
+    int64_t seconds = endTime > entryTime ? static_cast<int64_t>(endTime - entryTime) : 0;
     
-    // 使用difftime计算时间差（秒），然后转换为小时
-    // difftime返回两个time_t之间的秒数差
-    double hours = std::difftime(endTime, entryTime) / 3600.0;
-    
-    return hours;  // 返回停车时长（小时）
+    // 费用 = 秒数 × 每小时费率 / 3600，全程整数运算，加半小时的秒数实现四舍五入
+    return (seconds * hourlyRate + 1800) / 3600;
 }
 
-void Vehicle::setFee(double newFee) {
+void Vehicle::setFeeCents(Cents newFee) {
     // 更新停车费用
     // 通常在车辆出场时，根据时长和费率计算后调用
     fee = newFee;
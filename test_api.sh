@@ -47,18 +47,184 @@ curl -X PUT "${BASE_URL}/api/rate" \
 
 sleep 1
 
-# Test 5: Remove vehicle
-echo -e "\n\n5. Removing vehicle..."
+# Test 5: Get overstay alerts
+echo -e "\n\n5. Getting overstay alerts..."
+curl -X GET "${BASE_URL}/api/alerts/overstay?since=0" \
+     -H "Accept: application/json" \
+     -v
+
+sleep 1
+
+# Test 6: Remove vehicle
+echo -e "\n\n6. Removing vehicle..."
 curl -X DELETE "${BASE_URL}/api/vehicle/苏A12345" \
      -H "Accept: application/json" \
      -v
 
 sleep 1
 
-# Test 6: Get parking history
-echo -e "\n\n6. Getting parking history..."
+# Test 7: Get parking history
+echo -e "\n\n7. Getting parking history..."
 curl -X GET "${BASE_URL}/api/history" \
      -H "Accept: application/json" \
      -v
 
+# Test 8: Retry a removal with the same Idempotency-Key
+echo -e "\n\n8. Retrying removal with Idempotency-Key..."
+for i in 1 2; do
+    curl -X DELETE "${BASE_URL}/api/vehicle/苏A12345" \
+         -H "Accept: application/json" \
+         -H "Idempotency-Key: test-exit-1" \
+         -v
+done
+
+# Test 9: Export history as CSV
+echo -e "\n\n9. Exporting history as CSV..."
+curl -X GET "${BASE_URL}/api/export/history.csv?from=0" \
+     -v
+
+# Test 10: Export history in columnar formats
+echo -e "\n\n10. Exporting history as Arrow and Parquet..."
+curl -X GET "${BASE_URL}/api/export/history.arrow" -o history.arrows -v
+curl -X GET "${BASE_URL}/api/export/history.parquet" -o history.parquet -v
+
+# Test 11: Filter and aggregate history
+echo -e "\n\n11. Querying history (large vehicles over 10 hours, fee up to 20 yuan)..."
+curl -X GET "${BASE_URL}/api/history/query?type=%E5%A4%A7%E5%9E%8B&minDuration=36000&maxFee=20&groupBy=day" \
+     -H "Accept: application/json" \
+     -v
+
+# Test 12: All visits of a vehicle
+echo -e "\n\n12. Getting all visits of a vehicle..."
+curl -X GET "${BASE_URL}/api/vehicle/苏A12345/visits" \
+     -H "Accept: application/json" \
+     -v
+
+# Test 13: History storage tiers
+echo -e "\n\n13. Getting and updating history storage tiers..."
+curl -X GET "${BASE_URL}/api/history/storage" \
+     -H "Accept: application/json" \
+     -v
+curl -X PUT "${BASE_URL}/api/history/storage" \
+     -H "Content-Type: application/json" \
+     -d '{"hotDays": 30, "cacheMB": 64}' \
+     -v
+
+# Test 14: Multiple parking lots
+echo -e "\n\n14. Creating a parking lot and parking in it..."
+curl -X POST "${BASE_URL}/api/lots" \
+     -H "Content-Type: application/json" \
+     -d '{"id": "north", "capacity": 50, "smallRate": 6, "largeRate": 10}' \
+     -v
+curl -X POST "${BASE_URL}/api/lots/north/vehicle" \
+     -H "Content-Type: application/json" \
+     -d '{"plate": "苏A12345", "type": "小型"}' \
+     -v
+curl -X GET "${BASE_URL}/api/lots/north/status" \
+     -H "Accept: application/json" \
+     -v
+curl -X GET "${BASE_URL}/api/lots" \
+     -H "Accept: application/json" \
+     -v
+
+# Test 15: Partitioned parking lot
+echo -e "\n\n15. Creating a partitioned parking lot..."
+curl -X POST "${BASE_URL}/api/lots" \
+     -H "Content-Type: application/json" \
+     -d '{"id": "hub", "capacity": 2, "partitions": 4}' \
+     -v
+for plate in 苏A00001 苏A00002 苏A00003; do
+    curl -X POST "${BASE_URL}/api/lots/hub/vehicle" \
+         -H "Content-Type: application/json" \
+         -d "{\"plate\": \"${plate}\", \"type\": \"小型\"}" \
+         -v
+done
+curl -X GET "${BASE_URL}/api/lots/hub/current-vehicles" \
+     -H "Accept: application/json" \
+     -v
+
+# Test 16: Background task scheduler
+echo -e "\n\n16. Getting background task scheduler stats..."
+curl -X GET "${BASE_URL}/api/scheduler" \
+     -H "Accept: application/json" \
+     -v
+
+# Test 17: Parking lots keep their capacity, overstay limits and occupancy series across a restart
+# 另起一个使用临时数据文件的服务器，创建停车场、设置停车时限、进出一辆车后重启，检查容量、时限和占用时间序列
+echo -e "\n\n17. Restarting a server with large and partitioned lots..."
+RESTART_PORT=8091
+RESTART_DIR=$(mktemp -d)
+RESTART_URL="http://localhost:${RESTART_PORT}"
+start_restart_server() {
+    PARKING_PORT=${RESTART_PORT} PARKING_DATA="${RESTART_DIR}/parking_data.dat" \
+        ./parking_api_server > "${RESTART_DIR}/server.log" 2>&1 &
+    RESTART_PID=$!
+    sleep 1
+}
+start_restart_server
+curl -X POST "${RESTART_URL}/api/lots" \
+     -H "Content-Type: application/json" \
+     -d '{"id": "big", "capacity": 5000}'
+curl -X POST "${RESTART_URL}/api/lots" \
+     -H "Content-Type: application/json" \
+     -d '{"id": "hub", "capacity": 2000, "partitions": 3}'
+curl -X PUT "${RESTART_URL}/api/lots/hub/alerts/overstay" \
+     -H "Content-Type: application/json" \
+     -d '{"type": "小型", "limitMinutes": 90}'
+curl -X POST "${RESTART_URL}/api/lots/big/vehicle" \
+     -H "Content-Type: application/json" \
+     -d '{"plate": "京R12345", "type": "小型"}'
+curl -X DELETE "${RESTART_URL}/api/lots/big/vehicle/京R12345"
+# 分区停车场：几辆车依次进出，落在不同分区，整个停车场的最大占用数仍为1
+for PLATE in 京R20001 京R20002 京R20003 京R20004; do
+    curl -X POST "${RESTART_URL}/api/lots/hub/vehicle" \
+         -H "Content-Type: application/json" \
+         -d "{\"plate\": \"${PLATE}\", \"type\": \"小型\"}"
+    curl -X DELETE "${RESTART_URL}/api/lots/hub/vehicle/${PLATE}"
+done
+# 占用时间序列每10秒保存一次
+sleep 11
+kill ${RESTART_PID}
+wait ${RESTART_PID} 2>/dev/null
+start_restart_server
+LOTS=$(curl -s "${RESTART_URL}/api/lots")
+echo "${LOTS}"
+if echo "${LOTS}" | grep -q '"id":"big","capacity":5000' && echo "${LOTS}" | grep -q '"id":"hub","capacity":2000'; then
+    echo "Capacity preserved after restart"
+else
+    echo "FAILED: capacity changed after restart"
+fi
+LIMITS=$(curl -s "${RESTART_URL}/api/lots/hub/alerts/overstay?since=0")
+echo "${LIMITS}"
+if echo "${LIMITS}" | grep -q '"小型":5400'; then
+    echo "Overstay limit preserved after restart"
+else
+    echo "FAILED: overstay limit changed after restart"
+fi
+SERIES=$(curl -s "${RESTART_URL}/api/lots/big/stats/occupancy?resolution=hour")
+echo "${SERIES}"
+if echo "${SERIES}" | grep -q '"max":1'; then
+    echo "Occupancy series preserved after restart"
+else
+    echo "FAILED: occupancy series lost after restart"
+fi
+HUB_SERIES=$(curl -s "${RESTART_URL}/api/lots/hub/stats/occupancy?resolution=hour")
+echo "${HUB_SERIES}"
+if echo "${HUB_SERIES}" | grep -q '"max":1' && ! echo "${HUB_SERIES}" | grep -q '"max":[2-9]'; then
+    echo "Partitioned occupancy series preserved after restart"
+else
+    echo "FAILED: partitioned occupancy series wrong after restart"
+fi
+kill ${RESTART_PID}
+wait ${RESTART_PID} 2>/dev/null
+rm -rf "${RESTART_DIR}"
+
+# Test 18: Rates above the maximum are rejected
+echo -e "\n\n18. Setting an out-of-range rate (should fail)..."
+curl -X PUT "${BASE_URL}/api/rate" \
+     -H "Content-Type: application/json" \
+     -H "Accept: application/json" \
+     -d '{"smallRate": 90000000000000, "largeRate": 10.0}' \
+     -v
+
 echo -e "\n\nAPI testing completed."
\ No newline at end of file